@@ -0,0 +1,549 @@
+/*********************************************************************************************************************
+ *
+ * corebenchmark.cpp
+ *
+ * Micro-benchmarks of the hot paths of the core library (CPU only: runs without GPU nor Vulkan driver)
+ * Each benchmark runs batches of iterations, doubled until a batch lasts MIN_TIME_MS, and reports the mean time
+ * of an iteration of the last batch
+ *
+ * Usage: CoreBenchmark [filter]
+ * (filter: only the benchmarks whose name contains it)
+ * Before the benchmarks, checks that the SIMD culling gives exactly the visible objects of the scalar reference,
+ * and that the mesh codecs give back the encoded vertices and triangles (returns EXIT_FAILURE otherwise)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <thread>
+
+#include "core/geometry.h"
+#include "core/imageprocessing.h"
+#include "core/culling.h"
+#include "core/scenegraph.h"
+#include "core/gltf.h"
+#include "core/meshcodec.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+
+namespace
+{
+    using namespace VulkanDemo;
+
+    constexpr double MIN_TIME_MS = 200.0;
+
+    // results of the benchmarks are accumulated here, so that the compiler cannot remove the measured code
+    volatile size_t g_sink = 0;
+
+
+    struct Benchmark
+    {
+        std::string name;
+        size_t items;                       // nb of items processed by an iteration (throughput)
+        std::function<size_t()> iteration;
+    };
+
+
+    /*
+     * Runs a benchmark and prints its mean time per iteration
+     */
+    void run(Benchmark const& _benchmark)
+    {
+        g_sink = g_sink + _benchmark.iteration();      // warm-up
+
+        uint64_t iterations = 1;
+        double elapsedMs = 0.0;
+        while (true)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                g_sink = g_sink + _benchmark.iteration();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            elapsedMs = std::chrono::duration<double, std::milli>(end - start).count();
+            if (elapsedMs >= MIN_TIME_MS) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        double iterationUs = 1000.0 * elapsedMs / static_cast<double>(iterations);
+        double itemsPerSecond = static_cast<double>(_benchmark.items) * 1000000.0 / iterationUs;
+        std::cout << std::left << std::setw(36) << _benchmark.name << std::right
+                  << std::setw(14) << std::fixed << std::setprecision(3) << iterationUs << " us"
+                  << std::setw(14) << std::setprecision(1) << itemsPerSecond / 1000000.0 << " M items/s"
+                  << std::setw(12) << iterations << " iterations" << std::endl;
+    }
+
+
+    /*
+     * Same triangles, in the same order (the corners of a decoded triangle can be rotated)
+     */
+    bool haveSameTriangles(const std::vector<uint32_t>& _indices, const std::vector<uint32_t>& _decoded)
+    {
+        if (_indices.size() != _decoded.size()) {
+            return false;
+        }
+        for (size_t i = 0; i + 2 < _indices.size(); i += 3)
+        {
+            bool same = false;
+            for (size_t r = 0; r < 3 && !same; r++) {
+                same = _decoded[i] == _indices[i + r] && _decoded[i + 1] == _indices[i + (r + 1) % 3] && _decoded[i + 2] == _indices[i + (r + 2) % 3];
+            }
+            if (!same) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    /*
+     * Wavefront content of a grid of _size x _size quads (2 triangles each), with texture coordinates and normals
+     * (inner vertices are shared by 6 triangle corners)
+     */
+    std::string generateObjGrid(uint32_t _size)
+    {
+        std::ostringstream obj;
+        for (uint32_t y = 0; y <= _size; y++)
+        {
+            for (uint32_t x = 0; x <= _size; x++)
+            {
+                float u = static_cast<float>(x) / _size;
+                float v = static_cast<float>(y) / _size;
+                obj << "v " << u << " " << 0.1f * std::sin(10.0f * u) << " " << v << "\n";
+                obj << "vt " << u << " " << v << "\n";
+                obj << "vn 0 1 0\n";
+            }
+        }
+        for (uint32_t y = 0; y < _size; y++)
+        {
+            for (uint32_t x = 0; x < _size; x++)
+            {
+                uint32_t i0 = y * (_size + 1) + x + 1;      // obj indices start at 1
+                uint32_t i1 = i0 + 1;
+                uint32_t i2 = i0 + _size + 1;
+                uint32_t i3 = i2 + 1;
+                obj << "f " << i0 << "/" << i0 << "/" << i0 << " " << i1 << "/" << i1 << "/" << i1 << " " << i3 << "/" << i3 << "/" << i3 << "\n";
+                obj << "f " << i0 << "/" << i0 << "/" << i0 << " " << i3 << "/" << i3 << "/" << i3 << " " << i2 << "/" << i2 << "/" << i2 << "\n";
+            }
+        }
+        return obj.str();
+    }
+
+
+    /*
+     * Writes a .glb file holding the same grid as generateObjGrid(): float positions and normals (copied as they are),
+     * normalized 16 bit texture coordinates (converted), 32 bit indices
+     */
+    void writeGlbGrid(uint32_t _size, const std::string& _path)
+    {
+        uint32_t vertexCount = (_size + 1) * (_size + 1);
+        uint32_t indexCount = _size * _size * 6;
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<uint16_t> texCoords;
+        std::vector<uint32_t> indices;
+        for (uint32_t y = 0; y <= _size; y++)
+        {
+            for (uint32_t x = 0; x <= _size; x++)
+            {
+                float u = static_cast<float>(x) / _size;
+                float v = static_cast<float>(y) / _size;
+                positions.insert(positions.end(), { u, 0.1f * std::sin(10.0f * u), v });
+                normals.insert(normals.end(), { 0.0f, 1.0f, 0.0f });
+                texCoords.insert(texCoords.end(), { static_cast<uint16_t>(u * 65535.0f), static_cast<uint16_t>(v * 65535.0f) });
+            }
+        }
+        for (uint32_t y = 0; y < _size; y++)
+        {
+            for (uint32_t x = 0; x < _size; x++)
+            {
+                uint32_t i0 = y * (_size + 1) + x;
+                uint32_t i1 = i0 + 1;
+                uint32_t i2 = i0 + _size + 1;
+                uint32_t i3 = i2 + 1;
+                indices.insert(indices.end(), { i0, i1, i3, i0, i3, i2 });
+            }
+        }
+
+        // binary chunk: positions, normals, texture coordinates, indices (all sizes are multiples of 4)
+        size_t positionsSize = positions.size() * sizeof(float);
+        size_t texCoordsSize = texCoords.size() * sizeof(uint16_t);
+        size_t indicesSize = indices.size() * sizeof(uint32_t);
+        std::string binary(2 * positionsSize + texCoordsSize + indicesSize, '\0');
+        std::memcpy(&binary[0], positions.data(), positionsSize);
+        std::memcpy(&binary[positionsSize], normals.data(), positionsSize);
+        std::memcpy(&binary[2 * positionsSize], texCoords.data(), texCoordsSize);
+        std::memcpy(&binary[2 * positionsSize + texCoordsSize], indices.data(), indicesSize);
+
+        std::ostringstream json;
+        json << "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+             << "\"nodes\":[{\"mesh\":0,\"translation\":[0,1,0]}],"
+             << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+             << "\"buffers\":[{\"byteLength\":" << binary.size() << "}],"
+             << "\"bufferViews\":["
+             << "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << positionsSize << "},"
+             << "{\"buffer\":0,\"byteOffset\":" << positionsSize << ",\"byteLength\":" << positionsSize << "},"
+             << "{\"buffer\":0,\"byteOffset\":" << 2 * positionsSize << ",\"byteLength\":" << texCoordsSize << "},"
+             << "{\"buffer\":0,\"byteOffset\":" << 2 * positionsSize + texCoordsSize << ",\"byteLength\":" << indicesSize << "}],"
+             << "\"accessors\":["
+             << "{\"bufferView\":0,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\",\"min\":[0,-0.1,0],\"max\":[1,0.1,1]},"
+             << "{\"bufferView\":1,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\"},"
+             << "{\"bufferView\":2,\"componentType\":5123,\"normalized\":true,\"count\":" << vertexCount << ",\"type\":\"VEC2\"},"
+             << "{\"bufferView\":3,\"componentType\":5125,\"count\":" << indexCount << ",\"type\":\"SCALAR\"}]}";
+        std::string jsonChunk = json.str();
+        jsonChunk.resize((jsonChunk.size() + 3) & ~size_t(3), ' ');
+
+        auto writeUint32 = [](std::ofstream& _file, uint32_t _value) { _file.write(reinterpret_cast<const char*>(&_value), sizeof(_value)); };
+        std::ofstream file(_path, std::ios::binary);
+        writeUint32(file, 0x46546C67);
+        writeUint32(file, 2);
+        writeUint32(file, static_cast<uint32_t>(12 + 8 + jsonChunk.size() + 8 + binary.size()));
+        writeUint32(file, static_cast<uint32_t>(jsonChunk.size()));
+        writeUint32(file, 0x4E4F534A);
+        file.write(jsonChunk.data(), jsonChunk.size());
+        writeUint32(file, static_cast<uint32_t>(binary.size()));
+        writeUint32(file, 0x004E4942);
+        file.write(binary.data(), binary.size());
+    }
+
+
+    /*
+     * RGBA image with some content (gradients and noise)
+     */
+    std::vector<uint8_t> generateImage(uint32_t _width, uint32_t _height)
+    {
+        std::mt19937 random(42);
+        std::vector<uint8_t> pixels(static_cast<size_t>(_width) * _height * 4);
+        for (uint32_t y = 0; y < _height; y++)
+        {
+            for (uint32_t x = 0; x < _width; x++)
+            {
+                uint8_t* pixel = &pixels[(static_cast<size_t>(y) * _width + x) * 4];
+                pixel[0] = static_cast<uint8_t>(x);
+                pixel[1] = static_cast<uint8_t>(y);
+                pixel[2] = static_cast<uint8_t>(random());
+                pixel[3] = 255;
+            }
+        }
+        return pixels;
+    }
+
+
+    /*
+     * Bounding spheres scattered around the camera, about half of them in the frustum
+     */
+    std::vector<glm::vec4> generateSpheres(uint32_t _count)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+        std::vector<glm::vec4> spheres(_count);
+        for (auto& sphere : spheres) {
+            sphere = glm::vec4(position(random), position(random), position(random), radius(random));
+        }
+        return spheres;
+    }
+
+
+    /*
+     * Bounding volumes scattered around the camera: boxes of various proportions, and their spheres
+     */
+    BoundsSoA generateBounds(uint32_t _count)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> extent(0.05f, 2.0f);
+
+        BoundsSoA bounds;
+        bounds.resize(_count);
+        for (uint32_t i = 0; i < _count; i++)
+        {
+            Bounds object;
+            object.center = glm::vec3(position(random), position(random), position(random));
+            object.extents = glm::vec3(extent(random), extent(random), extent(random));
+            object.radius = glm::length(object.extents);
+            bounds.set(i, object);
+        }
+        return bounds;
+    }
+
+
+    /*
+     * Tree of _branching^3 leaves (plus the inner nodes): each node is rotated and moved relatively to its parent
+     */
+    void generateScene(SceneGraph& _scene, uint32_t _branching, std::vector<SceneGraph::NodeHandle>& _leaves)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        auto addChild = [&](SceneGraph::NodeHandle _parent)
+        {
+            glm::quat rotation = glm::angleAxis(offset(random), glm::vec3(0.0f, 1.0f, 0.0f));
+            return _scene.addNode(_parent, glm::vec3(offset(random), offset(random), offset(random)), rotation);
+        };
+
+        SceneGraph::NodeHandle root = _scene.addNode(SceneGraph::NO_PARENT);
+        for (uint32_t i = 0; i < _branching; i++)
+        {
+            SceneGraph::NodeHandle group = addChild(root);
+            for (uint32_t j = 0; j < _branching; j++)
+            {
+                SceneGraph::NodeHandle object = addChild(group);
+                for (uint32_t k = 0; k < _branching; k++) {
+                    _leaves.push_back(addChild(object));
+                }
+            }
+        }
+        _scene.update();
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    std::string filter = (argc > 1) ? argv[1] : "";
+
+    // 1. -----------------------------------------------------------------------------------------
+    // inputs
+    const uint32_t GRID_SIZE = 256;
+    const uint32_t IMAGE_SIZE = 1024;
+    const uint32_t SPHERE_COUNT = 16384;
+    const uint32_t OBJECT_COUNT = 1000000;
+    const uint32_t SCENE_BRANCHING = 64;
+    const uint32_t MOVED_LEAF_COUNT = 1024;
+
+    std::string objText = generateObjGrid(GRID_SIZE);
+    std::istringstream objStream(objText);
+    std::vector<Vertex> corners = parseObj(objStream);
+    MeshData mesh = weldVertices(corners);
+
+    // packed positions of the welded grid (vertices in order of first use), as in the geometry pool
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+    std::vector<float> positions(3 * static_cast<size_t>(vertexCount));
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        positions[3 * v] = mesh.vertices[v].pos.x;
+        positions[3 * v + 1] = mesh.vertices[v].pos.y;
+        positions[3 * v + 2] = mesh.vertices[v].pos.z;
+    }
+    size_t positionsSize = positions.size() * sizeof(float);
+    size_t indicesSize = mesh.indices.size() * sizeof(uint32_t);
+    std::vector<uint8_t> encodedPositions = encodeVertexBuffer(reinterpret_cast<const uint8_t*>(positions.data()), vertexCount, 12);
+    std::vector<uint8_t> encodedIndices = encodeIndexBuffer(mesh.indices.data(), indexCount);
+    std::vector<float> decodedPositions(positions.size());
+    std::vector<uint32_t> decodedIndices(indexCount);
+
+    std::string bytes(65536, '\0');
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = static_cast<char>(i * 31);
+    }
+
+    std::string glbPath = (std::filesystem::temp_directory_path() / "corebenchmark_grid.glb").string();
+    writeGlbGrid(GRID_SIZE, glbPath);
+    GltfModel gltf;
+    gltf.load(glbPath);
+    const GltfPrimitive& primitive = gltf.getMeshes()[0].primitives[0];
+    std::vector<float> streams(static_cast<size_t>(gltf.getVertexCount(primitive)) * (3 + 3 + 2));
+    std::vector<uint32_t> gltfIndices(gltf.getIndexCount(primitive));
+
+    std::vector<uint8_t> image = generateImage(IMAGE_SIZE, IMAGE_SIZE);
+    uint32_t mipCount = computeMipCount(IMAGE_SIZE, IMAGE_SIZE);
+    std::vector<uint8_t> halfImage;
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.2f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 viewProj = proj * view;
+    Frustum frustum = extractFrustum(viewProj);
+    std::vector<glm::vec4> spheres = generateSpheres(SPHERE_COUNT);
+    std::vector<uint32_t> visible;
+    visible.reserve(spheres.size());
+    BoundsSoA bounds = generateBounds(OBJECT_COUNT);
+    std::vector<uint32_t> visibleObjects;
+    std::vector<uint32_t> visibleObjectsScalar;
+
+    uint32_t coreCount = std::thread::hardware_concurrency();
+    SceneGraph scene;
+    scene.start((coreCount > 1) ? coreCount - 1 : 0);
+    std::vector<SceneGraph::NodeHandle> leaves;
+    generateScene(scene, SCENE_BRANCHING, leaves);
+    SceneGraph sceneSingleThread;
+    std::vector<SceneGraph::NodeHandle> leavesSingleThread;
+    generateScene(sceneSingleThread, SCENE_BRANCHING, leavesSingleThread);
+    float sceneAngle = 0.0f;     // animates the scene benchmarks (changed at each update)
+
+    std::cout << "mesh: " << corners.size() << " corners, " << mesh.vertices.size() << " vertices; image: "
+              << IMAGE_SIZE << "x" << IMAGE_SIZE << ", " << mipCount << " mips; spheres: "
+              << cullSpheres(frustum, spheres, visible) << " visible / " << spheres.size() << std::endl;
+
+    // the frustum is also moved, so that volumes straddle planes in all directions
+    for (float angle = 0.0f; angle < 360.0f; angle += 15.0f)
+    {
+        glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.3f, 1.0f, 0.1f));
+        Frustum rotatedFrustum = extractFrustum(viewProj * rotation);
+        cullBounds(rotatedFrustum, bounds, visibleObjects);
+        cullBoundsScalar(rotatedFrustum, bounds, visibleObjectsScalar);
+        if (visibleObjects != visibleObjectsScalar)
+        {
+            std::cout << "culling/cullBounds (" << getCullingInstructionSet() << "): " << visibleObjects.size()
+                      << " visible objects, scalar reference: " << visibleObjectsScalar.size() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    decodeVertexBuffer(reinterpret_cast<uint8_t*>(decodedPositions.data()), vertexCount, 12, encodedPositions.data(), encodedPositions.size());
+    decodeIndexBuffer(decodedIndices.data(), indexCount, vertexCount, encodedIndices.data(), encodedIndices.size());
+    if (std::memcmp(decodedPositions.data(), positions.data(), positionsSize) != 0 || !haveSameTriangles(mesh.indices, decodedIndices))
+    {
+        std::cout << "codec: the decoded mesh differs from the encoded one" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "codec: positions " << positionsSize << " -> " << encodedPositions.size() << " bytes, indices "
+              << indicesSize << " -> " << encodedIndices.size() << " bytes, decoded mesh identical" << std::endl;
+    std::cout << "glTF: " << gltf.getVertexCount(primitive) << " vertices, " << gltf.getIndexCount(primitive) << " indices, "
+              << gltf.computeMeshInstances().size() << " mesh instances" << std::endl;
+    std::cout << "objects: " << cullBounds(frustum, bounds, visibleObjects) << " visible / " << bounds.count
+              << ", " << getCullingInstructionSet() << " culling identical to the scalar reference" << std::endl;
+    std::cout << "scene: " << scene.getNodeCount() << " nodes, " << scene.getLevelCount() << " levels, "
+              << ((coreCount > 1) ? coreCount - 1 : 0) << " worker threads" << std::endl;
+
+    // 2. -----------------------------------------------------------------------------------------
+    // benchmarks (items: corners, vertices, bytes (decoded bytes for the codecs), pixels written, spheres, objects or nodes updated)
+    std::vector<Benchmark> benchmarks = {
+        { "geometry/parseObj", corners.size(), [&objText]()
+            {
+                std::istringstream stream(objText);
+                return parseObj(stream).size();
+            } },
+        { "geometry/weldVertices", corners.size(), [&corners]()
+            {
+                return weldVertices(corners).vertices.size();
+            } },
+        { "geometry/computeBoundingSphere", mesh.vertices.size(), [&mesh]()
+            {
+                return static_cast<size_t>(computeBoundingSphere(mesh.vertices).w);
+            } },
+        { "gltf/load", gltf.getVertexCount(primitive), [&glbPath]()
+            {
+                // maps the file and parses its JSON chunk: the binary chunk is not read
+                GltfModel model;
+                model.load(glbPath);
+                return model.getAccessors().size();
+            } },
+        { "gltf/copyStreams", gltf.getVertexCount(primitive), [&gltf, &primitive, &streams, &gltfIndices]()
+            {
+                // positions, normals and indices are copied as they are, texture coordinates are converted
+                const auto& accessors = gltf.getAccessors();
+                uint32_t primitiveVertexCount = gltf.getVertexCount(primitive);
+                size_t copied = GltfModel::copyAttribute(accessors[primitive.positions], streams.data(), 3);
+                copied += GltfModel::copyAttribute(accessors[primitive.normals], streams.data() + 3 * primitiveVertexCount, 3);
+                copied += GltfModel::copyAttribute(accessors[primitive.texCoords], streams.data() + 6 * primitiveVertexCount, 2);
+                copied += gltf.copyIndices(primitive, gltfIndices.data());
+                return copied;
+            } },
+        { "codec/encodeVertexBuffer", positionsSize, [&positions, vertexCount]()
+            {
+                return encodeVertexBuffer(reinterpret_cast<const uint8_t*>(positions.data()), vertexCount, 12).size();
+            } },
+        { "codec/decodeVertexBuffer", positionsSize, [&encodedPositions, &decodedPositions, vertexCount]()
+            {
+                return decodeVertexBuffer(reinterpret_cast<uint8_t*>(decodedPositions.data()), vertexCount, 12,
+                                          encodedPositions.data(), encodedPositions.size());
+            } },
+        { "codec/encodeIndexBuffer", indicesSize, [&mesh, indexCount]()
+            {
+                return encodeIndexBuffer(mesh.indices.data(), indexCount).size();
+            } },
+        { "codec/decodeIndexBuffer", indicesSize, [&encodedIndices, &decodedIndices, indexCount, vertexCount]()
+            {
+                return decodeIndexBuffer(decodedIndices.data(), indexCount, vertexCount, encodedIndices.data(), encodedIndices.size());
+            } },
+        { "hash/vertex", corners.size(), [&corners]()
+            {
+                size_t hash = 0;
+                for (const auto& vertex : corners) {
+                    hash ^= std::hash<Vertex>()(vertex);
+                }
+                return hash;
+            } },
+        { "hash/fnv1a", bytes.size(), [&bytes]()
+            {
+                uint64_t hash = FNV_OFFSET_BASIS;
+                hashBytes(hash, bytes);
+                return static_cast<size_t>(hash);
+            } },
+        { "image/downsampleBox", IMAGE_SIZE * IMAGE_SIZE / 4, [&image, &halfImage]()
+            {
+                downsampleBox(image.data(), IMAGE_SIZE, IMAGE_SIZE, halfImage);
+                return static_cast<size_t>(halfImage[0]);
+            } },
+        { "image/generateMipChain", IMAGE_SIZE * IMAGE_SIZE / 3, [&image, mipCount]()
+            {
+                return generateMipChain(image.data(), IMAGE_SIZE, IMAGE_SIZE, mipCount).back().size();
+            } },
+        { "culling/extractFrustum", 1, [&viewProj]()
+            {
+                return static_cast<size_t>(extractFrustum(viewProj).planes[0].w);
+            } },
+        { "culling/cullSpheres", spheres.size(), [&frustum, &spheres, &visible]()
+            {
+                return static_cast<size_t>(cullSpheres(frustum, spheres, visible));
+            } },
+        { "culling/cullBoundsScalar", bounds.count, [&frustum, &bounds, &visibleObjects]()
+            {
+                return static_cast<size_t>(cullBoundsScalar(frustum, bounds, visibleObjects));
+            } },
+        { std::string("culling/cullBounds (") + getCullingInstructionSet() + ")", bounds.count, [&frustum, &bounds, &visibleObjects]()
+            {
+                return static_cast<size_t>(cullBounds(frustum, bounds, visibleObjects));
+            } },
+        { "scene/updateAll", scene.getNodeCount(), [&scene, &sceneAngle]()
+            {
+                // the root moves: all the world matrices are computed again
+                sceneAngle += 0.01f;
+                scene.setRotation(0, glm::angleAxis(sceneAngle, glm::vec3(0.0f, 1.0f, 0.0f)));
+                return static_cast<size_t>(scene.update());
+            } },
+        { "scene/updateAll (1 thread)", sceneSingleThread.getNodeCount(), [&sceneSingleThread, &sceneAngle]()
+            {
+                sceneAngle += 0.01f;
+                sceneSingleThread.setRotation(0, glm::angleAxis(sceneAngle, glm::vec3(0.0f, 1.0f, 0.0f)));
+                return static_cast<size_t>(sceneSingleThread.update());
+            } },
+        { "scene/updateLeaves", MOVED_LEAF_COUNT, [&scene, &leaves, &sceneAngle]()
+            {
+                // a few leaves move: only their world matrices are computed again
+                sceneAngle += 0.01f;
+                for (uint32_t i = 0; i < MOVED_LEAF_COUNT; i++) {
+                    scene.setTranslation(leaves[i * 97 % leaves.size()], glm::vec3(sceneAngle, 0.0f, 0.0f));
+                }
+                return static_cast<size_t>(scene.update());
+            } },
+    };
+
+    for (const auto& benchmark : benchmarks)
+    {
+        if (benchmark.name.find(filter) != std::string::npos) {
+            run(benchmark);
+        }
+    }
+
+    // the glTF benchmarks are done: the generated file is not left in the temp directory
+    std::error_code error;
+    std::filesystem::remove(glbPath, error);
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*********************************************************************************************************************
+ *
+ * bindlesstextures.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "bindlesstextures.h"
+#include "context.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Creates the descriptor set layout, pool and set of the textures array
+ */
+void BindlessTextures::create(Context& _context)
+{
+    if (!_context.getCapabilities().descriptorIndexing) {
+        throw std::runtime_error("bindless textures require descriptor indexing!");
+    }
+
+    m_capacity = std::min(MAX_TEXTURES, _context.getCapabilities().maxBindlessTextures);
+    m_count = 0;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // Layout: one variable-size array of combined image samplers, that can be updated after being bound
+    VkDescriptorSetLayoutBinding texturesBinding{};
+    texturesBinding.binding = TEXTURES_BINDING;
+    texturesBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    texturesBinding.descriptorCount = m_capacity; // upper bound, actual count given at allocation
+    texturesBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    texturesBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+                                             | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+                                             | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT
+                                             | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &texturesBinding;
+
+    if (vkCreateDescriptorSetLayout(_context.getDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor set layout!");
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // Pool: a single set, shared by all frames in flight (textures are only appended)
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = m_capacity;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(_context.getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor pool!");
+    }
+
+    // 3. -----------------------------------------------------------------------------------------
+    // Set: allocated with the full capacity of the array
+    VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo{};
+    variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+    variableCountInfo.descriptorSetCount = 1;
+    variableCountInfo.pDescriptorCounts = &m_capacity;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = &variableCountInfo;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(_context.getDevice(), &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate bindless descriptor set!");
+    }
+
+    infoLog() << "BindlessTextures::create(): " + std::to_string(m_capacity) + " textures max";
+}
+
+
+/*
+ * Destroys the pool (which frees the set) and the layout
+ */
+void BindlessTextures::cleanup(Context& _context)
+{
+    vkDestroyDescriptorPool(_context.getDevice(), m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_context.getDevice(), m_descriptorSetLayout, nullptr);
+    m_descriptorSet = VK_NULL_HANDLE;
+    m_count = 0;
+}
+
+
+/*
+ * Writes a texture in the next free element of the array, returns its index (i.e., material index)
+ * The new element is not used by pending command buffers, so it can be written while frames are in flight
+ */
+uint32_t BindlessTextures::addTexture(Context& _context, VkImageView _imageView, VkSampler _sampler)
+{
+    if (m_count == m_capacity) {
+        throw std::runtime_error("bindless textures array is full!");
+    }
+
+    setTexture(_context, m_count, _imageView, _sampler);
+    return m_count++;
+}
+
+
+void BindlessTextures::setTexture(Context& _context, uint32_t _index, VkImageView _imageView, VkSampler _sampler)
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = _imageView;
+    imageInfo.sampler = _sampler;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_descriptorSet;
+    descriptorWrite.dstBinding = TEXTURES_BINDING;
+    descriptorWrite.dstArrayElement = _index;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(_context.getDevice(), 1, &descriptorWrite, 0, nullptr);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
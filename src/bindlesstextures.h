@@ -0,0 +1,72 @@
+/*********************************************************************************************************************
+ *
+ * bindlesstextures.h
+ *
+ * All the textures of the scene in one large descriptor array (VK_EXT_descriptor_indexing),
+ * indexed in the fragment shader by the material index of each draw
+ * The array is partially bound, has a variable count, and can be filled after being bound,
+ * so adding materials never requires new descriptor sets nor per-draw descriptor binds
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef BINDLESSTEXTURES_H
+#define BINDLESSTEXTURES_H
+
+
+#include "utils.h"
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class BindlessTextures
+{
+
+public:
+
+    // the textures array is the only binding of its own descriptor set
+    static constexpr uint32_t DESCRIPTOR_SET = 1;
+    static constexpr uint32_t TEXTURES_BINDING = 0;
+
+    static constexpr uint32_t MAX_TEXTURES = 4096; // upper bound, clamped to the device limit
+
+    BindlessTextures() = default;
+
+    BindlessTextures(BindlessTextures const& _other) = default;
+    BindlessTextures& operator=(BindlessTextures const& _other) = default;
+
+    virtual ~BindlessTextures() {};
+
+
+    VkDescriptorSetLayout const getDescriptorSetLayout() const { return m_descriptorSetLayout; }
+    VkDescriptorSet const getDescriptorSet() const { return m_descriptorSet; }
+    uint32_t const getCount() const { return m_count; }
+    uint32_t const getCapacity() const { return m_capacity; }
+
+    void create(Context& _context);
+    void cleanup(Context& _context);
+
+    uint32_t addTexture(Context& _context, VkImageView _imageView, VkSampler _sampler);
+    // replaces a texture already added (e.g. by a smaller version of it)
+    void setTexture(Context& _context, uint32_t _index, VkImageView _imageView, VkSampler _sampler);
+
+
+protected:
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    uint32_t m_capacity = 0;    // size of the descriptor array
+    uint32_t m_count = 0;       // nb of textures written in the array
+
+}; // class BindlessTextures
+
+} // namespace VulkanDemo
+
+#endif // BINDLESSTEXTURES_H
\ No newline at end of file
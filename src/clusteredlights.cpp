@@ -0,0 +1,352 @@
+/*********************************************************************************************************************
+ *
+ * clusteredlights.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "clusteredlights.h"
+#include "context.h"
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Creates the light assignment pipeline, the buffers (sized for MAX_LIGHTS lights) and the descriptor sets
+ */
+void ClusteredLights::create(Context& _context, uint32_t _framesInFlight)
+{
+    m_framesInFlight = _framesInFlight;
+    m_lightsInfos.resize(_framesInFlight);
+
+    // 1. -----------------------------------------------------------------------------------------
+    // buffers: lights of each frame in flight, kept mapped (bound at aligned offsets), and lights of each cluster
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_context.getPhysicalDevice(), &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+
+    VkDeviceSize frameSize = sizeof(LightsHeader) + MAX_LIGHTS * sizeof(PointLight);
+    m_frameStride = (frameSize + alignment - 1) / alignment * alignment;
+    VkDeviceSize lightsBufferSize = m_frameStride * m_framesInFlight;
+
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), lightsBufferSize,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniform,
+                                            m_lightsBuffer, m_lightsBufferMemory);
+    vkMapMemory(_context.getDevice(), m_lightsBufferMemory, 0, lightsBufferSize, 0, reinterpret_cast<void**>(&m_lightsBufferMapped));
+    std::memset(m_lightsBufferMapped, 0, static_cast<size_t>(lightsBufferSize));
+
+    // counts of all clusters, followed by a fixed range of light indices per cluster
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), CLUSTER_COUNT * (1 + MAX_LIGHTS_PER_CLUSTER) * sizeof(uint32_t),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Uniform,
+                                            m_clustersBuffer, m_clustersBufferMemory);
+
+    // 2. -----------------------------------------------------------------------------------------
+    // descriptor set layout (lights, clusters), pipeline layout and pipeline
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    for (uint32_t b = 0; b < bindings.size(); b++)
+    {
+        bindings[b].binding = b;
+        bindings[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[b].descriptorCount = 1;
+        bindings[b].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(_context.getDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light clustering descriptor set layout!");
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkCreatePipelineLayout(_context.getDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light clustering pipeline layout!");
+    }
+
+    createPipeline(_context);
+
+    // 3. -----------------------------------------------------------------------------------------
+    // descriptor sets: one per frame in flight
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * m_framesInFlight;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = m_framesInFlight;
+
+    if (vkCreateDescriptorPool(_context.getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light clustering descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(m_framesInFlight, m_descriptorSetLayout);
+    m_descriptorSets.resize(m_framesInFlight);
+
+    VkDescriptorSetAllocateInfo setAllocInfo{};
+    setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocInfo.descriptorPool = m_descriptorPool;
+    setAllocInfo.descriptorSetCount = m_framesInFlight;
+    setAllocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_context.getDevice(), &setAllocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate light clustering descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < m_framesInFlight; i++)
+    {
+        std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+        bufferInfos[0] = { m_lightsBuffer, i * m_frameStride, frameSize };
+        bufferInfos[1] = { m_clustersBuffer, 0, VK_WHOLE_SIZE };
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        for (uint32_t b = 0; b < descriptorWrites.size(); b++)
+        {
+            descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[b].dstSet = m_descriptorSets[i];
+            descriptorWrites[b].dstBinding = b;
+            descriptorWrites[b].descriptorCount = 1;
+            descriptorWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[b].pBufferInfo = &bufferInfos[b];
+        }
+
+        vkUpdateDescriptorSets(_context.getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    infoLog() << "ClusteredLights::create(): " + std::to_string(GRID_X) + "x" + std::to_string(GRID_Y) + "x" + std::to_string(GRID_Z)
+               + " clusters, " + std::to_string(MAX_LIGHTS) + " lights max ";
+}
+
+
+/*
+ * Loads the light assignment shader and creates its pipeline
+ */
+void ClusteredLights::createPipeline(Context& _context)
+{
+    auto shaderCode = _context.getShaderCompiler().load("cluster_lights.comp", {}, "cluster_lights.spv");
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shaderCode.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(_context.getDevice(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light clustering shader module!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(_context.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline);
+    vkDestroyShaderModule(_context.getDevice(), shaderModule, nullptr);
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light clustering pipeline!");
+    }
+}
+
+
+/*
+ * Hands the pipeline over to the deletion queue, and creates it again from the edited shader
+ */
+void ClusteredLights::reloadPipeline(Context& _context)
+{
+    VkPipeline pipeline = m_pipeline;
+    _context.getDeletionQueue().retire([pipeline](VkDevice _device)
+    {
+        vkDestroyPipeline(_device, pipeline, nullptr);
+    });
+
+    createPipeline(_context);
+}
+
+
+/*
+ * Destroys pipeline, layouts, descriptors and buffers
+ */
+void ClusteredLights::cleanup(Context& _context)
+{
+    vkDestroyDescriptorPool(_context.getDevice(), m_descriptorPool, nullptr);
+    vkDestroyPipeline(_context.getDevice(), m_pipeline, nullptr);
+    vkDestroyPipelineLayout(_context.getDevice(), m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_context.getDevice(), m_descriptorSetLayout, nullptr);
+
+    vkUnmapMemory(_context.getDevice(), m_lightsBufferMemory);
+    vkDestroyBuffer(_context.getDevice(), m_lightsBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_lightsBufferMemory);
+    vkDestroyBuffer(_context.getDevice(), m_clustersBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_clustersBufferMemory);
+    m_lightsBufferMapped = nullptr;
+    m_descriptorSets.clear();
+}
+
+
+/*
+ * Replaces the lights by _count random lights (same lights for a given count: the seed is fixed)
+ */
+void ClusteredLights::generateLights(uint32_t _count, const glm::vec3& _extent)
+{
+    _count = std::min(_count, MAX_LIGHTS);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+    // radius decreases when lights are added, so that the total energy of the scene stays similar
+    float radius = std::clamp(2.0f / std::cbrt(static_cast<float>(std::max(_count, 1u))), 0.15f, 1.0f);
+
+    m_lights.resize(_count);
+    m_speeds.resize(_count);
+    for (uint32_t i = 0; i < _count; i++)
+    {
+        glm::vec3 position = glm::vec3(signedUnit(generator), signedUnit(generator), signedUnit(generator)) * _extent;
+        glm::vec3 color = glm::vec3(unit(generator), unit(generator), unit(generator));
+        color /= std::max(color.r, std::max(color.g, color.b));
+
+        m_lights[i].positionRadius = glm::vec4(position, radius * (0.5f + unit(generator)));
+        m_lights[i].color = glm::vec4(color, 1.0f);
+        m_speeds[i] = signedUnit(generator);
+    }
+
+    infoLog() << "ClusteredLights::generateLights(): " + std::to_string(_count) + " point lights ";
+}
+
+
+/*
+ * Layout bindings of the lights and clusters (read by the fragment shader)
+ */
+void ClusteredLights::addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings)
+{
+    VkDescriptorSetLayoutBinding lightsBinding{};
+    lightsBinding.binding = LIGHTS_BINDING;
+    lightsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    lightsBinding.descriptorCount = 1;
+    lightsBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    lightsBinding.pImmutableSamplers = nullptr;
+    _bindings.push_back(lightsBinding);
+
+    VkDescriptorSetLayoutBinding clustersBinding = lightsBinding;
+    clustersBinding.binding = CLUSTERS_BINDING;
+    _bindings.push_back(clustersBinding);
+}
+
+
+/*
+ * Descriptors required by the lights (one descriptor set per frame in flight)
+ */
+void ClusteredLights::addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight)
+{
+    VkDescriptorPoolSize storageSize{};
+    storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageSize.descriptorCount = 2 * _framesInFlight;
+    _poolSizes.push_back(storageSize);
+}
+
+
+/*
+ * Descriptor writes for the descriptor set of a given frame in flight
+ */
+void ClusteredLights::addDescriptorWrites(VkDescriptorSet _descriptorSet, uint32_t _frameIndex, std::vector<VkWriteDescriptorSet>& _writes)
+{
+    m_lightsInfos[_frameIndex].buffer = m_lightsBuffer;
+    m_lightsInfos[_frameIndex].offset = _frameIndex * m_frameStride;
+    m_lightsInfos[_frameIndex].range = sizeof(LightsHeader) + MAX_LIGHTS * sizeof(PointLight);
+
+    m_clustersInfo.buffer = m_clustersBuffer;
+    m_clustersInfo.offset = 0;
+    m_clustersInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _descriptorSet;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    write.dstBinding = LIGHTS_BINDING;
+    write.pBufferInfo = &m_lightsInfos[_frameIndex];
+    _writes.push_back(write);
+
+    write.dstBinding = CLUSTERS_BINDING;
+    write.pBufferInfo = &m_clustersInfo;
+    _writes.push_back(write);
+}
+
+
+/*
+ * Rotates the lights around the vertical axis, then writes them in view space in the region of the current frame,
+ * after the parameters used to rebuild the clusters (near and far planes are extracted from the projection)
+ */
+void ClusteredLights::update(uint32_t _frameIndex, const glm::mat4& _view, const glm::mat4& _proj, VkExtent2D _renderExtent, float _time)
+{
+    uint8_t* frameData = m_lightsBufferMapped + _frameIndex * m_frameStride;
+
+    LightsHeader header{};
+    header.invProj = glm::inverse(_proj);
+    header.grid = glm::uvec4(GRID_X, GRID_Y, GRID_Z, getLightCount());
+    header.params = glm::vec4(static_cast<float>(_renderExtent.width), static_cast<float>(_renderExtent.height),
+                              _proj[3][2] / _proj[2][2], _proj[3][2] / (_proj[2][2] + 1.0f));
+    std::memcpy(frameData, &header, sizeof(LightsHeader));
+
+    PointLight* lights = reinterpret_cast<PointLight*>(frameData + sizeof(LightsHeader));
+    for (uint32_t i = 0; i < getLightCount(); i++)
+    {
+        float angle = _time * m_speeds[i];
+        glm::vec3 position = glm::vec3(m_lights[i].positionRadius);
+        glm::vec3 rotated(position.x * std::cos(angle) + position.z * std::sin(angle),
+                          position.y,
+                          -position.x * std::sin(angle) + position.z * std::cos(angle));
+
+        lights[i].positionRadius = glm::vec4(glm::vec3(_view * glm::vec4(rotated, 1.0f)), m_lights[i].positionRadius.w);
+        lights[i].color = m_lights[i].color;
+    }
+}
+
+
+/*
+ * Lists the lights of each cluster (one invocation per cluster)
+ */
+void ClusteredLights::recordClustering(VkCommandBuffer _commandBuffer, uint32_t _frameIndex)
+{
+    if (getLightCount() == 0) {
+        return;
+    }
+
+    // the previous frame may still read the clusters in its fragment shaders
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSets[_frameIndex], 0, nullptr);
+    vkCmdDispatch(_commandBuffer, (CLUSTER_COUNT + CLUSTERING_GROUP_SIZE - 1) / CLUSTERING_GROUP_SIZE, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
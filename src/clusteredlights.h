@@ -0,0 +1,122 @@
+/*********************************************************************************************************************
+ *
+ * clusteredlights.h
+ *
+ * Clustered forward shading of many point lights:
+ *  - the view frustum is divided into GRID_X * GRID_Y screen tiles and GRID_Z depth slices (exponential in view depth)
+ *  - each frame, the lights are written in view space (one storage buffer region per frame in flight),
+ *    then a compute pass lists the lights overlapping each cluster
+ *  - the fragment shader only iterates over the lights of its cluster (shaders/clustered_lights.glsl)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef CLUSTEREDLIGHTS_H
+#define CLUSTEREDLIGHTS_H
+
+
+#include "utils.h"
+
+#include <string>
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class ClusteredLights
+{
+
+public:
+
+    // bindings used by the lights in the descriptor set of the app
+    static constexpr uint32_t LIGHTS_BINDING = 6;
+    static constexpr uint32_t CLUSTERS_BINDING = 7;
+
+    static constexpr uint32_t MAX_LIGHTS = 4096;
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256;    // must match the shaders
+    static constexpr uint32_t GRID_X = 16;
+    static constexpr uint32_t GRID_Y = 9;
+    static constexpr uint32_t GRID_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+    ClusteredLights() = default;
+
+    ClusteredLights(ClusteredLights const& _other) = default;
+    ClusteredLights& operator=(ClusteredLights const& _other) = default;
+
+    virtual ~ClusteredLights() {};
+
+
+    uint32_t getLightCount() const { return static_cast<uint32_t>(m_lights.size()); }
+
+    void create(Context& _context, uint32_t _framesInFlight);
+    void cleanup(Context& _context);
+
+    // after cluster_lights.comp was edited (previous pipeline goes to the deletion queue)
+    void reloadPipeline(Context& _context);
+
+    // stress test: _count random point lights, in a box of half size _extent around the origin
+    void generateLights(uint32_t _count, const glm::vec3& _extent);
+
+    static void addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings);
+    static void addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight);
+    void addDescriptorWrites(VkDescriptorSet _descriptorSet, uint32_t _frameIndex, std::vector<VkWriteDescriptorSet>& _writes);
+
+    // used in updateUniformBuffer(): animates the lights and writes them in view space, with the parameters of the grid
+    void update(uint32_t _frameIndex, const glm::mat4& _view, const glm::mat4& _proj, VkExtent2D _renderExtent, float _time);
+    // used in the compute pass of the render graph, before the scene
+    void recordClustering(VkCommandBuffer _commandBuffer, uint32_t _frameIndex);
+
+
+protected:
+
+    static constexpr uint32_t CLUSTERING_GROUP_SIZE = 64;
+
+    void createPipeline(Context& _context);
+
+    // GPU layout of the lights region of a frame (std430): header, then the lights
+    struct LightsHeader
+    {
+        glm::mat4 invProj;
+        glm::uvec4 grid;        // nb of clusters along x, y and z, nb of lights
+        glm::vec4 params;       // render extent, near and far planes
+    };
+
+    struct PointLight
+    {
+        glm::vec4 positionRadius;   // world space (CPU), view space (GPU)
+        glm::vec4 color;
+    };
+
+    uint32_t m_framesInFlight = 0;
+    std::vector<PointLight> m_lights;
+    std::vector<float> m_speeds;            // angular speed of each light around the vertical axis
+
+    // lights of each frame in flight (host visible), lights of each cluster (GPU only)
+    VkBuffer m_lightsBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_lightsBufferMemory = VK_NULL_HANDLE;
+    uint8_t* m_lightsBufferMapped = nullptr;
+    VkDeviceSize m_frameStride = 0;
+    VkBuffer m_clustersBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_clustersBufferMemory = VK_NULL_HANDLE;
+
+    // light assignment
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_descriptorSets;         // one per frame in flight
+
+    // kept alive until vkUpdateDescriptorSets() is called with the writes
+    std::vector<VkDescriptorBufferInfo> m_lightsInfos;
+    VkDescriptorBufferInfo m_clustersInfo{};
+
+}; // class ClusteredLights
+
+} // namespace VulkanDemo
+
+#endif // CLUSTEREDLIGHTS_H
\ No newline at end of file
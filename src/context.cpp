@@ -9,6 +9,9 @@
  *
  *********************************************************************************************************************/
 
+#define NOMINMAX 
+#include <algorithm>
+
 #include "context.h"
 
 
@@ -35,7 +38,7 @@ void Context::createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_1; // 1.1 needed to query optional features (vkGetPhysicalDeviceFeatures2)
 
     // 2. -----------------------------------------------------------------------------------------
     // Fill-in the structure specifying parameters of a newly created instance (mandatory)
@@ -138,6 +141,10 @@ void Context::createLogicalDevice()
  
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // allows fragment shaders to write into storage buffers (virtual texture feedback), if available
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+    deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
     //deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading feature for the device
 
     VkDeviceCreateInfo createInfo{};
@@ -148,8 +155,136 @@ void Context::createLogicalDevice()
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // required extensions, plus the optional ones supported by the device
+    std::vector<const char*> extensions = deviceExtensions;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    bool hasFeatures2 = properties.apiVersion >= VK_API_VERSION_1_1;
+
+    // descriptor indexing (bindless textures)
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if (hasFeatures2 && checkDeviceExtensionSupport(m_physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+        m_capabilities.descriptorIndexing = indexingFeatures.runtimeDescriptorArray
+                                         && indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+                                         && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+                                         && indexingFeatures.descriptorBindingUpdateUnusedWhilePending
+                                         && indexingFeatures.descriptorBindingPartiallyBound
+                                         && indexingFeatures.descriptorBindingVariableDescriptorCount;
+    }
+    if (m_capabilities.descriptorIndexing)
+    {
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties2);
+
+        m_capabilities.maxBindlessTextures = std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                      indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers);
+
+        // only enable the features we use
+        indexingFeatures = {};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+        indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &indexingFeatures;
+
+        extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        infoLog() << "descriptor indexing enabled, " + std::to_string(m_capabilities.maxBindlessTextures) + " bindless textures max ";
+    }
+
+    // present id and present wait (latency measurement)
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    if (hasFeatures2 && checkDeviceExtensionSupport(m_physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+                     && checkDeviceExtensionSupport(m_physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &presentIdFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+        m_capabilities.presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+    }
+    if (m_capabilities.presentWait)
+    {
+        presentWaitFeatures.pNext = const_cast<void*>(createInfo.pNext);
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        createInfo.pNext = &presentIdFeatures;
+
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        infoLog() << "present wait enabled ";
+    }
+
+    // dynamic rendering, and the extensions it depends on (core in 1.2, but the instance targets 1.1)
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    if (hasFeatures2 && checkDeviceExtensionSupport(m_physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)
+                     && checkDeviceExtensionSupport(m_physicalDevice, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME)
+                     && checkDeviceExtensionSupport(m_physicalDevice, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &dynamicRenderingFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+
+        m_capabilities.dynamicRendering = dynamicRenderingFeatures.dynamicRendering;
+    }
+    if (m_capabilities.dynamicRendering)
+    {
+        dynamicRenderingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &dynamicRenderingFeatures;
+
+        extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        infoLog() << "dynamic rendering enabled ";
+    }
+
+    // timeline semaphores (required, the extension is in deviceExtensions): frame and upload synchronization
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    if (hasFeatures2)
+    {
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &timelineFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+    }
+    if (timelineFeatures.timelineSemaphore != VK_TRUE) {
+        throw std::runtime_error("timeline semaphores not supported!");
+    }
+    timelineFeatures.pNext = const_cast<void*>(createInfo.pNext);
+    createInfo.pNext = &timelineFeatures;
+
+    // memory budget (no feature to enable, the budget properties are queried per heap)
+    if (hasFeatures2 && checkDeviceExtensionSupport(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+    {
+        m_capabilities.memoryBudget = true;
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        infoLog() << "memory budget enabled ";
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (enableValidationLayers) 
     {
@@ -168,6 +303,10 @@ void Context::createLogicalDevice()
     vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
 
+    m_graphicsTimelinePtr->create(m_device, m_graphicsQueue);
+
+    m_memoryBudgetPtr->init(m_physicalDevice, m_capabilities.memoryBudget);
+
     infoLog() << "createLogicalDevice(): OK ";
 }
 
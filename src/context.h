@@ -16,11 +16,31 @@
 
 
 #include "utils.h"
+#include "samplercache.h"
+#include "deletionqueue.h"
+#include "shadercompiler.h"
+#include "memorybudget.h"
+#include "queuetimeline.h"
+
+#include <memory>
 
 namespace VulkanDemo
 {
 
 
+/*
+ * Optional device features, detected (and enabled if supported) in createLogicalDevice()
+ */
+struct DeviceCapabilities
+{
+    bool descriptorIndexing = false;    // VK_EXT_descriptor_indexing with the features needed for bindless textures
+    uint32_t maxBindlessTextures = 0;   // max nb of sampled images in an update-after-bind descriptor set
+    bool presentWait = false;           // VK_KHR_present_id and VK_KHR_present_wait (wait for a frame to be displayed)
+    bool dynamicRendering = false;      // VK_KHR_dynamic_rendering (render passes without VkRenderPass/VkFramebuffer)
+    bool memoryBudget = false;          // VK_EXT_memory_budget (budget and usage of each memory heap)
+};
+
+
 class Context
 {
     
@@ -54,6 +74,12 @@ public:
         m_presentQueue = _other.m_presentQueue;
         m_commandPool = _other.m_commandPool;
         m_surface = _other.m_surface;
+        m_samplerCachePtr = _other.m_samplerCachePtr;
+        m_deletionQueuePtr = _other.m_deletionQueuePtr;
+        m_shaderCompilerPtr = _other.m_shaderCompilerPtr;
+        m_memoryBudgetPtr = _other.m_memoryBudgetPtr;
+        m_graphicsTimelinePtr = _other.m_graphicsTimelinePtr;
+        m_capabilities = _other.m_capabilities;
         return *this;
     }
 
@@ -66,6 +92,12 @@ public:
         , m_presentQueue(_other.m_presentQueue)
         , m_commandPool(_other.m_commandPool)
         , m_surface(_other.m_surface)
+        , m_samplerCachePtr(_other.m_samplerCachePtr)
+        , m_deletionQueuePtr(_other.m_deletionQueuePtr)
+        , m_shaderCompilerPtr(_other.m_shaderCompilerPtr)
+        , m_memoryBudgetPtr(_other.m_memoryBudgetPtr)
+        , m_graphicsTimelinePtr(_other.m_graphicsTimelinePtr)
+        , m_capabilities(_other.m_capabilities)
     {}
 
     Context& operator=(Context&& _other)
@@ -78,6 +110,12 @@ public:
         m_presentQueue = _other.m_presentQueue;
         m_commandPool = _other.m_commandPool;
         m_surface = _other.m_surface;
+        m_samplerCachePtr = _other.m_samplerCachePtr;
+        m_deletionQueuePtr = _other.m_deletionQueuePtr;
+        m_shaderCompilerPtr = _other.m_shaderCompilerPtr;
+        m_memoryBudgetPtr = _other.m_memoryBudgetPtr;
+        m_graphicsTimelinePtr = _other.m_graphicsTimelinePtr;
+        m_capabilities = _other.m_capabilities;
         return *this;
     }
 
@@ -92,6 +130,12 @@ public:
     VkQueue const& getPresentQueue() const { return m_presentQueue; }
     VkCommandPool const& getCommandPool() const { return m_commandPool; }
     VkSurfaceKHR const& getSurface() const { return m_surface; }
+    SamplerCache& getSamplerCache() { return *m_samplerCachePtr; }
+    DeletionQueue& getDeletionQueue() { return *m_deletionQueuePtr; }
+    ShaderCompiler& getShaderCompiler() { return *m_shaderCompilerPtr; }
+    MemoryBudget& getMemoryBudget() { return *m_memoryBudgetPtr; }
+    QueueTimeline& getGraphicsTimeline() { return *m_graphicsTimelinePtr; }
+    DeviceCapabilities const& getCapabilities() const { return m_capabilities; }
 
 
     void createInstance();
@@ -113,6 +157,23 @@ protected:
     VkCommandPool m_commandPool;                        // command pool handle
     VkSurfaceKHR m_surface;                             // abstract type of surface to present rendered images to
 
+    // samplers shared by all images (shared between copies of the context, destroyed with the device)
+    std::shared_ptr<SamplerCache> m_samplerCachePtr = std::make_shared<SamplerCache>();
+
+    // objects waiting for the frames in flight to complete before destruction (shared between copies of the context)
+    std::shared_ptr<DeletionQueue> m_deletionQueuePtr = std::make_shared<DeletionQueue>();
+
+    // SPIR-V of the shaders, compiled at runtime and reloaded when edited (shared between copies of the context)
+    std::shared_ptr<ShaderCompiler> m_shaderCompilerPtr = std::make_shared<ShaderCompiler>();
+
+    // device memory allocations by category, and budget of the heaps (shared between copies of the context)
+    std::shared_ptr<MemoryBudget> m_memoryBudgetPtr = std::make_shared<MemoryBudget>();
+
+    // timeline semaphore of the graphics queue, signaled by the frames and the uploads (shared between copies of the context)
+    std::shared_ptr<QueueTimeline> m_graphicsTimelinePtr = std::make_shared<QueueTimeline>();
+
+    DeviceCapabilities m_capabilities;                  // optional features enabled on the logical device
+
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT _messageSeverity,
         VkDebugUtilsMessageTypeFlagsEXT _messageType,
@@ -0,0 +1,61 @@
+/*********************************************************************************************************************
+ *
+ * coreutils.h
+ *
+ * Helpers of the GPU-independent core (geometry, image processing, culling math)
+ * The core includes neither Vulkan nor GLFW: it builds, runs and is benchmarked on a machine without GPU
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef COREUTILS_H
+#define COREUTILS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES // handles data alignment automatically
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE // define a depth range of [0;1] instead of [-1;1] for the perspective projection matrix
+#include <glm/glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+
+namespace VulkanDemo
+{
+
+    /*
+     * Helper function to combine a value into a running hash (boost-like)
+     */
+    template <typename T>
+    inline void hashCombine(std::size_t& _seed, T const& _value)
+    {
+        _seed ^= std::hash<T>()(_value) + 0x9e3779b9 + (_seed << 6) + (_seed >> 2);
+    }
+
+
+    const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+    /*
+     * FNV-1a 64 bit hash (stable between runs and platforms, unlike std::hash)
+     */
+    inline void hashBytes(uint64_t& _hash, const std::string& _bytes)
+    {
+        for (unsigned char c : _bytes)
+        {
+            _hash ^= c;
+            _hash *= 0x100000001b3ull;
+        }
+        _hash ^= 0xff;      // separator, so that consecutive strings cannot be shifted
+        _hash *= 0x100000001b3ull;
+    }
+
+} // namespace VulkanDemo
+
+#endif // COREUTILS_H
\ No newline at end of file
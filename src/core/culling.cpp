@@ -0,0 +1,335 @@
+/*********************************************************************************************************************
+ *
+ * culling.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#include "core/culling.h"
+
+// widest instruction set enabled for the compilation (AVX2: CMake option USE_AVX2)
+#if defined(__AVX2__)
+#define CULLING_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Planes are combinations of the rows of the matrix (Gribb-Hartmann), normalized so that the plane equation
+ * gives the signed distance to the plane
+ */
+Frustum extractFrustum(const glm::mat4& _viewProj)
+{
+    // glm matrices are column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::mat4 m = glm::transpose(_viewProj);
+
+    Frustum frustum;
+    frustum.planes[0] = m[3] + m[0];    // left
+    frustum.planes[1] = m[3] - m[0];    // right
+    frustum.planes[2] = m[3] + m[1];    // bottom
+    frustum.planes[3] = m[3] - m[1];    // top
+    frustum.planes[4] = m[2];           // near (depth range [0;1])
+    frustum.planes[5] = m[3] - m[2];    // far
+
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+
+bool isSphereVisible(const Frustum& _frustum, const glm::vec4& _sphere)
+{
+    glm::vec3 center = glm::vec3(_sphere);
+    for (const auto& plane : _frustum.planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -_sphere.w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+uint32_t cullSpheres(const Frustum& _frustum, const std::vector<glm::vec4>& _spheres, std::vector<uint32_t>& _visible)
+{
+    _visible.clear();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(_spheres.size()); i++)
+    {
+        if (isSphereVisible(_frustum, _spheres[i])) {
+            _visible.push_back(i);
+        }
+    }
+    return static_cast<uint32_t>(_visible.size());
+}
+
+
+/*
+ * Pads the arrays to a multiple of BATCH_SIZE (the padding volumes have a negative radius: they are never visible)
+ */
+void BoundsSoA::resize(uint32_t _count)
+{
+    count = _count;
+    size_t padded = (static_cast<size_t>(_count) + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+
+    for (auto* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+        component->assign(padded, 0.0f);
+    }
+    radius.assign(padded, -std::numeric_limits<float>::max());
+}
+
+
+void BoundsSoA::set(uint32_t _index, const Bounds& _bounds)
+{
+    centerX[_index] = _bounds.center.x;
+    centerY[_index] = _bounds.center.y;
+    centerZ[_index] = _bounds.center.z;
+    extentX[_index] = _bounds.extents.x;
+    extentY[_index] = _bounds.extents.y;
+    extentZ[_index] = _bounds.extents.z;
+    radius[_index] = _bounds.radius;
+}
+
+
+/*
+ * The box stays axis aligned: its extents along each world axis are the projections of its rotated and scaled axes
+ */
+Bounds transformBounds(const Bounds& _bounds, const glm::mat4& _model)
+{
+    glm::mat3 linear = glm::mat3(_model);
+    glm::mat3 absLinear = glm::mat3(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+    float scale = glm::max(glm::length(linear[0]), glm::max(glm::length(linear[1]), glm::length(linear[2])));
+
+    Bounds bounds;
+    bounds.center = glm::vec3(_model * glm::vec4(_bounds.center, 1.0f));
+    bounds.extents = absLinear * _bounds.extents;
+    bounds.radius = scale * _bounds.radius;
+    return bounds;
+}
+
+
+/*
+ * For each plane, the volume is outside if the signed distance of its center is below the smallest of
+ * its radius and the projection of its box extents on the plane normal
+ */
+bool isVisible(const Frustum& _frustum, const BoundsSoA& _bounds, uint32_t _index)
+{
+    for (const auto& plane : _frustum.planes)
+    {
+        float dist = plane.x * _bounds.centerX[_index] + plane.y * _bounds.centerY[_index] + plane.z * _bounds.centerZ[_index] + plane.w;
+        float projected = std::abs(plane.x) * _bounds.extentX[_index] + std::abs(plane.y) * _bounds.extentY[_index] + std::abs(plane.z) * _bounds.extentZ[_index];
+        float effective = std::min(_bounds.radius[_index], projected);
+        if (!(dist + effective >= 0.0f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+uint32_t cullBoundsScalar(const Frustum& _frustum, const BoundsSoA& _bounds, std::vector<uint32_t>& _visible)
+{
+    _visible.resize(_bounds.count);
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < _bounds.count; i++)
+    {
+        if (isVisible(_frustum, _bounds, i)) {
+            _visible[visibleCount++] = i;
+        }
+    }
+    _visible.resize(visibleCount);
+    return visibleCount;
+}
+
+
+namespace
+{
+    /*
+     * Plane components broadcast once per call
+     */
+    struct Planes
+    {
+        std::array<float, 6> x, y, z, w;
+        std::array<float, 6> absX, absY, absZ;
+
+        explicit Planes(const Frustum& _frustum)
+        {
+            for (size_t p = 0; p < 6; p++)
+            {
+                x[p] = _frustum.planes[p].x;
+                y[p] = _frustum.planes[p].y;
+                z[p] = _frustum.planes[p].z;
+                w[p] = _frustum.planes[p].w;
+                absX[p] = std::abs(x[p]);
+                absY[p] = std::abs(y[p]);
+                absZ[p] = std::abs(z[p]);
+            }
+        }
+    };
+
+#if defined(CULLING_AVX2)
+
+    /*
+     * Visibility of the objects _first to _first + 7 (bit i set if _first + i is visible)
+     */
+    uint32_t testBatch(const Planes& _planes, const BoundsSoA& _bounds, size_t _first)
+    {
+        __m256 cx = _mm256_loadu_ps(&_bounds.centerX[_first]);
+        __m256 cy = _mm256_loadu_ps(&_bounds.centerY[_first]);
+        __m256 cz = _mm256_loadu_ps(&_bounds.centerZ[_first]);
+        __m256 ex = _mm256_loadu_ps(&_bounds.extentX[_first]);
+        __m256 ey = _mm256_loadu_ps(&_bounds.extentY[_first]);
+        __m256 ez = _mm256_loadu_ps(&_bounds.extentZ[_first]);
+        __m256 r = _mm256_loadu_ps(&_bounds.radius[_first]);
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t p = 0; p < 6; p++)
+        {
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(_planes.x[p]), cx),
+                                                                    _mm256_mul_ps(_mm256_set1_ps(_planes.y[p]), cy)),
+                                                      _mm256_mul_ps(_mm256_set1_ps(_planes.z[p]), cz)),
+                                        _mm256_set1_ps(_planes.w[p]));
+            __m256 projected = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(_planes.absX[p]), ex),
+                                                           _mm256_mul_ps(_mm256_set1_ps(_planes.absY[p]), ey)),
+                                             _mm256_mul_ps(_mm256_set1_ps(_planes.absZ[p]), ez));
+            __m256 effective = _mm256_min_ps(r, projected);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(dist, effective), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        return static_cast<uint32_t>(_mm256_movemask_ps(visible));
+    }
+
+#elif defined(CULLING_SSE2)
+
+    /*
+     * Visibility of the objects _first to _first + 3 (bit i set if _first + i is visible)
+     */
+    uint32_t testHalfBatch(const Planes& _planes, const BoundsSoA& _bounds, size_t _first)
+    {
+        __m128 cx = _mm_loadu_ps(&_bounds.centerX[_first]);
+        __m128 cy = _mm_loadu_ps(&_bounds.centerY[_first]);
+        __m128 cz = _mm_loadu_ps(&_bounds.centerZ[_first]);
+        __m128 ex = _mm_loadu_ps(&_bounds.extentX[_first]);
+        __m128 ey = _mm_loadu_ps(&_bounds.extentY[_first]);
+        __m128 ez = _mm_loadu_ps(&_bounds.extentZ[_first]);
+        __m128 r = _mm_loadu_ps(&_bounds.radius[_first]);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (size_t p = 0; p < 6; p++)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(_planes.x[p]), cx),
+                                                           _mm_mul_ps(_mm_set1_ps(_planes.y[p]), cy)),
+                                                _mm_mul_ps(_mm_set1_ps(_planes.z[p]), cz)),
+                                     _mm_set1_ps(_planes.w[p]));
+            __m128 projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(_planes.absX[p]), ex),
+                                                     _mm_mul_ps(_mm_set1_ps(_planes.absY[p]), ey)),
+                                          _mm_mul_ps(_mm_set1_ps(_planes.absZ[p]), ez));
+            __m128 effective = _mm_min_ps(r, projected);
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(dist, effective), _mm_setzero_ps()));
+        }
+        return static_cast<uint32_t>(_mm_movemask_ps(visible));
+    }
+
+    uint32_t testBatch(const Planes& _planes, const BoundsSoA& _bounds, size_t _first)
+    {
+        return testHalfBatch(_planes, _bounds, _first) | (testHalfBatch(_planes, _bounds, _first + 4) << 4);
+    }
+
+#elif defined(CULLING_NEON)
+
+    /*
+     * Visibility of the objects _first to _first + 3 (bit i set if _first + i is visible)
+     */
+    uint32_t testHalfBatch(const Planes& _planes, const BoundsSoA& _bounds, size_t _first)
+    {
+        float32x4_t cx = vld1q_f32(&_bounds.centerX[_first]);
+        float32x4_t cy = vld1q_f32(&_bounds.centerY[_first]);
+        float32x4_t cz = vld1q_f32(&_bounds.centerZ[_first]);
+        float32x4_t ex = vld1q_f32(&_bounds.extentX[_first]);
+        float32x4_t ey = vld1q_f32(&_bounds.extentY[_first]);
+        float32x4_t ez = vld1q_f32(&_bounds.extentZ[_first]);
+        float32x4_t r = vld1q_f32(&_bounds.radius[_first]);
+
+        // no fused multiply-add (vmlaq_f32 may be fused): same rounding as the scalar reference
+        uint32x4_t visible = vdupq_n_u32(0xFFFFFFFFu);
+        for (size_t p = 0; p < 6; p++)
+        {
+            float32x4_t dist = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(cx, _planes.x[p]), vmulq_n_f32(cy, _planes.y[p])),
+                                                   vmulq_n_f32(cz, _planes.z[p])),
+                                         vdupq_n_f32(_planes.w[p]));
+            float32x4_t projected = vaddq_f32(vaddq_f32(vmulq_n_f32(ex, _planes.absX[p]), vmulq_n_f32(ey, _planes.absY[p])),
+                                              vmulq_n_f32(ez, _planes.absZ[p]));
+            float32x4_t effective = vminq_f32(r, projected);
+            visible = vandq_u32(visible, vcgeq_f32(vaddq_f32(dist, effective), vdupq_n_f32(0.0f)));
+        }
+
+        const uint32_t bits[4] = { 1, 2, 4, 8 };
+        return vaddvq_u32(vandq_u32(visible, vld1q_u32(bits)));
+    }
+
+    uint32_t testBatch(const Planes& _planes, const BoundsSoA& _bounds, size_t _first)
+    {
+        return testHalfBatch(_planes, _bounds, _first) | (testHalfBatch(_planes, _bounds, _first + 4) << 4);
+    }
+
+#endif
+}
+
+
+uint32_t cullBounds(const Frustum& _frustum, const BoundsSoA& _bounds, std::vector<uint32_t>& _visible)
+{
+#if defined(CULLING_AVX2) || defined(CULLING_SSE2) || defined(CULLING_NEON)
+    Planes planes(_frustum);
+
+    // padding volumes are never visible: no index beyond the count is written
+    _visible.resize(_bounds.radius.size());
+    uint32_t visibleCount = 0;
+    for (size_t first = 0; first < _bounds.radius.size(); first += BoundsSoA::BATCH_SIZE)
+    {
+        uint32_t mask = testBatch(planes, _bounds, first);
+        while (mask != 0)
+        {
+            _visible[visibleCount++] = static_cast<uint32_t>(first) + static_cast<uint32_t>(std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+    _visible.resize(visibleCount);
+    return visibleCount;
+#else
+    return cullBoundsScalar(_frustum, _bounds, _visible);
+#endif
+}
+
+
+const char* getCullingInstructionSet()
+{
+#if defined(CULLING_AVX2)
+    return "AVX2";
+#elif defined(CULLING_SSE2)
+    return "SSE2";
+#elif defined(CULLING_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace VulkanDemo
\ No newline at end of file
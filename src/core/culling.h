@@ -0,0 +1,82 @@
+/*********************************************************************************************************************
+ *
+ * culling.h
+ *
+ * CPU-side visibility math, independent from the GPU: view frustum planes, and bounding volume tests
+ * (same conventions as the culling shader: world space volumes, depth range [0;1])
+ * Many objects are tested in batches of 8, with SIMD instructions (AVX2, SSE2 or NEON, chosen at compile time),
+ * on bounding volumes stored in a structure of arrays. The scalar version is the reference: both give the same
+ * results, as they compute the same operations in the same order
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef CULLING_H
+#define CULLING_H
+
+
+#include "core/coreutils.h"
+#include "core/geometry.h"
+
+#include <array>
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Planes of a view frustum (left, right, bottom, top, near, far), normals pointing inside: (n, d) with n.x + d >= 0
+ * for the points inside
+ */
+struct Frustum
+{
+    std::array<glm::vec4, 6> planes;
+};
+
+
+// planes of the frustum of a view-projection matrix
+Frustum extractFrustum(const glm::mat4& _viewProj);
+
+// false if a sphere (center, radius) is entirely outside a plane of the frustum
+bool isSphereVisible(const Frustum& _frustum, const glm::vec4& _sphere);
+
+// indices of the visible spheres (returns their nb)
+uint32_t cullSpheres(const Frustum& _frustum, const std::vector<glm::vec4>& _spheres, std::vector<uint32_t>& _visible);
+
+
+/*
+ * Bounding volumes of many objects (see Bounds), one array per component
+ * Arrays are padded to a multiple of BATCH_SIZE with volumes that are never visible
+ */
+struct BoundsSoA
+{
+    static constexpr uint32_t BATCH_SIZE = 8;
+
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+    uint32_t count = 0;
+
+    void resize(uint32_t _count);
+    void set(uint32_t _index, const Bounds& _bounds);
+};
+
+// world space bounds of an object, from its object space bounds and model matrix
+Bounds transformBounds(const Bounds& _bounds, const glm::mat4& _model);
+
+// an object is visible if, for each plane, neither its box nor its sphere is entirely outside (both must pass)
+bool isVisible(const Frustum& _frustum, const BoundsSoA& _bounds, uint32_t _index);
+
+// indices of the visible objects (returns their nb): one object per iteration (reference)
+uint32_t cullBoundsScalar(const Frustum& _frustum, const BoundsSoA& _bounds, std::vector<uint32_t>& _visible);
+// same, BATCH_SIZE objects per iteration
+uint32_t cullBounds(const Frustum& _frustum, const BoundsSoA& _bounds, std::vector<uint32_t>& _visible);
+
+// instruction set used by cullBounds()
+const char* getCullingInstructionSet();
+
+} // namespace VulkanDemo
+
+#endif // CULLING_H
\ No newline at end of file
@@ -0,0 +1,155 @@
+/*********************************************************************************************************************
+ *
+ * geometry.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "core/geometry.h"
+
+#include <unordered_map>
+
+
+namespace VulkanDemo
+{
+
+
+namespace
+{
+    /*
+     * Vertices of the triangle corners of all the shapes
+     */
+    std::vector<Vertex> extractCorners(tinyobj::attrib_t const& _attrib, std::vector<tinyobj::shape_t> const& _shapes)
+    {
+        std::vector<Vertex> corners;
+
+        for (const auto& shape : _shapes) 
+        {
+            for (const auto& index : shape.mesh.indices) 
+            {
+                Vertex vertex{};
+
+                vertex.pos = {
+                    _attrib.vertices[3 * index.vertex_index + 0],
+                    _attrib.vertices[3 * index.vertex_index + 1],
+                    _attrib.vertices[3 * index.vertex_index + 2]
+                };
+
+                vertex.color = { 1.0f, 1.0f, 1.0f };
+
+                vertex.texCoord = {
+                    _attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - _attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+
+                vertex.normal = {
+                    _attrib.normals[3 * index.normal_index + 0],
+                    _attrib.normals[3 * index.normal_index + 1],
+                    _attrib.normals[3 * index.normal_index + 2]
+                };
+
+                corners.push_back(vertex);
+            }
+        }
+        return corners;
+    }
+}
+
+
+/*
+ * Loads wavefront model
+ */
+std::vector<Vertex> parseObj(const std::string& _path)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, _path.c_str())) {
+        throw std::runtime_error(warn + err);
+    }
+    return extractCorners(attrib, shapes);
+}
+
+
+/*
+ * Parses wavefront content (materials are ignored)
+ */
+std::vector<Vertex> parseObj(std::istream& _stream)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &_stream)) {
+        throw std::runtime_error(warn + err);
+    }
+    return extractCorners(attrib, shapes);
+}
+
+
+/*
+ * Each distinct vertex is kept once, in order of first appearance
+ */
+MeshData weldVertices(const std::vector<Vertex>& _corners)
+{
+    MeshData mesh;
+    mesh.indices.reserve(_corners.size());
+
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+
+    for (const auto& vertex : _corners)
+    {
+        if (uniqueVertices.count(vertex) == 0) {
+            uniqueVertices[vertex] = static_cast<uint32_t>(mesh.vertices.size());
+            mesh.vertices.push_back(vertex);
+        }
+
+        mesh.indices.push_back(uniqueVertices[vertex]);
+    }
+    return mesh;
+}
+
+
+/*
+ * Bounding box of a set of vertices, and sphere centered on the box enclosing all of them
+ */
+Bounds computeBounds(const std::vector<Vertex>& _vertices)
+{
+    Bounds bounds;
+    if (_vertices.empty()) {
+        return bounds;
+    }
+
+    glm::vec3 minCorner = _vertices[0].pos;
+    glm::vec3 maxCorner = _vertices[0].pos;
+    for (const auto& vertex : _vertices)
+    {
+        minCorner = glm::min(minCorner, vertex.pos);
+        maxCorner = glm::max(maxCorner, vertex.pos);
+    }
+
+    bounds.center = 0.5f * (minCorner + maxCorner);
+    bounds.extents = 0.5f * (maxCorner - minCorner);
+    for (const auto& vertex : _vertices) {
+        bounds.radius = glm::max(bounds.radius, glm::length(vertex.pos - bounds.center));
+    }
+    return bounds;
+}
+
+
+glm::vec4 computeBoundingSphere(const std::vector<Vertex>& _vertices)
+{
+    Bounds bounds = computeBounds(_vertices);
+    return glm::vec4(bounds.center, bounds.radius);
+}
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*********************************************************************************************************************
+ *
+ * geometry.h
+ *
+ * CPU-side geometry processing, independent from the GPU:
+ * Wavefront (.obj) parsing with tinyobjloader, welding of identical vertices, bounding volumes (box and sphere)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+
+#include "core/coreutils.h"
+
+#include <istream>
+
+namespace VulkanDemo
+{
+
+
+/*
+* Structure for vertex attributes
+*/
+struct Vertex 
+{
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+
+
+    bool operator==(const Vertex& _other) const 
+    {
+        return pos == _other.pos && color == _other.color && texCoord == _other.texCoord && normal == _other.normal;
+    }
+};
+
+
+/*
+ * Bounding volumes sharing a center: axis aligned box (half extents) and sphere (radius)
+ */
+struct Bounds
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 extents = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+
+/*
+ * Indexed triangle list
+ */
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+
+// one vertex per triangle corner, from a file or a stream holding the content of a file
+std::vector<Vertex> parseObj(const std::string& _path);
+std::vector<Vertex> parseObj(std::istream& _stream);
+
+// indexed triangle list, identical corners sharing a single vertex
+MeshData weldVertices(const std::vector<Vertex>& _corners);
+
+// bounding box of the vertices, and sphere around its center
+Bounds computeBounds(const std::vector<Vertex>& _vertices);
+// sphere around the bounding box of the vertices (center, radius)
+glm::vec4 computeBoundingSphere(const std::vector<Vertex>& _vertices);
+
+} // namespace VulkanDemo
+
+
+//namespace std {
+//    template<> struct hash<VulkanDemo::Vertex> {
+//        size_t operator()(VulkanDemo::Vertex const& vertex) const {
+//            return ((hash<glm::vec3>()(vertex.pos) ^
+//                    (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+//                    (hash<glm::vec2>()(vertex.texCoord) << 1);
+//        }
+//    };
+//}
+namespace std {
+    template<> struct hash<VulkanDemo::Vertex> {
+        size_t operator()(VulkanDemo::Vertex const& vertex) const 
+        {
+            std::size_t h1 = hash<glm::vec3>()(vertex.pos);
+            std::size_t h2 = hash<glm::vec3>()(vertex.color);
+            std::size_t h3 = hash<glm::vec2>()(vertex.texCoord);
+            std::size_t h4 = hash<glm::vec3>()(vertex.normal);
+            std::string stg = std::to_string(h1) + std::to_string(h2) + std::to_string(h3) + std::to_string(h4);
+            return std::hash<std::string>()(stg);
+        }
+    };
+}
+
+#endif // GEOMETRY_H
\ No newline at end of file
@@ -0,0 +1,679 @@
+/*********************************************************************************************************************
+ *
+ * gltf.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <cstring>
+
+#include "core/gltf.h"
+#include "core/json.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+namespace VulkanDemo
+{
+
+namespace
+{
+    // GLB container (little endian)
+    const uint32_t GLB_MAGIC = 0x46546C67;          // "glTF"
+    const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;     // "JSON"
+    const uint32_t GLB_CHUNK_BIN = 0x004E4942;      // "BIN\0"
+    const uint32_t GLB_HEADER_SIZE = 12;
+    const uint32_t GLB_CHUNK_HEADER_SIZE = 8;
+
+    const uint32_t MODE_TRIANGLES = 4;
+
+
+    uint32_t readUint32(const uint8_t* _data)
+    {
+        uint32_t value;
+        std::memcpy(&value, _data, sizeof(value));
+        return value;
+    }
+
+
+    uint32_t getComponentSize(uint32_t _componentType)
+    {
+        switch (_componentType)
+        {
+            case GltfAccessor::BYTE:
+            case GltfAccessor::UNSIGNED_BYTE: return 1;
+            case GltfAccessor::SHORT:
+            case GltfAccessor::UNSIGNED_SHORT: return 2;
+            case GltfAccessor::UNSIGNED_INT:
+            case GltfAccessor::FLOAT: return 4;
+            default: throw std::runtime_error("failed to load glTF: unknown component type " + std::to_string(_componentType) + "!");
+        }
+    }
+
+
+    uint32_t getComponentCount(const std::string& _type)
+    {
+        if (_type == "SCALAR") return 1;
+        if (_type == "VEC2") return 2;
+        if (_type == "VEC3") return 3;
+        if (_type == "VEC4") return 4;
+        if (_type == "MAT2") return 4;
+        if (_type == "MAT3") return 9;
+        if (_type == "MAT4") return 16;
+        throw std::runtime_error("failed to load glTF: unknown accessor type " + _type + "!");
+    }
+
+
+    /*
+     * Component of an element as a float (normalized integers are mapped to [0;1] or [-1;1])
+     */
+    float readComponent(const uint8_t* _data, uint32_t _componentType, bool _normalized)
+    {
+        switch (_componentType)
+        {
+            case GltfAccessor::FLOAT:
+            {
+                float value;
+                std::memcpy(&value, _data, sizeof(value));
+                return value;
+            }
+            case GltfAccessor::UNSIGNED_BYTE:
+                return _normalized ? *_data / 255.0f : static_cast<float>(*_data);
+            case GltfAccessor::BYTE:
+            {
+                int8_t value = static_cast<int8_t>(*_data);
+                return _normalized ? std::max(value / 127.0f, -1.0f) : static_cast<float>(value);
+            }
+            case GltfAccessor::UNSIGNED_SHORT:
+            {
+                uint16_t value;
+                std::memcpy(&value, _data, sizeof(value));
+                return _normalized ? value / 65535.0f : static_cast<float>(value);
+            }
+            case GltfAccessor::SHORT:
+            {
+                int16_t value;
+                std::memcpy(&value, _data, sizeof(value));
+                return _normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+            }
+            default:
+                return static_cast<float>(readUint32(_data));
+        }
+    }
+
+
+    /*
+     * Decodes the %XX escapes of a relative uri
+     */
+    std::string decodeUri(const std::string& _uri)
+    {
+        std::string path;
+        for (size_t i = 0; i < _uri.size(); i++)
+        {
+            if (_uri[i] == '%' && i + 2 < _uri.size())
+            {
+                path += static_cast<char>(std::stoi(_uri.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            }
+            else {
+                path += _uri[i];
+            }
+        }
+        return path;
+    }
+
+
+    glm::mat4 readNodeMatrix(const JsonValue& _node)
+    {
+        if (const JsonValue* matrix = _node.find("matrix"))
+        {
+            // column major
+            glm::mat4 result(1.0f);
+            for (uint32_t i = 0; i < 16 && i < matrix->size(); i++) {
+                result[i / 4][i % 4] = static_cast<float>((*matrix)[i].asNumber());
+            }
+            return result;
+        }
+
+        glm::vec3 translation(0.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale(1.0f);
+        if (const JsonValue* t = _node.find("translation")) {
+            translation = glm::vec3((*t)[0].asNumber(), (*t)[1].asNumber(), (*t)[2].asNumber());
+        }
+        if (const JsonValue* r = _node.find("rotation")) {
+            // stored as x, y, z, w
+            rotation = glm::quat(static_cast<float>((*r)[3].asNumber()), static_cast<float>((*r)[0].asNumber()),
+                                 static_cast<float>((*r)[1].asNumber()), static_cast<float>((*r)[2].asNumber()));
+        }
+        if (const JsonValue* s = _node.find("scale")) {
+            scale = glm::vec3((*s)[0].asNumber(), (*s)[1].asNumber(), (*s)[2].asNumber());
+        }
+        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+}
+
+
+
+/*
+ * Maps the file, and parses its JSON part (the binary chunk of a .glb is not read)
+ */
+void GltfModel::load(const std::string& _path)
+{
+    m_files.clear();
+    m_accessors.clear();
+    m_meshes.clear();
+    m_materials.clear();
+    m_images.clear();
+    m_nodes.clear();
+    m_sceneRoots.clear();
+    m_skippedPrimitiveCount = 0;
+
+    size_t separator = _path.find_last_of("/\\");
+    std::string directory = (separator == std::string::npos) ? "" : _path.substr(0, separator + 1);
+
+    m_files.emplace_back(_path);
+    const uint8_t* data = m_files.back().getData();
+    size_t size = m_files.back().getSize();
+
+    // 1. -----------------------------------------------------------------------------------------
+    // .gltf: the whole file is the JSON document
+    if (size < GLB_HEADER_SIZE || readUint32(data) != GLB_MAGIC)
+    {
+        JsonValue document = JsonValue::parse(std::string_view(reinterpret_cast<const char*>(data), size));
+        parseDocument(document, directory, nullptr, 0);
+        return;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // .glb: header, JSON chunk, optional binary chunk (chunks are 4 byte aligned)
+    if (readUint32(data + 4) != 2) {
+        throw std::runtime_error("failed to load glTF: unsupported GLB version in " + _path + "!");
+    }
+    size = std::min(size, static_cast<size_t>(readUint32(data + 8)));
+
+    size_t offset = GLB_HEADER_SIZE;
+    std::string_view json;
+    const uint8_t* binaryChunk = nullptr;
+    size_t binaryChunkSize = 0;
+    while (offset + GLB_CHUNK_HEADER_SIZE <= size)
+    {
+        uint32_t chunkSize = readUint32(data + offset);
+        uint32_t chunkType = readUint32(data + offset + 4);
+        offset += GLB_CHUNK_HEADER_SIZE;
+        if (offset + chunkSize > size) {
+            throw std::runtime_error("failed to load glTF: truncated GLB chunk in " + _path + "!");
+        }
+
+        if (chunkType == GLB_CHUNK_JSON && json.empty()) {
+            json = std::string_view(reinterpret_cast<const char*>(data + offset), chunkSize);
+        }
+        else if (chunkType == GLB_CHUNK_BIN && binaryChunk == nullptr)
+        {
+            binaryChunk = data + offset;
+            binaryChunkSize = chunkSize;
+        }
+        // other chunks are ignored
+        offset += (chunkSize + 3) & ~3u;
+    }
+    if (json.empty()) {
+        throw std::runtime_error("failed to load glTF: no JSON chunk in " + _path + "!");
+    }
+
+    parseDocument(JsonValue::parse(json), directory, binaryChunk, binaryChunkSize);
+}
+
+
+const MappedFile& GltfModel::mapUri(const std::string& _directory, const std::string& _uri)
+{
+    if (_uri.rfind("data:", 0) == 0) {
+        throw std::runtime_error("failed to load glTF: embedded base64 data is not supported (convert the model to .glb)!");
+    }
+    m_files.emplace_back(_directory + decodeUri(_uri));
+    return m_files.back();
+}
+
+
+void GltfModel::parseDocument(const JsonValue& _document, const std::string& _directory, const uint8_t* _binaryChunk, size_t _binaryChunkSize)
+{
+    const JsonValue& asset = _document["asset"];
+    if (asset.getString("version", "").rfind("2.", 0) != 0) {
+        throw std::runtime_error("failed to load glTF: only version 2.x is supported!");
+    }
+
+    // 1. -----------------------------------------------------------------------------------------
+    // buffers: binary chunk of the .glb (first buffer without uri) or mapped files
+    std::vector<std::pair<const uint8_t*, size_t>> buffers;
+    for (const auto& buffer : _document["buffers"].getElements())
+    {
+        size_t byteLength = static_cast<size_t>(buffer.getNumber("byteLength", 0.0));
+        if (const JsonValue* uri = buffer.find("uri"))
+        {
+            const MappedFile& file = mapUri(_directory, uri->asString());
+            buffers.emplace_back(file.getData(), file.getSize());
+        }
+        else if (buffers.empty() && _binaryChunk != nullptr) {
+            buffers.emplace_back(_binaryChunk, _binaryChunkSize);
+        }
+        else {
+            throw std::runtime_error("failed to load glTF: buffer without data!");
+        }
+
+        if (byteLength > buffers.back().second) {
+            throw std::runtime_error("failed to load glTF: buffer larger than its data!");
+        }
+        buffers.back().second = byteLength;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // buffer views
+    std::vector<BufferView> views;
+    for (const auto& view : _document["bufferViews"].getElements())
+    {
+        uint32_t buffer = view["buffer"].asUint();
+        size_t offset = static_cast<size_t>(view.getNumber("byteOffset", 0.0));
+        size_t size = static_cast<size_t>(view["byteLength"].asNumber());
+        if (buffer >= buffers.size() || offset + size > buffers[buffer].second) {
+            throw std::runtime_error("failed to load glTF: buffer view out of its buffer!");
+        }
+        views.push_back({ buffers[buffer].first + offset, size, view.getUint("byteStride", 0) });
+    }
+
+    // 3. -----------------------------------------------------------------------------------------
+    // images: in a buffer view, or mapped files
+    for (const auto& image : _document["images"].getElements())
+    {
+        GltfImage result;
+        result.mimeType = image.getString("mimeType", "");
+        if (const JsonValue* view = image.find("bufferView"))
+        {
+            if (view->asUint() >= views.size()) {
+                throw std::runtime_error("failed to load glTF: invalid image buffer view!");
+            }
+            result.data = views[view->asUint()].data;
+            result.size = views[view->asUint()].size;
+        }
+        else if (const JsonValue* uri = image.find("uri"))
+        {
+            const MappedFile& file = mapUri(_directory, uri->asString());
+            result.data = file.getData();
+            result.size = file.getSize();
+        }
+        m_images.push_back(result);
+    }
+
+    parseAccessors(_document, views);
+    parseMaterials(_document);
+    parseMeshes(_document);
+    parseNodes(_document);
+}
+
+
+void GltfModel::parseAccessors(const JsonValue& _document, const std::vector<BufferView>& _views)
+{
+    for (const auto& accessor : _document["accessors"].getElements())
+    {
+        GltfAccessor result;
+        result.count = accessor["count"].asUint();
+        result.componentType = accessor["componentType"].asUint();
+        result.componentCount = getComponentCount(accessor["type"].asString());
+        result.componentSize = getComponentSize(result.componentType);
+        result.normalized = accessor.getBool("normalized", false);
+
+        if (accessor.has("sparse")) {
+            throw std::runtime_error("failed to load glTF: sparse accessors are not supported!");
+        }
+        if (!accessor.has("bufferView")) {
+            throw std::runtime_error("failed to load glTF: accessors without buffer view are not supported!");
+        }
+
+        uint32_t viewIndex = accessor["bufferView"].asUint();
+        if (viewIndex >= _views.size()) {
+            throw std::runtime_error("failed to load glTF: invalid accessor buffer view!");
+        }
+        const BufferView& view = _views[viewIndex];
+        size_t offset = static_cast<size_t>(accessor.getNumber("byteOffset", 0.0));
+        size_t elementSize = static_cast<size_t>(result.componentCount) * result.componentSize;
+        result.stride = (view.stride != 0) ? view.stride : static_cast<uint32_t>(elementSize);
+        if (result.count > 0 && offset + static_cast<size_t>(result.stride) * (result.count - 1) + elementSize > view.size) {
+            throw std::runtime_error("failed to load glTF: accessor out of its buffer view!");
+        }
+        result.data = view.data + offset;
+
+        const JsonValue* min = accessor.find("min");
+        const JsonValue* max = accessor.find("max");
+        if (min && max && min->size() >= 3 && max->size() >= 3)
+        {
+            result.hasBounds = true;
+            result.min = glm::vec3((*min)[0].asNumber(), (*min)[1].asNumber(), (*min)[2].asNumber());
+            result.max = glm::vec3((*max)[0].asNumber(), (*max)[1].asNumber(), (*max)[2].asNumber());
+        }
+        m_accessors.push_back(result);
+    }
+}
+
+
+void GltfModel::parseMaterials(const JsonValue& _document)
+{
+    // textures only add a sampler to their image
+    std::vector<uint32_t> textureImages;
+    for (const auto& texture : _document["textures"].getElements()) {
+        textureImages.push_back(texture.getUint("source", NONE));
+    }
+
+    for (const auto& material : _document["materials"].getElements())
+    {
+        GltfMaterial result;
+        result.name = material.getString("name", "");
+        const JsonValue& pbr = material["pbrMetallicRoughness"];
+        if (const JsonValue* factor = pbr.find("baseColorFactor")) {
+            result.baseColorFactor = glm::vec4((*factor)[0].asNumber(), (*factor)[1].asNumber(), (*factor)[2].asNumber(), (*factor)[3].asNumber());
+        }
+        if (const JsonValue* texture = pbr.find("baseColorTexture"))
+        {
+            uint32_t index = (*texture)["index"].asUint();
+            if (index < textureImages.size() && textureImages[index] < m_images.size()) {
+                result.baseColorImage = textureImages[index];
+            }
+        }
+        m_materials.push_back(result);
+    }
+}
+
+
+void GltfModel::parseMeshes(const JsonValue& _document)
+{
+    auto getAccessor = [this](const JsonValue& _object, std::string_view _key)
+    {
+        uint32_t index = _object.getUint(_key, NONE);
+        if (index != NONE && index >= m_accessors.size()) {
+            throw std::runtime_error("failed to load glTF: invalid accessor index!");
+        }
+        return index;
+    };
+
+    for (const auto& mesh : _document["meshes"].getElements())
+    {
+        GltfMesh result;
+        result.name = mesh.getString("name", "");
+        for (const auto& primitive : mesh["primitives"].getElements())
+        {
+            const JsonValue& attributes = primitive["attributes"];
+            GltfPrimitive part;
+            part.positions = getAccessor(attributes, "POSITION");
+            part.normals = getAccessor(attributes, "NORMAL");
+            part.texCoords = getAccessor(attributes, "TEXCOORD_0");
+            part.colors = getAccessor(attributes, "COLOR_0");
+            part.indices = getAccessor(primitive, "indices");
+            part.material = primitive.getUint("material", NONE);
+            if (part.material != NONE && part.material >= m_materials.size()) {
+                part.material = NONE;
+            }
+
+            if (primitive.getUint("mode", MODE_TRIANGLES) != MODE_TRIANGLES || part.positions == NONE)
+            {
+                m_skippedPrimitiveCount++;
+                continue;
+            }
+            // all the attributes of a primitive have the same count
+            uint32_t vertexCount = m_accessors[part.positions].count;
+            for (uint32_t attribute : { part.normals, part.texCoords, part.colors })
+            {
+                if (attribute != NONE && m_accessors[attribute].count != vertexCount) {
+                    throw std::runtime_error("failed to load glTF: attributes of different counts!");
+                }
+            }
+            result.primitives.push_back(part);
+        }
+        m_meshes.push_back(std::move(result));
+    }
+}
+
+
+void GltfModel::parseNodes(const JsonValue& _document)
+{
+    for (const auto& node : _document["nodes"].getElements())
+    {
+        GltfNode result;
+        result.name = node.getString("name", "");
+        result.localMatrix = readNodeMatrix(node);
+        result.mesh = node.getUint("mesh", NONE);
+        if (result.mesh != NONE && result.mesh >= m_meshes.size()) {
+            throw std::runtime_error("failed to load glTF: invalid node mesh!");
+        }
+        for (const auto& child : node["children"].getElements()) {
+            result.children.push_back(child.asUint());
+        }
+        m_nodes.push_back(std::move(result));
+    }
+
+    for (const auto& node : m_nodes)
+    {
+        for (uint32_t child : node.children)
+        {
+            if (child >= m_nodes.size()) {
+                throw std::runtime_error("failed to load glTF: invalid node child!");
+            }
+        }
+    }
+
+    // roots of the default scene, or all the nodes without parent
+    const JsonValue& scenes = _document["scenes"];
+    if (scenes.size() > 0)
+    {
+        uint32_t scene = std::min(_document.getUint("scene", 0), static_cast<uint32_t>(scenes.size()) - 1);
+        for (const auto& node : scenes[scene]["nodes"].getElements())
+        {
+            if (node.asUint() < m_nodes.size()) {
+                m_sceneRoots.push_back(node.asUint());
+            }
+        }
+    }
+    else
+    {
+        std::vector<uint8_t> isChild(m_nodes.size(), 0);
+        for (const auto& node : m_nodes)
+        {
+            for (uint32_t child : node.children) {
+                isChild[child] = 1;
+            }
+        }
+        for (uint32_t n = 0; n < static_cast<uint32_t>(m_nodes.size()); n++)
+        {
+            if (!isChild[n]) {
+                m_sceneRoots.push_back(n);
+            }
+        }
+    }
+}
+
+
+/*
+ * Depth first traversal of the scene (iterative: hierarchies can be deep), each node visited once
+ */
+std::vector<GltfMeshInstance> GltfModel::computeMeshInstances() const
+{
+    std::vector<GltfMeshInstance> instances;
+    std::vector<uint8_t> visited(m_nodes.size(), 0);
+    std::vector<std::pair<uint32_t, glm::mat4>> stack;
+    for (auto it = m_sceneRoots.rbegin(); it != m_sceneRoots.rend(); ++it) {
+        stack.emplace_back(*it, glm::mat4(1.0f));
+    }
+
+    while (!stack.empty())
+    {
+        auto [node, parentMatrix] = stack.back();
+        stack.pop_back();
+        if (visited[node]) {
+            continue;
+        }
+        visited[node] = 1;
+
+        glm::mat4 worldMatrix = parentMatrix * m_nodes[node].localMatrix;
+        if (m_nodes[node].mesh != NONE) {
+            instances.push_back({ m_nodes[node].mesh, worldMatrix });
+        }
+        const auto& children = m_nodes[node].children;
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.emplace_back(*it, worldMatrix);
+        }
+    }
+    return instances;
+}
+
+
+uint32_t GltfModel::getIndexCount(const GltfPrimitive& _primitive) const
+{
+    return (_primitive.indices != NONE) ? m_accessors[_primitive.indices].count : getVertexCount(_primitive);
+}
+
+
+Bounds GltfModel::computeBounds(const GltfPrimitive& _primitive) const
+{
+    const GltfAccessor& positions = m_accessors[_primitive.positions];
+    glm::vec3 minPos = positions.min;
+    glm::vec3 maxPos = positions.max;
+    if (!positions.hasBounds && positions.count > 0)
+    {
+        minPos = glm::vec3(std::numeric_limits<float>::max());
+        maxPos = glm::vec3(std::numeric_limits<float>::lowest());
+        for (uint32_t v = 0; v < positions.count; v++)
+        {
+            const uint8_t* element = positions.data + static_cast<size_t>(v) * positions.stride;
+            for (uint32_t c = 0; c < 3 && c < positions.componentCount; c++)
+            {
+                float value = readComponent(element + c * positions.componentSize, positions.componentType, positions.normalized);
+                minPos[c] = std::min(minPos[c], value);
+                maxPos[c] = std::max(maxPos[c], value);
+            }
+        }
+    }
+
+    Bounds bounds;
+    bounds.center = 0.5f * (minPos + maxPos);
+    bounds.extents = 0.5f * (maxPos - minPos);
+    bounds.radius = glm::length(bounds.extents);
+    return bounds;
+}
+
+
+/*
+ * Copies the elements of an accessor in an array of floats (e.g. mapped staging memory): in one memcpy when they
+ * already are packed floats, converted one by one otherwise
+ */
+bool GltfModel::copyAttribute(const GltfAccessor& _accessor, float* _dst, uint32_t _components)
+{
+    if (_accessor.isPackedFloat(_components))
+    {
+        std::memcpy(_dst, _accessor.data, static_cast<size_t>(_accessor.count) * _components * sizeof(float));
+        return true;
+    }
+
+    uint32_t copiedComponents = std::min(_components, _accessor.componentCount);
+    for (uint32_t e = 0; e < _accessor.count; e++)
+    {
+        const uint8_t* element = _accessor.data + static_cast<size_t>(e) * _accessor.stride;
+        float* dst = _dst + static_cast<size_t>(e) * _components;
+        for (uint32_t c = 0; c < copiedComponents; c++) {
+            dst[c] = readComponent(element + c * _accessor.componentSize, _accessor.componentType, _accessor.normalized);
+        }
+        for (uint32_t c = copiedComponents; c < _components; c++) {
+            dst[c] = 0.0f;
+        }
+    }
+    return false;
+}
+
+
+/*
+ * Copies the indices of a primitive as 32 bit integers (in one memcpy if they already are), or writes 0, 1, 2 ...
+ * for a non indexed primitive
+ */
+bool GltfModel::copyIndices(const GltfPrimitive& _primitive, uint32_t* _dst) const
+{
+    if (_primitive.indices == NONE)
+    {
+        for (uint32_t i = 0; i < getVertexCount(_primitive); i++) {
+            _dst[i] = i;
+        }
+        return false;
+    }
+
+    // an index out of the primitive would read the vertices of another mesh of the pool
+    // (checked on the mapped file: _dst may be write-combined memory, slow to read)
+    const GltfAccessor& indices = m_accessors[_primitive.indices];
+    uint32_t vertexCount = getVertexCount(_primitive);
+    uint32_t maxIndex = 0;
+    bool packed = indices.componentType == GltfAccessor::UNSIGNED_INT && indices.stride == 4;
+    for (uint32_t i = 0; i < indices.count; i++)
+    {
+        const uint8_t* element = indices.data + static_cast<size_t>(i) * indices.stride;
+        uint32_t index = 0;
+        switch (indices.componentType)
+        {
+            case GltfAccessor::UNSIGNED_BYTE: index = *element; break;
+            case GltfAccessor::UNSIGNED_SHORT:
+            {
+                uint16_t value;
+                std::memcpy(&value, element, sizeof(value));
+                index = value;
+                break;
+            }
+            default: index = readUint32(element); break;
+        }
+        maxIndex = std::max(maxIndex, index);
+        if (!packed) {
+            _dst[i] = index;
+        }
+    }
+    if (indices.count > 0 && maxIndex >= vertexCount) {
+        throw std::runtime_error("failed to load glTF: index out of the vertices of its primitive!");
+    }
+
+    if (packed) {
+        std::memcpy(_dst, indices.data, static_cast<size_t>(indices.count) * sizeof(uint32_t));
+    }
+    return packed;
+}
+
+
+/*
+ * Smooth normals (sum of the normals of the adjacent triangles, weighted by their area), for primitives without
+ * normals
+ */
+void GltfModel::computeNormals(const GltfPrimitive& _primitive, float* _dst) const
+{
+    uint32_t vertexCount = getVertexCount(_primitive);
+    std::vector<float> positions(static_cast<size_t>(vertexCount) * 3);
+    std::vector<uint32_t> indices(getIndexCount(_primitive));
+    copyAttribute(m_accessors[_primitive.positions], positions.data(), 3);
+    copyIndices(_primitive, indices.data());
+
+    auto position = [&positions](uint32_t _v) { return glm::vec3(positions[3 * _v], positions[3 * _v + 1], positions[3 * _v + 2]); };
+    std::vector<glm::vec3> normals(vertexCount, glm::vec3(0.0f));
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        glm::vec3 p0 = position(indices[t]);
+        glm::vec3 faceNormal = glm::cross(position(indices[t + 1]) - p0, position(indices[t + 2]) - p0);
+        for (uint32_t c = 0; c < 3; c++) {
+            normals[indices[t + c]] += faceNormal;
+        }
+    }
+
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        float length = glm::length(normals[v]);
+        glm::vec3 normal = (length > 0.0f) ? normals[v] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        _dst[3 * v] = normal.x;
+        _dst[3 * v + 1] = normal.y;
+        _dst[3 * v + 2] = normal.z;
+    }
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
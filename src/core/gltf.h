@@ -0,0 +1,205 @@
+/*********************************************************************************************************************
+ *
+ * gltf.h
+ *
+ * glTF 2.0 reader (.glb, or .gltf with external .bin and image files), independent from the GPU:
+ *  - the binary files are memory-mapped, never read nor copied into application buffers: accessors and images
+ *    point into the mappings, which live as long as the model
+ *  - copyAttribute() / copyIndices() write an accessor straight into its destination (e.g. staging memory), with
+ *    a single memcpy when its layout already matches (tightly packed floats, 32 bit indices), converted otherwise
+ *    (normalized integers, interleaved views, 8 and 16 bit indices)
+ *  - meshes (triangle primitives: position, normal, texcoord 0, color 0, indices), materials (base color factor and
+ *    texture), images, node hierarchy (matrix or translation / rotation / scale) and scenes
+ * Not supported: sparse accessors, base64 data URIs (convert the model to .glb), skins, morph targets, animations
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef GLTF_H
+#define GLTF_H
+
+
+#include "core/coreutils.h"
+#include "core/geometry.h"
+#include "core/mappedfile.h"
+
+#include <limits>
+
+namespace VulkanDemo
+{
+
+class JsonValue;
+
+
+/*
+ * Typed view of an array of elements, in a mapped buffer
+ */
+struct GltfAccessor
+{
+    // component types (values of the glTF specification)
+    static constexpr uint32_t BYTE = 5120;
+    static constexpr uint32_t UNSIGNED_BYTE = 5121;
+    static constexpr uint32_t SHORT = 5122;
+    static constexpr uint32_t UNSIGNED_SHORT = 5123;
+    static constexpr uint32_t UNSIGNED_INT = 5125;
+    static constexpr uint32_t FLOAT = 5126;
+
+    const uint8_t* data = nullptr;      // first element
+    uint32_t count = 0;
+    uint32_t componentType = FLOAT;
+    uint32_t componentCount = 1;        // 1 (SCALAR) to 4 (VEC4), 16 (MAT4)
+    uint32_t componentSize = 4;         // bytes
+    uint32_t stride = 4;                // bytes between 2 elements
+    bool normalized = false;
+
+    // per component (first 3 components), mandatory for positions
+    bool hasBounds = false;
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    // elements can be copied as they are into an array of _components floats
+    bool isPackedFloat(uint32_t _components) const
+    {
+        return componentType == FLOAT && componentCount == _components && stride == 4 * _components;
+    }
+};
+
+
+struct GltfPrimitive
+{
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    // accessor indices (NONE if missing)
+    uint32_t positions = NONE;
+    uint32_t normals = NONE;
+    uint32_t texCoords = NONE;
+    uint32_t colors = NONE;
+    uint32_t indices = NONE;            // non indexed primitives draw their vertices in order
+    uint32_t material = NONE;
+};
+
+
+struct GltfMesh
+{
+    std::string name;
+    std::vector<GltfPrimitive> primitives;
+};
+
+
+struct GltfMaterial
+{
+    std::string name;
+    glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    uint32_t baseColorImage = GltfPrimitive::NONE;
+};
+
+
+/*
+ * Content of an encoded image file (png, jpeg), in a mapped buffer or file
+ */
+struct GltfImage
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::string mimeType;
+};
+
+
+struct GltfNode
+{
+    std::string name;
+    glm::mat4 localMatrix = glm::mat4(1.0f);
+    uint32_t mesh = GltfPrimitive::NONE;
+    std::vector<uint32_t> children;
+};
+
+
+/*
+ * A mesh drawn by a node of the scene
+ */
+struct GltfMeshInstance
+{
+    uint32_t mesh = 0;
+    glm::mat4 worldMatrix = glm::mat4(1.0f);
+};
+
+
+class GltfModel
+{
+
+public:
+
+    static constexpr uint32_t NONE = GltfPrimitive::NONE;
+
+    GltfModel() = default;
+
+    // accessors point into its mapped files, it cannot be duplicated
+    GltfModel(GltfModel const& _other) = delete;
+    GltfModel& operator=(GltfModel const& _other) = delete;
+
+    virtual ~GltfModel() {};
+
+
+    const std::vector<GltfAccessor>& getAccessors() const { return m_accessors; }
+    const std::vector<GltfMesh>& getMeshes() const { return m_meshes; }
+    const std::vector<GltfMaterial>& getMaterials() const { return m_materials; }
+    const std::vector<GltfImage>& getImages() const { return m_images; }
+    const std::vector<GltfNode>& getNodes() const { return m_nodes; }
+    // primitives which are not triangle lists, or have no position (not kept in the meshes)
+    uint32_t getSkippedPrimitiveCount() const { return m_skippedPrimitiveCount; }
+
+    // .glb or .gltf, chosen by the content of the file
+    void load(const std::string& _path);
+
+    // meshes of the nodes of the default scene (all the root nodes if there is none), with their world matrices
+    std::vector<GltfMeshInstance> computeMeshInstances() const;
+
+    // nb of vertices and indices of a primitive (indices generated for non indexed primitives)
+    uint32_t getVertexCount(const GltfPrimitive& _primitive) const { return m_accessors[_primitive.positions].count; }
+    uint32_t getIndexCount(const GltfPrimitive& _primitive) const;
+    // bounds of the positions (from the min / max of the accessor, or computed if they are missing)
+    Bounds computeBounds(const GltfPrimitive& _primitive) const;
+
+    // writes count * _components floats (missing components are 0), returns true if copied as is
+    static bool copyAttribute(const GltfAccessor& _accessor, float* _dst, uint32_t _components);
+    // writes the indices of a primitive as 32 bit integers, returns true if copied as is
+    bool copyIndices(const GltfPrimitive& _primitive, uint32_t* _dst) const;
+    // writes vertex count * 3 floats
+    void computeNormals(const GltfPrimitive& _primitive, float* _dst) const;
+
+
+protected:
+
+    struct BufferView
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        uint32_t stride = 0;            // 0: tightly packed elements
+    };
+
+    void parseDocument(const JsonValue& _document, const std::string& _directory, const uint8_t* _binaryChunk, size_t _binaryChunkSize);
+    void parseAccessors(const JsonValue& _document, const std::vector<BufferView>& _views);
+    void parseMeshes(const JsonValue& _document);
+    void parseMaterials(const JsonValue& _document);
+    void parseNodes(const JsonValue& _document);
+    // maps a file referred by an uri relative to the model
+    const MappedFile& mapUri(const std::string& _directory, const std::string& _uri);
+
+    // the .glb / .gltf file, and the external buffers and images
+    std::vector<MappedFile> m_files;
+
+    std::vector<GltfAccessor> m_accessors;
+    std::vector<GltfMesh> m_meshes;
+    std::vector<GltfMaterial> m_materials;
+    std::vector<GltfImage> m_images;
+    std::vector<GltfNode> m_nodes;
+    std::vector<uint32_t> m_sceneRoots;
+    uint32_t m_skippedPrimitiveCount = 0;
+
+}; // class GltfModel
+
+} // namespace VulkanDemo
+
+#endif // GLTF_H
\ No newline at end of file
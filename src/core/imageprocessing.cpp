@@ -0,0 +1,77 @@
+/*********************************************************************************************************************
+ *
+ * imageprocessing.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "core/imageprocessing.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+uint32_t computeMipCount(uint32_t _width, uint32_t _height)
+{
+    uint32_t mipCount = 1;
+    uint32_t size = std::max(_width, _height);
+    while (size > 1)
+    {
+        size /= 2;
+        mipCount++;
+    }
+    return mipCount;
+}
+
+
+/*
+ * Each destination pixel is the rounded average of a 2x2 block of source pixels
+ */
+void downsampleBox(const uint8_t* _src, uint32_t _srcWidth, uint32_t _srcHeight, std::vector<uint8_t>& _dst)
+{
+    uint32_t dstWidth = std::max(1u, _srcWidth / 2);
+    uint32_t dstHeight = std::max(1u, _srcHeight / 2);
+    _dst.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+    // offsets in size_t: images of more than 2^30 pixels overflow 32 bit offsets
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        const uint8_t* row0 = _src + static_cast<size_t>(std::min(2 * y, _srcHeight - 1)) * _srcWidth * 4;
+        const uint8_t* row1 = _src + static_cast<size_t>(std::min(2 * y + 1, _srcHeight - 1)) * _srcWidth * 4;
+        uint8_t* dstRow = _dst.data() + static_cast<size_t>(y) * dstWidth * 4;
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+            size_t x0 = static_cast<size_t>(std::min(2 * x, _srcWidth - 1)) * 4;
+            size_t x1 = static_cast<size_t>(std::min(2 * x + 1, _srcWidth - 1)) * 4;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                dstRow[static_cast<size_t>(x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+
+std::vector<std::vector<uint8_t> > generateMipChain(const uint8_t* _pixels, uint32_t _width, uint32_t _height, uint32_t _mipCount)
+{
+    std::vector<std::vector<uint8_t> > mips(_mipCount);
+    mips[0].assign(_pixels, _pixels + static_cast<size_t>(_width) * _height * 4);
+
+    for (uint32_t mip = 1; mip < _mipCount; mip++)
+    {
+        uint32_t srcWidth = std::max(1u, _width >> (mip - 1));
+        uint32_t srcHeight = std::max(1u, _height >> (mip - 1));
+        downsampleBox(mips[mip - 1].data(), srcWidth, srcHeight, mips[mip]);
+    }
+    return mips;
+}
+
+} // namespace VulkanDemo
\ No newline at end of file
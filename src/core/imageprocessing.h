@@ -0,0 +1,32 @@
+/*********************************************************************************************************************
+ *
+ * imageprocessing.h
+ *
+ * CPU-side image processing, independent from the GPU (RGBA8 images, rows tightly packed)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef IMAGEPROCESSING_H
+#define IMAGEPROCESSING_H
+
+
+#include "core/coreutils.h"
+
+namespace VulkanDemo
+{
+
+// nb of mip levels of an image, down to a 1x1 level
+uint32_t computeMipCount(uint32_t _width, uint32_t _height);
+
+// half resolution copy of an image (2x2 box filter, edges clamped for odd sizes)
+void downsampleBox(const uint8_t* _src, uint32_t _srcWidth, uint32_t _srcHeight, std::vector<uint8_t>& _dst);
+
+// mip levels of an image, level 0 being a copy of the image
+std::vector<std::vector<uint8_t> > generateMipChain(const uint8_t* _pixels, uint32_t _width, uint32_t _height, uint32_t _mipCount);
+
+} // namespace VulkanDemo
+
+#endif // IMAGEPROCESSING_H
\ No newline at end of file
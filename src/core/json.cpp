@@ -0,0 +1,404 @@
+/*********************************************************************************************************************
+ *
+ * json.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "core/json.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Recursive descent parser over the text of a document
+ */
+class JsonParser
+{
+
+public:
+
+    // deeper documents are rejected (the parser is recursive)
+    static constexpr uint32_t MAX_DEPTH = 256;
+
+    JsonParser(std::string_view _text) : m_text(_text) {}
+
+    JsonValue parseDocument()
+    {
+        JsonValue value = parseValue(0);
+        skipWhitespace();
+        if (m_pos != m_text.size()) {
+            fail("unexpected characters after the value");
+        }
+        return value;
+    }
+
+
+protected:
+
+    [[noreturn]] void fail(const char* _message) const
+    {
+        throw std::runtime_error(std::string("failed to parse JSON: ") + _message + " at offset " + std::to_string(m_pos) + "!");
+    }
+
+    void skipWhitespace()
+    {
+        while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\n' || m_text[m_pos] == '\r')) {
+            m_pos++;
+        }
+    }
+
+    char peek() const { return (m_pos < m_text.size()) ? m_text[m_pos] : '\0'; }
+
+    void expect(char _c)
+    {
+        if (peek() != _c) {
+            fail((std::string("expected '") + _c + "'").c_str());
+        }
+        m_pos++;
+    }
+
+    void expectWord(std::string_view _word)
+    {
+        if (m_text.substr(m_pos, _word.size()) != _word) {
+            fail("invalid literal");
+        }
+        m_pos += _word.size();
+    }
+
+    JsonValue parseValue(uint32_t _depth)
+    {
+        if (_depth > MAX_DEPTH) {
+            fail("document too deep");
+        }
+
+        skipWhitespace();
+        JsonValue value;
+        switch (peek())
+        {
+            case '{': parseObject(value, _depth); break;
+            case '[': parseArray(value, _depth); break;
+            case '"':
+                value.m_type = JsonValue::Type::String;
+                value.m_string = parseString();
+                break;
+            case 't':
+                expectWord("true");
+                value.m_type = JsonValue::Type::Bool;
+                value.m_bool = true;
+                break;
+            case 'f':
+                expectWord("false");
+                value.m_type = JsonValue::Type::Bool;
+                break;
+            case 'n':
+                expectWord("null");
+                break;
+            default:
+                value.m_type = JsonValue::Type::Number;
+                value.m_number = parseNumber();
+                break;
+        }
+        return value;
+    }
+
+    void parseObject(JsonValue& _value, uint32_t _depth)
+    {
+        _value.m_type = JsonValue::Type::Object;
+        expect('{');
+        skipWhitespace();
+        if (peek() == '}')
+        {
+            m_pos++;
+            return;
+        }
+        while (true)
+        {
+            skipWhitespace();
+            _value.m_keys.push_back(parseString());
+            skipWhitespace();
+            expect(':');
+            _value.m_elements.push_back(parseValue(_depth + 1));
+            skipWhitespace();
+            if (peek() == ',')
+            {
+                m_pos++;
+                continue;
+            }
+            expect('}');
+            return;
+        }
+    }
+
+    void parseArray(JsonValue& _value, uint32_t _depth)
+    {
+        _value.m_type = JsonValue::Type::Array;
+        expect('[');
+        skipWhitespace();
+        if (peek() == ']')
+        {
+            m_pos++;
+            return;
+        }
+        while (true)
+        {
+            _value.m_elements.push_back(parseValue(_depth + 1));
+            skipWhitespace();
+            if (peek() == ',')
+            {
+                m_pos++;
+                continue;
+            }
+            expect(']');
+            return;
+        }
+    }
+
+    double parseNumber()
+    {
+        // strtod needs a null terminated string: the number is copied (they are short)
+        size_t start = m_pos;
+        while (m_pos < m_text.size() && std::strchr("+-0123456789.eE", m_text[m_pos]) != nullptr) {
+            m_pos++;
+        }
+        if (m_pos == start) {
+            fail("unexpected character");
+        }
+
+        std::string number(m_text.substr(start, m_pos - start));
+        char* end = nullptr;
+        double result = std::strtod(number.c_str(), &end);
+        if (end != number.c_str() + number.size() || !std::isfinite(result)) {
+            fail("invalid number");
+        }
+        return result;
+    }
+
+    uint32_t parseHex4()
+    {
+        if (m_pos + 4 > m_text.size()) {
+            fail("truncated unicode escape");
+        }
+        uint32_t code = 0;
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            char c = m_text[m_pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9')       code |= c - '0';
+            else if (c >= 'a' && c <= 'f')  code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')  code |= c - 'A' + 10;
+            else fail("invalid unicode escape");
+        }
+        return code;
+    }
+
+    static void appendUtf8(std::string& _string, uint32_t _code)
+    {
+        if (_code < 0x80) {
+            _string += static_cast<char>(_code);
+        }
+        else if (_code < 0x800)
+        {
+            _string += static_cast<char>(0xC0 | (_code >> 6));
+            _string += static_cast<char>(0x80 | (_code & 0x3F));
+        }
+        else if (_code < 0x10000)
+        {
+            _string += static_cast<char>(0xE0 | (_code >> 12));
+            _string += static_cast<char>(0x80 | ((_code >> 6) & 0x3F));
+            _string += static_cast<char>(0x80 | (_code & 0x3F));
+        }
+        else
+        {
+            _string += static_cast<char>(0xF0 | (_code >> 18));
+            _string += static_cast<char>(0x80 | ((_code >> 12) & 0x3F));
+            _string += static_cast<char>(0x80 | ((_code >> 6) & 0x3F));
+            _string += static_cast<char>(0x80 | (_code & 0x3F));
+        }
+    }
+
+    std::string parseString()
+    {
+        expect('"');
+        std::string result;
+        while (true)
+        {
+            if (m_pos >= m_text.size()) {
+                fail("unterminated string");
+            }
+            char c = m_text[m_pos++];
+            if (c == '"') {
+                return result;
+            }
+            if (c != '\\')
+            {
+                result += c;
+                continue;
+            }
+
+            if (m_pos >= m_text.size()) {
+                fail("unterminated string");
+            }
+            switch (m_text[m_pos++])
+            {
+                case '"':  result += '"'; break;
+                case '\\': result += '\\'; break;
+                case '/':  result += '/'; break;
+                case 'b':  result += '\b'; break;
+                case 'f':  result += '\f'; break;
+                case 'n':  result += '\n'; break;
+                case 'r':  result += '\r'; break;
+                case 't':  result += '\t'; break;
+                case 'u':
+                {
+                    uint32_t code = parseHex4();
+                    // surrogate pair
+                    if (code >= 0xD800 && code < 0xDC00 && m_text.substr(m_pos, 2) == "\\u")
+                    {
+                        m_pos += 2;
+                        uint32_t low = parseHex4();
+                        if (low < 0xDC00 || low > 0xDFFF) {
+                            fail("invalid surrogate pair");
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(result, code);
+                    break;
+                }
+                default: fail("invalid escape");
+            }
+        }
+    }
+
+    std::string_view m_text;
+    size_t m_pos = 0;
+
+}; // class JsonParser
+
+
+
+JsonValue JsonValue::parse(std::string_view _text)
+{
+    return JsonParser(_text).parseDocument();
+}
+
+
+bool JsonValue::asBool() const
+{
+    if (m_type != Type::Bool) {
+        throw std::runtime_error("failed to read JSON value: not a boolean!");
+    }
+    return m_bool;
+}
+
+
+double JsonValue::asNumber() const
+{
+    if (m_type != Type::Number) {
+        throw std::runtime_error("failed to read JSON value: not a number!");
+    }
+    return m_number;
+}
+
+
+uint32_t JsonValue::asUint() const
+{
+    double number = asNumber();
+    if (number < 0.0 || number > 4294967295.0 || number != std::floor(number)) {
+        throw std::runtime_error("failed to read JSON value: not an unsigned integer!");
+    }
+    return static_cast<uint32_t>(number);
+}
+
+
+const std::string& JsonValue::asString() const
+{
+    if (m_type != Type::String) {
+        throw std::runtime_error("failed to read JSON value: not a string!");
+    }
+    return m_string;
+}
+
+
+size_t JsonValue::size() const
+{
+    return (m_type == Type::Array || m_type == Type::Object) ? m_elements.size() : 0;
+}
+
+
+const JsonValue& JsonValue::operator[](size_t _index) const
+{
+    if (m_type != Type::Array || _index >= m_elements.size()) {
+        throw std::runtime_error("failed to read JSON value: index out of range!");
+    }
+    return m_elements[_index];
+}
+
+
+const std::vector<JsonValue>& JsonValue::getElements() const
+{
+    static const std::vector<JsonValue> empty;
+    return (m_type == Type::Array) ? m_elements : empty;
+}
+
+
+const JsonValue* JsonValue::find(std::string_view _key) const
+{
+    if (m_type != Type::Object) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < m_keys.size(); i++)
+    {
+        if (m_keys[i] == _key) {
+            return &m_elements[i];
+        }
+    }
+    return nullptr;
+}
+
+
+const JsonValue& JsonValue::operator[](std::string_view _key) const
+{
+    static const JsonValue null;
+    const JsonValue* value = find(_key);
+    return value ? *value : null;
+}
+
+
+double JsonValue::getNumber(std::string_view _key, double _default) const
+{
+    const JsonValue* value = find(_key);
+    return value ? value->asNumber() : _default;
+}
+
+
+uint32_t JsonValue::getUint(std::string_view _key, uint32_t _default) const
+{
+    const JsonValue* value = find(_key);
+    return value ? value->asUint() : _default;
+}
+
+
+bool JsonValue::getBool(std::string_view _key, bool _default) const
+{
+    const JsonValue* value = find(_key);
+    return value ? value->asBool() : _default;
+}
+
+
+std::string JsonValue::getString(std::string_view _key, const std::string& _default) const
+{
+    const JsonValue* value = find(_key);
+    return value ? value->asString() : _default;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
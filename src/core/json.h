@@ -0,0 +1,83 @@
+/*********************************************************************************************************************
+ *
+ * json.h
+ *
+ * Minimal JSON reader (RFC 8259), enough for the glTF manifests: the document is parsed once into a tree of values,
+ * objects keep their members in order (looked up by a linear search, they only have a few members)
+ * Strings are unescaped, \u escapes are converted to UTF-8
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef JSON_H
+#define JSON_H
+
+
+#include "core/coreutils.h"
+
+#include <string_view>
+#include <utility>
+
+namespace VulkanDemo
+{
+
+
+class JsonValue
+{
+
+public:
+
+    enum class Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+    JsonValue() = default;
+
+    Type getType() const { return m_type; }
+    bool isNull() const { return m_type == Type::Null; }
+    bool isNumber() const { return m_type == Type::Number; }
+    bool isString() const { return m_type == Type::String; }
+    bool isArray() const { return m_type == Type::Array; }
+    bool isObject() const { return m_type == Type::Object; }
+
+    // values of a wrong type throw, except for the defaults of the optional members below
+    bool asBool() const;
+    double asNumber() const;
+    uint32_t asUint() const;
+    const std::string& asString() const;
+
+    // nb of elements (array) or members (object)
+    size_t size() const;
+    const JsonValue& operator[](size_t _index) const;
+    const std::vector<JsonValue>& getElements() const;
+
+    // member of an object (null value if missing)
+    bool has(std::string_view _key) const { return find(_key) != nullptr; }
+    const JsonValue* find(std::string_view _key) const;
+    const JsonValue& operator[](std::string_view _key) const;
+
+    // optional members
+    double getNumber(std::string_view _key, double _default) const;
+    uint32_t getUint(std::string_view _key, uint32_t _default) const;
+    bool getBool(std::string_view _key, bool _default) const;
+    std::string getString(std::string_view _key, const std::string& _default) const;
+
+    static JsonValue parse(std::string_view _text);
+
+
+protected:
+
+    friend class JsonParser;
+
+    Type m_type = Type::Null;
+    bool m_bool = false;
+    double m_number = 0.0;
+    std::string m_string;
+    std::vector<JsonValue> m_elements;                          // array elements, or object member values
+    std::vector<std::string> m_keys;                            // object member names (same order as the values)
+
+}; // class JsonValue
+
+} // namespace VulkanDemo
+
+#endif // JSON_H
\ No newline at end of file
@@ -0,0 +1,143 @@
+/*********************************************************************************************************************
+ *
+ * mappedfile.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifdef _WIN32
+#define NOMINMAX 
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "core/mappedfile.h"
+
+
+namespace VulkanDemo
+{
+
+
+MappedFile& MappedFile::operator=(MappedFile&& _other) noexcept
+{
+    if (this != &_other)
+    {
+        close();
+        m_data = std::exchange(_other.m_data, nullptr);
+        m_size = std::exchange(_other.m_size, 0);
+        m_open = std::exchange(_other.m_open, false);
+#ifdef _WIN32
+        m_file = std::exchange(_other.m_file, nullptr);
+        m_mapping = std::exchange(_other.m_mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+
+/*
+ * Maps the whole file in read-only memory
+ */
+void MappedFile::open(const std::string& _path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open file " + _path + "!");
+    }
+    m_file = file;
+    m_open = true;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        close();
+        throw std::runtime_error("failed to read the size of file " + _path + "!");
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0) {
+        return;
+    }
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr)
+    {
+        close();
+        throw std::runtime_error("failed to map file " + _path + "!");
+    }
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        close();
+        throw std::runtime_error("failed to map file " + _path + "!");
+    }
+#else
+    int file = ::open(_path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("failed to open file " + _path + "!");
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+        ::close(file);
+        throw std::runtime_error("failed to read the size of file " + _path + "!");
+    }
+    m_size = static_cast<size_t>(status.st_size);
+    m_open = true;
+    if (m_size == 0)
+    {
+        ::close(file);
+        return;
+    }
+
+    // the mapping keeps its own reference to the file
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        m_size = 0;
+        m_open = false;
+        throw std::runtime_error("failed to map file " + _path + "!");
+    }
+    m_data = static_cast<const uint8_t*>(data);
+#endif
+}
+
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != nullptr) {
+        CloseHandle(m_file);
+    }
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    if (m_data != nullptr) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
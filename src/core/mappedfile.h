@@ -0,0 +1,65 @@
+/*********************************************************************************************************************
+ *
+ * mappedfile.h
+ *
+ * Read-only memory mapping of a whole file (MapViewOfFile on Windows, mmap elsewhere): the content is paged in
+ * by the OS when it is read, without being copied into a buffer of the application first
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+#include "core/coreutils.h"
+
+#include <utility>
+
+namespace VulkanDemo
+{
+
+
+class MappedFile
+{
+
+public:
+
+    MappedFile() = default;
+    MappedFile(const std::string& _path) { open(_path); }
+
+    // owns the mapping, it cannot be duplicated (but can be moved: the mapped address does not change)
+    MappedFile(MappedFile const& _other) = delete;
+    MappedFile& operator=(MappedFile const& _other) = delete;
+
+    MappedFile(MappedFile&& _other) noexcept { *this = std::move(_other); }
+    MappedFile& operator=(MappedFile&& _other) noexcept;
+
+    virtual ~MappedFile() { close(); };
+
+
+    const uint8_t* getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+    bool isOpen() const { return m_open; }
+
+    void open(const std::string& _path);
+    void close();
+
+
+protected:
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;            // an empty file is open but not mapped
+#ifdef _WIN32
+    void* m_file = nullptr;         // HANDLE
+    void* m_mapping = nullptr;      // HANDLE
+#endif
+
+}; // class MappedFile
+
+} // namespace VulkanDemo
+
+#endif // MAPPEDFILE_H
\ No newline at end of file
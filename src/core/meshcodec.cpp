@@ -0,0 +1,791 @@
+/*********************************************************************************************************************
+ *
+ * meshcodec.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <atomic>
+
+#include "core/meshcodec.h"
+
+// vertex decoding 16 vertices at a time (scalar otherwise)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace VulkanDemo
+{
+
+namespace
+{
+    // first byte of the encoded buffers (format version)
+    const uint8_t VERTEX_CODEC_HEADER = 0xA1;
+    const uint8_t INDEX_CODEC_HEADER = 0xE1;
+
+    // vertex codec
+    const uint32_t GROUP_SIZE = 16;                 // vertices whose deltas of a byte share the same bit width
+    const uint32_t VERTEX_BLOCK_MAX_VERTICES = 256;
+    const uint32_t VERTEX_BLOCK_MAX_BYTES = 8192;  // decoded block, kept in L1 cache
+
+    // suffix of the next temporary file written by CompressedMeshFile::write()
+    std::atomic<uint32_t> tempFileCount = 0;
+
+    // index codec
+    const uint32_t FIFO_SIZE = 16;
+    const uint8_t CODE_EDGE_MAX = 0xEF;             // (edge << 4) | vertex: edges 0 to 14
+    const uint8_t CODE_NEW_TRIANGLE = 0xF0;         // next 3 vertices
+    const uint8_t CODE_GENERIC_TRIANGLE = 0xFF;     // followed by 3 vertex tokens
+    const uint8_t VERTEX_NEXT = 0;                  // vertex codes (tokens of generic triangles)
+    const uint8_t VERTEX_EDGE_EXPLICIT = 15;        // after an edge: vertices 1 to 14 are in the FIFO
+    const uint8_t VERTEX_GENERIC_EXPLICIT = 17;     // in a generic triangle: vertices 1 to 16 are in the FIFO
+    const uint32_t INVALID_VERTEX = 0xFFFFFFFF;
+
+
+    inline uint8_t zigzag8(uint8_t _delta)
+    {
+        return static_cast<uint8_t>((_delta << 1) ^ static_cast<uint8_t>(static_cast<int8_t>(_delta) >> 7));
+    }
+
+#if !defined(MESHCODEC_SSE2)
+    inline uint8_t unzigzag8(uint8_t _value)
+    {
+        return static_cast<uint8_t>((_value >> 1) ^ (0u - (_value & 1u)));
+    }
+#endif
+
+
+    // decoded vertices copied at once to the destination, by blocks of whole groups
+    uint32_t getVertexBlockSize(uint32_t _vertexSize)
+    {
+        if (_vertexSize == 0 || _vertexSize % 4 != 0 || _vertexSize > 256) {
+            throw std::runtime_error("failed to encode vertex buffer: invalid vertex size!");
+        }
+        return std::min(VERTEX_BLOCK_MAX_VERTICES, (VERTEX_BLOCK_MAX_BYTES / _vertexSize) & ~(GROUP_SIZE - 1));
+    }
+
+
+    // bytes of a group of deltas, by mode (0: all zeros, 1: 2 bits each, 2: 4 bits each, 3: bytes)
+    const uint32_t GROUP_BYTES[4] = { 0, 4, 8, 16 };
+
+    /*
+     * Appends the zigzag deltas of a group: the delta i of a group of n bytes is in byte (i % n), shifted by
+     * bits * (i / n), so that the group is unpacked with a few shifts of whole words
+     */
+    uint32_t encodeGroup(std::vector<uint8_t>& _dst, const uint8_t* _deltas)
+    {
+        uint8_t maxDelta = *std::max_element(_deltas, _deltas + GROUP_SIZE);
+        uint32_t mode = (maxDelta == 0) ? 0 : (maxDelta < 4) ? 1 : (maxDelta < 16) ? 2 : 3;
+
+        if (mode == 3) {
+            _dst.insert(_dst.end(), _deltas, _deltas + GROUP_SIZE);
+        }
+        else if (mode != 0)
+        {
+            uint32_t bits = mode * 2;
+            uint32_t size = GROUP_BYTES[mode];
+            uint8_t packed[8] = {};
+            for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+                packed[i % size] |= static_cast<uint8_t>(_deltas[i] << (bits * (i / size)));
+            }
+            _dst.insert(_dst.end(), packed, packed + size);
+        }
+        return mode;
+    }
+
+
+#if defined(MESHCODEC_SSE2)
+
+    inline __m128i unpackGroup(const uint8_t* _data, uint32_t _mode)
+    {
+        switch (_mode)
+        {
+        case 0:
+            return _mm_setzero_si128();
+        case 1:
+        {
+            uint32_t word;
+            std::memcpy(&word, _data, sizeof(word));
+            return _mm_setr_epi32(static_cast<int>(word & 0x03030303), static_cast<int>((word >> 2) & 0x03030303),
+                                  static_cast<int>((word >> 4) & 0x03030303), static_cast<int>((word >> 6) & 0x03030303));
+        }
+        case 2:
+        {
+            uint64_t word;
+            std::memcpy(&word, _data, sizeof(word));
+            return _mm_set_epi64x(static_cast<long long>((word >> 4) & 0x0F0F0F0F0F0F0F0Full), static_cast<long long>(word & 0x0F0F0F0F0F0F0F0Full));
+        }
+        default:
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(_data));
+        }
+    }
+
+    /*
+     * Values of a byte of 16 vertices: prefix sum of the deltas, added to the value of the previous vertex
+     */
+    inline __m128i accumulateGroup(__m128i _zigzag, uint8_t& _previous)
+    {
+        __m128i half = _mm_and_si128(_mm_srli_epi16(_zigzag, 1), _mm_set1_epi8(0x7F));
+        __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(_zigzag, _mm_set1_epi8(1)));
+        __m128i values = _mm_xor_si128(half, sign);
+
+        values = _mm_add_epi8(values, _mm_slli_si128(values, 1));
+        values = _mm_add_epi8(values, _mm_slli_si128(values, 2));
+        values = _mm_add_epi8(values, _mm_slli_si128(values, 4));
+        values = _mm_add_epi8(values, _mm_slli_si128(values, 8));
+        values = _mm_add_epi8(values, _mm_set1_epi8(static_cast<char>(_previous)));
+
+        _previous = static_cast<uint8_t>(_mm_extract_epi16(values, 7) >> 8);
+        return values;
+    }
+
+#else
+
+    inline void unpackGroup(const uint8_t* _data, uint32_t _mode, uint8_t* _deltas)
+    {
+        switch (_mode)
+        {
+        case 0:
+            std::memset(_deltas, 0, GROUP_SIZE);
+            break;
+        case 1:
+        {
+            uint32_t word;
+            std::memcpy(&word, _data, sizeof(word));
+            for (uint32_t s = 0; s < 4; s++)
+            {
+                uint32_t values = (word >> (2 * s)) & 0x03030303;
+                std::memcpy(_deltas + 4 * s, &values, sizeof(values));
+            }
+            break;
+        }
+        case 2:
+        {
+            uint64_t word;
+            std::memcpy(&word, _data, sizeof(word));
+            uint64_t low = word & 0x0F0F0F0F0F0F0F0Full;
+            uint64_t high = (word >> 4) & 0x0F0F0F0F0F0F0F0Full;
+            std::memcpy(_deltas, &low, sizeof(low));
+            std::memcpy(_deltas + 8, &high, sizeof(high));
+            break;
+        }
+        default:
+            std::memcpy(_deltas, _data, GROUP_SIZE);
+            break;
+        }
+    }
+
+#endif
+
+
+    /*
+     * Decodes 4 bytes (a header byte with the modes of their groups, then the groups) of 16 vertices,
+     * returns the end of the data read
+     */
+    const uint8_t* decodeQuad(const uint8_t* _data, const uint8_t* _end, uint8_t* _dst, uint32_t _vertexSize, uint8_t* _previous)
+    {
+        if (_data == _end) {
+            throw std::runtime_error("failed to decode vertex buffer: truncated data!");
+        }
+        uint32_t header = *_data++;
+        const uint8_t* groups[4];
+        size_t size = 0;
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            groups[k] = _data + size;
+            size += GROUP_BYTES[(header >> (2 * k)) & 3];
+        }
+        if (static_cast<size_t>(_end - _data) < size) {
+            throw std::runtime_error("failed to decode vertex buffer: truncated data!");
+        }
+
+#if defined(MESHCODEC_SSE2)
+        __m128i v0 = accumulateGroup(unpackGroup(groups[0], header & 3), _previous[0]);
+        __m128i v1 = accumulateGroup(unpackGroup(groups[1], (header >> 2) & 3), _previous[1]);
+        __m128i v2 = accumulateGroup(unpackGroup(groups[2], (header >> 4) & 3), _previous[2]);
+        __m128i v3 = accumulateGroup(unpackGroup(groups[3], header >> 6), _previous[3]);
+
+        // transpose: 4 bytes of each vertex
+        __m128i t0 = _mm_unpacklo_epi8(v0, v1);
+        __m128i t1 = _mm_unpackhi_epi8(v0, v1);
+        __m128i t2 = _mm_unpacklo_epi8(v2, v3);
+        __m128i t3 = _mm_unpackhi_epi8(v2, v3);
+        alignas(16) uint32_t words[GROUP_SIZE];
+        _mm_store_si128(reinterpret_cast<__m128i*>(words), _mm_unpacklo_epi16(t0, t2));
+        _mm_store_si128(reinterpret_cast<__m128i*>(words + 4), _mm_unpackhi_epi16(t0, t2));
+        _mm_store_si128(reinterpret_cast<__m128i*>(words + 8), _mm_unpacklo_epi16(t1, t3));
+        _mm_store_si128(reinterpret_cast<__m128i*>(words + 12), _mm_unpackhi_epi16(t1, t3));
+
+        for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+            std::memcpy(_dst + i * _vertexSize, &words[i], sizeof(uint32_t));
+        }
+#else
+        uint8_t deltas[GROUP_SIZE];
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            unpackGroup(groups[k], (header >> (2 * k)) & 3, deltas);
+            uint8_t value = _previous[k];
+            for (uint32_t i = 0; i < GROUP_SIZE; i++)
+            {
+                value = static_cast<uint8_t>(value + unzigzag8(deltas[i]));
+                _dst[i * _vertexSize + k] = value;
+            }
+            _previous[k] = value;
+        }
+#endif
+        return _data + size;
+    }
+
+
+    /*
+     * Recently used edges and vertices, updated in the same way by the encoder and the decoder
+     */
+    struct IndexCodecState
+    {
+        uint32_t edges[FIFO_SIZE][2];
+        uint32_t vertices[FIFO_SIZE];
+        uint32_t edgeHead = 0;          // next slot written
+        uint32_t vertexHead = 0;
+        uint32_t next = 0;              // first vertex not referenced yet (if the vertices are in order of first use)
+        uint32_t last = 0;              // last explicit vertex
+
+        IndexCodecState()
+        {
+            std::fill(&edges[0][0], &edges[0][0] + 2 * FIFO_SIZE, INVALID_VERTEX);
+            std::fill(vertices, vertices + FIFO_SIZE, INVALID_VERTEX);
+        }
+
+        // 0: most recent
+        const uint32_t* getEdge(uint32_t _age) const { return edges[(edgeHead - 1 - _age) & (FIFO_SIZE - 1)]; }
+        uint32_t getVertex(uint32_t _age) const { return vertices[(vertexHead - 1 - _age) & (FIFO_SIZE - 1)]; }
+
+        void pushEdge(uint32_t _a, uint32_t _b)
+        {
+            edges[edgeHead & (FIFO_SIZE - 1)][0] = _a;
+            edges[edgeHead & (FIFO_SIZE - 1)][1] = _b;
+            edgeHead++;
+        }
+
+        void pushVertex(uint32_t _v)
+        {
+            vertices[vertexHead & (FIFO_SIZE - 1)] = _v;
+            vertexHead++;
+        }
+
+        // age in the vertex FIFO, or FIFO_SIZE if missing
+        uint32_t findVertex(uint32_t _v, uint32_t _maxAge) const
+        {
+            for (uint32_t age = 0; age < _maxAge; age++)
+            {
+                if (getVertex(age) == _v) {
+                    return age;
+                }
+            }
+            return FIFO_SIZE;
+        }
+    };
+
+
+    void writeVarint(std::vector<uint8_t>& _dst, uint32_t _value)
+    {
+        while (_value >= 0x80)
+        {
+            _dst.push_back(static_cast<uint8_t>(_value | 0x80));
+            _value >>= 7;
+        }
+        _dst.push_back(static_cast<uint8_t>(_value));
+    }
+
+    uint32_t readVarint(const uint8_t*& _data, const uint8_t* _end)
+    {
+        uint32_t value = 0;
+        for (uint32_t shift = 0; shift < 35; shift += 7)
+        {
+            if (_data == _end) {
+                break;
+            }
+            uint8_t byte = *_data++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("failed to decode index buffer: invalid varint!");
+    }
+
+
+    // explicit vertex, zigzag delta to the last explicit vertex
+    void writeExplicitVertex(std::vector<uint8_t>& _dst, IndexCodecState& _state, uint32_t _v)
+    {
+        int32_t delta = static_cast<int32_t>(_v - _state.last);
+        writeVarint(_dst, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+        _state.last = _v;
+        _state.pushVertex(_v);
+    }
+
+    uint32_t readExplicitVertex(const uint8_t*& _data, const uint8_t* _end, IndexCodecState& _state)
+    {
+        uint32_t value = readVarint(_data, _end);
+        uint32_t v = _state.last + ((value >> 1) ^ (0u - (value & 1u)));
+        _state.last = v;
+        _state.pushVertex(v);
+        return v;
+    }
+
+
+    // vertex token of a generic triangle
+    void writeGenericVertex(std::vector<uint8_t>& _dst, IndexCodecState& _state, uint32_t _v)
+    {
+        if (_v == _state.next)
+        {
+            _dst.push_back(VERTEX_NEXT);
+            _state.pushVertex(_state.next++);
+            return;
+        }
+        uint32_t age = _state.findVertex(_v, FIFO_SIZE);
+        if (age < FIFO_SIZE)
+        {
+            _dst.push_back(static_cast<uint8_t>(1 + age));
+            return;
+        }
+        _dst.push_back(VERTEX_GENERIC_EXPLICIT);
+        writeExplicitVertex(_dst, _state, _v);
+    }
+
+    uint32_t readGenericVertex(const uint8_t*& _data, const uint8_t* _end, IndexCodecState& _state)
+    {
+        if (_data == _end) {
+            throw std::runtime_error("failed to decode index buffer: truncated data!");
+        }
+        uint8_t token = *_data++;
+        if (token == VERTEX_NEXT)
+        {
+            uint32_t v = _state.next++;
+            _state.pushVertex(v);
+            return v;
+        }
+        if (token < VERTEX_GENERIC_EXPLICIT) {
+            return _state.getVertex(token - 1);
+        }
+        if (token == VERTEX_GENERIC_EXPLICIT) {
+            return readExplicitVertex(_data, _end, _state);
+        }
+        throw std::runtime_error("failed to decode index buffer: invalid vertex token!");
+    }
+}
+
+
+/*
+ * Encodes vertices by groups of 16 (the last one padded with copies of the last vertex), 4 bytes at a time:
+ * a header byte with the modes of the 4 groups of deltas, then the groups (see encodeGroup())
+ */
+std::vector<uint8_t> encodeVertexBuffer(const uint8_t* _vertices, uint32_t _vertexCount, uint32_t _vertexSize)
+{
+    getVertexBlockSize(_vertexSize);
+
+    std::vector<uint8_t> encoded;
+    encoded.reserve(1 + static_cast<size_t>(_vertexCount) * _vertexSize);
+    encoded.push_back(VERTEX_CODEC_HEADER);
+
+    std::vector<uint8_t> previous(_vertexSize, 0);
+    uint8_t deltas[GROUP_SIZE];
+
+    for (uint32_t first = 0; first < _vertexCount; first += GROUP_SIZE)
+    {
+        uint32_t count = std::min(GROUP_SIZE, _vertexCount - first);
+        const uint8_t* group = _vertices + static_cast<size_t>(first) * _vertexSize;
+
+        for (uint32_t k = 0; k < _vertexSize; k += 4)
+        {
+            size_t headerOffset = encoded.size();
+            encoded.push_back(0);
+
+            for (uint32_t b = 0; b < 4; b++)
+            {
+                uint8_t last = previous[k + b];
+                for (uint32_t i = 0; i < GROUP_SIZE; i++)
+                {
+                    uint8_t value = (i < count) ? group[i * _vertexSize + k + b] : last;
+                    deltas[i] = zigzag8(static_cast<uint8_t>(value - last));
+                    last = value;
+                }
+                previous[k + b] = last;
+                encoded[headerOffset] |= static_cast<uint8_t>(encodeGroup(encoded, deltas) << (2 * b));
+            }
+        }
+    }
+    return encoded;
+}
+
+
+/*
+ * Each block of groups is rebuilt in a local buffer, then copied as a whole: _dst can be write-combined memory
+ */
+size_t decodeVertexBuffer(uint8_t* _dst, uint32_t _vertexCount, uint32_t _vertexSize, const uint8_t* _encoded, size_t _encodedSize)
+{
+    uint32_t blockSize = getVertexBlockSize(_vertexSize);
+    if (_encodedSize < 1 || _encoded[0] != VERTEX_CODEC_HEADER) {
+        throw std::runtime_error("failed to decode vertex buffer: invalid header!");
+    }
+    const uint8_t* data = _encoded + 1;
+    const uint8_t* end = _encoded + _encodedSize;
+
+    alignas(16) uint8_t block[VERTEX_BLOCK_MAX_BYTES];
+    uint8_t previous[256] = {};
+
+    for (uint32_t first = 0; first < _vertexCount; first += blockSize)
+    {
+        uint32_t count = std::min(blockSize, _vertexCount - first);
+
+        for (uint32_t group = 0; group < count; group += GROUP_SIZE)
+        {
+            for (uint32_t k = 0; k < _vertexSize; k += 4) {
+                data = decodeQuad(data, end, block + group * _vertexSize + k, _vertexSize, previous + k);
+            }
+        }
+
+        std::memcpy(_dst + static_cast<size_t>(first) * _vertexSize, block, static_cast<size_t>(count) * _vertexSize);
+    }
+    return static_cast<size_t>(data - _encoded);
+}
+
+
+/*
+ * Encodes the triangles in order, each one with a code byte (see meshcodec.h):
+ *  - (edge << 4) | vertex: a rotation of the triangle has an edge of the edge FIFO (reversed), the third vertex is
+ *    the next one (0), in the vertex FIFO (1 to 14), or explicit (15, followed by a varint)
+ *  - CODE_NEW_TRIANGLE: the next 3 vertices
+ *  - CODE_GENERIC_TRIANGLE: followed by a token per vertex (next, in the FIFO, or explicit)
+ */
+std::vector<uint8_t> encodeIndexBuffer(const uint32_t* _indices, uint32_t _indexCount)
+{
+    if (_indexCount % 3 != 0) {
+        throw std::runtime_error("failed to encode index buffer: not a triangle list!");
+    }
+
+    std::vector<uint8_t> encoded;
+    encoded.reserve(1 + _indexCount / 3 + _indexCount / 16);
+    encoded.push_back(INDEX_CODEC_HEADER);
+
+    IndexCodecState state;
+
+    for (uint32_t i = 0; i < _indexCount; i += 3)
+    {
+        const uint32_t* triangle = _indices + i;
+
+        // 1. -----------------------------------------------------------------------------------------
+        // shared edge: most recent edge first, any rotation
+        bool shared = false;
+        for (uint32_t age = 0; age < FIFO_SIZE - 1 && !shared; age++)
+        {
+            const uint32_t* edge = state.getEdge(age);
+            for (uint32_t r = 0; r < 3; r++)
+            {
+                uint32_t x = triangle[r];
+                uint32_t y = triangle[(r + 1) % 3];
+                uint32_t z = triangle[(r + 2) % 3];
+                if (edge[0] != y || edge[1] != x) {
+                    continue;
+                }
+
+                uint8_t vertexCode;
+                if (z == state.next)
+                {
+                    vertexCode = VERTEX_NEXT;
+                    state.pushVertex(state.next++);
+                }
+                else
+                {
+                    uint32_t vertexAge = state.findVertex(z, VERTEX_EDGE_EXPLICIT - 1);
+                    vertexCode = (vertexAge < FIFO_SIZE) ? static_cast<uint8_t>(1 + vertexAge) : VERTEX_EDGE_EXPLICIT;
+                }
+                encoded.push_back(static_cast<uint8_t>((age << 4) | vertexCode));
+                if (vertexCode == VERTEX_EDGE_EXPLICIT) {
+                    writeExplicitVertex(encoded, state, z);
+                }
+
+                state.pushEdge(y, z);
+                state.pushEdge(z, x);
+                shared = true;
+                break;
+            }
+        }
+        if (shared) {
+            continue;
+        }
+
+        // 2. -----------------------------------------------------------------------------------------
+        // new or generic triangle
+        if (triangle[0] == state.next && triangle[1] == state.next + 1 && triangle[2] == state.next + 2)
+        {
+            encoded.push_back(CODE_NEW_TRIANGLE);
+            for (uint32_t v = 0; v < 3; v++) {
+                state.pushVertex(state.next++);
+            }
+        }
+        else
+        {
+            encoded.push_back(CODE_GENERIC_TRIANGLE);
+            for (uint32_t v = 0; v < 3; v++) {
+                writeGenericVertex(encoded, state, triangle[v]);
+            }
+        }
+        state.pushEdge(triangle[0], triangle[1]);
+        state.pushEdge(triangle[1], triangle[2]);
+        state.pushEdge(triangle[2], triangle[0]);
+    }
+    return encoded;
+}
+
+
+/*
+ * Replays the updates of the encoder; the decoded triangles can be rotations of the encoded ones
+ */
+size_t decodeIndexBuffer(uint32_t* _dst, uint32_t _indexCount, uint32_t _vertexCount, const uint8_t* _encoded, size_t _encodedSize)
+{
+    if (_indexCount % 3 != 0) {
+        throw std::runtime_error("failed to decode index buffer: not a triangle list!");
+    }
+    if (_encodedSize < 1 || _encoded[0] != INDEX_CODEC_HEADER) {
+        throw std::runtime_error("failed to decode index buffer: invalid header!");
+    }
+    const uint8_t* data = _encoded + 1;
+    const uint8_t* end = _encoded + _encodedSize;
+
+    IndexCodecState state;
+
+    for (uint32_t i = 0; i < _indexCount; i += 3)
+    {
+        if (data == end) {
+            throw std::runtime_error("failed to decode index buffer: truncated data!");
+        }
+        uint8_t code = *data++;
+        uint32_t a, b, c;
+
+        if (code <= CODE_EDGE_MAX)
+        {
+            const uint32_t* edge = state.getEdge(code >> 4);
+            a = edge[1];
+            b = edge[0];
+
+            uint32_t vertexCode = code & 15;
+            if (vertexCode == VERTEX_NEXT)
+            {
+                c = state.next++;
+                state.pushVertex(c);
+            }
+            else if (vertexCode < VERTEX_EDGE_EXPLICIT) {
+                c = state.getVertex(vertexCode - 1);
+            }
+            else {
+                c = readExplicitVertex(data, end, state);
+            }
+
+            state.pushEdge(b, c);
+            state.pushEdge(c, a);
+        }
+        else
+        {
+            if (code == CODE_NEW_TRIANGLE)
+            {
+                a = state.next;
+                b = state.next + 1;
+                c = state.next + 2;
+                state.next += 3;
+                state.pushVertex(a);
+                state.pushVertex(b);
+                state.pushVertex(c);
+            }
+            else if (code == CODE_GENERIC_TRIANGLE)
+            {
+                a = readGenericVertex(data, end, state);
+                b = readGenericVertex(data, end, state);
+                c = readGenericVertex(data, end, state);
+            }
+            else {
+                throw std::runtime_error("failed to decode index buffer: invalid triangle code!");
+            }
+
+            state.pushEdge(a, b);
+            state.pushEdge(b, c);
+            state.pushEdge(c, a);
+        }
+
+        // also rejects the unused entries of the FIFOs
+        if (a >= _vertexCount || b >= _vertexCount || c >= _vertexCount) {
+            throw std::runtime_error("failed to decode index buffer: vertex index out of range!");
+        }
+        _dst[i] = a;
+        _dst[i + 1] = b;
+        _dst[i + 2] = c;
+    }
+    return static_cast<size_t>(data - _encoded);
+}
+
+
+
+Bounds CompressedMeshFile::getBounds() const
+{
+    Bounds bounds;
+    bounds.center = glm::vec3(m_header.center[0], m_header.center[1], m_header.center[2]);
+    bounds.extents = glm::vec3(m_header.extents[0], m_header.extents[1], m_header.extents[2]);
+    bounds.radius = m_header.radius;
+    return bounds;
+}
+
+
+/*
+ * Reads the header only, and checks that the file holds exactly the sections it describes
+ */
+bool CompressedMeshFile::isCurrent(const std::string& _path)
+{
+    std::ifstream file(_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    CompressedMeshHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(CompressedMeshHeader))) {
+        return false;
+    }
+
+    CompressedMeshHeader reference;
+    if (std::memcmp(header.magic, reference.magic, sizeof(reference.magic)) != 0 || header.version != reference.version) {
+        return false;
+    }
+
+    uint64_t expectedSize = sizeof(CompressedMeshHeader) + uint64_t(header.indexSize);
+    for (uint32_t s = 0; s < STREAM_COUNT; s++) {
+        expectedSize += header.streamSizes[s];
+    }
+    return fileSize == expectedSize;
+}
+
+
+/*
+ * Maps a compressed mesh file, and checks that its sections fit in it
+ */
+void CompressedMeshFile::open(const std::string& _path)
+{
+    m_file.open(_path);
+
+    CompressedMeshHeader reference;
+    if (m_file.getSize() < sizeof(CompressedMeshHeader)) {
+        throw std::runtime_error("invalid compressed mesh file " + _path + "!");
+    }
+    std::memcpy(&m_header, m_file.getData(), sizeof(CompressedMeshHeader));
+    if (std::memcmp(m_header.magic, reference.magic, sizeof(reference.magic)) != 0 || m_header.version != reference.version) {
+        throw std::runtime_error("invalid compressed mesh file " + _path + "!");
+    }
+
+    uint64_t offset = sizeof(CompressedMeshHeader);
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        m_streams[s] = m_file.getData() + offset;
+        offset += m_header.streamSizes[s];
+    }
+    m_indices = m_file.getData() + offset;
+    offset += m_header.indexSize;
+
+    if (offset > m_file.getSize()) {
+        throw std::runtime_error("invalid compressed mesh file " + _path + ": truncated!");
+    }
+}
+
+
+void CompressedMeshFile::decodeStream(uint32_t _stream, float* _dst) const
+{
+    decodeVertexBuffer(reinterpret_cast<uint8_t*>(_dst), m_header.vertexCount, 4 * STREAM_COMPONENTS[_stream],
+                       m_streams[_stream], m_header.streamSizes[_stream]);
+}
+
+
+void CompressedMeshFile::decodeIndices(uint32_t* _dst) const
+{
+    decodeIndexBuffer(_dst, m_header.indexCount, m_header.vertexCount, m_indices, m_header.indexSize);
+}
+
+
+/*
+ * Encodes a mesh into a compressed mesh file (offline step)
+ * The vertices are split into streams of packed floats, in the layout of the geometry pool
+ */
+void CompressedMeshFile::write(const std::string& _path, const MeshData& _mesh)
+{
+    CompressedMeshHeader header;
+    header.vertexCount = static_cast<uint32_t>(_mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(_mesh.indices.size());
+
+    Bounds bounds = computeBounds(_mesh.vertices);
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        header.center[c] = bounds.center[c];
+        header.extents[c] = bounds.extents[c];
+    }
+    header.radius = bounds.radius;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // vertex streams
+    std::array<std::vector<uint8_t>, STREAM_COUNT> streams;
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        uint32_t components = STREAM_COMPONENTS[s];
+        std::vector<float> stream(static_cast<size_t>(header.vertexCount) * components);
+        for (size_t v = 0; v < _mesh.vertices.size(); v++)
+        {
+            const Vertex& vertex = _mesh.vertices[v];
+            const float* src = (s == 0) ? &vertex.pos.x : (s == 1) ? &vertex.color.x : (s == 2) ? &vertex.texCoord.x : &vertex.normal.x;
+            std::copy(src, src + components, &stream[v * components]);
+        }
+        streams[s] = encodeVertexBuffer(reinterpret_cast<const uint8_t*>(stream.data()), header.vertexCount, 4 * components);
+        header.streamSizes[s] = static_cast<uint32_t>(streams[s].size());
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // indices
+    std::vector<uint8_t> indices = encodeIndexBuffer(_mesh.indices.data(), header.indexCount);
+    header.indexSize = static_cast<uint32_t>(indices.size());
+
+    // 3. -----------------------------------------------------------------------------------------
+    // written next to its final name, then renamed: an interrupted write never leaves a file with a valid header
+    std::string tempPath = _path + "." + std::to_string(tempFileCount++) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to create compressed mesh file " + _path + "!");
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(CompressedMeshHeader));
+        for (const auto& stream : streams) {
+            file.write(reinterpret_cast<const char*>(stream.data()), stream.size());
+        }
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size());
+        file.close();
+        if (!file)
+        {
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            throw std::runtime_error("failed to write compressed mesh file " + _path + "!");
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, _path, error);
+    if (error)
+    {
+        std::filesystem::remove(tempPath, error);
+        throw std::runtime_error("failed to write compressed mesh file " + _path + "!");
+    }
+}
+
+} // namespace VulkanDemo
\ No newline at end of file
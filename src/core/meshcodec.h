@@ -0,0 +1,112 @@
+/*********************************************************************************************************************
+ *
+ * meshcodec.h
+ *
+ * Lossless compression of vertex and index buffers (in the spirit of meshoptimizer's codecs), decoded fast enough
+ * to be decoded straight into staging memory:
+ *  - vertices: each byte of a vertex is delta-coded against the same byte of the previous vertex, zigzag-mapped, and
+ *    the deltas of 16 vertices are stored with 0, 2, 4 or 8 bits each (a 2 bit header per byte of the vertex).
+ *    Decoded 16 vertices at a time (SSE2 when available) into a small local buffer, copied by blocks of 256 vertices
+ *  - indices: one code byte per triangle, referring to a recent edge (FIFO of 16 edges, shared with a previous
+ *    triangle) plus a third vertex which is the next unused vertex, a recent vertex (FIFO of 16 vertices), or an
+ *    explicit zigzag varint delta. Triangles may come out rotated (same winding), never reordered
+ *  - CompressedMeshFile: .vmesh file holding the 4 vertex streams of the geometry pool and the indices, memory-mapped
+ *    and decoded stream by stream
+ * Both codecs work best when the vertices are in the order of their first use by the triangles (see weldVertices())
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef MESHCODEC_H
+#define MESHCODEC_H
+
+
+#include "core/coreutils.h"
+#include "core/geometry.h"
+#include "core/mappedfile.h"
+
+#include <array>
+
+namespace VulkanDemo
+{
+
+
+// vertices of _vertexSize bytes (multiple of 4, at most 256)
+std::vector<uint8_t> encodeVertexBuffer(const uint8_t* _vertices, uint32_t _vertexCount, uint32_t _vertexSize);
+// writes _vertexCount * _vertexSize bytes, returns the nb of encoded bytes read (throws if the data is invalid)
+size_t decodeVertexBuffer(uint8_t* _dst, uint32_t _vertexCount, uint32_t _vertexSize, const uint8_t* _encoded, size_t _encodedSize);
+
+// triangle list
+std::vector<uint8_t> encodeIndexBuffer(const uint32_t* _indices, uint32_t _indexCount);
+// writes _indexCount indices, returns the nb of encoded bytes read (throws if the data is invalid, or if an index
+// is not below _vertexCount)
+size_t decodeIndexBuffer(uint32_t* _dst, uint32_t _indexCount, uint32_t _vertexCount, const uint8_t* _encoded, size_t _encodedSize);
+
+
+/*
+ * Compressed mesh format (.vmesh):
+ *  - header (CompressedMeshHeader)
+ *  - encoded vertex streams (positions, colors, texture coordinates, normals: packed floats), then encoded indices
+ */
+struct CompressedMeshHeader
+{
+    char magic[4] = { 'V', 'M', 'S', 'H' };
+    uint32_t version = 1;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    float center[3] = { 0.0f, 0.0f, 0.0f };     // bounds of the positions
+    float extents[3] = { 0.0f, 0.0f, 0.0f };
+    float radius = 0.0f;
+    uint32_t streamSizes[4] = { 0, 0, 0, 0 };   // encoded bytes
+    uint32_t indexSize = 0;
+};
+
+
+class CompressedMeshFile
+{
+
+public:
+
+    // same streams as the geometry pool
+    static constexpr uint32_t STREAM_COUNT = 4;
+    static constexpr std::array<uint32_t, STREAM_COUNT> STREAM_COMPONENTS = { 3, 3, 2, 3 };   // floats per vertex
+
+    CompressedMeshFile() = default;
+
+    // owns the mapping of the file, it cannot be duplicated
+    CompressedMeshFile(CompressedMeshFile const& _other) = delete;
+    CompressedMeshFile& operator=(CompressedMeshFile const& _other) = delete;
+
+    virtual ~CompressedMeshFile() {};
+
+
+    CompressedMeshHeader const& getHeader() const { return m_header; }
+    uint32_t getVertexCount() const { return m_header.vertexCount; }
+    uint32_t getIndexCount() const { return m_header.indexCount; }
+    Bounds getBounds() const;
+    size_t getFileSize() const { return m_file.getSize(); }
+
+    void open(const std::string& _path);
+    // false if the file is missing, or was written by another version of the format (it must be written again)
+    static bool isCurrent(const std::string& _path);
+    // _dst holds vertex count * STREAM_COMPONENTS[_stream] floats
+    void decodeStream(uint32_t _stream, float* _dst) const;
+    void decodeIndices(uint32_t* _dst) const;
+
+    static void write(const std::string& _path, const MeshData& _mesh);
+
+
+protected:
+
+    MappedFile m_file;
+    CompressedMeshHeader m_header;
+    std::array<const uint8_t*, STREAM_COUNT> m_streams{};
+    const uint8_t* m_indices = nullptr;
+
+}; // class CompressedMeshFile
+
+} // namespace VulkanDemo
+
+#endif // MESHCODEC_H
\ No newline at end of file
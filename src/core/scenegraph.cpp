@@ -0,0 +1,306 @@
+/*********************************************************************************************************************
+ *
+ * scenegraph.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "core/scenegraph.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Starts the worker threads (none: levels are all processed by the thread calling update())
+ */
+void SceneGraph::start(uint32_t _workerCount)
+{
+    if (!m_workers.empty()) {
+        return;
+    }
+
+    m_stopping = false;
+    for (uint32_t i = 0; i < _workerCount; i++) {
+        // the current level id is given, so that a worker started late does not miss the next level
+        m_workers.emplace_back(&SceneGraph::work, this, m_levelId);
+    }
+}
+
+
+void SceneGraph::stop()
+{
+    if (m_workers.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workCondition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+
+void SceneGraph::clear()
+{
+    m_translations.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_worldMatrices.clear();
+    m_parents.clear();
+    m_dirty.clear();
+    m_handles.clear();
+    m_slots.clear();
+    m_depths.clear();
+    m_levelStarts.clear();
+    m_sorted = true;
+    m_firstDirtySlot = 0;
+}
+
+
+/*
+ * Appends a node (dirty), the arrays are sorted by depth again on the next update
+ */
+SceneGraph::NodeHandle SceneGraph::addNode(NodeHandle _parent, const glm::vec3& _translation, const glm::quat& _rotation, const glm::vec3& _scale)
+{
+    NodeHandle handle = static_cast<NodeHandle>(m_slots.size());
+    if (_parent != NO_PARENT && _parent >= handle) {
+        throw std::runtime_error("failed to add scene node: invalid parent!");
+    }
+
+    uint32_t slot = static_cast<uint32_t>(m_handles.size());
+    m_slots.push_back(slot);
+    m_depths.push_back((_parent == NO_PARENT) ? 0 : m_depths[_parent] + 1);
+
+    m_translations.push_back(_translation);
+    m_rotations.push_back(_rotation);
+    m_scales.push_back(_scale);
+    m_worldMatrices.push_back(glm::mat4(1.0f));
+    m_parents.push_back((_parent == NO_PARENT) ? NO_PARENT : m_slots[_parent]);
+    m_dirty.push_back(1);
+    m_handles.push_back(handle);
+
+    m_sorted = false;
+    return handle;
+}
+
+
+void SceneGraph::markDirty(uint32_t _slot)
+{
+    m_dirty[_slot] = 1;
+    m_firstDirtySlot = std::min(m_firstDirtySlot, _slot);
+}
+
+
+void SceneGraph::setTranslation(NodeHandle _node, const glm::vec3& _translation)
+{
+    m_translations[m_slots[_node]] = _translation;
+    markDirty(m_slots[_node]);
+}
+
+
+void SceneGraph::setRotation(NodeHandle _node, const glm::quat& _rotation)
+{
+    m_rotations[m_slots[_node]] = _rotation;
+    markDirty(m_slots[_node]);
+}
+
+
+void SceneGraph::setScale(NodeHandle _node, const glm::vec3& _scale)
+{
+    m_scales[m_slots[_node]] = _scale;
+    markDirty(m_slots[_node]);
+}
+
+
+/*
+ * Counting sort of the nodes by depth (stable: nodes of a level stay in the order they were added)
+ */
+void SceneGraph::sortByDepth()
+{
+    uint32_t nodeCount = getNodeCount();
+    uint32_t levelCount = (nodeCount == 0) ? 0 : *std::max_element(m_depths.begin(), m_depths.end()) + 1;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // first slot of each level, and new slot of each handle
+    m_levelStarts.assign(levelCount + 1, 0);
+    for (uint32_t depth : m_depths) {
+        m_levelStarts[depth + 1]++;
+    }
+    for (uint32_t l = 0; l < levelCount; l++) {
+        m_levelStarts[l + 1] += m_levelStarts[l];
+    }
+
+    std::vector<uint32_t> slots(nodeCount);
+    std::vector<uint32_t> nextSlots(m_levelStarts.begin(), m_levelStarts.end() - 1);
+    for (NodeHandle handle = 0; handle < nodeCount; handle++) {
+        slots[handle] = nextSlots[m_depths[handle]]++;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // arrays moved to the new slots
+    for (auto& parent : m_parents)
+    {
+        if (parent != NO_PARENT) {
+            parent = slots[m_handles[parent]];
+        }
+    }
+
+    auto permute = [this, &slots](auto& _array)
+    {
+        std::remove_reference_t<decltype(_array)> sorted(_array.size());
+        for (uint32_t slot = 0; slot < _array.size(); slot++) {
+            sorted[slots[m_handles[slot]]] = _array[slot];
+        }
+        _array.swap(sorted);
+    };
+    permute(m_translations);
+    permute(m_rotations);
+    permute(m_scales);
+    permute(m_worldMatrices);
+    permute(m_parents);
+    permute(m_dirty);
+    permute(m_handles);
+    m_slots.swap(slots);
+
+    auto firstDirty = std::find(m_dirty.begin(), m_dirty.end(), 1);
+    m_firstDirtySlot = static_cast<uint32_t>(firstDirty - m_dirty.begin());
+    m_sorted = true;
+}
+
+
+/*
+ * Nodes of a level whose local transformation changed, or whose parent was updated
+ * (parents belong to the previous level, already updated)
+ */
+uint32_t SceneGraph::updateRange(uint32_t _begin, uint32_t _end)
+{
+    uint32_t updatedCount = 0;
+    for (uint32_t i = _begin; i < _end; i++)
+    {
+        uint32_t parent = m_parents[i];
+        bool parentUpdated = (parent != NO_PARENT) && m_dirty[parent];
+        if (!m_dirty[i] && !parentUpdated) {
+            continue;
+        }
+
+        glm::mat4 local = glm::mat4_cast(m_rotations[i]);
+        local[0] *= m_scales[i].x;
+        local[1] *= m_scales[i].y;
+        local[2] *= m_scales[i].z;
+        local[3] = glm::vec4(m_translations[i], 1.0f);
+
+        m_worldMatrices[i] = (parent == NO_PARENT) ? local : m_worldMatrices[parent] * local;
+        m_dirty[i] = 1;     // its children are updated too
+        updatedCount++;
+    }
+    return updatedCount;
+}
+
+
+/*
+ * Chunks of the current level, taken by the calling thread and the workers until none is left
+ */
+uint32_t SceneGraph::processChunks()
+{
+    uint32_t updatedCount = 0;
+    while (true)
+    {
+        uint32_t first = m_nextChunk.fetch_add(CHUNK_SIZE);
+        if (first >= m_levelEnd) {
+            return updatedCount;
+        }
+        updatedCount += updateRange(first, std::min(first + CHUNK_SIZE, m_levelEnd));
+    }
+}
+
+
+uint32_t SceneGraph::updateLevel(uint32_t _begin, uint32_t _end)
+{
+    if (m_workers.empty() || _end - _begin <= CHUNK_SIZE) {
+        return updateRange(_begin, _end);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_levelEnd = _end;
+        m_nextChunk = _begin;
+        m_updatedCount = 0;
+        m_activeWorkers = static_cast<uint32_t>(m_workers.size());
+        m_levelId++;
+    }
+    m_workCondition.notify_all();
+
+    uint32_t updatedCount = processChunks();
+
+    // the next level reads the world matrices written by the workers
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]() { return m_activeWorkers == 0; });
+    return updatedCount + m_updatedCount;
+}
+
+
+/*
+ * Worker thread: helps with each level given by update()
+ */
+void SceneGraph::work(uint64_t _levelId)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_workCondition.wait(lock, [this, _levelId]() { return m_stopping || m_levelId != _levelId; });
+        if (m_stopping) {
+            return;
+        }
+        _levelId = m_levelId;
+        lock.unlock();
+
+        m_updatedCount += processChunks();
+
+        lock.lock();
+        if (--m_activeWorkers == 0) {
+            m_doneCondition.notify_one();
+        }
+    }
+}
+
+
+/*
+ * Level by level, from the first dirty node: clean nodes are only tested
+ */
+uint32_t SceneGraph::update()
+{
+    if (!m_sorted) {
+        sortByDepth();
+    }
+    uint32_t nodeCount = getNodeCount();
+    if (m_firstDirtySlot >= nodeCount) {
+        return 0;
+    }
+
+    uint32_t updatedCount = 0;
+    uint32_t firstLevel = static_cast<uint32_t>(std::upper_bound(m_levelStarts.begin(), m_levelStarts.end(), m_firstDirtySlot) - m_levelStarts.begin()) - 1;
+    for (uint32_t l = firstLevel; l < getLevelCount(); l++) {
+        updatedCount += updateLevel(std::max(m_levelStarts[l], m_firstDirtySlot), m_levelStarts[l + 1]);
+    }
+
+    std::fill(m_dirty.begin() + m_firstDirtySlot, m_dirty.end(), 0);
+    m_firstDirtySlot = nodeCount;
+    return updatedCount;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*********************************************************************************************************************
+ *
+ * scenegraph.h
+ *
+ * Hierarchy of nodes with local transformations (translation, rotation, scale), stored as flat arrays
+ * (one per component) sorted by depth: the parent of a node always lies in an earlier level
+ * Setting a local transformation marks the node dirty; update() then recomputes the world matrices of the dirty
+ * nodes and their descendants only, level by level: the nodes of a level are independent, large levels are split
+ * in chunks processed by worker threads
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+
+#include "core/coreutils.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace VulkanDemo
+{
+
+
+class SceneGraph
+{
+
+public:
+
+    // stable identifier of a node (its position in the arrays changes when nodes are sorted by depth)
+    using NodeHandle = uint32_t;
+
+    static constexpr NodeHandle NO_PARENT = std::numeric_limits<uint32_t>::max();
+    // nb of nodes of a level processed by a thread at once (smaller levels are processed by the calling thread)
+    static constexpr uint32_t CHUNK_SIZE = 4096;
+
+    SceneGraph() = default;
+
+    // owns its worker threads, it cannot be duplicated
+    SceneGraph(SceneGraph const& _other) = delete;
+    SceneGraph& operator=(SceneGraph const& _other) = delete;
+
+    virtual ~SceneGraph() { stop(); };
+
+
+    uint32_t getNodeCount() const { return static_cast<uint32_t>(m_handles.size()); }
+    uint32_t getLevelCount() const { return m_levelStarts.empty() ? 0 : static_cast<uint32_t>(m_levelStarts.size()) - 1; }
+
+    // worker threads helping the calling thread in update()
+    void start(uint32_t _workerCount);
+    void stop();
+
+    void clear();
+    // the parent must have been added before its children
+    NodeHandle addNode(NodeHandle _parent, const glm::vec3& _translation = glm::vec3(0.0f),
+                       const glm::quat& _rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& _scale = glm::vec3(1.0f));
+
+    void setTranslation(NodeHandle _node, const glm::vec3& _translation);
+    void setRotation(NodeHandle _node, const glm::quat& _rotation);
+    void setScale(NodeHandle _node, const glm::vec3& _scale);
+    const glm::vec3& getTranslation(NodeHandle _node) const { return m_translations[m_slots[_node]]; }
+    const glm::quat& getRotation(NodeHandle _node) const { return m_rotations[m_slots[_node]]; }
+    const glm::vec3& getScale(NodeHandle _node) const { return m_scales[m_slots[_node]]; }
+
+    // up to date after update()
+    const glm::mat4& getWorldMatrix(NodeHandle _node) const { return m_worldMatrices[m_slots[_node]]; }
+
+    // recomputes the world matrices of the dirty nodes and their descendants (returns their nb)
+    uint32_t update();
+
+
+protected:
+
+    void sortByDepth();
+    void markDirty(uint32_t _slot);
+    uint32_t updateRange(uint32_t _begin, uint32_t _end);
+    uint32_t updateLevel(uint32_t _begin, uint32_t _end);
+    uint32_t processChunks();
+    void work(uint64_t _levelId);
+
+    // per node, in depth order (indexed by slot)
+    std::vector<glm::vec3> m_translations;
+    std::vector<glm::quat> m_rotations;
+    std::vector<glm::vec3> m_scales;
+    std::vector<glm::mat4> m_worldMatrices;
+    std::vector<uint32_t> m_parents;            // slot of the parent (NO_PARENT for the roots)
+    std::vector<uint8_t> m_dirty;               // local transformation changed, or world matrix recomputed by update()
+    std::vector<NodeHandle> m_handles;          // handle of the node
+
+    std::vector<uint32_t> m_slots;              // slot of each handle
+    std::vector<uint32_t> m_depths;             // depth of each handle
+    std::vector<uint32_t> m_levelStarts;        // first slot of each level (plus the nb of nodes)
+    bool m_sorted = true;                       // no node added since the last sort
+    uint32_t m_firstDirtySlot = 0;              // nodes before it are not dirty (node count: none is)
+
+    // shared with the worker threads: the level being updated
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_workCondition;    // a level is ready, or the workers stop
+    std::condition_variable m_doneCondition;    // all the workers are done with the level
+    uint64_t m_levelId = 0;                     // incremented for each level given to the workers
+    uint32_t m_levelEnd = 0;
+    std::atomic<uint32_t> m_nextChunk = 0;      // first slot of the next chunk to process
+    std::atomic<uint32_t> m_updatedCount = 0;
+    uint32_t m_activeWorkers = 0;               // nb of workers still processing the level
+    bool m_stopping = false;
+
+}; // class SceneGraph
+
+} // namespace VulkanDemo
+
+#endif // SCENEGRAPH_H
\ No newline at end of file
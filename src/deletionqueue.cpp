@@ -0,0 +1,110 @@
+/*********************************************************************************************************************
+ *
+ * deletionqueue.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include <iterator>
+
+#include "deletionqueue.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Allocates one queue per frame in flight
+ */
+void DeletionQueue::create(uint32_t _framesInFlight)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queues.resize(_framesInFlight);
+}
+
+
+/*
+ * Destroys the objects attached to the last submission of this frame (its timeline value is reached)
+ */
+void DeletionQueue::beginFrame(VkDevice _device, uint32_t _frameIndex)
+{
+    std::vector<Deleter> deleters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        deleters.swap(m_queues[_frameIndex]);
+    }
+
+    // oldest first
+    for (auto& deleter : deleters) {
+        deleter(_device);
+    }
+}
+
+
+/*
+ * Attaches the objects retired so far to the submission of this frame
+ */
+void DeletionQueue::endFrame(uint32_t _frameIndex)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& queue = m_queues[_frameIndex];
+    queue.insert(queue.end(), std::make_move_iterator(m_pending.begin()), std::make_move_iterator(m_pending.end()));
+    m_pending.clear();
+}
+
+
+/*
+ * Queues the destruction of objects that may still be used by frames in flight
+ */
+void DeletionQueue::retire(Deleter _deleter)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_queues.empty()) {
+        throw std::runtime_error("deletion queue used before creation!");
+    }
+    m_pending.push_back(std::move(_deleter));
+}
+
+
+/*
+ * Destroys all the retired objects (the device must be idle)
+ */
+void DeletionQueue::flush(VkDevice _device)
+{
+    std::vector<Deleter> deleters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& queue : m_queues) 
+        {
+            deleters.insert(deleters.end(), std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.end()));
+            queue.clear();
+        }
+        deleters.insert(deleters.end(), std::make_move_iterator(m_pending.begin()), std::make_move_iterator(m_pending.end()));
+        m_pending.clear();
+    }
+
+    for (auto& deleter : deleters) {
+        deleter(_device);
+    }
+}
+
+
+/*
+ * Nb of objects waiting for destruction
+ */
+size_t DeletionQueue::getPendingCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = m_pending.size();
+    for (auto const& queue : m_queues) {
+        count += queue.size();
+    }
+    return count;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
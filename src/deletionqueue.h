@@ -0,0 +1,67 @@
+/*********************************************************************************************************************
+ *
+ * deletionqueue.h
+ *
+ * Deferred destruction of Vulkan objects, with one queue per frame in flight
+ * Retired objects are attached to the next submission, and destroyed once its timeline value is reached:
+ * all the frames that may have used them were submitted before, so they are complete as well
+ * (objects can be replaced without vkDeviceWaitIdle)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+
+#include "utils.h"
+
+#include <mutex>
+
+namespace VulkanDemo
+{
+
+
+class DeletionQueue
+{
+
+public:
+
+    using Deleter = std::function<void(VkDevice)>;
+
+    DeletionQueue() = default;
+
+    // owns pending destructions, cannot be duplicated
+    DeletionQueue(DeletionQueue const& _other) = delete;
+    DeletionQueue& operator=(DeletionQueue const& _other) = delete;
+
+    virtual ~DeletionQueue() {};
+
+
+    size_t getPendingCount();
+
+    void create(uint32_t _framesInFlight);
+
+    // used in drawFrame(), once the timeline value of the frame is reached, and once the frame is submitted
+    void beginFrame(VkDevice _device, uint32_t _frameIndex);
+    void endFrame(uint32_t _frameIndex);
+
+    void retire(Deleter _deleter);
+
+    // used when the device is idle (e.g., before destroying it)
+    void flush(VkDevice _device);
+
+
+protected:
+
+    std::vector<Deleter> m_pending;                 // retired since the last submission
+    std::vector<std::vector<Deleter>> m_queues;     // one per frame in flight, waiting for its timeline value
+    std::mutex m_mutex;                             // objects may be retired by loading threads
+
+}; // class DeletionQueue
+
+} // namespace VulkanDemo
+
+#endif // DELETIONQUEUE_H
\ No newline at end of file
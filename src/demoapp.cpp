@@ -15,8 +15,12 @@
 #include <algorithm> // Necessary for std::clamp
 #include <chrono>
 #include <unordered_map>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
 
 #include "demoapp.h"
+#include "core/meshcodec.h"
 
 
 namespace VulkanDemo
@@ -70,27 +74,93 @@ void DemoApp::initVulkan()
     m_contextPtr->createSurface(m_window);
     pickPhysicalDevice();
     m_contextPtr->createLogicalDevice();
+    m_contextPtr->getDeletionQueue().create(m_framesInFlight);
+    m_contextPtr->getShaderCompiler().init(SHADER_DIR, SHADER_CACHE_DIR);
+    m_pipelineCache.start();
+    uint32_t coreCount = std::thread::hardware_concurrency();
+    m_sceneGraph.start((coreCount > 1) ? std::min(coreCount - 1, 3u) : 0);
+    if (m_useBindless && !m_contextPtr->getCapabilities().descriptorIndexing)
+    {
+        infoLog() << "descriptor indexing not supported, bindless textures disabled ";
+        m_useBindless = false;
+    }
+    if (m_useDynamicRendering && !m_contextPtr->getCapabilities().dynamicRendering)
+    {
+        infoLog() << "dynamic rendering not supported, using render passes ";
+        m_useDynamicRendering = false;
+    }
+    m_renderGraph.setDynamicRendering(m_useDynamicRendering);
     createSwapChain();
     createImageViews();
-    createRenderPass();
+    initUBO();
+    m_qualityController.init(m_msaaSamples, m_renderScaleSupported);
+    m_msaaSamples = m_qualityController.getLevel().samples;
+    m_renderScale = m_qualityController.getLevel().renderScale;
+    m_occlusionCuller.create(*m_contextPtr, MAX_OBJECTS, m_framesInFlight);
+    m_clusteredLights.create(*m_contextPtr, m_framesInFlight);
+    m_clusteredLights.generateLights(LIGHT_COUNTS[m_lightCountIndex], LIGHTS_EXTENT);
+    m_renderGraph.setTimer(&m_gpuTimer);
+    createRenderTargets();
     createDescriptorSetLayout();
+    if (m_useBindless) {
+        m_bindlessTextures.create(*m_contextPtr);
+    }
     createGraphicsPipeline(); 
     m_contextPtr->createCommandPool();
-    createColorResources();
-    createDepthResources();
-    createFramebuffers();
     m_textureImage.createTextureImage(*m_contextPtr);
     m_textureImage.createTextureImageView(*m_contextPtr);
     m_textureImage.createTextureSampler(*m_contextPtr);
-    m_mesh.loadModel();
-    m_mesh.createVertexBuffer(*m_contextPtr);
-    m_mesh.createIndexBuffer(*m_contextPtr);
+    if (m_useBindless) {
+        m_textureIndex = m_bindlessTextures.addTexture(*m_contextPtr, m_textureImage.getImageView(), m_textureImage.getSampler());
+    }
+    if (m_useVirtualTexture)
+    {
+        if (!std::filesystem::exists(VIRTUAL_TEXTURE_PATH)) {
+            TiledTextureFile::convert(TEXTURE_PATH, VIRTUAL_TEXTURE_PATH, 128, 1);
+        }
+        m_virtualTexture.create(*m_contextPtr, VIRTUAL_TEXTURE_PATH, m_framesInFlight);
+    }
+    m_geometryPool.create(*m_contextPtr, GEOMETRY_VERTEX_CAPACITY, GEOMETRY_INDEX_CAPACITY);
+    if (Model::isGltf(m_modelPath)) {
+        m_model.loadGltf(*m_contextPtr, m_geometryPool, m_useBindless ? &m_bindlessTextures : nullptr, m_modelPath);
+    }
+    else
+    {
+        // Wavefront files are encoded once into a compressed mesh, decoded straight into the staging memory
+        // (cached under the name of the model and a hash of its path: the models folder is not written)
+        uint64_t pathHash = FNV_OFFSET_BASIS;
+        hashBytes(pathHash, std::filesystem::absolute(m_modelPath).string());
+        std::ostringstream compressedName;
+        compressedName << MESH_CACHE_DIR << std::filesystem::path(m_modelPath).stem().string() << "."
+                       << std::hex << std::setw(16) << std::setfill('0') << pathHash << ".vmesh";
+        std::string compressedPath = compressedName.str();
+
+        // encoded again when the model is newer, or when the file is from another version of the format
+        if (!CompressedMeshFile::isCurrent(compressedPath)
+            || std::filesystem::last_write_time(compressedPath) < std::filesystem::last_write_time(m_modelPath))
+        {
+            std::filesystem::create_directories(MESH_CACHE_DIR);
+            Mesh source;
+            source.loadModel(m_modelPath);
+            source.saveCompressed(compressedPath);
+        }
+        Mesh mesh;
+        mesh.uploadCompressed(*m_contextPtr, m_geometryPool, compressedPath);
+        m_model.addMesh(mesh);
+    }
+    m_model.createPartsBuffer(*m_contextPtr);
+    m_meshBounds = m_model.getBounds();
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers();
     createSyncObjects();
+    m_gpuTimer.create(*m_contextPtr, m_framesInFlight);
+    m_latencyMeter.create(*m_contextPtr);
+    m_contextPtr->getShaderCompiler().startWatching();
 
+    infoLog() << "initVulkan(): shaders: " + std::to_string(m_contextPtr->getShaderCompiler().getCacheHits()) + " cached, "
+               + std::to_string(m_contextPtr->getShaderCompiler().getCacheMisses()) + " compiled ";
     infoLog() << "initVulkan(): OK ";
 }
 
@@ -103,14 +173,33 @@ void DemoApp::initUBO()
     m_trackball.init(m_swapChainExtent.width, m_swapChainExtent.height);
 
     // initial transformation to re-orient mesh
-    m_initModel = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f))
-                * glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    // build MVP matrices
-    m_ubo.model = m_initModel;
-    m_ubo.view = m_camera.getViewMatrix();
-    m_ubo.proj = m_camera.getProjectionMatrix();
-    m_ubo.proj[1][1] *= -1;
-    m_ubo.lightPos = glm::vec3(2.0f, 2.0f, 0.0f); // light source position in view space
+    m_defaultModel = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f))
+                   * glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    m_initModel = m_defaultModel;
+    // build view and projection matrices
+    m_frameUniforms.view = m_camera.getViewMatrix();
+    m_frameUniforms.proj = m_camera.getProjectionMatrix();
+    m_frameUniforms.proj[1][1] *= -1;
+    m_frameUniforms.lightPos = glm::vec3(2.0f, 2.0f, 0.0f); // light source position in view space
+}
+
+
+/*
+ * Adapts camera and trackball to a new window size, without losing the current view
+ */
+void DemoApp::resizeCamera()
+{
+    // the camera never moves, re-init only updates its aspect ratio
+    m_camera.init(0.01f, 8.0f, 45.0f, 1.0f, m_swapChainExtent.width, m_swapChainExtent.height, glm::vec3(0.0f, 2.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), 0); 
+
+    // the trackball restarts from the current orientation
+    m_initModel = m_trackball.getRotationMatrix() * m_initModel;
+    m_trackball.init(m_swapChainExtent.width, m_swapChainExtent.height);
+    m_trackball.reStart();
+
+    m_frameUniforms.view = m_camera.getViewMatrix();
+    m_frameUniforms.proj = m_camera.getProjectionMatrix();
+    m_frameUniforms.proj[1][1] *= -1;
 }
 
 
@@ -137,36 +226,51 @@ void DemoApp::mainLoop()
  */
 void DemoApp::cleanup()
 {
+    // no more shader reloads, nor pipeline builds
+    m_contextPtr->getShaderCompiler().stopWatching();
+    m_pipelineCache.wait();
+
+    // the device is idle, objects retired during the last frames can be destroyed
+    m_contextPtr->getDeletionQueue().flush(m_contextPtr->getDevice());
+
     cleanupSwapChain();
+    m_occlusionCuller.cleanup(*m_contextPtr);
+    m_clusteredLights.cleanup(*m_contextPtr);
 
     m_textureImage.cleanup(*m_contextPtr);
+    m_model.cleanup(*m_contextPtr);
+    if (m_useVirtualTexture) {
+        m_virtualTexture.cleanup(*m_contextPtr);
+    }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
-    {
-        vkDestroyBuffer(m_contextPtr->getDevice(), m_uniformBuffers[i], nullptr);
-        vkFreeMemory(m_contextPtr->getDevice(), m_uniformBuffersMemory[i], nullptr);
+    m_uniformRingBuffer.cleanup(*m_contextPtr);
+    m_gpuTimer.cleanup(*m_contextPtr);
+
+    if (m_useBindless) {
+        m_bindlessTextures.cleanup(*m_contextPtr);
     }
 
     vkDestroyDescriptorPool(m_contextPtr->getDevice(), m_descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(m_contextPtr->getDevice(), m_descriptorSetLayout, nullptr);
 
-    m_mesh.cleanup(*m_contextPtr);
+    m_geometryPool.cleanup(*m_contextPtr);
 
-    vkDestroyPipeline(m_contextPtr->getDevice(), m_graphicsPipeline, nullptr);
+    m_pipelineCache.cleanup(m_contextPtr->getDevice());
+    m_sceneGraph.stop();
     vkDestroyPipelineLayout(m_contextPtr->getDevice(), m_pipelineLayout, nullptr);
 
-    vkDestroyRenderPass(m_contextPtr->getDevice(), m_renderPass, nullptr);
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
+    for (size_t i = 0; i < m_framesInFlight; i++) 
     {
         vkDestroySemaphore(m_contextPtr->getDevice(), m_imageAvailableSemaphores[i], nullptr);
         vkDestroySemaphore(m_contextPtr->getDevice(), m_renderFinishedSemaphores[i], nullptr);
-        vkDestroyFence(m_contextPtr->getDevice(), m_inFlightFences[i], nullptr);
     }
+    m_contextPtr->getGraphicsTimeline().cleanup(m_contextPtr->getDevice());
 
     // Command buffers are automatically freed when their command pool is destroyed
     vkDestroyCommandPool(m_contextPtr->getDevice(), m_contextPtr->getCommandPool(), nullptr);
 
+    m_contextPtr->getSamplerCache().cleanup(m_contextPtr->getDevice());
+
     vkDestroyDevice(m_contextPtr->getDevice(), nullptr);
 
     if (enableValidationLayers) 
@@ -281,6 +385,25 @@ void DemoApp::pickPhysicalDevice()
         {
             m_contextPtr->setPhysicalDevice(device);
             m_msaaSamples = getMaxUsableSampleCount();
+
+            // virtual texture feedback is written by the fragment shader
+            VkPhysicalDeviceFeatures supportedFeatures;
+            vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+            if (m_useVirtualTexture && !supportedFeatures.fragmentStoresAndAtomics)
+            {
+                infoLog() << "fragmentStoresAndAtomics not supported, virtual texture disabled ";
+                m_useVirtualTexture = false;
+            }
+
+            // per-draw data must fit in push constants, otherwise fall back to object uniforms
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(device, &properties);
+            if (properties.limits.maxPushConstantsSize < sizeof(ObjectPushConstants))
+            {
+                infoLog() << "maxPushConstantsSize too small, push constants disabled ";
+                m_pushConstantsSupported = false;
+                m_usePushConstants = false;
+            }
             break; // early exit
         }
     }
@@ -317,15 +440,55 @@ VkPresentModeKHR DemoApp::chooseSwapPresentMode(const std::vector<VkPresentModeK
 {
     for (const auto& availablePresentMode : _availablePresentModes) 
     {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) 
+        if (availablePresentMode == m_presentMode) 
         {
+            infoLog() << "present mode: " + getPresentModeName(availablePresentMode);
             return availablePresentMode;
         }
     }
+    // FIFO is the only mode guaranteed to be available
+    infoLog() << getPresentModeName(m_presentMode) + " not supported, present mode: FIFO";
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 
+/*
+ * Selects the next present mode supported by the surface (the swap chain is recreated after the next present)
+ */
+void DemoApp::cyclePresentMode()
+{
+    const std::array<VkPresentModeKHR, 4> presentModes = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                                           VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+
+    std::vector<VkPresentModeKHR> available = querySwapChainSupport(m_contextPtr->getPhysicalDevice()).presentModes;
+
+    auto current = std::find(presentModes.begin(), presentModes.end(), m_presentMode);
+    size_t index = (current == presentModes.end()) ? 0 : static_cast<size_t>(current - presentModes.begin());
+    for (size_t i = 1; i <= presentModes.size(); i++)
+    {
+        VkPresentModeKHR candidate = presentModes[(index + i) % presentModes.size()];
+        if (std::find(available.begin(), available.end(), candidate) != available.end())
+        {
+            m_presentMode = candidate;
+            break;
+        }
+    }
+    m_presentModeChanged = true;
+}
+
+
+/*
+ * Sets the nb of frames recorded ahead of the GPU (more throughput, but more latency)
+ */
+void DemoApp::setFramesInFlight(uint32_t _framesInFlight)
+{
+    if (_framesInFlight < 1 || _framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        throw std::invalid_argument("frames in flight must be in [1, " + std::to_string(MAX_FRAMES_IN_FLIGHT) + "]!");
+    }
+    m_framesInFlight = _framesInFlight;
+}
+
+
 /*
  * Swap extent (resolution of images in swap chain)
  */
@@ -381,6 +544,16 @@ void DemoApp::createSwapChain()
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+    // when rendering at a lower resolution, the swap chain is the destination of the upscaling blit
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_contextPtr->getPhysicalDevice(), surfaceFormat.format, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    m_renderScaleSupported = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+                          && (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    if (m_renderScaleSupported) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+
     QueueFamilyIndices indices = findQueueFamilies(m_contextPtr->getPhysicalDevice(), m_contextPtr->getSurface());
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -402,7 +575,8 @@ void DemoApp::createSwapChain()
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // the previous swap chain (if any) is retired, its images already acquired can still be presented
+    createInfo.oldSwapchain = m_swapChain;
 
     if (vkCreateSwapchainKHR(m_contextPtr->getDevice(), &createInfo, nullptr, &m_swapChain) != VK_SUCCESS) 
     {
@@ -416,8 +590,6 @@ void DemoApp::createSwapChain()
     m_swapChainImageFormat = surfaceFormat.format;
     m_swapChainExtent = extent;
 
-    initUBO(); // re-init camera and trackball when resize occurs
-
     infoLog() << "createSwapChain(): OK ";
 }
 
@@ -464,106 +636,26 @@ void DemoApp::createImageViews()
 }
 
 
-/*
- * Creation of render pass 
- */
-void DemoApp::createRenderPass()
-{
-    // defines color attachment
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = m_swapChainImageFormat;
-    colorAttachment.samples = m_msaaSamples;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-    // subpass will reference color attachment
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // resolve attachment for multisampling
-    VkAttachmentDescription colorAttachmentResolve{};
-    colorAttachmentResolve.format = m_swapChainImageFormat;
-    colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    // subpass will reference resolve attachment
-    VkAttachmentReference colorAttachmentResolveRef{};
-    colorAttachmentResolveRef.attachment = 2;
-    colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // defines depth attachment
-    VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = findDepthFormat();
-    depthAttachment.samples = m_msaaSamples;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    // subpass will reference depth attachment
-    VkAttachmentReference depthAttachmentRef{};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    // defines a subpass
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    subpass.pResolveAttachments = &colorAttachmentResolveRef;
-
-    // Subpass dependencies
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-    // assemble info to build render pass
-    std::array<VkAttachmentDescription, 3> attachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-
-    if (vkCreateRenderPass(m_contextPtr->getDevice(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create render pass!");
-    }
-
-    infoLog() << "createRenderPass(): OK ";
-}
-
-
 /*
  * Bindings layouts
  */
 void DemoApp::createDescriptorSetLayout()
 {
-    // uniform buffer binding
+    // uniform buffer bindings (dynamic offsets in the ring buffer)
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
+    VkDescriptorSetLayoutBinding objectLayoutBinding{};
+    objectLayoutBinding.binding = OBJECT_UBO_BINDING;
+    objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    objectLayoutBinding.descriptorCount = 1;
+    objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    objectLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
     // sampler (i.e., texture) binding
     VkDescriptorSetLayoutBinding samplerLayoutBinding{};
     samplerLayoutBinding.binding = 1;
@@ -572,7 +664,14 @@ void DemoApp::createDescriptorSetLayout()
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+    std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding };
+    if (m_useVirtualTexture) {
+        VirtualTexture::addDescriptorSetLayoutBindings(bindings);
+    }
+    ClusteredLights::addDescriptorSetLayoutBindings(bindings);
+    GeometryPool::addDescriptorSetLayoutBindings(bindings);
+    Model::addDescriptorSetLayoutBindings(bindings);
+
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -585,15 +684,140 @@ void DemoApp::createDescriptorSetLayout()
 
 
 /*
- * Creation of graphics pipeline
+ * Creation of the layout of the graphics pipeline, and selection of the variants in use
  */
 void DemoApp::createGraphicsPipeline()
 {
-    auto vertShaderCode = GLtools::readFile("../src/shaders/vert.spv");
-    auto fragShaderCode = GLtools::readFile("../src/shaders/frag.spv");
+    // per-draw data (push constants fast path)
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ObjectPushConstants);
+
+    // pipeline layout
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    // set 0: uniforms and textures, set 1: bindless textures array
+    std::vector<VkDescriptorSetLayout> setLayouts = { m_descriptorSetLayout };
+    if (m_useBindless) {
+        setLayouts.push_back(m_bindlessTextures.getDescriptorSetLayout());
+    }
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = m_usePushConstants ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = m_usePushConstants ? &pushConstantRange : nullptr;
+
+    if (vkCreatePipelineLayout(m_contextPtr->getDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    selectPipelineVariants();
+
+    infoLog() << "createGraphicsPipeline(): OK ";
+}
+
+
+/*
+ * Picks the variants of the scene pipeline matching the current features and states
+ * Missing variants are built in the background, and replaced meanwhile by a ready variant with the same states
+ * (only the first variant of a sample count, or of a new layout, is built before drawing)
+ */
+void DemoApp::selectPipelineVariants()
+{
+    // the builds run on worker threads: they get a copy of the state they read
+    PipelineBuildState state;
+    state.layout = m_pipelineLayout;
+    state.usePushConstants = m_usePushConstants;
+    state.useVirtualTexture = m_useVirtualTexture;
+    state.useBindless = m_useBindless;
+    state.renderPass = m_renderPass;
+    if (m_renderGraph.isDynamicRendering())
+    {
+        state.renderPass = VK_NULL_HANDLE;
+        state.colorFormats = m_renderGraph.getColorFormats(m_scenePass);
+        state.depthFormat = m_renderGraph.getDepthFormat(m_scenePass);
+    }
+    auto create = [this, state](PipelineKey const& _key) { return createPipelineVariant(_key, state); };
+
+    PipelineKey key = m_shadingFeatures;
+    key.samples = m_msaaSamples;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // depth pre-pass, and shading with an EQUAL depth test: used once both states are built
+    // (the depth pre-pass has no fragment shader: a single variant per sample count)
+    if (m_useDepthPrepass)
+    {
+        PipelineKey depthKey{};
+        depthKey.vertexFormat = PipelineKey::VertexFormat::PositionOnly;
+        depthKey.samples = m_msaaSamples;
+        VkPipeline depthPrepassPipeline = m_pipelineCache.requestPipeline(depthKey, create);
+
+        key.depthEqual = VK_TRUE;
+        VkPipeline pipeline = m_pipelineCache.requestPipeline(key, create);
+        if (pipeline == VK_NULL_HANDLE) {
+            pipeline = m_pipelineCache.findCompatible(key);
+        }
+
+        if (depthPrepassPipeline != VK_NULL_HANDLE && pipeline != VK_NULL_HANDLE)
+        {
+            m_depthPrepassPipeline = depthPrepassPipeline;
+            m_graphicsPipeline = pipeline;
+            return;
+        }
+        key.depthEqual = VK_FALSE;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // shading without pre-pass
+    m_depthPrepassPipeline = VK_NULL_HANDLE;
+    m_graphicsPipeline = m_pipelineCache.requestPipeline(key, create);
+    if (m_graphicsPipeline == VK_NULL_HANDLE) {
+        m_graphicsPipeline = m_pipelineCache.findCompatible(key);
+    }
+    if (m_graphicsPipeline == VK_NULL_HANDLE) {
+        m_graphicsPipeline = m_pipelineCache.getPipeline(key, create);
+    }
+}
+
+
+/*
+ * Creation of a variant of the graphics pipeline (called from the worker threads of m_pipelineCache)
+ */
+VkPipeline DemoApp::createPipelineVariant(PipelineKey const& _key, PipelineBuildState const& _state)
+{
+    // depth pre-pass: only a vertex shader reading positions, and no color writes
+    bool depthOnly = (_key.vertexFormat == PipelineKey::VertexFormat::PositionOnly);
+
+    ShaderCompiler& shaderCompiler = m_contextPtr->getShaderCompiler();
+    std::vector<std::string> vertDefines;
+    if (_state.usePushConstants) {
+        vertDefines.push_back("USE_PUSH_CONSTANTS");
+    }
+
+    // both shaders are loaded before creating a module (a failed load throws)
+    auto vertShaderCode = depthOnly ? shaderCompiler.load("vert_shader_depth.vert", vertDefines, _state.usePushConstants ? "vert_depth_pc.spv" : "vert_depth.spv")
+                        : shaderCompiler.load("vert_shader.vert", vertDefines, _state.usePushConstants ? "vert_pc.spv" : "vert.spv");
+    std::vector<char> fragShaderCode;
+    if (!depthOnly)
+    {
+        fragShaderCode = _state.useVirtualTexture ? shaderCompiler.load("frag_shader_vt.frag", {}, "frag_vt.spv")
+                       : _state.useBindless ? shaderCompiler.load("frag_shader_bindless.frag", {}, "frag_bindless.spv")
+                       : shaderCompiler.load("frag_shader.frag", {}, "frag.spv");
+    }
 
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    if (!depthOnly) {
+        fragShaderModule = createShaderModule(fragShaderCode);
+    }
+
+    // features of the variant (the key holds the values of the constants)
+    auto specializationEntries = PipelineKey::getSpecializationMapEntries();
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(PipelineKey);
+    specializationInfo.pData = &_key;
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -606,18 +830,15 @@ void DemoApp::createGraphicsPipeline()
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-    // describes the format of the vertex data that will be passed to the vertex shader
+    // no vertex input: the vertex shaders fetch the vertices from the geometry pool (vertex pulling)
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    vertexInputInfo.vertexBindingDescriptionCount = 0;
+    vertexInputInfo.vertexAttributeDescriptionCount = 0;
 
 
     // Describes what kind of geometry will be drawn from the vertices and if primitive restart should be enabled.
@@ -667,7 +888,7 @@ void DemoApp::createGraphicsPipeline()
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE; // use VK_TRUE to enable sample shading in the pipeline
-    multisampling.rasterizationSamples = m_msaaSamples;
+    multisampling.rasterizationSamples = _key.samples;
     multisampling.minSampleShading = 1.0f; // use .2f as min fraction for sample shading, closer to one is smoother
     multisampling.pSampleMask = nullptr; // Optional
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
@@ -720,23 +941,10 @@ void DemoApp::createGraphicsPipeline()
     dynamicState.pDynamicStates = dynamicStates.data();
 
 
-    // pipeline layout
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    if (vkCreatePipelineLayout(m_contextPtr->getDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
-
-
     // Assemble info for creation of graphics pipeline
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = depthOnly ? 1 : 2;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
@@ -746,23 +954,54 @@ void DemoApp::createGraphicsPipeline()
     pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
-    pipelineInfo.layout = m_pipelineLayout; // references the structures describing the fixed-function stage
-    pipelineInfo.renderPass = m_renderPass;
+    pipelineInfo.layout = _state.layout; // references the structures describing the fixed-function stage
+    pipelineInfo.renderPass = _state.renderPass;
     pipelineInfo.subpass = 0;
+
+    // with dynamic rendering, only the attachment formats are needed (no render pass)
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    if (_state.renderPass == VK_NULL_HANDLE)
+    {
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(_state.colorFormats.size());
+        renderingInfo.pColorAttachmentFormats = _state.colorFormats.data();
+        renderingInfo.depthAttachmentFormat = _state.depthFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    }
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 
-    // Finally creates the pipeline
-    if (vkCreateGraphicsPipelines(m_contextPtr->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    // after a depth pre-pass, the depth buffer already holds the closest surfaces
+    if (_key.depthEqual)
+    {
+        depthStencil.depthWriteEnable = VK_FALSE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
     }
-    
+    if (depthOnly)
+    {
+        colorBlendAttachment.blendEnable = VK_FALSE;
+        colorBlendAttachment.colorWriteMask = 0;
+    }
+
+    // Finally creates the pipeline (the modules are destroyed first: a failed build must not leak them)
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(m_contextPtr->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
 
-    vkDestroyShaderModule(m_contextPtr->getDevice(), fragShaderModule, nullptr);
+    if (fragShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(m_contextPtr->getDevice(), fragShaderModule, nullptr);
+    }
     vkDestroyShaderModule(m_contextPtr->getDevice(), vertShaderModule, nullptr);
-    
 
-    infoLog() << "createGraphicsPipeline(): OK ";
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    static const char* LIGHTING_NAMES[PipelineKey::LIGHTING_MODEL_COUNT] = { "unlit", "diffuse", "normals" };
+    infoLog() << "createPipelineVariant(): " + (depthOnly ? std::string("depth only")
+                                               : std::string(_key.textured ? "textured, " : "untextured, ") + LIGHTING_NAMES[_key.lightingModel])
+               + ", " + std::to_string(_key.samples) + " samples" + (_key.depthEqual ? ", depth equal " : " ");
+
+    return pipeline;
 }
 
 
@@ -786,59 +1025,6 @@ VkShaderModule DemoApp::createShaderModule(const std::vector<char>& _code)
 }
 
 
-/*
- * Creation of framebuffers
- */
-void DemoApp::createFramebuffers()
-{
-    m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
-
-    // iterate through the image views and create a framebuffer for each of them
-    for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
-    {
-          std::array<VkImageView, 3> attachments = { m_colorImage.getImageView(),
-                                                     m_depthImage.getImageView(),
-                                                     m_swapChainImageViews[i] };
-
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = m_renderPass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = m_swapChainExtent.width;
-        framebufferInfo.height = m_swapChainExtent.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(m_contextPtr->getDevice(), &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
-        }
-    }
-
-    infoLog() << "createFramebuffers(): OK ";
-}
-
-
-/*
- * Setup depth-buffer
- */
-void DemoApp::createDepthResources()
-{
-    VkFormat depthFormat = findDepthFormat();
-
-    m_depthImage.createImage(*m_contextPtr,
-                             m_swapChainExtent.width, m_swapChainExtent.height, m_msaaSamples,
-                             depthFormat,
-                             VK_IMAGE_TILING_OPTIMAL,
-                             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    m_depthImage.createImageView(*m_contextPtr, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-
-    m_depthImage.transitionImageLayout(*m_contextPtr, depthFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-}
-
-
 /*
  * Sorts a given list of candidate formats from most desirable to least desirable, 
  * and checks which is the first one that is supported
@@ -876,41 +1062,131 @@ VkFormat DemoApp::findDepthFormat()
 
 
 /*
- * Creates a multisampled color buffer
+ * Declares the passes of the frame and their images, then compiles the render graph
+ * (render passes, framebuffers, barriers and render targets, at the current sample count and render scale)
+ */
+void DemoApp::createRenderTargets()
+{
+    m_renderExtent.width = std::max(1u, static_cast<uint32_t>(m_renderScale * m_swapChainExtent.width));
+    m_renderExtent.height = std::max(1u, static_cast<uint32_t>(m_renderScale * m_swapChainExtent.height));
+
+    bool multisampled = (m_msaaSamples != VK_SAMPLE_COUNT_1_BIT);
+
+    // 1. -----------------------------------------------------------------------------------------
+    // images: swap chain (imported), then the ones owned by the graph
+    RenderGraph::ImageDesc swapChainDesc{};
+    swapChainDesc.format = m_swapChainImageFormat;
+    swapChainDesc.extent = m_swapChainExtent;
+    swapChainDesc.clearValue.color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+    m_swapChainResource = m_renderGraph.importImages("swap chain", swapChainDesc, m_swapChainImages, m_swapChainImageViews, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    // final image of the scene: swap chain image, or image at render scale upscaled to the swap chain
+    m_sceneResource = m_swapChainResource;
+    if (isRenderingOffscreen())
+    {
+        RenderGraph::ImageDesc sceneDesc = swapChainDesc;
+        sceneDesc.extent = m_renderExtent;
+        m_sceneResource = m_renderGraph.createImage("scene", sceneDesc);
+    }
+
+    // without MSAA, the color attachment is directly the final image (no resolve)
+    RenderGraph::ResourceHandle colorResource = m_sceneResource;
+    if (multisampled)
+    {
+        RenderGraph::ImageDesc colorDesc = swapChainDesc;
+        colorDesc.extent = m_renderExtent;
+        colorDesc.samples = m_msaaSamples;
+        colorResource = m_renderGraph.createImage("color", colorDesc);
+    }
+
+    RenderGraph::ImageDesc depthDesc{};
+    depthDesc.format = findDepthFormat();
+    depthDesc.extent = m_renderExtent;
+    depthDesc.samples = m_msaaSamples;
+    depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depthDesc.clearValue.depthStencil = { 1.0f, 0 };
+    RenderGraph::ResourceHandle depthResource = m_renderGraph.createImage("depth", depthDesc);
+
+    // 2. -----------------------------------------------------------------------------------------
+    // passes
+    std::vector<RenderGraph::ResourceHandle> resolves;
+    if (multisampled) {
+        resolves.push_back(m_sceneResource);
+    }
+
+    // lights of each cluster, read by the fragment shaders of the scene passes
+    m_renderGraph.addComputePass("light clustering", {},
+                                 [this](VkCommandBuffer _commandBuffer, uint32_t _imageIndex) { m_clusteredLights.recordClustering(_commandBuffer, m_currentFrame); });
+
+    if (m_useOcclusionCulling)
+    {
+        // objects visible in the previous frame, depth pyramid and culling, then objects that became visible
+        // (only the late pass resolves: both render passes stay compatible with the same pipeline)
+        m_scenePass = m_renderGraph.addGraphicsPass("scene (early)", { colorResource }, depthResource, {},
+                                                    [this](VkCommandBuffer _commandBuffer, uint32_t _imageIndex) { recordScene(_commandBuffer, OcclusionCuller::EARLY_PHASE); });
+        m_renderGraph.addComputePass("occlusion culling", { depthResource },
+                                     [this](VkCommandBuffer _commandBuffer, uint32_t _imageIndex) { recordOcclusionCulling(_commandBuffer); });
+        m_renderGraph.addGraphicsPass("scene (late)", { colorResource }, depthResource, resolves,
+                                      [this](VkCommandBuffer _commandBuffer, uint32_t _imageIndex) { recordScene(_commandBuffer, OcclusionCuller::LATE_PHASE); });
+    }
+    else
+    {
+        m_scenePass = m_renderGraph.addGraphicsPass("scene", { colorResource }, depthResource, resolves,
+                                                    [this](VkCommandBuffer _commandBuffer, uint32_t _imageIndex) { recordScene(_commandBuffer, OcclusionCuller::NO_CULLING); });
+    }
+
+    if (isRenderingOffscreen())
+    {
+        m_renderGraph.addTransferPass("upscale", { m_sceneResource }, { m_swapChainResource },
+                                      [this](VkCommandBuffer _commandBuffer, uint32_t _imageIndex) { recordUpscale(_commandBuffer, _imageIndex); });
+    }
+
+    // 3. -----------------------------------------------------------------------------------------
+    m_renderGraph.compile(*m_contextPtr);
+    m_renderPass = m_renderGraph.getRenderPass(m_scenePass);
+
+    if (m_useOcclusionCulling) {
+        m_occlusionCuller.createPyramid(*m_contextPtr, m_renderGraph.getImageView(depthResource, 0), m_renderExtent, m_msaaSamples);
+    }
+}
+
+
+/*
+ * Destruction of all the render targets
  */
-void DemoApp::createColorResources()
+void DemoApp::cleanupRenderTargets()
 {
-    VkFormat colorFormat = m_swapChainImageFormat;
+    m_renderGraph.cleanup(*m_contextPtr);
+    m_occlusionCuller.cleanupPyramid(*m_contextPtr);
+    m_renderPass = VK_NULL_HANDLE;
+}
+
 
-    m_colorImage.createImage(*m_contextPtr,
-                             m_swapChainExtent.width, m_swapChainExtent.height, m_msaaSamples,
-                             colorFormat,
-                             VK_IMAGE_TILING_OPTIMAL,
-                             VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+/*
+ * Hands all the render targets over to the deletion queue
+ */
+void DemoApp::retireRenderTargets()
+{
+    // variants built in the background use the render pass
+    m_pipelineCache.wait();
 
-    m_colorImage.createImageView(*m_contextPtr, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_renderGraph.retire(*m_contextPtr);
+    m_occlusionCuller.retirePyramid(*m_contextPtr);
+    m_renderPass = VK_NULL_HANDLE;
 }
 
 
 /*
  * Creation of Uniforms buffer
+ * (a single ring buffer, with room for the frame uniforms and MAX_OBJECTS object uniforms per frame in flight)
  */
 void DemoApp::createUniformBuffers() 
 {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+    VkDeviceSize alignment = UniformRingBuffer::queryAlignment(*m_contextPtr);
+    VkDeviceSize frameCapacity = UniformRingBuffer::alignSize(sizeof(FrameUniforms), alignment)
+                               + MAX_OBJECTS * UniformRingBuffer::alignSize(sizeof(ObjectUniforms), alignment);
 
-    m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    m_uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    m_uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
-    {
-        createBuffer(m_contextPtr->getPhysicalDevice(), m_contextPtr->getDevice(), bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-
-        vkMapMemory(m_contextPtr->getDevice(), m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i]);
-    }
+    m_uniformRingBuffer.create(*m_contextPtr, frameCapacity, m_framesInFlight);
 }
 
 
@@ -919,18 +1195,24 @@ void DemoApp::createUniformBuffers()
  */
 void DemoApp::createDescriptorPool() 
 {
-    // Two descriptors: uniforms and sampler
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    // Three descriptors: frame and object uniforms, and sampler
+    std::vector<VkDescriptorPoolSize> poolSizes(2);
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(2 * m_framesInFlight);
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(m_framesInFlight);
+    if (m_useVirtualTexture) {
+        VirtualTexture::addDescriptorPoolSizes(poolSizes, m_framesInFlight);
+    }
+    ClusteredLights::addDescriptorPoolSizes(poolSizes, m_framesInFlight);
+    GeometryPool::addDescriptorPoolSizes(poolSizes, m_framesInFlight);
+    Model::addDescriptorPoolSizes(poolSizes, m_framesInFlight);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolInfo.maxSets = static_cast<uint32_t>(m_framesInFlight);
 
     if (vkCreateDescriptorPool(m_contextPtr->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
@@ -943,37 +1225,43 @@ void DemoApp::createDescriptorPool()
  */
 void DemoApp::createDescriptorSets()
 {
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(m_framesInFlight, m_descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(m_framesInFlight);
     allocInfo.pSetLayouts = layouts.data();
 
-    m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    m_descriptorSets.resize(m_framesInFlight);
     if (vkAllocateDescriptorSets(m_contextPtr->getDevice(), &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
+    for (size_t i = 0; i < m_framesInFlight; i++) 
     {
+        // the actual offsets in the ring buffer are given when binding the descriptor set
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_uniformBuffers[i];
+        bufferInfo.buffer = m_uniformRingBuffer.getBuffer();
         bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
+        bufferInfo.range = sizeof(FrameUniforms);
+
+        VkDescriptorBufferInfo objectBufferInfo{};
+        objectBufferInfo.buffer = m_uniformRingBuffer.getBuffer();
+        objectBufferInfo.offset = 0;
+        objectBufferInfo.range = sizeof(ObjectUniforms);
 
         VkDescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         imageInfo.imageView = m_textureImage.getImageView();
         imageInfo.sampler = m_textureImage.getSampler();
 
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        std::vector<VkWriteDescriptorSet> descriptorWrites(3);
 
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[0].dstSet = m_descriptorSets[i];
         descriptorWrites[0].dstBinding = 0;
         descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         descriptorWrites[0].descriptorCount = 1;
         descriptorWrites[0].pBufferInfo = &bufferInfo;
 
@@ -986,6 +1274,21 @@ void DemoApp::createDescriptorSets()
         descriptorWrites[1].pImageInfo = &imageInfo;
         //descriptorWrites[1].pTexelBufferView = nullptr; // Optional
 
+        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[2].dstSet = m_descriptorSets[i];
+        descriptorWrites[2].dstBinding = OBJECT_UBO_BINDING;
+        descriptorWrites[2].dstArrayElement = 0;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[2].descriptorCount = 1;
+        descriptorWrites[2].pBufferInfo = &objectBufferInfo;
+
+        if (m_useVirtualTexture) {
+            m_virtualTexture.addDescriptorWrites(m_descriptorSets[i], static_cast<uint32_t>(i), descriptorWrites);
+        }
+        m_clusteredLights.addDescriptorWrites(m_descriptorSets[i], static_cast<uint32_t>(i), descriptorWrites);
+        m_geometryPool.addDescriptorWrites(m_descriptorSets[i], descriptorWrites);
+        m_model.addDescriptorWrites(m_descriptorSets[i], descriptorWrites);
+
         vkUpdateDescriptorSets(m_contextPtr->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 }
@@ -996,7 +1299,7 @@ void DemoApp::createDescriptorSets()
  */
 void DemoApp::createCommandBuffers()
 {
-    m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_commandBuffers.resize(m_framesInFlight);
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1027,90 +1330,168 @@ void DemoApp::recordCommandBuffer(VkCommandBuffer _commandBuffer, uint32_t _imag
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    m_gpuTimer.recordBegin(_commandBuffer, m_currentFrame);
+
+    // Streamed tiles must be uploaded outside of the render pass
+    if (m_useVirtualTexture) {
+        m_virtualTexture.recordUploads(_commandBuffer, m_currentFrame);
+    }
+
+    // draw commands of the early scene pass, from the visibility of the previous frame
+    if (m_useOcclusionCulling) {
+        m_occlusionCuller.recordEarlyCommands(_commandBuffer, m_currentFrame, m_objectGridSize * m_objectGridSize, m_model.getParts()[0].range);
+    }
 
-    // Prepares render pass
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_swapChainFramebuffers[_imageIndex];
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = m_swapChainExtent;
+    // render passes, upscaling blit and the barriers between them
+    m_renderGraph.execute(_commandBuffer, _imageIndex);
 
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-    clearValues[1].depthStencil = { 1.0f, 0 };
+    if (m_useVirtualTexture) {
+        m_virtualTexture.recordFeedbackBarrier(_commandBuffer, m_currentFrame);
+    }
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+    m_gpuTimer.recordEnd(_commandBuffer, m_currentFrame);
 
-    // Begins render pass
-    vkCmdBeginRenderPass(_commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (vkEndCommandBuffer(_commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
 
-    {
-        // Basic drawing commands
-        vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
 
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(m_swapChainExtent.width);
-        viewport.height = static_cast<float>(m_swapChainExtent.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(_commandBuffer, 0, 1, &viewport);
+/*
+ * Records the draw commands of the scene (inside the scene pass of the render graph)
+ * With occlusion culling, only the objects drawn in _cullingPhase
+ */
+void DemoApp::recordScene(VkCommandBuffer _commandBuffer, uint32_t _cullingPhase)
+{
+    // Basic drawing commands
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(m_renderExtent.width);
+    viewport.height = static_cast<float>(m_renderExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(_commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = m_renderExtent;
+    vkCmdSetScissor(_commandBuffer, 0, 1, &scissor);
+
+
+    // Bind index buffer of the geometry pool (shared by all meshes, and both passes)
+    m_geometryPool.bind(_commandBuffer);
+
+    // Bind the textures array once for all draws (set 1 only depends on the material index)
+    if (m_useBindless)
+    {
+        VkDescriptorSet bindlessSet = m_bindlessTextures.getDescriptorSet();
+        vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, BindlessTextures::DESCRIPTOR_SET, 1, &bindlessSet, 0, nullptr);
+    }
 
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = m_swapChainExtent;
-        vkCmdSetScissor(_commandBuffer, 0, 1, &scissor);
+    // 1. -----------------------------------------------------------------------------------------
+    // depth pre-pass: fills the depth buffer with the closest surfaces, reading positions only
+    // (once its pipelines are built)
+    if (m_depthPrepassPipeline != VK_NULL_HANDLE)
+    {
+        vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPrepassPipeline);
+        recordDraws(_commandBuffer, _cullingPhase);
+    }
 
+    // 2. -----------------------------------------------------------------------------------------
+    // shading (with the pre-pass, only the fragments passing the EQUAL depth test are shaded)
+    vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+    recordDraws(_commandBuffer, _cullingPhase);
+}
 
-        // Bind vertex buffer
-        VkBuffer vertexBuffers[] = { m_mesh.getVertexBuffer() };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(_commandBuffer, 0, 1, vertexBuffers, offsets);
 
-        // Bind index buffer
-        vkCmdBindIndexBuffer(_commandBuffer, m_mesh.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32 /*VK_INDEX_TYPE_UINT16*/);
+/*
+ * Issues one draw per part of each object, with its per-draw data (push constants or object uniforms offset)
+ * With occlusion culling (single part models), each draw reads its instance count (0 if culled) from the command
+ * written by the GPU
+ */
+void DemoApp::recordDraws(VkCommandBuffer _commandBuffer, uint32_t _cullingPhase)
+{
+    const std::vector<Model::Part>& parts = m_model.getParts();
+    auto drawObject = [this, _commandBuffer, _cullingPhase, &parts](uint32_t _objectIndex)
+    {
+        if (_cullingPhase == OcclusionCuller::NO_CULLING)
+        {
+            // Issue draw commands ! (the range of each part in the geometry pool, its index as first instance
+            // selects its transformation and material in the vertex shader)
+            for (uint32_t p = 0; p < static_cast<uint32_t>(parts.size()); p++)
+            {
+                const GeometryPool::MeshRange& range = parts[p].range;
+                vkCmdDrawIndexed(_commandBuffer, range.indexCount, 1, range.firstIndex, range.vertexOffset, p);
+            }
+        }
+        else
+        {
+            vkCmdDrawIndexedIndirect(_commandBuffer, m_occlusionCuller.getCommandBuffer(), m_occlusionCuller.getCommandOffset(_cullingPhase, _objectIndex),
+                                     1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    };
 
-        // Bind descriptors (i.e., uniforms)
-        vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[m_currentFrame], 0, nullptr);
+    if (m_usePushConstants)
+    {
+        // Bind descriptors (i.e., uniforms) once, the object uniforms are not read by the shader
+        std::array<uint32_t, 2> dynamicOffsets = { m_frameUniformsOffset, 0 };
+        vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[m_currentFrame],
+                                static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
 
-        // Issue draw command !
-        //vkCmdDraw(_commandBuffer, static_cast<uint32_t>(m_vertices.size()), 1, 0, 0); // unindexed vertex buffer version
-        vkCmdDrawIndexed(_commandBuffer, static_cast<uint32_t>(m_mesh.getIndices().size() ), 1, 0, 0, 0); // indexed vertex buffer version
+        for (uint32_t i : m_drawnObjects)
+        {
+            // per-draw data is recorded directly in the command buffer
+            vkCmdPushConstants(_commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ObjectPushConstants), &m_objectPushConstants[i]);
 
+            drawObject(i);
+        }
     }
+    else
+    {
+        for (uint32_t i : m_drawnObjects)
+        {
+            // Bind descriptors (i.e., uniforms), only the dynamic offsets change between objects
+            // (in binding order: frame uniforms, then object uniforms)
+            std::array<uint32_t, 2> dynamicOffsets = { m_frameUniformsOffset, m_objectUniformsOffsets[i] };
+            vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[m_currentFrame],
+                                    static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
 
-    // Ends render pass
-    vkCmdEndRenderPass(_commandBuffer);
-    if (vkEndCommandBuffer(_commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to record command buffer!");
+            drawObject(i);
+        }
     }
 }
 
 
 /*
- * Creation of semaphores and fences
+ * Builds the depth pyramid from the early scene pass, and tests all the objects against it
+ * (inside the compute pass of the render graph, the depth attachment is in read-only layout)
+ */
+void DemoApp::recordOcclusionCulling(VkCommandBuffer _commandBuffer)
+{
+    m_occlusionCuller.recordPyramid(_commandBuffer);
+    m_occlusionCuller.recordCulling(_commandBuffer, m_currentFrame, m_frameUniforms.proj * m_frameUniforms.view,
+                                    m_objectGridSize * m_objectGridSize, m_model.getParts()[0].range);
+}
+
+
+/*
+ * Creation of the semaphores of the swap chain (the frames in flight are tracked by the graphics timeline)
  */
 void DemoApp::createSyncObjects()
 {
-    m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    m_imageAvailableSemaphores.resize(m_framesInFlight);
+    m_renderFinishedSemaphores.resize(m_framesInFlight);
+    // value 0 is reached at creation: no wait for the first frames
+    m_frameTimelineValues.assign(m_framesInFlight, 0);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < m_framesInFlight; i++)
     {
         if (vkCreateSemaphore(m_contextPtr->getDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(m_contextPtr->getDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(m_contextPtr->getDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
+            vkCreateSemaphore(m_contextPtr->getDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create semaphores!");
         }
@@ -1126,7 +1507,101 @@ void DemoApp::createSyncObjects()
 void DemoApp::drawFrame()
 {
 
-    vkWaitForFences(m_contextPtr->getDevice(), 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    // shaders edited on disk (already compiled by the watching thread): only the pipelines using them are created again
+    for (const auto& source : m_contextPtr->getShaderCompiler().takeReloaded())
+    {
+        infoLog() << "shader reloaded: " + source;
+        if (source == "cluster_lights.comp") {
+            m_clusteredLights.reloadPipeline(*m_contextPtr);
+        }
+        else if (source == "hiz_reduce.comp" || source == "cull.comp") {
+            m_occlusionCuller.reloadPipelines(*m_contextPtr);
+        }
+        else {
+            m_pipelineOutdated = true;
+        }
+    }
+
+    // switching between push constants and object uniforms requires a new layout, and new pipelines
+    if (m_pipelineOutdated)
+    {
+        m_pipelineOutdated = false;
+        m_pipelineVariantOutdated = false;
+        recreateGraphicsPipeline();
+    }
+
+    // variants built in the background since the last frame replace their fallbacks
+    if (m_pipelineCache.collectBuilt()) {
+        selectPipelineVariants();
+    }
+
+    // shading features and depth pre-pass only select other variants (built once, then taken from the cache)
+    if (m_pipelineVariantOutdated)
+    {
+        m_pipelineVariantOutdated = false;
+        selectPipelineVariants();
+
+        m_gpuTimeAccum = 0.0;
+        m_gpuTimeFrames = 0;
+    }
+
+    // switching occlusion culling changes the passes of the frame (the pipeline is kept)
+    if (m_renderTargetsOutdated)
+    {
+        m_renderTargetsOutdated = false;
+        retireRenderTargets();
+        createRenderTargets();
+        m_occlusionCuller.invalidate();
+        m_cullingStatsAccum = OcclusionCuller::Stats{};
+        m_cullingStatsFrames = 0;
+
+        // pass indices changed
+        m_gpuTimer.invalidate();
+        m_passTimeAccum.fill(0.0);
+        m_passTimeFrames.fill(0);
+    }
+
+    // waits for the last submission of this frame slot only (later frames and uploads may still run)
+    m_contextPtr->getGraphicsTimeline().wait(m_contextPtr->getDevice(), m_frameTimelineValues[m_currentFrame]);
+
+    // objects retired before the last submission of this frame are no longer in use
+    m_contextPtr->getDeletionQueue().beginFrame(m_contextPtr->getDevice(), m_currentFrame);
+
+    // budgets and usage of the heaps, memory is freed before the budget is exceeded
+    m_contextPtr->getMemoryBudget().update();
+    applyResidencyPolicy();
+
+    // GPU time of the last submission of this frame slot drives the quality level
+    double gpuFrameTime = 0.0;
+    if (m_gpuTimer.getFrameTime(*m_contextPtr, m_currentFrame, gpuFrameTime))
+    {
+        m_gpuTimeAccum += gpuFrameTime;
+        m_gpuTimeFrames++;
+        if (m_qualityController.update(gpuFrameTime)) {
+            applyQualityLevel();
+        }
+    }
+
+    // objects drawn and culled by the last submission of this frame slot
+    OcclusionCuller::Stats cullingStats;
+    if (m_occlusionCuller.getStats(m_currentFrame, cullingStats))
+    {
+        m_cullingStatsAccum.drawnEarly += cullingStats.drawnEarly;
+        m_cullingStatsAccum.drawnLate += cullingStats.drawnLate;
+        m_cullingStatsAccum.culled += cullingStats.culled;
+        m_cullingStatsFrames++;
+    }
+
+    // GPU time of each pass of the last submission of this frame slot
+    for (uint32_t p = 0; p < std::min(m_renderGraph.getPassCount(), GpuTimer::MAX_PASSES); p++)
+    {
+        double passTime = 0.0;
+        if (m_gpuTimer.getPassTime(*m_contextPtr, m_currentFrame, p, passTime))
+        {
+            m_passTimeAccum[p] += passTime;
+            m_passTimeFrames[p]++;
+        }
+    }
 
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(m_contextPtr->getDevice(), m_swapChain, UINT64_MAX, 
@@ -1143,33 +1618,100 @@ void DemoApp::drawFrame()
 
     updateUniformBuffer(m_currentFrame);
 
-    // Only reset the fence if we are submitting work
-    vkResetFences(m_contextPtr->getDevice(), 1, &m_inFlightFences[m_currentFrame]);
+    // the timeline wait guarantees the feedback of this frame slot is complete
+    if (m_useVirtualTexture) {
+        m_virtualTexture.update(m_currentFrame);
+    }
 
     vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
+
+    auto recordStart = std::chrono::high_resolution_clock::now();
     recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex);
+    auto recordEnd = std::chrono::high_resolution_clock::now();
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    // compares the cost of both per-draw data paths at high draw counts (CPU),
+    // and the shading cost with and without depth pre-pass when objects overlap (GPU)
+    m_recordTimeAccum += std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+    if (++m_recordTimeFrames == STATS_FRAMES)
+    {
+        std::string gpuTime = (m_gpuTimeFrames > 0) ? std::to_string(m_gpuTimeAccum / m_gpuTimeFrames) + " ms GPU" : "no GPU time";
+        std::string culling;
+        if (m_cullingStatsFrames > 0)
+        {
+            const auto& stats = m_cullingStatsAccum;
+            culling = ", " + std::to_string((stats.drawnEarly + stats.drawnLate) / m_cullingStatsFrames) + " drawn ("
+                    + std::to_string(stats.drawnLate / m_cullingStatsFrames) + " late), "
+                    + std::to_string(stats.culled / m_cullingStatsFrames) + " culled per frame";
+        }
+        else if (m_useFrustumCulling)
+        {
+            culling = ", " + std::to_string(m_drawnObjectsAccum / STATS_FRAMES) + " drawn per frame (frustum culling: "
+                    + std::to_string(m_frustumCullingTimeAccum / STATS_FRAMES) + " ms, " + getCullingInstructionSet() + ")";
+        }
+        infoLog() << std::string(m_usePushConstants ? "push constants" : "object uniforms")
+                   + (m_useDepthPrepass ? ", depth pre-pass" : "")
+                   + ", " + std::to_string(m_objectGridSize * m_objectGridSize) + " objects, "
+                   + std::to_string(m_clusteredLights.getLightCount()) + " lights: "
+                   + std::to_string(m_sceneUpdateTimeAccum / STATS_FRAMES) + " ms per scene update, "
+                   + std::to_string(m_recordTimeAccum / STATS_FRAMES) + " ms per command buffer, " + gpuTime + culling;
+
+        std::string passTimes;
+        for (uint32_t p = 0; p < std::min(m_renderGraph.getPassCount(), GpuTimer::MAX_PASSES); p++)
+        {
+            if (m_passTimeFrames[p] > 0) {
+                passTimes += " " + m_renderGraph.getPassName(p) + ": " + std::to_string(m_passTimeAccum[p] / m_passTimeFrames[p]) + " ms,";
+            }
+        }
+        if (!passTimes.empty()) {
+            infoLog() << "GPU time per pass:" + passTimes.substr(0, passTimes.size() - 1);
+        }
 
-    VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
+        MemoryBudget::Stats memoryStats = m_contextPtr->getMemoryBudget().getStats();
+        std::string memory;
+        for (const auto& heap : memoryStats.heaps)
+        {
+            if (heap.deviceLocal) {
+                memory += " " + std::to_string(heap.usage >> 20) + " / " + std::to_string(heap.budget >> 20) + " MB,";
+            }
+        }
+        for (uint32_t c = 0; c < MemoryBudget::CATEGORY_COUNT; c++)
+        {
+            memory += std::string(" ") + MemoryBudget::getCategoryName(static_cast<MemoryCategory>(c)) + ": "
+                    + std::to_string(memoryStats.categoryBytes[c] >> 10) + " KB (" + std::to_string(memoryStats.categoryAllocations[c]) + "),";
+        }
+        infoLog() << "device memory:" + memory.substr(0, memory.size() - 1);
+        m_recordTimeAccum = 0.0;
+        m_recordTimeFrames = 0;
+        m_sceneUpdateTimeAccum = 0.0;
+        m_frustumCullingTimeAccum = 0.0;
+        m_drawnObjectsAccum = 0;
+        m_gpuTimeAccum = 0.0;
+        m_gpuTimeFrames = 0;
+        m_cullingStatsAccum = OcclusionCuller::Stats{};
+        m_cullingStatsFrames = 0;
+        m_passTimeAccum.fill(0.0);
+        m_passTimeFrames.fill(0);
+    }
 
+    // waits for the acquired image, signals the present semaphore and the next value of the graphics timeline
+    // (the GPU timer starts the frame at the waiting stage, so that the wait for the image is not measured)
     VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(m_contextPtr->getGraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
-    }
+    m_frameTimelineValues[m_currentFrame] = m_contextPtr->getGraphicsTimeline().submit(
+        &m_commandBuffers[m_currentFrame], 1,
+        { { m_imageAvailableSemaphores[m_currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT } },
+        { signalSemaphores[0] });
+    m_contextPtr->getDeletionQueue().endFrame(m_currentFrame);
+
+    // identifies the present, to know when the frame is displayed (if supported)
+    uint64_t presentId = m_latencyMeter.onPresent();
+    VkPresentIdKHR presentIdInfo{};
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.swapchainCount = 1;
+    presentIdInfo.pPresentIds = &presentId;
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = (presentId != 0) ? &presentIdInfo : nullptr;
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pWaitSemaphores = signalSemaphores;
     VkSwapchainKHR swapChains[] = { m_swapChain };
@@ -1180,9 +1722,14 @@ void DemoApp::drawFrame()
 
     result = vkQueuePresentKHR(m_contextPtr->getPresentQueue(), &presentInfo);
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized)
+    if (m_latencyMeter.isPresentWaitSupported()) {
+        m_latencyMeter.update(*m_contextPtr, m_swapChain);
+    }
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized || m_presentModeChanged)
     {
         m_framebufferResized = false;
+        m_presentModeChanged = false;
         recreateSwapChain();
     }
     else if (result != VK_SUCCESS) {
@@ -1190,7 +1737,7 @@ void DemoApp::drawFrame()
     }
 
     // update current frame id
-    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
 }
 
 
@@ -1199,13 +1746,7 @@ void DemoApp::drawFrame()
  */
 void DemoApp::cleanupSwapChain() 
 {
-    m_colorImage.cleanup(*m_contextPtr);
-    m_depthImage.cleanup(*m_contextPtr);
-
-    for (size_t i = 0; i < m_swapChainFramebuffers.size(); i++)
-    {
-        vkDestroyFramebuffer(m_contextPtr->getDevice(), m_swapChainFramebuffers[i], nullptr);
-    }
+    cleanupRenderTargets();
 
     for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
     {
@@ -1229,20 +1770,271 @@ void DemoApp::recreateSwapChain()
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(m_contextPtr->getDevice());
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-    cleanupSwapChain();
+    // frames in flight may still use the current swap chain: its resources are retired instead of destroyed
+    VkFormat previousFormat = m_swapChainImageFormat;
+    m_latencyMeter.reset();
+    retireSwapChain();
 
     createSwapChain();
     createImageViews();
-    createColorResources();
-    createDepthResources();
-    createFramebuffers();
+
+    // the new swap chain may not be the destination of the upscaling blit anymore (or may be again)
+    VkSampleCountFlagBits previousSamples = m_msaaSamples;
+    if (m_qualityController.setRenderScaleAllowed(m_renderScaleSupported))
+    {
+        m_msaaSamples = m_qualityController.getLevel().samples;
+        m_renderScale = m_qualityController.getLevel().renderScale;
+        m_gpuTimer.invalidate();
+    }
+
+    // the render graph is compiled again for the new swap chain images
+    // (with dynamic rendering, only images and barriers: no render pass nor framebuffers)
+    createRenderTargets();
+
+    // rare: the pipeline depends on the swap chain format and the sample count
+    // (otherwise, the new render pass is compatible with the one used to create the pipeline)
+    if (m_swapChainImageFormat != previousFormat || m_msaaSamples != previousSamples)
+    {
+        retireGraphicsPipeline();
+        createGraphicsPipeline();
+    }
+
+    resizeCamera();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    infoLog() << "recreateSwapChain(): " + std::to_string(std::chrono::duration<double, std::milli>(endTime - startTime).count()) + " ms";
+}
+
+
+/*
+ * Hands the resources of the current swap chain over to the deletion queue
+ * (the swap chain handle is kept until the new one is created, to be passed as oldSwapchain)
+ */
+void DemoApp::retireSwapChain()
+{
+    retireRenderTargets();
+
+    std::vector<VkImageView> imageViews = std::move(m_swapChainImageViews);
+    VkSwapchainKHR swapChain = m_swapChain;
+    m_contextPtr->getDeletionQueue().retire([imageViews, swapChain](VkDevice _device)
+    {
+        for (auto imageView : imageViews) {
+            vkDestroyImageView(_device, imageView, nullptr);
+        }
+        vkDestroySwapchainKHR(_device, swapChain, nullptr);
+    });
+    m_swapChainImageViews.clear();
+}
+
+
+/*
+ * Hands all the variants of the graphics pipeline and their layout over to the deletion queue
+ * (the render pass belongs to the render graph)
+ */
+void DemoApp::retireGraphicsPipeline()
+{
+    m_pipelineCache.retire(*m_contextPtr);
+    m_graphicsPipeline = VK_NULL_HANDLE;
+    m_depthPrepassPipeline = VK_NULL_HANDLE;
+
+    VkPipelineLayout pipelineLayout = m_pipelineLayout;
+    m_contextPtr->getDeletionQueue().retire([pipelineLayout](VkDevice _device)
+    {
+        vkDestroyPipelineLayout(_device, pipelineLayout, nullptr);
+    });
+}
+
+
+/*
+ * Recreate the graphics pipeline (and its layout) when the per-draw data path or the shaders change
+ */
+void DemoApp::recreateGraphicsPipeline()
+{
+    // frames in flight may still use the previous pipeline
+    retireGraphicsPipeline();
+
+    createGraphicsPipeline();
+
+    m_recordTimeAccum = 0.0;
+    m_recordTimeFrames = 0;
+    m_gpuTimeAccum = 0.0;
+    m_gpuTimeFrames = 0;
+    m_gpuTimer.invalidate();
 }
 
 
 /*
- * Generates a new transformation every frame to make the geometry spin around
+ * Frees device memory when the usage gets close to the budget: the largest texture (of the app or of the glTF model)
+ * is replaced by its lower mip levels, at most once every RESIDENCY_COOLDOWN_FRAMES
+ * (the virtual texture is not evicted: its atlas has a fixed size)
+ */
+void DemoApp::applyResidencyPolicy()
+{
+    MemoryBudget& memoryBudget = m_contextPtr->getMemoryBudget();
+
+    // the memory retired by the last eviction is freed, and the budget queried again, before the next decision
+    if (m_residencyCooldown > 0)
+    {
+        m_residencyCooldown--;
+        return;
+    }
+    if (!memoryBudget.isUsageHigh()) {
+        return;
+    }
+    m_residencyCooldown = RESIDENCY_COOLDOWN_FRAMES;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // nothing is evicted if the pressure comes from other categories (buffers, render targets)
+    MemoryBudget::Stats stats = memoryBudget.getStats();
+    VkDeviceSize allocated = 0;
+    for (VkDeviceSize bytes : stats.categoryBytes) {
+        allocated += bytes;
+    }
+    VkDeviceSize textureBytes = stats.categoryBytes[static_cast<uint32_t>(MemoryCategory::Texture)];
+    if (static_cast<double>(textureBytes) < MIN_TEXTURE_SHARE * static_cast<double>(allocated)) {
+        return;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // largest texture which can lose a mip level, and whose smaller copy fits in the budget
+    // (the copy, a quarter of the texture, is allocated before the texture is retired)
+    Image* evicted = nullptr;
+    uint32_t evictedIndex = 0;       // in the bindless array
+    VkDeviceSize headroom = memoryBudget.getDeviceLocalHeadroom();
+    auto consider = [&](Image& _texture, uint32_t _bindlessIndex)
+    {
+        uint32_t largestSide = std::max(_texture.getWidth(), _texture.getHeight());
+        if (_texture.getMiplevels() < 2 || largestSide / 2 < MIN_TEXTURE_SIZE) {
+            return;     // nothing left to free
+        }
+        VkDeviceSize size = VkDeviceSize(_texture.getWidth()) * _texture.getHeight();
+        VkDeviceSize copySize = size * 4 / 3;    // (w/2 x h/2 pixels of 4 bytes: w x h bytes, plus its mips)
+        if (copySize > headroom) {
+            return;
+        }
+        if (evicted == nullptr || size > VkDeviceSize(evicted->getWidth()) * evicted->getHeight())
+        {
+            evicted = &_texture;
+            evictedIndex = _bindlessIndex;
+        }
+    };
+    consider(m_textureImage, m_textureIndex);
+    for (size_t t = 0; t < m_model.getTextures().size(); t++) {
+        consider(m_model.getTextures()[t], m_model.getTextureIndices()[t]);
+    }
+    if (evicted == nullptr) {
+        return;
+    }
+
+    // 3. -----------------------------------------------------------------------------------------
+    // copy waited for, previous image retired: no device wait
+    if (!evicted->dropTopMips(*m_contextPtr, 1, MIN_TEXTURE_SIZE)) {
+        return;
+    }
+
+    if (evicted == &m_textureImage)
+    {
+        for (size_t i = 0; i < m_descriptorSets.size(); i++)
+        {
+            VkDescriptorImageInfo imageInfo{};
+            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfo.imageView = m_textureImage.getImageView();
+            imageInfo.sampler = m_textureImage.getSampler();
+
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = m_descriptorSets[i];
+            descriptorWrite.dstBinding = 1;
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.pImageInfo = &imageInfo;
+
+            vkUpdateDescriptorSets(m_contextPtr->getDevice(), 1, &descriptorWrite, 0, nullptr);
+        }
+    }
+    if (m_useBindless) {
+        m_bindlessTextures.setTexture(*m_contextPtr, evictedIndex, evicted->getImageView(), evicted->getSampler());
+    }
+    memoryBudget.update();
+
+    infoLog() << "device memory usage high: texture reduced to " + std::to_string(evicted->getWidth()) + "x"
+               + std::to_string(evicted->getHeight()) + " (" + std::to_string(evicted->getMiplevels()) + " mip levels) ";
+}
+
+
+/*
+ * Recreate the render pass, the pipeline and the render targets for the level chosen by the quality controller
+ */
+void DemoApp::applyQualityLevel()
+{
+    // frames in flight may still use the previous targets and pipeline
+    retireRenderTargets();
+    retireGraphicsPipeline();
+
+    m_msaaSamples = m_qualityController.getLevel().samples;
+    m_renderScale = m_qualityController.getLevel().renderScale;
+
+    createRenderTargets();
+    createGraphicsPipeline();
+
+    // pending timings were measured with the previous level
+    m_gpuTimer.invalidate();
+}
+
+
+/*
+ * Upscales the scene image to the swap chain image (linear filtering)
+ * (layout transitions before and after the blit are recorded by the render graph)
+ */
+void DemoApp::recordUpscale(VkCommandBuffer _commandBuffer, uint32_t _imageIndex)
+{
+    VkImageBlit blit{};
+    blit.srcOffsets[0] = { 0, 0, 0 };
+    blit.srcOffsets[1] = { static_cast<int32_t>(m_renderExtent.width), static_cast<int32_t>(m_renderExtent.height), 1 };
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = 0;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.dstOffsets[0] = { 0, 0, 0 };
+    blit.dstOffsets[1] = { static_cast<int32_t>(m_swapChainExtent.width), static_cast<int32_t>(m_swapChainExtent.height), 1 };
+    blit.dstSubresource = blit.srcSubresource;
+
+    vkCmdBlitImage(_commandBuffer,
+                   m_renderGraph.getImage(m_sceneResource, _imageIndex), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   m_renderGraph.getImage(m_swapChainResource, _imageIndex), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &blit, VK_FILTER_LINEAR);
+}
+
+
+/*
+ * Scene graph of the grid of objects: a root, and one child per object at its position on the grid
+ */
+void DemoApp::createScene()
+{
+    // objects are laid out on a grid centered on the origin
+    const float spacing = 1.5f;
+    float gridOffset = 0.5f * spacing * static_cast<float>(m_objectGridSize - 1);
+    glm::quat orientation = glm::quat_cast(m_defaultModel);
+
+    m_sceneGraph.clear();
+    m_objectNodes.clear();
+    m_sceneRoot = m_sceneGraph.addNode(SceneGraph::NO_PARENT);
+    for (uint32_t i = 0; i < m_objectGridSize * m_objectGridSize; i++)
+    {
+        glm::vec3 position(spacing * static_cast<float>(i % m_objectGridSize) - gridOffset,
+                           0.0f,
+                           spacing * static_cast<float>(i / m_objectGridSize) - gridOffset);
+        m_objectNodes.push_back(m_sceneGraph.addNode(m_sceneRoot, position, orientation));
+    }
+}
+
+
+/*
+ * Generates a new transformation every frame to make the geometry spin around,
+ * and writes frame and object uniforms into the region of the current frame in the ring buffer
  */
 void DemoApp::updateUniformBuffer(uint32_t _currentImage) 
 {
@@ -1250,11 +2042,78 @@ void DemoApp::updateUniformBuffer(uint32_t _currentImage)
     //auto currentTime = std::chrono::high_resolution_clock::now();
     //float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+    m_uniformRingBuffer.beginFrame(_currentImage);
+    m_frameUniformsOffset = m_uniformRingBuffer.push(m_frameUniforms);
+
+    // point lights turn around the vertical axis of the scene
+    static auto lightsStartTime = std::chrono::high_resolution_clock::now();
+    float lightsTime = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - lightsStartTime).count();
+    m_clusteredLights.update(_currentImage, m_frameUniforms.view, m_frameUniforms.proj, m_renderExtent, lightsTime);
+
     //m_initModel = glm::rotate(m_initModel, glm::radians(0.05f), glm::vec3(0.0f, 0.0f, 1.0f));
-    m_ubo.model = m_trackball.getRotationMatrix() 
-                * m_initModel;
+    glm::mat4 rotation = m_trackball.getRotationMatrix() 
+                       * m_initModel;
 
-    memcpy(m_uniformBuffersMapped[_currentImage], &m_ubo, sizeof(m_ubo));
+    uint32_t objectCount = m_objectGridSize * m_objectGridSize;
+    if (m_objectNodes.size() != objectCount) {
+        createScene();
+    }
+
+    // only the root moves (the objects keep m_defaultModel as local orientation): the world matrices
+    // are computed again when the trackball rotates
+    auto sceneStart = std::chrono::high_resolution_clock::now();
+    glm::quat gridRotation = glm::quat_cast(rotation * glm::inverse(m_defaultModel));
+    if (gridRotation != m_sceneGraph.getRotation(m_sceneRoot)) {
+        m_sceneGraph.setRotation(m_sceneRoot, gridRotation);
+    }
+    m_sceneGraph.update();
+    m_sceneUpdateTimeAccum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sceneStart).count();
+
+    m_objectUniformsOffsets.clear();
+    m_objectPushConstants.clear();
+    m_objectBounds.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) 
+    {
+        const glm::mat4& model = m_sceneGraph.getWorldMatrix(m_objectNodes[i]);
+
+        Bounds bounds = transformBounds(m_meshBounds, model);
+        if (m_useOcclusionCulling) {
+            m_occlusionCuller.setBounds(_currentImage, i, glm::vec4(bounds.center, bounds.radius));
+        }
+        else {
+            m_objectBounds.set(i, bounds);
+        }
+        uint32_t materialIndex = m_useBindless ? i % m_bindlessTextures.getCount() : 0;
+
+        if (m_usePushConstants)
+        {
+            // recorded in the command buffer, nothing to write in the ring buffer
+            m_objectPushConstants.push_back({ model, i, materialIndex });
+        }
+        else
+        {
+            ObjectUniforms objectUniforms{};
+            objectUniforms.model = model;
+            objectUniforms.materialIndex = materialIndex;
+            m_objectUniformsOffsets.push_back(m_uniformRingBuffer.push(objectUniforms));
+        }
+    }
+
+    // objects drawn: the ones intersecting the view frustum (all of them with occlusion culling, tested on the GPU)
+    auto cullingStart = std::chrono::high_resolution_clock::now();
+    if (m_useFrustumCulling && !m_useOcclusionCulling)
+    {
+        cullBounds(extractFrustum(m_frameUniforms.proj * m_frameUniforms.view), m_objectBounds, m_drawnObjects);
+    }
+    else
+    {
+        m_drawnObjects.resize(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            m_drawnObjects[i] = i;
+        }
+    }
+    m_frustumCullingTimeAccum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullingStart).count();
+    m_drawnObjectsAccum += m_drawnObjects.size();
 }
 
 
@@ -1272,12 +2131,107 @@ void DemoApp::framebufferResizeCallback(GLFWwindow* _window, int _width, int _he
  */
 void DemoApp::keyCallback(GLFWwindow* _window, int _key, int _scancode, int _action, int _mods)
 {
+    auto app = reinterpret_cast<DemoApp*>(glfwGetWindowUserPointer(_window));
+    app->m_latencyMeter.markInput();
+
     // return to init positon when "R" pressed
     if (_key == GLFW_KEY_R && _action == GLFW_PRESS)
     {
-        auto app = reinterpret_cast<DemoApp*>(glfwGetWindowUserPointer(_window));
+        app->m_initModel = app->m_defaultModel;
         app->m_trackball.reStart();
     }
+
+    // select the next present mode when "V" pressed
+    if (_key == GLFW_KEY_V && _action == GLFW_PRESS)
+    {
+        app->cyclePresentMode();
+    }
+
+    // enable/disable adaptive MSAA and render scale when "Q" pressed
+    if (_key == GLFW_KEY_Q && _action == GLFW_PRESS)
+    {
+        app->m_qualityController.setEnabled(!app->m_qualityController.isEnabled());
+    }
+
+    // switch per-draw data between push constants and object uniforms when "P" pressed
+    if (_key == GLFW_KEY_P && _action == GLFW_PRESS && app->m_pushConstantsSupported)
+    {
+        app->m_usePushConstants = !app->m_usePushConstants;
+        app->m_pipelineOutdated = true;
+    }
+
+    // enable/disable the depth pre-pass when "Z" pressed
+    if (_key == GLFW_KEY_Z && _action == GLFW_PRESS)
+    {
+        app->m_useDepthPrepass = !app->m_useDepthPrepass;
+        app->m_pipelineVariantOutdated = true;
+        infoLog() << std::string("depth pre-pass: ") + (app->m_useDepthPrepass ? "on" : "off");
+    }
+
+    // enable/disable texturing when "T" pressed
+    if (_key == GLFW_KEY_T && _action == GLFW_PRESS)
+    {
+        app->m_shadingFeatures.textured = app->m_shadingFeatures.textured ? VK_FALSE : VK_TRUE;
+        app->m_pipelineVariantOutdated = true;
+        infoLog() << std::string("texturing: ") + (app->m_shadingFeatures.textured ? "on" : "off");
+    }
+
+    // select the next lighting model (unlit, diffuse, normals) when "M" pressed
+    if (_key == GLFW_KEY_M && _action == GLFW_PRESS)
+    {
+        app->m_shadingFeatures.lightingModel = (app->m_shadingFeatures.lightingModel + 1) % PipelineKey::LIGHTING_MODEL_COUNT;
+        app->m_pipelineVariantOutdated = true;
+    }
+
+    // switch the texture coordinates scale between 1 and 2 when "U" pressed
+    if (_key == GLFW_KEY_U && _action == GLFW_PRESS)
+    {
+        app->m_shadingFeatures.texCoordScale = (app->m_shadingFeatures.texCoordScale == 1.0f) ? 2.0f : 1.0f;
+        app->m_pipelineVariantOutdated = true;
+    }
+
+    // enable/disable frustum culling when "F" pressed
+    if (_key == GLFW_KEY_F && _action == GLFW_PRESS)
+    {
+        app->m_useFrustumCulling = !app->m_useFrustumCulling;
+        infoLog() << std::string("frustum culling: ") + (app->m_useFrustumCulling ? "on" : "off");
+    }
+
+    // enable/disable occlusion culling when "O" pressed
+    if (_key == GLFW_KEY_O && _action == GLFW_PRESS)
+    {
+        // the culling shader writes one draw command per object
+        if (!app->m_useOcclusionCulling && app->m_model.getPartCount() > 1) {
+            infoLog() << "occlusion culling: only for single part models ";
+        }
+        else
+        {
+            app->m_useOcclusionCulling = !app->m_useOcclusionCulling;
+            app->m_renderTargetsOutdated = true;
+            infoLog() << std::string("occlusion culling: ") + (app->m_useOcclusionCulling ? "on" : "off");
+        }
+    }
+
+    // cycle the nb of point lights when "L" pressed (stress test of the clustered lighting)
+    if (_key == GLFW_KEY_L && _action == GLFW_PRESS)
+    {
+        app->m_lightCountIndex = (app->m_lightCountIndex + 1) % static_cast<uint32_t>(LIGHT_COUNTS.size());
+        app->m_clusteredLights.generateLights(LIGHT_COUNTS[app->m_lightCountIndex], LIGHTS_EXTENT);
+    }
+
+    // grow/shrink the grid of drawn objects with "+" and "-"
+    if ((_key == GLFW_KEY_EQUAL || _key == GLFW_KEY_KP_ADD) && _action == GLFW_PRESS)
+    {
+        if ((app->m_objectGridSize + 1) * (app->m_objectGridSize + 1) <= MAX_OBJECTS)
+            app->m_objectGridSize++;
+        infoLog() << "objects: " + std::to_string(app->m_objectGridSize * app->m_objectGridSize);
+    }
+    if ((_key == GLFW_KEY_MINUS || _key == GLFW_KEY_KP_SUBTRACT) && _action == GLFW_PRESS)
+    {
+        if (app->m_objectGridSize > 1)
+            app->m_objectGridSize--;
+        infoLog() << "objects: " + std::to_string(app->m_objectGridSize * app->m_objectGridSize);
+    }
 }
 
 /*
@@ -1286,6 +2240,7 @@ void DemoApp::keyCallback(GLFWwindow* _window, int _key, int _scancode, int _act
 void DemoApp::mouseButtonCallback(GLFWwindow* _window, int _button, int _action, int _mods)
 {
     auto app = reinterpret_cast<DemoApp*>(glfwGetWindowUserPointer(_window));
+    app->m_latencyMeter.markInput();
 
     // get mouse cursor position
     double x, y;
@@ -1322,7 +2277,10 @@ void DemoApp::cursorPosCallback(GLFWwindow* _window, double _x, double _y)
 
     // rotate trackball according to mouse cursor movement
     if ( app->m_trackball.isTracking()) 
+    {
+        app->m_latencyMeter.markInput();
         app->m_trackball.move( glm::vec2(_x, _y) );
+    }
 }
 
 
@@ -19,8 +19,22 @@
 
 
 #include "context.h"
+#include "geometrypool.h"
 #include "mesh.h"
+#include "model.h"
 #include "image.h"
+#include "virtualtexture.h"
+#include "uniformringbuffer.h"
+#include "bindlesstextures.h"
+#include "gputimer.h"
+#include "qualitycontroller.h"
+#include "latencymeter.h"
+#include "rendergraph.h"
+#include "occlusionculler.h"
+#include "clusteredlights.h"
+#include "pipelinecache.h"
+#include "core/culling.h"
+#include "core/scenegraph.h"
 
 
 namespace VulkanDemo
@@ -29,12 +43,19 @@ namespace VulkanDemo
 
 class DemoApp
 {
-    const int MAX_FRAMES_IN_FLIGHT = 2;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
 
 public:
 
     void run();
 
+    // settings, must be set before run()
+    void setFramesInFlight(uint32_t _framesInFlight);
+    void setPresentMode(VkPresentModeKHR _presentMode) { m_presentMode = _presentMode; }
+    void setDynamicRendering(bool _enabled) { m_useDynamicRendering = _enabled; }
+    // Wavefront (.obj) or glTF 2.0 (.glb, .gltf) file
+    void setModelPath(const std::string& _path) { m_modelPath = _path; }
+
 private:
 
     // Context contains handles for: 
@@ -48,49 +69,160 @@ private:
     std::shared_ptr<Context> m_contextPtr = nullptr; 
 
     GLFWwindow* m_window;
-    VkSwapchainKHR m_swapChain;                         // swap chain
+    VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;        // swap chain
     std::vector<VkImage> m_swapChainImages;             // handles of the VkImage
     VkFormat m_swapChainImageFormat;                    // format chosen for the swap chain images
     VkExtent2D m_swapChainExtent;                       // extent chosen for the swap chain images
     std::vector<VkImageView> m_swapChainImageViews;     // image views
-    VkRenderPass m_renderPass;                          // the render pipeline
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;         // render pass of the scene (owned by m_renderGraph)
     VkDescriptorSetLayout m_descriptorSetLayout;        // defines uniforms
     VkPipelineLayout m_pipelineLayout;                  // defines uniforms
-    VkPipeline m_graphicsPipeline;                      // final graphics pipeline
-    std::vector<VkFramebuffer> m_swapChainFramebuffers; // framebuffers
+    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;     // variant of the graphics pipeline in use (owned by m_pipelineCache)
+    VkPipeline m_depthPrepassPipeline = VK_NULL_HANDLE; // depth only, positions only (if m_useDepthPrepass, owned by m_pipelineCache)
+    PipelineCache m_pipelineCache;                      // variants of the graphics pipeline, built on first use
+
+    // state read by the builds of the pipeline variants (copied: variants are built on worker threads)
+    struct PipelineBuildState
+    {
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        bool usePushConstants = false;
+        bool useVirtualTexture = false;                 // selects the fragment shader
+        bool useBindless = false;
+        VkRenderPass renderPass = VK_NULL_HANDLE;       // VK_NULL_HANDLE with dynamic rendering
+        std::vector<VkFormat> colorFormats;             // with dynamic rendering
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    };
     VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT; // nb of samples per pixel
+    float m_renderScale = 1.0f;                         // size of the render targets relative to the swap chain
+    VkExtent2D m_renderExtent;                          // extent of the render targets
+    bool m_renderScaleSupported = false;                // swap chain can be the destination of a blit
 
     // images
     Image m_textureImage;   // texture
-    Image m_depthImage;     // depth buffer
-    Image m_colorImage;     // image to store the desired number of samples per pixel
+
+    // passes of the frame, owns the render targets (multisampled color, depth, and scene image if m_renderScale < 1)
+    RenderGraph m_renderGraph;
+    bool m_useDynamicRendering = true;  // falls back to render passes if VK_KHR_dynamic_rendering is not supported
+    RenderGraph::PassHandle m_scenePass = 0;
+    RenderGraph::ResourceHandle m_sceneResource = RenderGraph::NO_RESOURCE;
+    RenderGraph::ResourceHandle m_swapChainResource = RenderGraph::NO_RESOURCE;
+    bool m_renderTargetsOutdated = false;
+
+    // two-phase occlusion culling against a depth pyramid: the scene is drawn in two passes,
+    // with a compute pass in between (toggled with "O")
+    OcclusionCuller m_occlusionCuller;
+    bool m_useOcclusionCulling = false;
+    Bounds m_meshBounds;                        // bounding box and sphere of the model, in object space
+
+    // objects outside the view frustum are not drawn, tested on the CPU in batches (toggled with "F")
+    // (not used with occlusion culling, which also tests the frustum, on the GPU)
+    BoundsSoA m_objectBounds;                   // world space bounds of each object
+    std::vector<uint32_t> m_drawnObjects;       // indices of the objects drawn this frame
+    bool m_useFrustumCulling = true;
+
+    // point lights shaded per view space cluster, assigned by a compute pass (nb of lights cycled with "L")
+    static constexpr std::array<uint32_t, 4> LIGHT_COUNTS = { 0, 64, 1024, ClusteredLights::MAX_LIGHTS };
+    inline static const glm::vec3 LIGHTS_EXTENT = glm::vec3(4.0f, 1.0f, 4.0f);    // half size of the box containing the lights
+    ClusteredLights m_clusteredLights;
+    uint32_t m_lightCountIndex = 1;
+
+    // virtual texture, streamed by tiles (replaces m_textureImage in the fragment shader when enabled)
+    VirtualTexture m_virtualTexture;
+    bool m_useVirtualTexture = false;
+
+    // all textures in one descriptor array indexed by material (if descriptor indexing is supported)
+    BindlessTextures m_bindlessTextures;
+    bool m_useBindless = true;
+    uint32_t m_textureIndex = 0;                // of m_textureImage in the bindless array
+
+    // device memory is accounted against the heap budgets: when the usage gets high,
+    // the largest texture loses its largest mip level (down to MIN_TEXTURE_SIZE)
+    static constexpr uint32_t MIN_TEXTURE_SIZE = 256;
+    static constexpr uint32_t RESIDENCY_COOLDOWN_FRAMES = 30;  // nb of frames between two evictions (retired memory is freed meanwhile)
+    static constexpr double MIN_TEXTURE_SHARE = 0.25;          // textures are evicted if they hold this fraction of our allocations at least
+    uint32_t m_residencyCooldown = 0;
 
     // Command buffer (for each in-flight frame)
     std::vector<VkCommandBuffer> m_commandBuffers;
 
-    // Semaphores and fences (for each in-flight frame)
+    // Binary semaphores of the swap chain acquire and present (for each in-flight frame)
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
-    std::vector<VkFence> m_inFlightFences;
+    // Value of the graphics timeline signaled by the last submission of each in-flight frame
+    std::vector<uint64_t> m_frameTimelineValues;
 
     // Resize flag
     bool m_framebufferResized = false;
 
+    // frame pacing: nb of frames recorded ahead of the GPU, and requested present mode (cycled with "V")
+    uint32_t m_framesInFlight = 2;
+    VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    bool m_presentModeChanged = false;
+    LatencyMeter m_latencyMeter;
+
     // id of current frame to draw
     uint32_t m_currentFrame = 0;
 
-    // Mesh contains vertex buffer and index buffer
-    Mesh m_mesh;
+    // vertices and indices of all the meshes (fetched by the vertex shaders), drawn without other buffer binds
+    static constexpr uint32_t GEOMETRY_VERTEX_CAPACITY = 1 << 20;
+    static constexpr uint32_t GEOMETRY_INDEX_CAPACITY = 1 << 22;
+    GeometryPool m_geometryPool;
+
+    // Model contains the parts drawn for each object (ranges in m_geometryPool, transformations and materials)
+    std::string m_modelPath = MODEL_PATH;
+    Model m_model;
 
-    UniformBufferObject m_ubo{};
-    glm::mat4 m_initModel;
+    FrameUniforms m_frameUniforms{};
+    glm::mat4 m_defaultModel;   // initial transformation to re-orient mesh
+    glm::mat4 m_initModel;      // m_defaultModel, plus the trackball rotations kept across resizes
     GLtools::Camera m_camera;
     GLtools::Trackball m_trackball;
 
-    // uniforms storage
-    std::vector<VkBuffer> m_uniformBuffers;
-    std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-    std::vector<void*> m_uniformBuffersMapped;
+    // the mesh is drawn as a grid of m_objectGridSize^2 objects
+    uint32_t m_objectGridSize = 1;
+
+    // transformations of the objects: the root of the grid carries the trackball rotation,
+    // its children (one per object) their position on the grid
+    SceneGraph m_sceneGraph;
+    SceneGraph::NodeHandle m_sceneRoot = SceneGraph::NO_PARENT;
+    std::vector<SceneGraph::NodeHandle> m_objectNodes;
+
+    // uniforms storage (frame and object uniforms of every frame in flight)
+    UniformRingBuffer m_uniformRingBuffer;
+    uint32_t m_frameUniformsOffset = 0;             // dynamic offsets for the current frame
+    std::vector<uint32_t> m_objectUniformsOffsets;
+
+    // per-draw data sent as push constants instead of object uniforms 
+    // (disabled if maxPushConstantsSize is too small, toggled with "P")
+    bool m_usePushConstants = true;
+    bool m_pushConstantsSupported = true;
+    bool m_pipelineOutdated = false;
+    std::vector<ObjectPushConstants> m_objectPushConstants;
+
+    // depth pre-pass: only the closest fragment of each pixel is shaded (toggled with "Z")
+    bool m_useDepthPrepass = false;
+
+    // shading features of the graphics pipeline, compiled into its variants (toggled with "T", "M" and "U")
+    PipelineKey m_shadingFeatures;
+    bool m_pipelineVariantOutdated = false;
+
+    // GPU frame time drives MSAA sample count and render scale (toggled with "Q")
+    GpuTimer m_gpuTimer;
+    QualityController m_qualityController;
+
+    // CPU time spent recording draw commands and GPU frame time, averaged over STATS_FRAMES frames
+    static constexpr uint32_t STATS_FRAMES = 500;
+    double m_recordTimeAccum = 0.0;
+    uint32_t m_recordTimeFrames = 0;
+    double m_sceneUpdateTimeAccum = 0.0;
+    double m_frustumCullingTimeAccum = 0.0;
+    uint64_t m_drawnObjectsAccum = 0;
+    double m_gpuTimeAccum = 0.0;
+    uint32_t m_gpuTimeFrames = 0;
+    OcclusionCuller::Stats m_cullingStatsAccum;
+    uint32_t m_cullingStatsFrames = 0;
+    std::array<double, GpuTimer::MAX_PASSES> m_passTimeAccum{};     // GPU time of each pass of the render graph
+    std::array<uint32_t, GpuTimer::MAX_PASSES> m_passTimeFrames{};
 
     // Descriptors (i.e., uniforms)
     VkDescriptorPool m_descriptorPool;
@@ -100,6 +232,7 @@ private:
     void initWindow();
     void initVulkan();
     void initUBO();
+    void resizeCamera();
     void mainLoop();
     void cleanup();
 
@@ -107,12 +240,8 @@ private:
     void pickPhysicalDevice();
     void createSwapChain();
     void createImageViews();
-    void createRenderPass();
     void createDescriptorSetLayout();
     void createGraphicsPipeline();
-    void createFramebuffers();
-    void createDepthResources();
-    void createColorResources();
     void createUniformBuffers();
     void createDescriptorPool();
     void createDescriptorSets();
@@ -128,14 +257,17 @@ private:
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& _availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& _availablePresentModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& _capabilities);
+    void cyclePresentMode();
 
     // used in createImageViews()
     VkImageView createImageView(VkImage _image, VkFormat _format, VkImageAspectFlags _aspectFlags, uint32_t _mipLevels);
 
     // used in createGraphicsPipeline()
+    void selectPipelineVariants();
+    VkPipeline createPipelineVariant(PipelineKey const& _key, PipelineBuildState const& _state);
     VkShaderModule createShaderModule(const std::vector<char>& _code);
 
-    // used in createDepthResources()
+    // used in createRenderTargets()
     VkFormat findSupportedFormat(const std::vector<VkFormat>& _candidates, VkImageTiling _tiling, VkFormatFeatureFlags _features);
     VkFormat findDepthFormat();
 
@@ -144,8 +276,24 @@ private:
 
     // used in drawFrame()
     void recordCommandBuffer(VkCommandBuffer _commandBuffer, uint32_t _imageIndex);
+    void recordScene(VkCommandBuffer _commandBuffer, uint32_t _cullingPhase);
+    void recordDraws(VkCommandBuffer _commandBuffer, uint32_t _cullingPhase);
+    void recordOcclusionCulling(VkCommandBuffer _commandBuffer);
+    void applyResidencyPolicy();
     void cleanupSwapChain();
     void recreateSwapChain();
+    void retireSwapChain();
+    void retireGraphicsPipeline();
+    void recreateGraphicsPipeline();
+    void applyQualityLevel();
+    void recordUpscale(VkCommandBuffer _commandBuffer, uint32_t _imageIndex);
+
+    // render targets (depend on swap chain extent, sample count and render scale)
+    bool isRenderingOffscreen() const { return m_renderScale < 1.0f; }
+    void createRenderTargets();
+    void cleanupRenderTargets();
+    void retireRenderTargets();
+    void createScene();
     void updateUniformBuffer(uint32_t _currentImage);
 
     // UI callbacks
@@ -0,0 +1,324 @@
+/*********************************************************************************************************************
+ *
+ * geometrypool.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "geometrypool.h"
+#include "context.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+void GeometryPool::RangeAllocator::reset(uint32_t _capacity)
+{
+    capacity = _capacity;
+    freeRanges.assign(1, { 0, _capacity });
+}
+
+
+/*
+ * First free range large enough (returns INVALID_OFFSET if there is none)
+ */
+uint32_t GeometryPool::RangeAllocator::allocate(uint32_t _size)
+{
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); it++)
+    {
+        if (it->second < _size) {
+            continue;
+        }
+
+        uint32_t offset = it->first;
+        it->first += _size;
+        it->second -= _size;
+        if (it->second == 0) {
+            freeRanges.erase(it);
+        }
+        return offset;
+    }
+    return INVALID_OFFSET;
+}
+
+
+void GeometryPool::RangeAllocator::free(uint32_t _offset, uint32_t _size)
+{
+    if (_size == 0) {
+        return;
+    }
+
+    auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), std::make_pair(_offset, 0u));
+    auto range = freeRanges.insert(next, { _offset, _size });
+
+    // merged with the next range, then with the previous one
+    if (range + 1 != freeRanges.end() && range->first + range->second == (range + 1)->first)
+    {
+        range->second += (range + 1)->second;
+        freeRanges.erase(range + 1);
+    }
+    if (range != freeRanges.begin() && (range - 1)->first + (range - 1)->second == range->first)
+    {
+        (range - 1)->second += range->second;
+        freeRanges.erase(range);
+    }
+}
+
+
+/*
+ * Allocates the buffers of the pool (nb of vertices and indices of all the meshes together)
+ */
+void GeometryPool::create(Context& _context, uint32_t _vertexCapacity, uint32_t _indexCapacity)
+{
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        _context.getMemoryBudget().createBuffer(_context.getDevice(), VkDeviceSize(_vertexCapacity) * STREAM_COMPONENTS[s] * sizeof(float),
+                                                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Mesh,
+                                                m_streamBuffers[s], m_streamBufferMemories[s]);
+    }
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), VkDeviceSize(_indexCapacity) * sizeof(uint32_t),
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Mesh,
+                                            m_indexBuffer, m_indexBufferMemory);
+
+    m_vertices.reset(_vertexCapacity);
+    m_indices.reset(_indexCapacity);
+}
+
+
+void GeometryPool::cleanup(Context& _context)
+{
+    vkDestroyBuffer(_context.getDevice(), m_indexBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_indexBufferMemory);
+    m_indexBuffer = VK_NULL_HANDLE;
+    m_indexBufferMemory = VK_NULL_HANDLE;
+
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        vkDestroyBuffer(_context.getDevice(), m_streamBuffers[s], nullptr);
+        _context.getMemoryBudget().free(_context.getDevice(), m_streamBufferMemories[s]);
+        m_streamBuffers[s] = VK_NULL_HANDLE;
+        m_streamBufferMemories[s] = VK_NULL_HANDLE;
+    }
+}
+
+
+/*
+ * Suballocates a mesh, and copies its streams and indices from one staging buffer, filled by _write
+ */
+GeometryPool::MeshRange GeometryPool::addMesh(Context& _context, uint32_t _vertexCount, uint32_t _indexCount,
+                                              const std::function<void(StagingMesh const&)>& _write)
+{
+    // nothing to draw (e.g., empty glTF primitive): no staging buffer nor copies of size 0
+    if (_vertexCount == 0 || _indexCount == 0) {
+        return MeshRange{};
+    }
+
+    // 1. -----------------------------------------------------------------------------------------
+    // ranges in the buffers
+    uint32_t vertexOffset = m_vertices.allocate(_vertexCount);
+    uint32_t firstIndex = m_indices.allocate(_indexCount);
+    if (vertexOffset == RangeAllocator::INVALID_OFFSET || firstIndex == RangeAllocator::INVALID_OFFSET)
+    {
+        if (vertexOffset != RangeAllocator::INVALID_OFFSET) {
+            m_vertices.free(vertexOffset, _vertexCount);
+        }
+        if (firstIndex != RangeAllocator::INVALID_OFFSET) {
+            m_indices.free(firstIndex, _indexCount);
+        }
+        throw std::runtime_error("geometry pool is full!");
+    }
+
+    MeshRange range;
+    range.firstIndex = firstIndex;
+    range.indexCount = _indexCount;
+    range.vertexOffset = static_cast<int32_t>(vertexOffset);
+    range.vertexCount = _vertexCount;
+
+    // 2. -----------------------------------------------------------------------------------------
+    // staging buffer: streams, then indices
+    std::array<VkDeviceSize, STREAM_COUNT + 1> offsets{};
+    for (uint32_t s = 0; s < STREAM_COUNT; s++) {
+        offsets[s + 1] = offsets[s] + VkDeviceSize(_vertexCount) * STREAM_COMPONENTS[s] * sizeof(float);
+    }
+    VkDeviceSize indicesSize = VkDeviceSize(_indexCount) * sizeof(uint32_t);
+    VkDeviceSize stagingSize = offsets[STREAM_COUNT] + indicesSize;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging,
+                                            stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(_context.getDevice(), stagingBufferMemory, 0, stagingSize, 0, &data);
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+
+    StagingMesh staging;
+    for (uint32_t s = 0; s < STREAM_COUNT; s++) {
+        staging.streams[s] = reinterpret_cast<float*>(bytes + offsets[s]);
+    }
+    staging.indices = reinterpret_cast<uint32_t*>(bytes + offsets[STREAM_COUNT]);
+    staging.vertexCount = _vertexCount;
+    staging.indexCount = _indexCount;
+
+    // the caller may throw (e.g., corrupt compressed mesh): the staging buffer and the ranges are released
+    try
+    {
+        _write(staging);
+    }
+    catch (...)
+    {
+        vkUnmapMemory(_context.getDevice(), stagingBufferMemory);
+        vkDestroyBuffer(_context.getDevice(), stagingBuffer, nullptr);
+        _context.getMemoryBudget().free(_context.getDevice(), stagingBufferMemory);
+        m_vertices.free(vertexOffset, _vertexCount);
+        m_indices.free(firstIndex, _indexCount);
+        throw;
+    }
+
+    vkUnmapMemory(_context.getDevice(), stagingBufferMemory);
+
+    // 3. -----------------------------------------------------------------------------------------
+    // copies to the ranges of the mesh
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(_context.getDevice(), _context.getCommandPool());
+
+    VkBufferCopy copyRegion{};
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        copyRegion.srcOffset = offsets[s];
+        copyRegion.dstOffset = VkDeviceSize(vertexOffset) * STREAM_COMPONENTS[s] * sizeof(float);
+        copyRegion.size = offsets[s + 1] - offsets[s];
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_streamBuffers[s], 1, &copyRegion);
+    }
+
+    copyRegion.srcOffset = offsets[STREAM_COUNT];
+    copyRegion.dstOffset = VkDeviceSize(firstIndex) * sizeof(uint32_t);
+    copyRegion.size = indicesSize;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, m_indexBuffer, 1, &copyRegion);
+
+    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsTimeline());
+
+    vkDestroyBuffer(_context.getDevice(), stagingBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), stagingBufferMemory);
+
+    return range;
+}
+
+
+/*
+ * Mesh built on the CPU: its vertices are split into the streams
+ */
+GeometryPool::MeshRange GeometryPool::addMesh(Context& _context, const std::vector<Vertex>& _vertices, const std::vector<uint32_t>& _indices)
+{
+    return addMesh(_context, static_cast<uint32_t>(_vertices.size()), static_cast<uint32_t>(_indices.size()),
+                   [&_vertices, &_indices](StagingMesh const& _staging)
+    {
+        for (size_t i = 0; i < _vertices.size(); i++)
+        {
+            const Vertex& vertex = _vertices[i];
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                _staging.streams[POSITIONS][3 * i + c] = vertex.pos[c];
+                _staging.streams[COLORS][3 * i + c] = vertex.color[c];
+                _staging.streams[NORMALS][3 * i + c] = vertex.normal[c];
+            }
+            _staging.streams[TEXCOORDS][2 * i] = vertex.texCoord.x;
+            _staging.streams[TEXCOORDS][2 * i + 1] = vertex.texCoord.y;
+        }
+        memcpy(_staging.indices, _indices.data(), _indices.size() * sizeof(uint32_t));
+    });
+}
+
+
+/*
+ * Frees the ranges of a mesh through the deletion queue (frames in flight may still draw it)
+ */
+void GeometryPool::removeMesh(Context& _context, MeshRange const& _range)
+{
+    if (_range.vertexCount == 0 || _range.indexCount == 0) {
+        return;     // empty mesh, no ranges allocated
+    }
+
+    _context.getDeletionQueue().retire([this, _range](VkDevice _device)
+    {
+        m_vertices.free(static_cast<uint32_t>(_range.vertexOffset), _range.vertexCount);
+        m_indices.free(_range.firstIndex, _range.indexCount);
+    });
+}
+
+
+/*
+ * Bindings of the streams, read by the vertex shaders
+ */
+void GeometryPool::addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings)
+{
+    VkDescriptorSetLayoutBinding streamBinding{};
+    streamBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    streamBinding.descriptorCount = 1;
+    streamBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    streamBinding.pImmutableSamplers = nullptr;
+
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        streamBinding.binding = FIRST_STREAM_BINDING + s;
+        _bindings.push_back(streamBinding);
+    }
+}
+
+
+/*
+ * Descriptors required by the pool (one descriptor set per frame in flight)
+ */
+void GeometryPool::addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight)
+{
+    VkDescriptorPoolSize storageSize{};
+    storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageSize.descriptorCount = STREAM_COUNT * _framesInFlight;
+    _poolSizes.push_back(storageSize);
+}
+
+
+/*
+ * Descriptor writes for the descriptor set of a frame in flight (same buffers for all the frames)
+ */
+void GeometryPool::addDescriptorWrites(VkDescriptorSet _descriptorSet, std::vector<VkWriteDescriptorSet>& _writes)
+{
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _descriptorSet;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    for (uint32_t s = 0; s < STREAM_COUNT; s++)
+    {
+        m_streamInfos[s].buffer = m_streamBuffers[s];
+        m_streamInfos[s].offset = 0;
+        m_streamInfos[s].range = VK_WHOLE_SIZE;
+
+        write.dstBinding = FIRST_STREAM_BINDING + s;
+        write.pBufferInfo = &m_streamInfos[s];
+        _writes.push_back(write);
+    }
+}
+
+
+/*
+ * Index buffer shared by all the draws (vertices are read through the descriptor set)
+ */
+void GeometryPool::bind(VkCommandBuffer _commandBuffer)
+{
+    vkCmdBindIndexBuffer(_commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,135 @@
+/*********************************************************************************************************************
+ *
+ * geometrypool.h
+ *
+ * Vertices and indices of all the meshes, suballocated in a few large device local buffers:
+ *  - one storage buffer per vertex attribute (tightly packed floats, whatever the alignment of the glm types),
+ *    fetched by the vertex shaders with gl_VertexIndex (vertex pulling: the pipelines have no vertex input),
+ *    so the depth pre-pass reads the positions only
+ *  - indices are in one index buffer, bound once per command buffer
+ * A draw only carries the range of its mesh (first index and vertex offset), so that the whole scene
+ * is drawn without binding other buffers
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+
+
+#include "utils.h"
+#include "core/geometry.h"
+
+#include <limits>
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class GeometryPool
+{
+
+public:
+
+    // vertex attributes, in the order of their bindings
+    static constexpr uint32_t POSITIONS = 0;
+    static constexpr uint32_t COLORS = 1;
+    static constexpr uint32_t TEXCOORDS = 2;
+    static constexpr uint32_t NORMALS = 3;
+    static constexpr uint32_t STREAM_COUNT = 4;
+    static constexpr std::array<uint32_t, STREAM_COUNT> STREAM_COMPONENTS = { 3, 3, 2, 3 };   // floats per vertex
+
+    // bindings used by the vertex shaders in the descriptor set of the app (one per stream)
+    static constexpr uint32_t FIRST_STREAM_BINDING = 8;
+
+    /*
+     * Location of a mesh in the pool (arguments of its indexed draws)
+     */
+    struct MeshRange
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        int32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
+    };
+
+    /*
+     * Staging memory of a mesh being added, written by the caller
+     * (streams of vertexCount * STREAM_COMPONENTS floats, indices relative to the first vertex of the mesh)
+     */
+    struct StagingMesh
+    {
+        std::array<float*, STREAM_COUNT> streams{};
+        uint32_t* indices = nullptr;
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+    };
+
+    GeometryPool() = default;
+
+    // owns the buffers shared by all the meshes, it cannot be duplicated
+    GeometryPool(GeometryPool const& _other) = delete;
+    GeometryPool& operator=(GeometryPool const& _other) = delete;
+
+    virtual ~GeometryPool() {};
+
+
+    VkBuffer const getIndexBuffer() const { return m_indexBuffer; }
+    uint32_t const getVertexCapacity() const { return m_vertices.capacity; }
+    uint32_t const getIndexCapacity() const { return m_indices.capacity; }
+
+    void create(Context& _context, uint32_t _vertexCapacity, uint32_t _indexCapacity);
+    void cleanup(Context& _context);
+
+    // uploads a mesh in free ranges of the buffers, _write fills its staging memory
+    // (a mesh without vertices or indices gets an empty range, and nothing is uploaded)
+    MeshRange addMesh(Context& _context, uint32_t _vertexCount, uint32_t _indexCount, const std::function<void(StagingMesh const&)>& _write);
+    MeshRange addMesh(Context& _context, const std::vector<Vertex>& _vertices, const std::vector<uint32_t>& _indices);
+    // the ranges are reused once the frames in flight no longer draw the mesh
+    void removeMesh(Context& _context, MeshRange const& _range);
+
+    static void addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings);
+    static void addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight);
+    void addDescriptorWrites(VkDescriptorSet _descriptorSet, std::vector<VkWriteDescriptorSet>& _writes);
+
+    // used in recordScene()
+    void bind(VkCommandBuffer _commandBuffer);
+
+
+protected:
+
+    /*
+     * Free ranges of one buffer, in elements (first fit, adjacent ranges are merged)
+     */
+    struct RangeAllocator
+    {
+        static constexpr uint32_t INVALID_OFFSET = std::numeric_limits<uint32_t>::max();
+
+        uint32_t capacity = 0;
+        std::vector<std::pair<uint32_t, uint32_t>> freeRanges;      // offset, size (sorted by offset)
+
+        void reset(uint32_t _capacity);
+        uint32_t allocate(uint32_t _size);
+        void free(uint32_t _offset, uint32_t _size);
+    };
+
+    std::array<VkBuffer, STREAM_COUNT> m_streamBuffers{};
+    std::array<VkDeviceMemory, STREAM_COUNT> m_streamBufferMemories{};
+    VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_indexBufferMemory = VK_NULL_HANDLE;
+
+    RangeAllocator m_vertices;      // shared by the streams
+    RangeAllocator m_indices;
+
+    // kept alive until vkUpdateDescriptorSets() is called with the writes
+    std::array<VkDescriptorBufferInfo, STREAM_COUNT> m_streamInfos{};
+
+}; // class GeometryPool
+
+} // namespace VulkanDemo
+
+#endif // GEOMETRYPOOL_H
\ No newline at end of file
@@ -0,0 +1,189 @@
+/*********************************************************************************************************************
+ *
+ * gputimer.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "gputimer.h"
+#include "context.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Creates the query pool, if the graphics queue supports timestamps
+ */
+void GpuTimer::create(Context& _context, uint32_t _framesInFlight)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_context.getPhysicalDevice(), &properties);
+
+    QueueFamilyIndices indices = findQueueFamilies(_context.getPhysicalDevice(), _context.getSurface());
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(_context.getPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(_context.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+    m_supported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+    if (!m_supported) 
+    {
+        infoLog() << "GpuTimer::create(): timestamps not supported ";
+        return;
+    }
+
+    m_timestampPeriod = static_cast<double>(properties.limits.timestampPeriod);
+    m_timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+    m_recorded.assign(_framesInFlight, false);
+    m_recordedPasses.assign(_framesInFlight, 0);
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = QUERIES_PER_FRAME * _framesInFlight;
+
+    if (vkCreateQueryPool(_context.getDevice(), &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+}
+
+
+/*
+ * Destroys the query pool
+ */
+void GpuTimer::cleanup(Context& _context)
+{
+    vkDestroyQueryPool(_context.getDevice(), m_queryPool, nullptr);
+    m_queryPool = VK_NULL_HANDLE;
+}
+
+
+/*
+ * Resets the queries of the frame and writes the first timestamp (must be outside of a render pass)
+ * The timestamp is written at the stage the submission waits for the acquired image: at TOP_OF_PIPE, it would
+ * include the wait for the swap chain (vsync with FIFO) in the frame time
+ */
+void GpuTimer::recordBegin(VkCommandBuffer _commandBuffer, uint32_t _frameIndex)
+{
+    if (!m_supported) {
+        return;
+    }
+
+    vkCmdResetQueryPool(_commandBuffer, m_queryPool, QUERIES_PER_FRAME * _frameIndex, QUERIES_PER_FRAME);
+    vkCmdWriteTimestamp(_commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, m_queryPool, QUERIES_PER_FRAME * _frameIndex);
+    m_recordingFrame = _frameIndex;
+    m_recordedPasses[_frameIndex] = 0;
+}
+
+
+/*
+ * Writes the second timestamp, once all previous commands are complete
+ */
+void GpuTimer::recordEnd(VkCommandBuffer _commandBuffer, uint32_t _frameIndex)
+{
+    if (!m_supported) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, QUERIES_PER_FRAME * _frameIndex + 1);
+    m_recorded[_frameIndex] = true;
+}
+
+
+/*
+ * Timestamp before the barriers and commands of a pass (passes beyond MAX_PASSES are not measured)
+ */
+void GpuTimer::recordPassBegin(VkCommandBuffer _commandBuffer, uint32_t _passIndex)
+{
+    if (!m_supported || _passIndex >= MAX_PASSES) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, QUERIES_PER_FRAME * m_recordingFrame + 2 + 2 * _passIndex);
+}
+
+
+/*
+ * Timestamp once the commands of a pass are complete
+ */
+void GpuTimer::recordPassEnd(VkCommandBuffer _commandBuffer, uint32_t _passIndex)
+{
+    if (!m_supported || _passIndex >= MAX_PASSES) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, QUERIES_PER_FRAME * m_recordingFrame + 3 + 2 * _passIndex);
+    m_recordedPasses[m_recordingFrame] |= (1u << _passIndex);
+}
+
+
+/*
+ * Reads the GPU time of the last submission of a frame slot, returns false if not available
+ */
+bool GpuTimer::getFrameTime(Context& _context, uint32_t _frameIndex, double& _milliseconds)
+{
+    if (!m_supported || !m_recorded[_frameIndex]) {
+        return false;
+    }
+    if (!readInterval(_context, QUERIES_PER_FRAME * _frameIndex, _milliseconds)) {
+        return false;
+    }
+    m_recorded[_frameIndex] = false; // each submission is read once
+    return true;
+}
+
+
+/*
+ * Reads the GPU time of a pass in the last submission of a frame slot, returns false if not available
+ */
+bool GpuTimer::getPassTime(Context& _context, uint32_t _frameIndex, uint32_t _passIndex, double& _milliseconds)
+{
+    if (!m_supported || _passIndex >= MAX_PASSES || (m_recordedPasses[_frameIndex] & (1u << _passIndex)) == 0) {
+        return false;
+    }
+    if (!readInterval(_context, QUERIES_PER_FRAME * _frameIndex + 2 + 2 * _passIndex, _milliseconds)) {
+        return false;
+    }
+    m_recordedPasses[_frameIndex] &= ~(1u << _passIndex);
+    return true;
+}
+
+
+/*
+ * Time between two consecutive timestamps of the pool
+ */
+bool GpuTimer::readInterval(Context& _context, uint32_t _firstQuery, double& _milliseconds)
+{
+    std::array<uint64_t, 2> timestamps = { 0, 0 };
+    VkResult result = vkGetQueryPoolResults(_context.getDevice(), m_queryPool, _firstQuery, 2,
+                                            sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    uint64_t ticks = ((timestamps[1] & m_timestampMask) - (timestamps[0] & m_timestampMask)) & m_timestampMask;
+    _milliseconds = static_cast<double>(ticks) * m_timestampPeriod * 1e-6;
+    return true;
+}
+
+
+/*
+ * Discards pending results (e.g., after the queries of a frame were dropped)
+ */
+void GpuTimer::invalidate()
+{
+    std::fill(m_recorded.begin(), m_recorded.end(), false);
+    std::fill(m_recordedPasses.begin(), m_recordedPasses.end(), 0);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,79 @@
+/*********************************************************************************************************************
+ *
+ * gputimer.h
+ *
+ * Measures the GPU time of each frame with timestamp queries (two per frame in flight),
+ * and of each pass of the frame (two more per pass, written by the render graph)
+ * Results are read back without stalling, once the timeline value of the frame is reached
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+
+#include "utils.h"
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class GpuTimer
+{
+
+public:
+
+    static constexpr uint32_t MAX_PASSES = 8;   // passes measured per frame, at most
+
+    GpuTimer() = default;
+
+    GpuTimer(GpuTimer const& _other) = default;
+    GpuTimer& operator=(GpuTimer const& _other) = default;
+
+    virtual ~GpuTimer() {};
+
+
+    bool const isSupported() const { return m_supported; }
+
+    void create(Context& _context, uint32_t _framesInFlight);
+    void cleanup(Context& _context);
+
+    // used in recordCommandBuffer(), at the beginning and at the end of the frame
+    void recordBegin(VkCommandBuffer _commandBuffer, uint32_t _frameIndex);
+    void recordEnd(VkCommandBuffer _commandBuffer, uint32_t _frameIndex);
+
+    // used by the render graph around each pass of the frame being recorded
+    void recordPassBegin(VkCommandBuffer _commandBuffer, uint32_t _passIndex);
+    void recordPassEnd(VkCommandBuffer _commandBuffer, uint32_t _passIndex);
+
+    // used in drawFrame(), once the timeline value of the frame is reached
+    bool getFrameTime(Context& _context, uint32_t _frameIndex, double& _milliseconds);
+    bool getPassTime(Context& _context, uint32_t _frameIndex, uint32_t _passIndex, double& _milliseconds);
+
+    void invalidate();
+
+
+protected:
+
+    static constexpr uint32_t QUERIES_PER_FRAME = 2 + 2 * MAX_PASSES;
+
+    bool readInterval(Context& _context, uint32_t _firstQuery, double& _milliseconds);
+
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    bool m_supported = false;
+    double m_timestampPeriod = 1.0;     // nb of nanoseconds per timestamp tick
+    uint64_t m_timestampMask = ~0ull;   // valid bits of the timestamps
+    std::vector<bool> m_recorded;       // frames whose queries have been written
+    std::vector<uint32_t> m_recordedPasses;     // per frame, bit mask of the passes whose queries have been written
+    uint32_t m_recordingFrame = 0;      // frame given to the last recordBegin()
+
+}; // class GpuTimer
+
+} // namespace VulkanDemo
+
+#endif // GPUTIMER_H
\ No newline at end of file
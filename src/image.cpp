@@ -19,6 +19,7 @@
 
 #include "image.h"
 #include "context.h"
+#include "core/imageprocessing.h"
 
 
 
@@ -31,11 +32,39 @@ namespace VulkanDemo
  */
 void Image::cleanup(Context& _context)
 {
-    if(m_sampler != nullptr)
-        vkDestroySampler(_context.getDevice(), m_sampler, nullptr);
+    // m_sampler is owned by the context's sampler cache
+    m_sampler = nullptr;
     vkDestroyImageView(_context.getDevice(), m_imageView, nullptr);
     vkDestroyImage(_context.getDevice(), m_image, nullptr);
-    vkFreeMemory(_context.getDevice(), m_imageMemory, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_imageMemory);
+    // null handles are ignored, so cleanup of an image that was never created is a no-op
+    m_imageView = VK_NULL_HANDLE;
+    m_image = VK_NULL_HANDLE;
+    m_imageMemory = VK_NULL_HANDLE;
+}
+
+
+/*
+ * Hands the image over to the deletion queue of the context, for images that may still be used by frames in flight
+ */
+void Image::retire(Context& _context)
+{
+    VkImageView imageView = m_imageView;
+    VkImage image = m_image;
+    VkDeviceMemory imageMemory = m_imageMemory;
+    MemoryBudget* memoryBudget = &_context.getMemoryBudget();
+
+    _context.getDeletionQueue().retire([imageView, image, imageMemory, memoryBudget](VkDevice _device)
+    {
+        vkDestroyImageView(_device, imageView, nullptr);
+        vkDestroyImage(_device, image, nullptr);
+        memoryBudget->free(_device, imageMemory);
+    });
+
+    m_sampler = nullptr;
+    m_imageView = VK_NULL_HANDLE;
+    m_image = VK_NULL_HANDLE;
+    m_imageMemory = VK_NULL_HANDLE;
 }
 
 
@@ -45,8 +74,12 @@ void Image::cleanup(Context& _context)
 void Image::createImage(Context& _context,
                         uint32_t _width, uint32_t _height,
                         VkSampleCountFlagBits _numSamples, VkFormat _format,
-                        VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties)
+                        VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties,
+                        MemoryCategory _category)
 {
+    m_width = _width;
+    m_height = _height;
+
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -70,14 +103,7 @@ void Image::createImage(Context& _context,
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(_context.getDevice(), m_image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(_context.getPhysicalDevice(), memRequirements.memoryTypeBits, _properties);
-
-    if (vkAllocateMemory(_context.getDevice(), &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
+    m_imageMemory = _context.getMemoryBudget().allocate(_context.getDevice(), memRequirements, _properties, _category);
 
     vkBindImageMemory(_context.getDevice(), m_image, m_imageMemory, 0);
 }
@@ -108,6 +134,7 @@ void Image::createImageView(Context& _context, VkFormat _format, VkImageAspectFl
 
 /*
  * Set up such a sampler object
+ * (fetched from the context's sampler cache, so textures with identical parameters share the same sampler)
  */
 void Image::createTextureSampler(Context& _context)
 {
@@ -129,12 +156,10 @@ void Image::createTextureSampler(Context& _context)
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.minLod = 0.0f; // Optional
-    samplerInfo.maxLod = static_cast<float>(m_mipLevels);
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // mip range is already limited by the image view
     samplerInfo.mipLodBias = 0.0f; // Optional
 
-    if (vkCreateSampler(_context.getDevice(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create texture sampler!");
-    }
+    m_sampler = _context.getSamplerCache().getSampler(_context.getDevice(), samplerInfo);
 }
 
 
@@ -146,29 +171,57 @@ void Image::createTextureImage(Context& _context)
     // load image
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-    m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
     if (!pixels) {
         throw std::runtime_error("failed to load texture image!");
     }
 
+    uploadTexturePixels(_context, pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    stbi_image_free(pixels);
+}
+
+
+/*
+ * Decodes an image file held in memory (png, jpeg ...) and uploads it into a Vulkan image object
+ */
+void Image::createTextureImage(Context& _context, const uint8_t* _encoded, size_t _size)
+{
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(_encoded, static_cast<int>(_size), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+    if (!pixels) {
+        throw std::runtime_error("failed to decode texture image!");
+    }
+
+    uploadTexturePixels(_context, pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    stbi_image_free(pixels);
+}
+
+
+/*
+ * Uploads RGBA pixels into a new texture, and generates its mip levels
+ */
+void Image::uploadTexturePixels(Context& _context, const uint8_t* _pixels, uint32_t _width, uint32_t _height)
+{
+    int32_t texWidth = static_cast<int32_t>(_width);
+    int32_t texHeight = static_cast<int32_t>(_height);
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(_width) * _height * 4;
+
+    m_mipLevels = computeMipCount(_width, _height);
+
     // create a buffer in host visible memory so that we can use vkMapMemory and copy the pixels to it
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
 
-    createBuffer(_context.getPhysicalDevice(), _context.getDevice(), imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging,
+                                            stagingBuffer, stagingBufferMemory);
 
     void* data;
     vkMapMemory(_context.getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
+    memcpy(data, _pixels, static_cast<size_t>(imageSize));
     vkUnmapMemory(_context.getDevice(), stagingBufferMemory);
 
-    stbi_image_free(pixels);
-
 
     // create a texture
     createImage(_context,
@@ -188,7 +241,7 @@ void Image::createTextureImage(Context& _context)
 
 
     vkDestroyBuffer( _context.getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory( _context.getDevice(), stagingBufferMemory, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), stagingBufferMemory);
 
     generateMipmaps( _context, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight);
 }
@@ -203,6 +256,107 @@ void Image::createTextureImageView(Context& _context)
 }
 
 
+/*
+ * Replaces the texture by a smaller image holding its lower mip levels, copied on the GPU
+ * The copy is waited for: the frames submitted before it are complete as well, so the descriptors of the texture
+ * can be updated. The previous image is retired (freed once the frames in flight no longer use it)
+ */
+bool Image::dropTopMips(Context& _context, uint32_t _count, uint32_t _minSize)
+{
+    // 1. -----------------------------------------------------------------------------------------
+    // nb of levels dropped: the largest side of the new base level stays above the minimum size
+    uint32_t dropped = 0;
+    uint32_t width = m_width;
+    uint32_t height = m_height;
+    while (dropped < _count && dropped + 1 < m_mipLevels && std::max(width, height) / 2 >= _minSize)
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        dropped++;
+    }
+    if (dropped == 0) {
+        return false;
+    }
+
+    Image smaller;
+    smaller.m_mipLevels = m_mipLevels - dropped;
+    smaller.createImage(_context,
+        width, height, VK_SAMPLE_COUNT_1_BIT,
+        VK_FORMAT_R8G8B8A8_SRGB,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // 2. -----------------------------------------------------------------------------------------
+    // remaining levels copied one by one
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(_context.getDevice(), _context.getCommandPool());
+
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    for (auto& barrier : barriers)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = smaller.m_mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+    barriers[0].image = m_image;
+    barriers[0].subresourceRange.baseMipLevel = dropped;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].image = smaller.m_image;
+    barriers[1].subresourceRange.baseMipLevel = 0;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    std::vector<VkImageCopy> regions(smaller.m_mipLevels);
+    for (uint32_t i = 0; i < smaller.m_mipLevels; i++)
+    {
+        regions[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, dropped + i, 0, 1 };
+        regions[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+        regions[i].extent = { std::max(width >> i, 1u), std::max(height >> i, 1u), 1 };
+    }
+    vkCmdCopyImage(commandBuffer,
+        m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        smaller.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barriers[1]);
+
+    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsTimeline());
+
+    // 3. -----------------------------------------------------------------------------------------
+    // the smaller image takes the place of the texture (the sampler is kept: the mip range is limited by the view)
+    VkSampler sampler = m_sampler;
+    retire(_context);
+    *this = smaller;
+    m_sampler = sampler;
+    createTextureImageView(_context);
+    return true;
+}
+
+
 /*
  * Handles layout transitions
  */
@@ -276,7 +430,7 @@ void Image::transitionImageLayout(Context& _context,
         1, &barrier
     );
 
-    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsQueue());
+    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsTimeline());
 }
 
 
@@ -314,7 +468,7 @@ void Image::copyBufferToImage(Context& _context,
         &region
     );
 
-    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsQueue());
+    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsTimeline());
 }
 
 
@@ -409,7 +563,7 @@ void Image::generateMipmaps(Context& _context,
         0, nullptr,
         1, &barrier);
 
-    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsQueue());
+    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsTimeline());
 }
 
 
@@ -18,6 +18,7 @@
 
 
 #include "utils.h"
+#include "memorybudget.h"
 
 namespace VulkanDemo
 {
@@ -40,6 +41,8 @@ public:
         m_imageMemory = _other.m_imageMemory;
         m_imageView = _other.m_imageView;
         m_mipLevels = _other.m_mipLevels;
+        m_width = _other.m_width;
+        m_height = _other.m_height;
         m_sampler = _other.m_sampler;
         return *this;
     }
@@ -49,6 +52,8 @@ public:
         , m_imageMemory(_other.m_imageMemory)
         , m_imageView(_other.m_imageView)
         , m_mipLevels(_other.m_mipLevels)
+        , m_width(_other.m_width)
+        , m_height(_other.m_height)
         , m_sampler(_other.m_sampler)
     {}
 
@@ -58,6 +63,8 @@ public:
         m_imageMemory = _other.m_imageMemory;
         m_imageView = _other.m_imageView;
         m_mipLevels = _other.m_mipLevels;
+        m_width = _other.m_width;
+        m_height = _other.m_height;
         m_sampler = _other.m_sampler;
         return *this;
     }
@@ -69,21 +76,29 @@ public:
     VkDeviceMemory const getImageMemory() const { return m_imageMemory; }
     VkImageView getImageView() { return m_imageView; }
     uint32_t const getMiplevels() const { return m_mipLevels; }
+    uint32_t const getWidth() const { return m_width; }
+    uint32_t const getHeight() const { return m_height; }
     VkSampler const getSampler() const { return m_sampler; }
 
     void cleanup(Context& _context);
+    void retire(Context& _context);
 
     void createImageView(Context& _context, VkFormat _format, VkImageAspectFlags _aspectFlags);
 
     void createTextureSampler(Context& _context);
     void createTextureImage(Context& _context);
+    // from the content of an image file (e.g. embedded in a glTF model)
+    void createTextureImage(Context& _context, const uint8_t* _encoded, size_t _size);
     void createTextureImageView(Context& _context);
+    // frees the largest mip levels of the texture (returns false if it is already at its minimum size)
+    bool dropTopMips(Context& _context, uint32_t _count, uint32_t _minSize);
 
     // called in createTextureImage()
     void createImage(Context& _context,
                      uint32_t _width, uint32_t _height,
                      VkSampleCountFlagBits _numSamples, VkFormat _format,
-                     VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties);
+                     VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties,
+                     MemoryCategory _category = MemoryCategory::Texture);
     void transitionImageLayout(Context& _context,
                                VkFormat _format, VkImageLayout _oldLayout, VkImageLayout _newLayout);
     void copyBufferToImage(Context& _context,
@@ -94,10 +109,15 @@ public:
 
 protected:
 
-    VkImage m_image;
-    VkDeviceMemory m_imageMemory;
-    VkImageView m_imageView;
+    // called in createTextureImage()
+    void uploadTexturePixels(Context& _context, const uint8_t* _pixels, uint32_t _width, uint32_t _height);
+
+    VkImage m_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_imageMemory = VK_NULL_HANDLE;
+    VkImageView m_imageView = VK_NULL_HANDLE;
     uint32_t m_mipLevels = 1; // modified in createTextureImage() to match texture, stays 1 otherwise
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
     VkSampler m_sampler = nullptr;
 
 }; // class Image
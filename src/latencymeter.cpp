@@ -0,0 +1,112 @@
+/*********************************************************************************************************************
+ *
+ * latencymeter.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "latencymeter.h"
+#include "context.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Loads vkWaitForPresentKHR, if present wait is enabled on the device
+ */
+void LatencyMeter::create(Context& _context)
+{
+    m_vkWaitForPresentKHR = nullptr;
+    if (_context.getCapabilities().presentWait) {
+        m_vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(_context.getDevice(), "vkWaitForPresentKHR"));
+    }
+
+    infoLog() << std::string("LatencyMeter::create(): present wait ") + (isPresentWaitSupported() ? "supported" : "not supported");
+}
+
+
+/*
+ * Timestamps an input event (only the first one since the last present is kept)
+ */
+void LatencyMeter::markInput()
+{
+    if (!m_inputTime.has_value()) {
+        m_inputTime = Clock::now();
+    }
+}
+
+
+/*
+ * Measures input to present call, and starts waiting for the frame to be displayed
+ */
+uint64_t LatencyMeter::onPresent()
+{
+    uint64_t presentId = isPresentWaitSupported() ? ++m_presentId : 0;
+
+    if (m_inputTime.has_value())
+    {
+        m_presentCallAccum += std::chrono::duration<double, std::milli>(Clock::now() - m_inputTime.value()).count();
+        m_presentCallCount++;
+
+        if (presentId != 0 && m_pending.size() < MAX_PENDING) {
+            m_pending.push_back({ presentId, m_inputTime.value() });
+        }
+        m_inputTime.reset();
+    }
+
+    return presentId;
+}
+
+
+/*
+ * Checks (without blocking) which frames with an input were displayed, and logs averaged latencies
+ */
+void LatencyMeter::update(Context& _context, VkSwapchainKHR _swapChain)
+{
+    if (!isPresentWaitSupported()) {
+        return;
+    }
+
+    while (!m_pending.empty())
+    {
+        VkResult result = m_vkWaitForPresentKHR(_context.getDevice(), _swapChain, m_pending.front().presentId, 0);
+        if (result != VK_SUCCESS) {
+            break; // VK_TIMEOUT: not displayed yet
+        }
+
+        m_displayAccum += std::chrono::duration<double, std::milli>(Clock::now() - m_pending.front().inputTime).count();
+        m_displayCount++;
+        m_pending.pop_front();
+    }
+
+    if (m_presentCallCount >= STATS_SAMPLES)
+    {
+        std::string log = "latency: input to present call " + std::to_string(m_presentCallAccum / m_presentCallCount) + " ms";
+        if (m_displayCount > 0) {
+            log += ", input to display " + std::to_string(m_displayAccum / m_displayCount) + " ms";
+        }
+        infoLog() << log;
+
+        m_presentCallAccum = 0.0;
+        m_presentCallCount = 0;
+        m_displayAccum = 0.0;
+        m_displayCount = 0;
+    }
+}
+
+
+/*
+ * Drops pending presents (e.g., when the swap chain is recreated)
+ */
+void LatencyMeter::reset()
+{
+    m_pending.clear();
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*********************************************************************************************************************
+ *
+ * latencymeter.h
+ *
+ * Measures the latency between an input event (received in glfwPollEvents) and the presentation of the first frame
+ * that took it into account:
+ *  - input to vkQueuePresentKHR call, always available
+ *  - input to image actually presented, with VK_KHR_present_id and VK_KHR_present_wait (polled once per frame,
+ *    so the resolution is one frame)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef LATENCYMETER_H
+#define LATENCYMETER_H
+
+
+#include "utils.h"
+
+#include <chrono>
+#include <deque>
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class LatencyMeter
+{
+
+public:
+
+    static constexpr uint32_t STATS_SAMPLES = 30;   // nb of measures averaged in each log
+    static constexpr size_t MAX_PENDING = 16;       // nb of presents waited on, at most
+
+    LatencyMeter() = default;
+
+    LatencyMeter(LatencyMeter const& _other) = default;
+    LatencyMeter& operator=(LatencyMeter const& _other) = default;
+
+    virtual ~LatencyMeter() {};
+
+
+    bool const isPresentWaitSupported() const { return m_vkWaitForPresentKHR != nullptr; }
+
+    void create(Context& _context);
+
+    void markInput();
+
+    // used in drawFrame(): before vkQueuePresentKHR (returns the present id to chain, 0 if unsupported), then once per frame
+    uint64_t onPresent();
+    void update(Context& _context, VkSwapchainKHR _swapChain);
+
+    // present ids are only valid for the swap chain they were given to
+    void reset();
+
+
+protected:
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct PendingPresent
+    {
+        uint64_t presentId;
+        Clock::time_point inputTime;
+    };
+
+    PFN_vkWaitForPresentKHR m_vkWaitForPresentKHR = nullptr;
+
+    std::optional<Clock::time_point> m_inputTime;   // first input not yet presented
+    std::deque<PendingPresent> m_pending;           // presents of frames with an input, not yet displayed
+    uint64_t m_presentId = 0;
+
+    double m_presentCallAccum = 0.0;
+    uint32_t m_presentCallCount = 0;
+    double m_displayAccum = 0.0;
+    uint32_t m_displayCount = 0;
+
+}; // class LatencyMeter
+
+} // namespace VulkanDemo
+
+#endif // LATENCYMETER_H
\ No newline at end of file
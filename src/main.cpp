@@ -4,6 +4,11 @@
  *
  * Based on: https://vulkan-tutorial.com/
  *
+ * Usage: Vulkan_demo [--present-mode immediate|mailbox|fifo|fifo_relaxed] [--frames-in-flight N] [--render-pass]
+ *                    [--model path]
+ * (--render-pass: use VkRenderPass/VkFramebuffer objects even if dynamic rendering is supported)
+ * (--model: Wavefront .obj or glTF 2.0 .glb/.gltf file drawn instead of MODEL_PATH)
+ *
  * Vulkan_demo
  * Ludovic Blache
  *
@@ -12,20 +17,54 @@
 
 
 #include <stdexcept>
+#include <cstring>
 
 #include "demoapp.h"
 
 
-int main() 
+/*
+ * Parses a present mode name given on the command line
+ */
+VkPresentModeKHR parsePresentMode(const char* _name)
+{
+    if (std::strcmp(_name, "immediate") == 0)       return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (std::strcmp(_name, "mailbox") == 0)         return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (std::strcmp(_name, "fifo") == 0)            return VK_PRESENT_MODE_FIFO_KHR;
+    if (std::strcmp(_name, "fifo_relaxed") == 0)    return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+
+    throw std::invalid_argument(std::string("unknown present mode: ") + _name);
+}
+
+
+int main(int argc, char** argv)
 {
 
     VulkanDemo::DemoApp app;
 
-    try 
+    try
     {
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+                app.setPresentMode(parsePresentMode(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+                app.setFramesInFlight(static_cast<uint32_t>(std::stoul(argv[++i])));
+            }
+            else if (std::strcmp(argv[i], "--render-pass") == 0) {
+                app.setDynamicRendering(false);
+            }
+            else if (std::strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+                app.setModelPath(argv[++i]);
+            }
+            else {
+                throw std::invalid_argument(std::string("unknown argument: ") + argv[i]);
+            }
+        }
+
         app.run();
     }
-    catch (const std::exception& e) 
+    catch (const std::exception& e)
     {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
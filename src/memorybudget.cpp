@@ -0,0 +1,209 @@
+/*********************************************************************************************************************
+ *
+ * memorybudget.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "memorybudget.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+const char* MemoryBudget::getCategoryName(MemoryCategory _category)
+{
+    switch (_category)
+    {
+        case MemoryCategory::Mesh: return "mesh";
+        case MemoryCategory::Texture: return "texture";
+        case MemoryCategory::Attachment: return "attachment";
+        case MemoryCategory::Staging: return "staging";
+        case MemoryCategory::Uniform: return "uniform";
+        default: return "unknown";
+    }
+}
+
+
+/*
+ * Reads the heaps of the device (VK_EXT_memory_budget must be enabled on the device to use it)
+ */
+void MemoryBudget::init(VkPhysicalDevice _physicalDevice, bool _useExtension)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_physicalDevice = _physicalDevice;
+    m_useExtension = _useExtension;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+
+    m_stats.heaps.resize(m_memoryProperties.memoryHeapCount);
+    for (uint32_t h = 0; h < m_memoryProperties.memoryHeapCount; h++)
+    {
+        auto& heap = m_stats.heaps[h];
+        heap.size = m_memoryProperties.memoryHeaps[h].size;
+        heap.budget = static_cast<VkDeviceSize>(DEFAULT_BUDGET_RATIO * static_cast<double>(heap.size));
+        heap.deviceLocal = (m_memoryProperties.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+}
+
+
+/*
+ * Queries the budget and usage of each heap (without the extension, only our allocations are known)
+ */
+void MemoryBudget::update()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_useExtension)
+    {
+        for (auto& heap : m_stats.heaps) {
+            heap.usage = heap.allocated;
+        }
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties2);
+
+    for (uint32_t h = 0; h < static_cast<uint32_t>(m_stats.heaps.size()); h++)
+    {
+        m_stats.heaps[h].budget = budgetProperties.heapBudget[h];
+        m_stats.heaps[h].usage = budgetProperties.heapUsage[h];
+    }
+}
+
+
+MemoryBudget::Stats MemoryBudget::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+
+double MemoryBudget::getDeviceLocalUsageRatio()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double ratio = 0.0;
+    for (const auto& heap : m_stats.heaps)
+    {
+        if (heap.deviceLocal && heap.budget > 0) {
+            ratio = std::max(ratio, static_cast<double>(heap.usage) / static_cast<double>(heap.budget));
+        }
+    }
+    return ratio;
+}
+
+
+VkDeviceSize MemoryBudget::getDeviceLocalHeadroom()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double ratio = -1.0;
+    VkDeviceSize headroom = 0;
+    for (const auto& heap : m_stats.heaps)
+    {
+        if (!heap.deviceLocal || heap.budget == 0) {
+            continue;
+        }
+        double heapRatio = static_cast<double>(heap.usage) / static_cast<double>(heap.budget);
+        if (heapRatio > ratio)
+        {
+            ratio = heapRatio;
+            headroom = (heap.usage < heap.budget) ? heap.budget - heap.usage : 0;
+        }
+    }
+    return headroom;
+}
+
+
+/*
+ * Allocates and accounts memory for a resource
+ * (an allocation exceeding the budget is attempted anyway, the driver may page memory out)
+ */
+VkDeviceMemory MemoryBudget::allocate(VkDevice _device, VkMemoryRequirements const& _requirements, VkMemoryPropertyFlags _properties, MemoryCategory _category)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = _requirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(m_physicalDevice, _requirements.memoryTypeBits, _properties);
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& heap = m_stats.heaps[heapIndex];
+    if (heap.usage + _requirements.size > heap.budget)
+    {
+        infoLog() << std::string("MemoryBudget: ") + getCategoryName(_category) + " allocation of " + std::to_string(_requirements.size >> 10)
+                   + " KB exceeds the budget of heap " + std::to_string(heapIndex) + " ";
+    }
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error(std::string("failed to allocate ") + getCategoryName(_category) + " memory!");
+    }
+
+    m_allocations[memory] = { _requirements.size, heapIndex, _category };
+    heap.allocated += _requirements.size;
+    heap.usage += _requirements.size;
+    m_stats.categoryBytes[static_cast<uint32_t>(_category)] += _requirements.size;
+    m_stats.categoryAllocations[static_cast<uint32_t>(_category)]++;
+    return memory;
+}
+
+
+/*
+ * Frees memory allocated by allocate() (or directly: then it is only freed)
+ */
+void MemoryBudget::free(VkDevice _device, VkDeviceMemory _memory)
+{
+    if (_memory == VK_NULL_HANDLE) {
+        return;
+    }
+    vkFreeMemory(_device, _memory, nullptr);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_allocations.find(_memory);
+    if (it == m_allocations.end()) {
+        return;
+    }
+
+    const Allocation& allocation = it->second;
+    auto& heap = m_stats.heaps[allocation.heapIndex];
+    heap.allocated -= allocation.size;
+    heap.usage -= std::min(heap.usage, allocation.size);
+    m_stats.categoryBytes[static_cast<uint32_t>(allocation.category)] -= allocation.size;
+    m_stats.categoryAllocations[static_cast<uint32_t>(allocation.category)]--;
+    m_allocations.erase(it);
+}
+
+
+void MemoryBudget::createBuffer(VkDevice _device, VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _properties, MemoryCategory _category,
+                                VkBuffer& _buffer, VkDeviceMemory& _bufferMemory)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = _size;
+    bufferInfo.usage = _usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(_device, &bufferInfo, nullptr, &_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(_device, _buffer, &memRequirements);
+
+    _bufferMemory = allocate(_device, memRequirements, _properties, _category);
+
+    vkBindBufferMemory(_device, _buffer, _bufferMemory, 0);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
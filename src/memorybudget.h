@@ -0,0 +1,122 @@
+/*********************************************************************************************************************
+ *
+ * memorybudget.h
+ *
+ * Accounting of the device memory allocations, by category, against the budget of each memory heap:
+ *  - with VK_EXT_memory_budget, budget and usage (whole process, other applications taken into account) are
+ *    queried from the driver once per frame, and the allocations made since are added to the usage
+ *  - without it, the budget is a fraction of the heap size, and the usage is the sum of our allocations
+ * The application checks isUsageHigh() every frame, and frees memory (drops texture mips) before the budget
+ * is exceeded
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+
+#include "utils.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace VulkanDemo
+{
+
+
+enum class MemoryCategory : uint32_t
+{
+    Mesh,           // vertex and index buffers
+    Texture,        // sampled images (textures, virtual texture atlas)
+    Attachment,     // render targets and depth pyramid
+    Staging,        // host visible upload and readback buffers
+    Uniform,        // uniform and storage buffers updated per frame
+    Count
+};
+
+
+class MemoryBudget
+{
+
+public:
+
+    static constexpr uint32_t CATEGORY_COUNT = static_cast<uint32_t>(MemoryCategory::Count);
+    // without VK_EXT_memory_budget: fraction of the heap size available to the application
+    static constexpr double DEFAULT_BUDGET_RATIO = 0.8;
+    // fraction of the budget of a device local heap above which memory should be freed
+    static constexpr double HIGH_USAGE_RATIO = 0.9;
+
+    struct HeapStats
+    {
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;        // memory the process can use without degrading performance
+        VkDeviceSize usage = 0;         // memory used by the process (estimated between two updates)
+        VkDeviceSize allocated = 0;     // memory allocated through this class
+        bool deviceLocal = false;
+    };
+
+    struct Stats
+    {
+        std::vector<HeapStats> heaps;
+        std::array<VkDeviceSize, CATEGORY_COUNT> categoryBytes{};
+        std::array<uint32_t, CATEGORY_COUNT> categoryAllocations{};
+    };
+
+    MemoryBudget() = default;
+
+    // keeps track of the live allocations, it cannot be duplicated
+    MemoryBudget(MemoryBudget const& _other) = delete;
+    MemoryBudget& operator=(MemoryBudget const& _other) = delete;
+
+    virtual ~MemoryBudget() {};
+
+
+    bool const isExtensionEnabled() const { return m_useExtension; }
+    // heaps and categories, as of the last update() plus the allocations made since
+    Stats getStats();
+    static const char* getCategoryName(MemoryCategory _category);
+
+    void init(VkPhysicalDevice _physicalDevice, bool _useExtension);
+    // used once per frame
+    void update();
+
+    // usage of the most used device local heap, relative to its budget
+    double getDeviceLocalUsageRatio();
+    bool isUsageHigh() { return getDeviceLocalUsageRatio() > HIGH_USAGE_RATIO; }
+    // memory left before the budget of the most used device local heap is reached
+    VkDeviceSize getDeviceLocalHeadroom();
+
+    // memory of a resource, accounted to a category
+    VkDeviceMemory allocate(VkDevice _device, VkMemoryRequirements const& _requirements, VkMemoryPropertyFlags _properties, MemoryCategory _category);
+    void free(VkDevice _device, VkDeviceMemory _memory);
+    // createBuffer() of utils.h, with the memory accounted to a category
+    void createBuffer(VkDevice _device, VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _properties, MemoryCategory _category,
+                      VkBuffer& _buffer, VkDeviceMemory& _bufferMemory);
+
+
+protected:
+
+    struct Allocation
+    {
+        VkDeviceSize size;
+        uint32_t heapIndex;
+        MemoryCategory category;
+    };
+
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+    bool m_useExtension = false;
+
+    // allocations are freed by the deletion queue as well
+    std::mutex m_mutex;
+    std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+    Stats m_stats;
+
+}; // class MemoryBudget
+
+} // namespace VulkanDemo
+
+#endif // MEMORYBUDGET_H
\ No newline at end of file
@@ -9,30 +9,15 @@
  *
  *********************************************************************************************************************/
 
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #include "mesh.h"
 #include "context.h"
+#include "core/meshcodec.h"
 
 
 namespace VulkanDemo
 {
 
 
-/*
- * Destroyes buffers and frees memory 
- */
-void Mesh::cleanup(Context& _context)
-{
-    vkDestroyBuffer(_context.getDevice(), m_indexBuffer, nullptr);
-    vkFreeMemory(_context.getDevice(),m_indexBufferMemory, nullptr);
-
-    vkDestroyBuffer(_context.getDevice(),m_vertexBuffer, nullptr);
-    vkFreeMemory(_context.getDevice(), m_vertexBufferMemory, nullptr);
-}
-
 /*
  * Creates 2 colored quads
  */
@@ -63,125 +48,77 @@ void Mesh::createQuads()
         0, 1, 2, 2, 3, 0,
         4, 5, 6, 6, 7, 4
     };
+    m_bounds = VulkanDemo::computeBounds(m_vertices);
 }
 
 
 /*
  * Loads wavefront model
  */
-void Mesh::loadModel()
+void Mesh::loadModel(const std::string& _path)
 {
-    m_vertices.clear();
-    m_indices.clear();
+    MeshData mesh = weldVertices(parseObj(_path));
+    m_vertices = std::move(mesh.vertices);
+    m_indices = std::move(mesh.indices);
+    m_bounds = VulkanDemo::computeBounds(m_vertices);
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    infoLog() << "number of unique vertices: " + std::to_string(m_vertices.size());
+}
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-        throw std::runtime_error(warn + err);
-    }
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+/*
+ * Encodes the vertices and indices into a compressed mesh file
+ */
+void Mesh::saveCompressed(const std::string& _path) const
+{
+    MeshData mesh;
+    mesh.vertices = m_vertices;
+    mesh.indices = m_indices;
+    CompressedMeshFile::write(_path, mesh);
 
-    for (const auto& shape : shapes) 
-    {
-        for (const auto& index : shape.mesh.indices) 
-        {
-            Vertex vertex{};
-
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.color = { 1.0f, 1.0f, 1.0f };
-
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            vertex.normal = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]
-            };
-
-            if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(m_vertices.size());
-                m_vertices.push_back(vertex);
-            }
-            
-            m_indices.push_back(uniqueVertices[vertex]);
-        }
-    }
-    infoLog() << "number of unique vertices: " + std::to_string(uniqueVertices.size());
+    infoLog() << "compressed mesh saved: " + _path;
 }
 
 
 /*
- * Creation of vertex buffer
+ * Copies the vertices and indices to the geometry pool
  */
-void Mesh::createVertexBuffer(Context& _context)
+void Mesh::upload(Context& _context, GeometryPool& _geometryPool)
 {
-    VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-
-    // Init temporary CPU buffer (stagingBuffer) with associated memory storage (stagingBufferMemory)
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer( _context.getPhysicalDevice(), _context.getDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-
-    // map memory buffer (data) with stagingBufferMemory
-    void* data;
-    vkMapMemory(_context.getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    // fill-in data  with m_vertices content
-    memcpy(data, m_vertices.data(), (size_t)bufferSize);
-    // unmap, now that stagingBufferMemory contains m_vertices data
-    vkUnmapMemory(_context.getDevice(), stagingBufferMemory);
-
-    // Init actual vertex buffer (m_vertexBuffer) with associated memory storage (m_vertexBufferMemory)
-    createBuffer( _context.getPhysicalDevice(), _context.getDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 m_vertexBuffer, m_vertexBufferMemory);
-    // data is copied from stagingBuffer to m_vertexBuffer
-    copyBuffer(_context.getDevice(), _context.getCommandPool(), _context.getGraphicsQueue(), stagingBuffer, m_vertexBuffer, bufferSize);
-
-    // cleanup temporary data after copy
-    vkDestroyBuffer(_context.getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(_context.getDevice(), stagingBufferMemory, nullptr);
+    m_range = _geometryPool.addMesh(_context, m_vertices, m_indices);
 }
 
 
 /*
- * Creation of index buffer
+ * Maps a compressed mesh file and decodes its streams and indices directly into the staging memory of the pool
  */
-void Mesh::createIndexBuffer(Context& _context)
+void Mesh::uploadCompressed(Context& _context, GeometryPool& _geometryPool, const std::string& _path)
+{
+    CompressedMeshFile file;
+    file.open(_path);
+
+    m_vertices.clear();
+    m_indices.clear();
+    m_bounds = file.getBounds();
+
+    auto write = [&](GeometryPool::StagingMesh const& _staging)
+    {
+        for (uint32_t s = 0; s < GeometryPool::STREAM_COUNT; s++) {
+            file.decodeStream(s, _staging.streams[s]);
+        }
+        file.decodeIndices(_staging.indices);
+    };
+    m_range = _geometryPool.addMesh(_context, file.getVertexCount(), file.getIndexCount(), write);
+
+    infoLog() << "compressed mesh: " + _path + ": " + std::to_string(file.getVertexCount()) + " vertices, "
+               + std::to_string(file.getIndexCount()) + " indices, " + std::to_string(file.getFileSize()) + " bytes ";
+}
+
+
+void Mesh::release(Context& _context, GeometryPool& _geometryPool)
 {
-    VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
-
-    // temporary CPU buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer( _context.getPhysicalDevice(), _context.getDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(_context.getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(_context.getDevice(), stagingBufferMemory);
-
-    // actual index buffer
-    createBuffer( _context.getPhysicalDevice(), _context.getDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 m_indexBuffer, m_indexBufferMemory);
-    // data is copied from staging buffer
-    copyBuffer(_context.getDevice(), _context.getCommandPool(), _context.getGraphicsQueue(), stagingBuffer, m_indexBuffer, bufferSize);
-
-    // cleanup data after copy
-    vkDestroyBuffer(_context.getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(_context.getDevice(), stagingBufferMemory, nullptr);
+    _geometryPool.removeMesh(_context, m_range);
+    m_range = GeometryPool::MeshRange{};
 }
 
 } // namespace VulkanDemo
\ No newline at end of file
@@ -2,8 +2,10 @@
  *
  * mesh.h
  *
- * Mesh class to store geometry and handle vertex and index buffers
- * Can create a mesh from a Wavefront (.obj) file using tinyobjloader lib, or build a default geometry (quads)
+ * Mesh class to store geometry, uploaded in the geometry pool shared by all meshes
+ * Can create a mesh from a Wavefront (.obj) file (parsed by the core library), or build a default geometry (quads)
+ * A mesh can be saved as a compressed mesh file (.vmesh, see core/meshcodec.h), which is then uploaded by decoding
+ * it straight into the staging memory of the geometry pool (no copy of the vertices kept on the CPU)
  *
  * Based on: https://vulkan-tutorial.com/
  *
@@ -22,6 +24,8 @@
 
 
 #include "utils.h"
+#include "core/geometry.h"
+#include "geometrypool.h"
 
 #include <string>
 
@@ -31,68 +35,6 @@ namespace VulkanDemo
 class Context;
 
 
-/*
-* Structure for vertex attributes
-*/
-struct Vertex 
-{
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 texCoord;
-    glm::vec3 normal;
-
-
-    bool operator==(const Vertex& _other) const 
-    {
-        return pos == _other.pos && color == _other.color && texCoord == _other.texCoord && normal == _other.normal;
-    }
-
-    static VkVertexInputBindingDescription getBindingDescription() 
-    {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        // VK_VERTEX_INPUT_RATE_VERTEX = Move to the next data entry after each vertex
-        // VK_VERTEX_INPUT_RATE_INSTANCE = Move to the next data entry after each instance
-
-        return bindingDescription;
-    }
-
-    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() 
-    {
-        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
-
-        // Attribute description for position
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        // Attribute description for color
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-        // Attribute description for UVs
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-        // Attribute description for normals
-        attributeDescriptions[3].binding = 0;
-        attributeDescriptions[3].location = 3;
-        attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[3].offset = offsetof(Vertex, normal);
-
-        return attributeDescriptions;
-    }
-
-};
-
-
 class Mesh
 {
     
@@ -107,30 +49,24 @@ public:
     {
         m_vertices = _other.m_vertices;
         m_indices = _other.m_indices;
-        m_vertexBuffer = _other.m_vertexBuffer;
-        m_vertexBufferMemory = _other.m_vertexBufferMemory;
-        m_indexBuffer = _other.m_indexBuffer;
-        m_indexBufferMemory = _other.m_indexBufferMemory;
+        m_range = _other.m_range;
+        m_bounds = _other.m_bounds;
         return *this;
     }
 
     Mesh(Mesh&& _other)
         : m_vertices(std::move(_other.m_vertices))
         , m_indices(std::move(_other.m_indices))
-        , m_vertexBuffer(_other.m_vertexBuffer)
-        , m_vertexBufferMemory(_other.m_vertexBufferMemory)
-        , m_indexBuffer(_other.m_indexBuffer)
-        , m_indexBufferMemory(_other.m_indexBufferMemory)
+        , m_range(_other.m_range)
+        , m_bounds(_other.m_bounds)
     {}
 
     Mesh& operator=(Mesh&& _other)
     {
         m_vertices = std::move(_other.m_vertices);
         m_indices = std::move(_other.m_indices);
-        m_vertexBuffer = _other.m_vertexBuffer;
-        m_vertexBufferMemory = _other.m_vertexBufferMemory;
-        m_indexBuffer = _other.m_indexBuffer;
-        m_indexBufferMemory = _other.m_indexBufferMemory;
+        m_range = _other.m_range;
+        m_bounds = _other.m_bounds;
         return *this;
     }
 
@@ -139,19 +75,22 @@ public:
 
     std::vector<Vertex> const& getVertices() const { return m_vertices; }
     std::vector<uint32_t> const& getIndices() const { return m_indices; }
-    VkBuffer const getVertexBuffer() const { return m_vertexBuffer; }
-    VkDeviceMemory const& getVertexBufferMemory() const { return m_vertexBufferMemory; }
-    VkBuffer const getIndexBuffer() const { return m_indexBuffer; }
-    VkDeviceMemory const getIndexBufferMemory() const { return m_indexBufferMemory; }
+    // location of the mesh in the geometry pool, after upload()
+    GeometryPool::MeshRange const& getRange() const { return m_range; }
 
+    // bounding box of the vertices, and sphere around it, in object space
+    Bounds const& getBounds() const { return m_bounds; }
 
-    void cleanup(Context& _context);
 
     void createQuads();
-    void loadModel();
+    void loadModel(const std::string& _path = MODEL_PATH);
+    void saveCompressed(const std::string& _path) const;
 
-    void createVertexBuffer(Context& _context);
-    void createIndexBuffer(Context& _context);
+    void upload(Context& _context, GeometryPool& _geometryPool);
+    // decodes a compressed mesh file into the geometry pool (the vertices and indices are not kept)
+    void uploadCompressed(Context& _context, GeometryPool& _geometryPool, const std::string& _path);
+    // for a mesh that may still be drawn by frames in flight
+    void release(Context& _context, GeometryPool& _geometryPool);
 
 protected:
 
@@ -160,43 +99,14 @@ protected:
     // List of indices
     std::vector<uint32_t> m_indices;
 
-    // Vertex buffer
-    VkBuffer m_vertexBuffer;
-    // Handle to the vertex buffer memory
-    VkDeviceMemory m_vertexBufferMemory;
-
-    // Index buffer
-    VkBuffer m_indexBuffer;
-    // Handle to the index buffer memory
-    VkDeviceMemory m_indexBufferMemory;
+    // Vertices and indices in the geometry pool
+    GeometryPool::MeshRange m_range;
+    // Bounds of the vertices
+    Bounds m_bounds;
 
 
 }; // class Mesh
 
 } // namespace VulkanDemo
 
-
-//namespace std {
-//    template<> struct hash<VulkanDemo::Vertex> {
-//        size_t operator()(VulkanDemo::Vertex const& vertex) const {
-//            return ((hash<glm::vec3>()(vertex.pos) ^
-//                    (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-//                    (hash<glm::vec2>()(vertex.texCoord) << 1);
-//        }
-//    };
-//}
-namespace std {
-    template<> struct hash<VulkanDemo::Vertex> {
-        size_t operator()(VulkanDemo::Vertex const& vertex) const 
-        {
-            std::size_t h1 = hash<glm::vec3>()(vertex.pos);
-            std::size_t h2 = hash<glm::vec3>()(vertex.color);
-            std::size_t h3 = hash<glm::vec2>()(vertex.texCoord);
-            std::size_t h4 = hash<glm::vec3>()(vertex.normal);
-            std::string stg = std::to_string(h1) + std::to_string(h2) + std::to_string(h3) + std::to_string(h4);
-            return std::hash<std::string>()(stg);
-        }
-    };
-}
-
 #endif // MESH_H
\ No newline at end of file
@@ -0,0 +1,279 @@
+/*********************************************************************************************************************
+ *
+ * model.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <cctype>
+
+#include "model.h"
+#include "mesh.h"
+#include "context.h"
+#include "bindlesstextures.h"
+#include "core/gltf.h"
+#include "core/culling.h"
+
+
+namespace VulkanDemo
+{
+
+
+bool Model::isGltf(const std::string& _path)
+{
+    std::string extension = _path.substr(std::min(_path.find_last_of('.'), _path.size()));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".glb" || extension == ".gltf";
+}
+
+
+/*
+ * Adds a part, and grows the bounds of the model to include it
+ */
+void Model::addPart(Part const& _part, Bounds const& _bounds)
+{
+    m_parts.push_back(_part);
+    if (!m_hasBounds)
+    {
+        m_bounds = _bounds;
+        m_hasBounds = true;
+        return;
+    }
+
+    glm::vec3 minCorner = glm::min(m_bounds.center - m_bounds.extents, _bounds.center - _bounds.extents);
+    glm::vec3 maxCorner = glm::max(m_bounds.center + m_bounds.extents, _bounds.center + _bounds.extents);
+    Bounds bounds;
+    bounds.center = 0.5f * (minCorner + maxCorner);
+    bounds.extents = 0.5f * (maxCorner - minCorner);
+    // sphere enclosing both spheres (and no larger than the sphere around the box)
+    bounds.radius = std::min(glm::length(bounds.extents),
+                             std::max(glm::length(m_bounds.center - bounds.center) + m_bounds.radius,
+                                      glm::length(_bounds.center - bounds.center) + _bounds.radius));
+    m_bounds = bounds;
+}
+
+
+/*
+ * Adds an uploaded mesh as a single part, drawn with the material of the object
+ */
+void Model::addMesh(Mesh const& _mesh)
+{
+    Part part;
+    part.range = _mesh.getRange();
+    addPart(part, _mesh.getBounds());
+}
+
+
+/*
+ * Loads a glTF model: one part per primitive of each mesh instance of the scene
+ * (the meshes drawn by several nodes are uploaded once)
+ */
+void Model::loadGltf(Context& _context, GeometryPool& _geometryPool, BindlessTextures* _bindlessTextures, const std::string& _path)
+{
+    GltfModel gltf;
+    gltf.load(_path);
+    const auto& accessors = gltf.getAccessors();
+    const auto& materials = gltf.getMaterials();
+
+    // 1. -----------------------------------------------------------------------------------------
+    // base color textures, decoded from the mapped file (only used by the bindless fragment shader)
+    std::vector<uint32_t> imageMaterials(gltf.getImages().size(), NO_MATERIAL);
+    if (_bindlessTextures != nullptr)
+    {
+        for (const auto& material : materials)
+        {
+            uint32_t image = material.baseColorImage;
+            if (image == GltfModel::NONE || imageMaterials[image] != NO_MATERIAL || gltf.getImages()[image].data == nullptr) {
+                continue;
+            }
+            if (_bindlessTextures->getCount() == _bindlessTextures->getCapacity())
+            {
+                infoLog() << "Model: bindless textures array full, textures of " + _path + " skipped ";
+                break;
+            }
+
+            Image texture;
+            texture.createTextureImage(_context, gltf.getImages()[image].data, gltf.getImages()[image].size);
+            texture.createTextureImageView(_context);
+            texture.createTextureSampler(_context);
+            imageMaterials[image] = _bindlessTextures->addTexture(_context, texture.getImageView(), texture.getSampler());
+            m_textures.push_back(texture);
+            m_textureIndices.push_back(imageMaterials[image]);
+        }
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // primitives, copied from the mapped file into the staging memory of the geometry pool
+    uint32_t directCopies = 0;
+    uint32_t convertedCopies = 0;
+    auto uploadPrimitive = [&](GltfPrimitive const& _primitive)
+    {
+        // without vertex colors, the base color factor of the material is used as vertex color
+        glm::vec4 baseColor = (_primitive.material != GltfModel::NONE) ? materials[_primitive.material].baseColorFactor : glm::vec4(1.0f);
+        uint32_t vertexCount = gltf.getVertexCount(_primitive);
+
+        auto write = [&](GeometryPool::StagingMesh const& _staging)
+        {
+            auto copy = [&](uint32_t _accessor, uint32_t _stream)
+            {
+                if (_accessor == GltfModel::NONE) {
+                    return false;
+                }
+                bool direct = GltfModel::copyAttribute(accessors[_accessor], _staging.streams[_stream], GeometryPool::STREAM_COMPONENTS[_stream]);
+                (direct ? directCopies : convertedCopies)++;
+                return true;
+            };
+
+            copy(_primitive.positions, GeometryPool::POSITIONS);
+            if (!copy(_primitive.colors, GeometryPool::COLORS))
+            {
+                float* colors = _staging.streams[GeometryPool::COLORS];
+                for (uint32_t v = 0; v < vertexCount; v++)
+                {
+                    colors[3 * v] = baseColor.r;
+                    colors[3 * v + 1] = baseColor.g;
+                    colors[3 * v + 2] = baseColor.b;
+                }
+            }
+            if (!copy(_primitive.texCoords, GeometryPool::TEXCOORDS)) {
+                std::fill_n(_staging.streams[GeometryPool::TEXCOORDS], 2 * static_cast<size_t>(vertexCount), 0.0f);
+            }
+            if (!copy(_primitive.normals, GeometryPool::NORMALS)) {
+                gltf.computeNormals(_primitive, _staging.streams[GeometryPool::NORMALS]);
+            }
+            (gltf.copyIndices(_primitive, _staging.indices) ? directCopies : convertedCopies)++;
+        };
+
+        return _geometryPool.addMesh(_context, vertexCount, gltf.getIndexCount(_primitive), write);
+    };
+
+    // 3. -----------------------------------------------------------------------------------------
+    // parts
+    std::vector<std::vector<GeometryPool::MeshRange>> meshRanges(gltf.getMeshes().size());
+    uint32_t uploadedMeshCount = 0;
+    for (const auto& instance : gltf.computeMeshInstances())
+    {
+        const auto& primitives = gltf.getMeshes()[instance.mesh].primitives;
+        auto& ranges = meshRanges[instance.mesh];
+        if (ranges.empty() && !primitives.empty())
+        {
+            for (const auto& primitive : primitives) {
+                ranges.push_back(uploadPrimitive(primitive));
+            }
+            uploadedMeshCount++;
+        }
+
+        for (size_t p = 0; p < primitives.size(); p++)
+        {
+            Part part;
+            part.range = ranges[p];
+            part.transform = instance.worldMatrix;
+            if (primitives[p].material != GltfModel::NONE && materials[primitives[p].material].baseColorImage != GltfModel::NONE) {
+                part.materialIndex = imageMaterials[materials[primitives[p].material].baseColorImage];
+            }
+            addPart(part, transformBounds(gltf.computeBounds(primitives[p]), instance.worldMatrix));
+        }
+    }
+
+    if (m_parts.empty()) {
+        throw std::runtime_error("failed to load model " + _path + ": no triangles in its scene!");
+    }
+
+    infoLog() << "Model: " + _path + ": " + std::to_string(m_parts.size()) + " parts, " + std::to_string(uploadedMeshCount) + " meshes, "
+               + std::to_string(m_textures.size()) + " textures; streams copied as is: " + std::to_string(directCopies) + ", converted: "
+               + std::to_string(convertedCopies) + ", primitives skipped: " + std::to_string(gltf.getSkippedPrimitiveCount()) + " ";
+}
+
+
+/*
+ * Storage buffer holding the transformation and material of each part (written once, host visible)
+ */
+void Model::createPartsBuffer(Context& _context)
+{
+    std::vector<PartData> parts(m_parts.size());
+    for (size_t p = 0; p < m_parts.size(); p++)
+    {
+        parts[p].transform = m_parts[p].transform;
+        parts[p].materialIndex = m_parts[p].materialIndex;
+    }
+
+    VkDeviceSize bufferSize = sizeof(PartData) * parts.size();
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Mesh,
+                                            m_partsBuffer, m_partsBufferMemory);
+
+    void* data;
+    vkMapMemory(_context.getDevice(), m_partsBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, parts.data(), static_cast<size_t>(bufferSize));
+    vkUnmapMemory(_context.getDevice(), m_partsBufferMemory);
+}
+
+
+/*
+ * Destroys the parts buffer and the textures (the meshes are freed with the geometry pool)
+ */
+void Model::cleanup(Context& _context)
+{
+    vkDestroyBuffer(_context.getDevice(), m_partsBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_partsBufferMemory);
+    m_partsBuffer = VK_NULL_HANDLE;
+    m_partsBufferMemory = VK_NULL_HANDLE;
+
+    for (auto& texture : m_textures) {
+        texture.cleanup(_context);
+    }
+    m_textures.clear();
+    m_textureIndices.clear();
+}
+
+
+void Model::addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings)
+{
+    VkDescriptorSetLayoutBinding partsBinding{};
+    partsBinding.binding = PARTS_BINDING;
+    partsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    partsBinding.descriptorCount = 1;
+    partsBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    partsBinding.pImmutableSamplers = nullptr;
+    _bindings.push_back(partsBinding);
+}
+
+
+/*
+ * Descriptors required by the model (one descriptor set per frame in flight)
+ */
+void Model::addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight)
+{
+    VkDescriptorPoolSize storageSize{};
+    storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageSize.descriptorCount = _framesInFlight;
+    _poolSizes.push_back(storageSize);
+}
+
+
+/*
+ * Descriptor write for the descriptor set of a frame in flight (same buffer for all the frames)
+ */
+void Model::addDescriptorWrites(VkDescriptorSet _descriptorSet, std::vector<VkWriteDescriptorSet>& _writes)
+{
+    m_partsInfo.buffer = m_partsBuffer;
+    m_partsInfo.offset = 0;
+    m_partsInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _descriptorSet;
+    write.dstBinding = PARTS_BINDING;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &m_partsInfo;
+    _writes.push_back(write);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
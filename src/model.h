@@ -0,0 +1,120 @@
+/*********************************************************************************************************************
+ *
+ * model.h
+ *
+ * Model class: the parts drawn for an object, each a mesh of the geometry pool with its transformation and material
+ *  - a mesh (e.g. decoded from the compressed copy of a Wavefront file) is a single part
+ *  - a glTF 2.0 model (.glb or .gltf, read by the core library) has one part per primitive of each mesh instance
+ *    of its scene: the attributes are copied from the mapped file straight into the staging memory of the pool
+ *    (without conversion when they already are packed floats and 32 bit indices), and the base color textures
+ *    are decoded from the mapped file as well
+ * The transformations and materials of the parts are in a storage buffer read by the vertex shaders, the draw of a
+ * part uses its index as first instance
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef MODEL_H
+#define MODEL_H
+
+
+#include "utils.h"
+#include "core/geometry.h"
+#include "geometrypool.h"
+#include "image.h"
+
+#include <limits>
+
+namespace VulkanDemo
+{
+
+class Context;
+class Mesh;
+class BindlessTextures;
+
+
+class Model
+{
+
+public:
+
+    // binding used by the vertex shaders in the descriptor set of the app
+    static constexpr uint32_t PARTS_BINDING = 12;
+    // parts without texture use the material of the object
+    static constexpr uint32_t NO_MATERIAL = std::numeric_limits<uint32_t>::max();
+
+    struct Part
+    {
+        GeometryPool::MeshRange range;
+        glm::mat4 transform = glm::mat4(1.0f);      // relative to the object
+        uint32_t materialIndex = NO_MATERIAL;       // in the bindless textures array
+    };
+
+    Model() = default;
+
+    // owns its textures and parts buffer, it cannot be duplicated
+    Model(Model const& _other) = delete;
+    Model& operator=(Model const& _other) = delete;
+
+    virtual ~Model() {};
+
+
+    std::vector<Part> const& getParts() const { return m_parts; }
+    uint32_t const getPartCount() const { return static_cast<uint32_t>(m_parts.size()); }
+    // of all the parts, in object space
+    Bounds const& getBounds() const { return m_bounds; }
+    // base color textures of a glTF model, and their index in the bindless textures array
+    std::vector<Image>& getTextures() { return m_textures; }
+    std::vector<uint32_t> const& getTextureIndices() const { return m_textureIndices; }
+
+    // .glb and .gltf files are loaded by loadGltf(), others are Wavefront files
+    static bool isGltf(const std::string& _path);
+
+    // (mesh already uploaded to the geometry pool)
+    void addMesh(Mesh const& _mesh);
+    // (textures are only used with bindless textures, _bindlessTextures can be null)
+    void loadGltf(Context& _context, GeometryPool& _geometryPool, BindlessTextures* _bindlessTextures, const std::string& _path);
+    // once all the parts are added
+    void createPartsBuffer(Context& _context);
+    void cleanup(Context& _context);
+
+    static void addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings);
+    static void addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight);
+    void addDescriptorWrites(VkDescriptorSet _descriptorSet, std::vector<VkWriteDescriptorSet>& _writes);
+
+
+protected:
+
+    /*
+     * Part in the storage buffer (std430 layout)
+     */
+    struct PartData
+    {
+        alignas(16) glm::mat4 transform;
+        uint32_t materialIndex;
+        uint32_t padding[3];
+    };
+
+    void addPart(Part const& _part, Bounds const& _bounds);
+
+    std::vector<Part> m_parts;
+    Bounds m_bounds;
+    bool m_hasBounds = false;
+
+    // base color textures of a glTF model
+    std::vector<Image> m_textures;
+    std::vector<uint32_t> m_textureIndices;
+
+    VkBuffer m_partsBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_partsBufferMemory = VK_NULL_HANDLE;
+
+    // kept alive until vkUpdateDescriptorSets() is called with the writes
+    VkDescriptorBufferInfo m_partsInfo{};
+
+}; // class Model
+
+} // namespace VulkanDemo
+
+#endif // MODEL_H
\ No newline at end of file
@@ -0,0 +1,649 @@
+/*********************************************************************************************************************
+ *
+ * occlusionculler.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <cstring>
+
+#include "occlusionculler.h"
+#include "context.h"
+#include "deletionqueue.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Creates the compute pipelines and the buffers (sized for _maxObjects objects)
+ */
+void OcclusionCuller::create(Context& _context, uint32_t _maxObjects, uint32_t _framesInFlight)
+{
+    m_maxObjects = _maxObjects;
+    m_framesInFlight = _framesInFlight;
+    m_recorded.assign(_framesInFlight, false);
+    m_visibilityOutdated = true;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // descriptor set layouts: reduction (previous level, next level), culling (buffers, pyramid)
+    std::array<VkDescriptorSetLayoutBinding, 2> reduceBindings{};
+    reduceBindings[0].binding = 0;
+    reduceBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduceBindings[0].descriptorCount = 1;
+    reduceBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    reduceBindings[1].binding = 1;
+    reduceBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    reduceBindings[1].descriptorCount = 1;
+    reduceBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 5> cullingBindings{};
+    for (uint32_t b = 0; b < cullingBindings.size(); b++)
+    {
+        cullingBindings[b].binding = b;
+        cullingBindings[b].descriptorType = (b == 4) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullingBindings[b].descriptorCount = 1;
+        cullingBindings[b].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(reduceBindings.size());
+    layoutInfo.pBindings = reduceBindings.data();
+    if (vkCreateDescriptorSetLayout(_context.getDevice(), &layoutInfo, nullptr, &m_reduceSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+    }
+    layoutInfo.bindingCount = static_cast<uint32_t>(cullingBindings.size());
+    layoutInfo.pBindings = cullingBindings.data();
+    if (vkCreateDescriptorSetLayout(_context.getDevice(), &layoutInfo, nullptr, &m_cullingSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling descriptor set layout!");
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // pipeline layouts and pipelines
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    pipelineLayoutInfo.pSetLayouts = &m_reduceSetLayout;
+    pushConstantRange.size = sizeof(ReducePushConstants);
+    if (vkCreatePipelineLayout(_context.getDevice(), &pipelineLayoutInfo, nullptr, &m_reduceLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+    }
+    pipelineLayoutInfo.pSetLayouts = &m_cullingSetLayout;
+    pushConstantRange.size = sizeof(CullingPushConstants);
+    if (vkCreatePipelineLayout(_context.getDevice(), &pipelineLayoutInfo, nullptr, &m_cullingLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline layout!");
+    }
+
+    createPipelines(_context);
+
+    // 3. -----------------------------------------------------------------------------------------
+    // buffers: two draw commands per object (early and late phases), and the visibility of each object
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), 2 * m_maxObjects * sizeof(VkDrawIndexedIndirectCommand),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Uniform,
+                                            m_commandBuffer, m_commandBufferMemory);
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), m_maxObjects * sizeof(uint32_t),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Uniform,
+                                            m_visibilityBuffer, m_visibilityBufferMemory);
+
+    // bounds and stats of each frame in flight, kept mapped (both are bound at aligned offsets)
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_context.getPhysicalDevice(), &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+    auto alignSize = [alignment](VkDeviceSize _size) { return (_size + alignment - 1) / alignment * alignment; };
+
+    m_boundsSize = alignSize(m_maxObjects * sizeof(glm::vec4));
+    m_frameStride = m_boundsSize + alignSize(sizeof(Stats));
+    VkDeviceSize frameBufferSize = m_frameStride * m_framesInFlight;
+
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), frameBufferSize,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniform,
+                                            m_frameBuffer, m_frameBufferMemory);
+    vkMapMemory(_context.getDevice(), m_frameBufferMemory, 0, frameBufferSize, 0, reinterpret_cast<void**>(&m_frameBufferMapped));
+    std::memset(m_frameBufferMapped, 0, static_cast<size_t>(frameBufferSize));
+
+    infoLog() << "OcclusionCuller::create(): " + std::to_string(m_maxObjects) + " objects ";
+}
+
+
+/*
+ * Pyramid reduction (single-sampled and multisampled first level) and culling pipelines
+ */
+void OcclusionCuller::createPipelines(Context& _context)
+{
+    m_reducePipeline = createPipeline(_context, "hiz_reduce.comp", {}, "hiz_reduce.spv", m_reduceLayout);
+    m_reduceMultisampledPipeline = createPipeline(_context, "hiz_reduce.comp", { "MULTISAMPLED" }, "hiz_reduce_ms.spv", m_reduceLayout);
+    m_cullingPipeline = createPipeline(_context, "cull.comp", {}, "cull.spv", m_cullingLayout);
+}
+
+
+/*
+ * Hands the pipelines over to the deletion queue, and creates them again from the edited shaders
+ */
+void OcclusionCuller::reloadPipelines(Context& _context)
+{
+    std::array<VkPipeline, 3> pipelines = { m_reducePipeline, m_reduceMultisampledPipeline, m_cullingPipeline };
+    _context.getDeletionQueue().retire([pipelines](VkDevice _device)
+    {
+        for (auto pipeline : pipelines) {
+            vkDestroyPipeline(_device, pipeline, nullptr);
+        }
+    });
+
+    createPipelines(_context);
+}
+
+
+/*
+ * Loads a compute shader and creates its pipeline
+ */
+VkPipeline OcclusionCuller::createPipeline(Context& _context, const std::string& _source, const std::vector<std::string>& _defines,
+                                           const std::string& _spirvName, VkPipelineLayout _layout)
+{
+    auto shaderCode = _context.getShaderCompiler().load(_source, _defines, _spirvName);
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shaderCode.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(_context.getDevice(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module " + _source + "!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = _layout;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(_context.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(_context.getDevice(), shaderModule, nullptr);
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline " + _source + "!");
+    }
+    return pipeline;
+}
+
+
+/*
+ * Destroys pipelines, layouts and buffers (the pyramid must be destroyed before)
+ */
+void OcclusionCuller::cleanup(Context& _context)
+{
+    vkDestroyPipeline(_context.getDevice(), m_reducePipeline, nullptr);
+    vkDestroyPipeline(_context.getDevice(), m_reduceMultisampledPipeline, nullptr);
+    vkDestroyPipeline(_context.getDevice(), m_cullingPipeline, nullptr);
+    vkDestroyPipelineLayout(_context.getDevice(), m_reduceLayout, nullptr);
+    vkDestroyPipelineLayout(_context.getDevice(), m_cullingLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_context.getDevice(), m_reduceSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_context.getDevice(), m_cullingSetLayout, nullptr);
+
+    vkDestroyBuffer(_context.getDevice(), m_commandBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_commandBufferMemory);
+    vkDestroyBuffer(_context.getDevice(), m_visibilityBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_visibilityBufferMemory);
+    vkUnmapMemory(_context.getDevice(), m_frameBufferMemory);
+    vkDestroyBuffer(_context.getDevice(), m_frameBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_frameBufferMemory);
+    m_frameBufferMapped = nullptr;
+}
+
+
+/*
+ * Creates the depth pyramid of a depth attachment, and the descriptor sets reading it:
+ * the first level is the largest power of two not greater than the depth extent, each level halves the previous one
+ */
+void OcclusionCuller::createPyramid(Context& _context, VkImageView _depthView, VkExtent2D _depthExtent, VkSampleCountFlagBits _samples)
+{
+    m_depthExtent = _depthExtent;
+    m_depthSamples = _samples;
+
+    auto previousPowerOfTwo = [](uint32_t _value)
+    {
+        uint32_t power = 1;
+        while (power * 2 <= _value) {
+            power *= 2;
+        }
+        return power;
+    };
+
+    VkExtent2D extent = { previousPowerOfTwo(_depthExtent.width), previousPowerOfTwo(_depthExtent.height) };
+    m_pyramidLevelExtents.clear();
+    m_pyramidLevelExtents.push_back(extent);
+    while (extent.width > 1 || extent.height > 1)
+    {
+        extent = { std::max(1u, extent.width / 2), std::max(1u, extent.height / 2) };
+        m_pyramidLevelExtents.push_back(extent);
+    }
+    uint32_t mipCount = static_cast<uint32_t>(m_pyramidLevelExtents.size());
+
+    // 1. -----------------------------------------------------------------------------------------
+    // image, written level by level, then sampled at any level
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { m_pyramidLevelExtents[0].width, m_pyramidLevelExtents[0].height, 1 };
+    imageInfo.mipLevels = mipCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(_context.getDevice(), &imageInfo, nullptr, &m_pyramidImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_context.getDevice(), m_pyramidImage, &memRequirements);
+
+    m_pyramidMemory = _context.getMemoryBudget().allocate(_context.getDevice(), memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Attachment);
+    vkBindImageMemory(_context.getDevice(), m_pyramidImage, m_pyramidMemory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_pyramidImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = mipCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_context.getDevice(), &viewInfo, nullptr, &m_pyramidView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid image view!");
+    }
+
+    m_pyramidLevelViews.resize(mipCount);
+    for (uint32_t level = 0; level < mipCount; level++)
+    {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        if (vkCreateImageView(_context.getDevice(), &viewInfo, nullptr, &m_pyramidLevelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid level view!");
+        }
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // descriptor sets: one per level for the reduction, one per frame in flight for the culling
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = mipCount + m_framesInFlight;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = mipCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = 4 * m_framesInFlight;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = mipCount + m_framesInFlight;
+
+    if (vkCreateDescriptorPool(_context.getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(mipCount, m_reduceSetLayout);
+    layouts.insert(layouts.end(), m_framesInFlight, m_cullingSetLayout);
+    std::vector<VkDescriptorSet> sets(layouts.size());
+
+    VkDescriptorSetAllocateInfo setAllocInfo{};
+    setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocInfo.descriptorPool = m_descriptorPool;
+    setAllocInfo.descriptorSetCount = static_cast<uint32_t>(sets.size());
+    setAllocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(_context.getDevice(), &setAllocInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+    }
+    m_reduceSets.assign(sets.begin(), sets.begin() + mipCount);
+    m_cullingSets.assign(sets.begin() + mipCount, sets.end());
+
+    // texels are read exactly: nearest filtering, no anisotropy
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VkSampler sampler = _context.getSamplerCache().getSampler(_context.getDevice(), samplerInfo);
+
+    // 3. -----------------------------------------------------------------------------------------
+    // reduction: depth attachment (or previous level) to each level
+    for (uint32_t level = 0; level < mipCount; level++)
+    {
+        VkDescriptorImageInfo inputInfo{};
+        inputInfo.sampler = sampler;
+        inputInfo.imageView = (level == 0) ? _depthView : m_pyramidLevelViews[level - 1];
+        inputInfo.imageLayout = (level == 0) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo outputInfo{};
+        outputInfo.imageView = m_pyramidLevelViews[level];
+        outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = m_reduceSets[level];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &inputInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = m_reduceSets[level];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &outputInfo;
+
+        vkUpdateDescriptorSets(_context.getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    // culling: bounds, visibility, commands and stats, and the whole pyramid
+    for (uint32_t i = 0; i < m_framesInFlight; i++)
+    {
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+        bufferInfos[0] = { m_frameBuffer, i * m_frameStride, m_maxObjects * sizeof(glm::vec4) };
+        bufferInfos[1] = { m_visibilityBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[2] = { m_commandBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[3] = { m_frameBuffer, i * m_frameStride + m_boundsSize, sizeof(Stats) };
+
+        VkDescriptorImageInfo pyramidInfo{};
+        pyramidInfo.sampler = sampler;
+        pyramidInfo.imageView = m_pyramidView;
+        pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+        for (uint32_t b = 0; b < descriptorWrites.size(); b++)
+        {
+            descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[b].dstSet = m_cullingSets[i];
+            descriptorWrites[b].dstBinding = b;
+            descriptorWrites[b].descriptorCount = 1;
+            if (b < bufferInfos.size())
+            {
+                descriptorWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[b].pBufferInfo = &bufferInfos[b];
+            }
+            else
+            {
+                descriptorWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorWrites[b].pImageInfo = &pyramidInfo;
+            }
+        }
+
+        vkUpdateDescriptorSets(_context.getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    infoLog() << "OcclusionCuller::createPyramid(): " + std::to_string(m_pyramidLevelExtents[0].width) + "x"
+               + std::to_string(m_pyramidLevelExtents[0].height) + ", " + std::to_string(mipCount) + " levels ";
+}
+
+
+/*
+ * Destroys the depth pyramid and its descriptors
+ */
+void OcclusionCuller::cleanupPyramid(Context& _context)
+{
+    if (m_pyramidImage == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkDestroyDescriptorPool(_context.getDevice(), m_descriptorPool, nullptr);
+    for (auto levelView : m_pyramidLevelViews) {
+        vkDestroyImageView(_context.getDevice(), levelView, nullptr);
+    }
+    vkDestroyImageView(_context.getDevice(), m_pyramidView, nullptr);
+    vkDestroyImage(_context.getDevice(), m_pyramidImage, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_pyramidMemory);
+
+    m_pyramidImage = VK_NULL_HANDLE;
+    m_pyramidLevelViews.clear();
+    m_reduceSets.clear();
+    m_cullingSets.clear();
+}
+
+
+/*
+ * Hands the depth pyramid and its descriptors over to the deletion queue
+ */
+void OcclusionCuller::retirePyramid(Context& _context)
+{
+    if (m_pyramidImage == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkDescriptorPool descriptorPool = m_descriptorPool;
+    std::vector<VkImageView> imageViews = m_pyramidLevelViews;
+    imageViews.push_back(m_pyramidView);
+    VkImage image = m_pyramidImage;
+    VkDeviceMemory memory = m_pyramidMemory;
+    MemoryBudget* memoryBudget = &_context.getMemoryBudget();
+    _context.getDeletionQueue().retire([descriptorPool, imageViews, image, memory, memoryBudget](VkDevice _device)
+    {
+        vkDestroyDescriptorPool(_device, descriptorPool, nullptr);
+        for (auto imageView : imageViews) {
+            vkDestroyImageView(_device, imageView, nullptr);
+        }
+        vkDestroyImage(_device, image, nullptr);
+        memoryBudget->free(_device, memory);
+    });
+
+    m_pyramidImage = VK_NULL_HANDLE;
+    m_pyramidLevelViews.clear();
+    m_reduceSets.clear();
+    m_cullingSets.clear();
+}
+
+
+/*
+ * Writes the bounding sphere of an object in the region of the current frame
+ */
+void OcclusionCuller::setBounds(uint32_t _frameIndex, uint32_t _objectIndex, const glm::vec4& _sphere)
+{
+    std::memcpy(m_frameBufferMapped + _frameIndex * m_frameStride + _objectIndex * sizeof(glm::vec4), &_sphere, sizeof(glm::vec4));
+}
+
+
+/*
+ * Binds the culling pipeline and dispatches one invocation per object
+ */
+void OcclusionCuller::recordDispatch(VkCommandBuffer _commandBuffer, uint32_t _frameIndex, const CullingPushConstants& _pushConstants)
+{
+    vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingPipeline);
+    vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingLayout, 0, 1, &m_cullingSets[_frameIndex], 0, nullptr);
+    vkCmdPushConstants(_commandBuffer, m_cullingLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingPushConstants), &_pushConstants);
+    vkCmdDispatch(_commandBuffer, (_pushConstants.objectCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+}
+
+
+/*
+ * Early phase: draw commands of the objects visible in the previous frame
+ */
+void OcclusionCuller::recordEarlyCommands(VkCommandBuffer _commandBuffer, uint32_t _frameIndex, uint32_t _objectCount, GeometryPool::MeshRange const& _mesh)
+{
+    // counters of this frame slot (its timeline value is reached)
+    std::memset(m_frameBufferMapped + _frameIndex * m_frameStride + m_boundsSize, 0, sizeof(Stats));
+
+    // the previous frame may still write the visibility, read the draw commands and sample the pyramid
+    // (its content is discarded, the layout only has to match the descriptors bound for the dispatch)
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkImageMemoryBarrier pyramidBarrier{};
+    pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramidBarrier.srcAccessMask = 0;
+    pyramidBarrier.dstAccessMask = 0;
+    pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.image = m_pyramidImage;
+    pyramidBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    pyramidBarrier.subresourceRange.baseMipLevel = 0;
+    pyramidBarrier.subresourceRange.levelCount = static_cast<uint32_t>(m_pyramidLevelExtents.size());
+    pyramidBarrier.subresourceRange.baseArrayLayer = 0;
+    pyramidBarrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 1, &pyramidBarrier);
+
+    if (m_visibilityOutdated)
+    {
+        m_visibilityOutdated = false;
+        vkCmdFillBuffer(_commandBuffer, m_visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    CullingPushConstants pushConstants{};
+    pushConstants.objectCount = std::min(_objectCount, m_maxObjects);
+    pushConstants.maxObjects = m_maxObjects;
+    pushConstants.indexCount = _mesh.indexCount;
+    pushConstants.firstIndex = _mesh.firstIndex;
+    pushConstants.vertexOffset = _mesh.vertexOffset;
+    pushConstants.phase = EARLY_PHASE;
+    recordDispatch(_commandBuffer, _frameIndex, pushConstants);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+/*
+ * Builds the depth pyramid, level by level (the depth attachment is already in read-only layout)
+ */
+void OcclusionCuller::recordPyramid(VkCommandBuffer _commandBuffer)
+{
+    uint32_t mipCount = static_cast<uint32_t>(m_pyramidLevelExtents.size());
+
+    // already in general layout (recordEarlyCommands()), written after the early culling dispatch
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_pyramidImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    for (uint32_t level = 0; level < mipCount; level++)
+    {
+        bool multisampled = (level == 0 && m_depthSamples != VK_SAMPLE_COUNT_1_BIT);
+        VkExtent2D inputExtent = (level == 0) ? m_depthExtent : m_pyramidLevelExtents[level - 1];
+        VkExtent2D outputExtent = m_pyramidLevelExtents[level];
+
+        ReducePushConstants pushConstants{};
+        pushConstants.inputSize = glm::ivec2(inputExtent.width, inputExtent.height);
+        pushConstants.outputSize = glm::ivec2(outputExtent.width, outputExtent.height);
+        pushConstants.samples = static_cast<int32_t>(m_depthSamples);
+
+        vkCmdBindPipeline(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampled ? m_reduceMultisampledPipeline : m_reducePipeline);
+        vkCmdBindDescriptorSets(_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reduceLayout, 0, 1, &m_reduceSets[level], 0, nullptr);
+        vkCmdPushConstants(_commandBuffer, m_reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstants), &pushConstants);
+        vkCmdDispatch(_commandBuffer, (outputExtent.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                                      (outputExtent.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+        // level read by the next reduction, and by the culling
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = 1;
+        vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
+
+
+/*
+ * Late phase: tests every object against the pyramid, writes the draw commands of the objects that became visible,
+ * and the visibility used by the early phase of the next frame
+ */
+void OcclusionCuller::recordCulling(VkCommandBuffer _commandBuffer, uint32_t _frameIndex, const glm::mat4& _viewProj, uint32_t _objectCount,
+                                    GeometryPool::MeshRange const& _mesh)
+{
+    CullingPushConstants pushConstants{};
+    pushConstants.viewProj = _viewProj;
+    pushConstants.pyramidSize = glm::vec2(m_pyramidLevelExtents[0].width, m_pyramidLevelExtents[0].height);
+    pushConstants.mipCount = static_cast<uint32_t>(m_pyramidLevelExtents.size());
+    pushConstants.objectCount = std::min(_objectCount, m_maxObjects);
+    pushConstants.maxObjects = m_maxObjects;
+    pushConstants.indexCount = _mesh.indexCount;
+    pushConstants.firstIndex = _mesh.firstIndex;
+    pushConstants.vertexOffset = _mesh.vertexOffset;
+    pushConstants.phase = LATE_PHASE;
+    recordDispatch(_commandBuffer, _frameIndex, pushConstants);
+
+    // draw commands for the late scene pass, stats for the host
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_recorded[_frameIndex] = true;
+}
+
+
+/*
+ * Reads the counters written by the last submission of a frame (returns false if no culling was recorded)
+ */
+bool OcclusionCuller::getStats(uint32_t _frameIndex, Stats& _stats)
+{
+    if (m_recorded.empty() || !m_recorded[_frameIndex]) {
+        return false;
+    }
+    m_recorded[_frameIndex] = false;
+
+    std::memcpy(&_stats, m_frameBufferMapped + _frameIndex * m_frameStride + m_boundsSize, sizeof(Stats));
+    return true;
+}
+
+
+void OcclusionCuller::invalidate()
+{
+    m_visibilityOutdated = true;
+    std::fill(m_recorded.begin(), m_recorded.end(), false);
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
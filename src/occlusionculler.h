@@ -0,0 +1,162 @@
+/*********************************************************************************************************************
+ *
+ * occlusionculler.h
+ *
+ * Two-phase GPU occlusion culling against a hierarchical depth buffer (Hi-Z):
+ *  - early phase: objects visible in the previous frame are drawn first
+ *  - the depth pyramid is built from the depth attachment with compute (farthest depth of each texel)
+ *  - late phase: the bounding sphere of every object is tested against the pyramid, objects that became
+ *    visible are drawn, and the visibility is kept for the next frame (no popping of disoccluded objects)
+ * Objects keep one draw each, with its own push constants or dynamic offsets: the compute shader only writes
+ * the instance count (0 or 1) of one indirect draw command per object and per phase
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+
+#include "utils.h"
+#include "geometrypool.h"
+
+#include <string>
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class OcclusionCuller
+{
+
+public:
+
+    static constexpr uint32_t EARLY_PHASE = 0;
+    static constexpr uint32_t LATE_PHASE = 1;
+    static constexpr uint32_t NO_CULLING = UINT32_MAX;     // draws all the objects directly
+
+    // nb of objects of a frame, counted by the compute shader
+    struct Stats
+    {
+        uint32_t drawnEarly = 0;
+        uint32_t drawnLate = 0;
+        uint32_t culled = 0;
+    };
+
+    OcclusionCuller() = default;
+
+    OcclusionCuller(OcclusionCuller const& _other) = default;
+    OcclusionCuller& operator=(OcclusionCuller const& _other) = default;
+
+    virtual ~OcclusionCuller() {};
+
+
+    void create(Context& _context, uint32_t _maxObjects, uint32_t _framesInFlight);
+    void cleanup(Context& _context);
+
+    // after hiz_reduce.comp or cull.comp was edited (previous pipelines go to the deletion queue)
+    void reloadPipelines(Context& _context);
+
+    // pyramid of the depth attachment of the render graph (created again with the render targets)
+    void createPyramid(Context& _context, VkImageView _depthView, VkExtent2D _depthExtent, VkSampleCountFlagBits _samples);
+    void cleanupPyramid(Context& _context);
+    void retirePyramid(Context& _context);
+
+    // used in updateUniformBuffer(): world space bounding sphere (center, radius) of an object
+    void setBounds(uint32_t _frameIndex, uint32_t _objectIndex, const glm::vec4& _sphere);
+
+    // used in recordCommandBuffer(), before the first scene pass
+    void recordEarlyCommands(VkCommandBuffer _commandBuffer, uint32_t _frameIndex, uint32_t _objectCount, GeometryPool::MeshRange const& _mesh);
+    // used in the compute pass of the render graph, between both scene passes
+    void recordPyramid(VkCommandBuffer _commandBuffer);
+    void recordCulling(VkCommandBuffer _commandBuffer, uint32_t _frameIndex, const glm::mat4& _viewProj, uint32_t _objectCount,
+                       GeometryPool::MeshRange const& _mesh);
+
+    // draw command of an object (one VkDrawIndexedIndirectCommand)
+    VkBuffer getCommandBuffer() const { return m_commandBuffer; }
+    VkDeviceSize getCommandOffset(uint32_t _phase, uint32_t _objectIndex) const
+    { return (_phase * m_maxObjects + _objectIndex) * sizeof(VkDrawIndexedIndirectCommand); }
+
+    // used in drawFrame(), once the timeline value of the frame is reached
+    bool getStats(uint32_t _frameIndex, Stats& _stats);
+
+    // all objects are considered hidden in the next frame, and pending stats are dropped
+    void invalidate();
+
+
+protected:
+
+    static constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+    static constexpr uint32_t CULLING_GROUP_SIZE = 64;
+
+    struct ReducePushConstants
+    {
+        glm::ivec2 inputSize;
+        glm::ivec2 outputSize;
+        int32_t samples;
+    };
+
+    struct CullingPushConstants
+    {
+        glm::mat4 viewProj;
+        glm::vec2 pyramidSize;
+        uint32_t mipCount;
+        uint32_t objectCount;
+        uint32_t maxObjects;
+        uint32_t indexCount;        // range of the mesh in the geometry pool
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t phase;
+    };
+
+    void createPipelines(Context& _context);
+    VkPipeline createPipeline(Context& _context, const std::string& _source, const std::vector<std::string>& _defines,
+                              const std::string& _spirvName, VkPipelineLayout _layout);
+    void recordDispatch(VkCommandBuffer _commandBuffer, uint32_t _frameIndex, const CullingPushConstants& _pushConstants);
+
+    uint32_t m_maxObjects = 0;
+    uint32_t m_framesInFlight = 0;
+
+    // layouts and pipelines
+    VkDescriptorSetLayout m_reduceSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_cullingSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_reduceLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_cullingLayout = VK_NULL_HANDLE;
+    VkPipeline m_reducePipeline = VK_NULL_HANDLE;
+    VkPipeline m_reduceMultisampledPipeline = VK_NULL_HANDLE;  // first level, from a multisampled depth attachment
+    VkPipeline m_cullingPipeline = VK_NULL_HANDLE;
+
+    // buffers: draw commands and visibility (GPU only), bounds and stats of each frame in flight (host visible)
+    VkBuffer m_commandBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_commandBufferMemory = VK_NULL_HANDLE;
+    VkBuffer m_visibilityBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_visibilityBufferMemory = VK_NULL_HANDLE;
+    VkBuffer m_frameBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_frameBufferMemory = VK_NULL_HANDLE;
+    uint8_t* m_frameBufferMapped = nullptr;
+    VkDeviceSize m_boundsSize = 0;          // bounds of a frame, followed by its stats
+    VkDeviceSize m_frameStride = 0;
+    bool m_visibilityOutdated = true;
+    std::vector<bool> m_recorded;           // frames whose stats are written
+
+    // depth pyramid (single R32 image with a full mip chain, kept in general layout)
+    VkImage m_pyramidImage = VK_NULL_HANDLE;
+    VkDeviceMemory m_pyramidMemory = VK_NULL_HANDLE;
+    VkImageView m_pyramidView = VK_NULL_HANDLE;             // all levels, sampled by the culling shader
+    std::vector<VkImageView> m_pyramidLevelViews;           // one per level, written by the reduction shader
+    std::vector<VkExtent2D> m_pyramidLevelExtents;
+    VkExtent2D m_depthExtent = { 0, 0 };
+    VkSampleCountFlagBits m_depthSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_reduceSets;              // one per level
+    std::vector<VkDescriptorSet> m_cullingSets;             // one per frame in flight
+
+}; // class OcclusionCuller
+
+} // namespace VulkanDemo
+
+#endif // OCCLUSIONCULLER_H
\ No newline at end of file
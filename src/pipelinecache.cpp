@@ -0,0 +1,287 @@
+/*********************************************************************************************************************
+ *
+ * pipelinecache.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "pipelinecache.h"
+#include "context.h"
+
+#include <algorithm>
+#include <cstddef>
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Specialization constants of the fragment shaders, read from the key itself
+ */
+std::array<VkSpecializationMapEntry, 3> PipelineKey::getSpecializationMapEntries()
+{
+    return { {
+        { 0, offsetof(PipelineKey, textured), sizeof(VkBool32) },
+        { 1, offsetof(PipelineKey, lightingModel), sizeof(uint32_t) },
+        { 2, offsetof(PipelineKey, texCoordScale), sizeof(float) }
+    } };
+}
+
+
+bool PipelineKey::operator==(PipelineKey const& _other) const
+{
+    return textured == _other.textured &&
+           lightingModel == _other.lightingModel &&
+           texCoordScale == _other.texCoordScale &&
+           vertexFormat == _other.vertexFormat &&
+           samples == _other.samples &&
+           depthEqual == _other.depthEqual;
+}
+
+
+bool PipelineKey::hasSameStates(PipelineKey const& _other) const
+{
+    return vertexFormat == _other.vertexFormat &&
+           samples == _other.samples &&
+           depthEqual == _other.depthEqual;
+}
+
+
+size_t PipelineCache::PipelineKeyHash::operator()(PipelineKey const& _key) const
+{
+    size_t seed = 0;
+    hashCombine(seed, _key.textured);
+    hashCombine(seed, _key.lightingModel);
+    hashCombine(seed, _key.texCoordScale);
+    hashCombine(seed, _key.vertexFormat);
+    hashCombine(seed, _key.samples);
+    hashCombine(seed, _key.depthEqual);
+    return seed;
+}
+
+
+/*
+ * Starts the worker threads
+ */
+void PipelineCache::start()
+{
+    if (!m_workers.empty()) {
+        return;
+    }
+
+    m_stopping = false;
+    for (uint32_t i = 0; i < WORKER_COUNT; i++) {
+        m_workers.emplace_back(&PipelineCache::work, this);
+    }
+}
+
+
+/*
+ * Stops the worker threads (the builds not started yet are dropped)
+ */
+void PipelineCache::stop()
+{
+    if (m_workers.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        for (const auto& build : m_queue) {
+            m_pending.erase(build.key);
+        }
+        m_queue.clear();
+    }
+    m_workCondition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+
+/*
+ * Worker thread: builds the queued variants
+ * (a variant failing to build is reported, and its fallback stays in use)
+ */
+void PipelineCache::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_workCondition.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+        if (m_stopping) {
+            return;
+        }
+
+        Build build = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_running++;
+        lock.unlock();
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        try {
+            pipeline = build.create(build.key);
+        }
+        catch (const std::exception& e) {
+            infoLog() << std::string("PipelineCache: variant not built\n") + e.what();
+        }
+
+        lock.lock();
+        m_running--;
+        m_built.push_back({ build.key, pipeline });
+        m_builtCondition.notify_all();
+    }
+}
+
+
+/*
+ * Returns the pipeline of a variant if it is ready, queues its build on first request
+ */
+VkPipeline PipelineCache::requestPipeline(PipelineKey const& _key, CreateFunction const& _create)
+{
+    auto it = m_pipelines.find(_key);
+    if (it != m_pipelines.end())
+    {
+        m_hits++;
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.insert(_key).second)
+    {
+        m_misses++;
+        m_queue.push_back({ _key, _create });
+        m_workCondition.notify_one();
+    }
+    return VK_NULL_HANDLE;
+}
+
+
+/*
+ * Returns the pipeline of a variant, builds it on the calling thread if it was not requested yet
+ */
+VkPipeline PipelineCache::getPipeline(PipelineKey const& _key, CreateFunction const& _create)
+{
+    if (m_pipelines.find(_key) == m_pipelines.end())
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_pending.count(_key) > 0)
+        {
+            // queued or in progress: built only once
+            m_builtCondition.wait(lock, [this, &_key]()
+            {
+                return std::any_of(m_built.begin(), m_built.end(), [&_key](const auto& _built) { return _built.first == _key; });
+            });
+            lock.unlock();
+            collectBuilt();
+        }
+        else
+        {
+            lock.unlock();
+            m_misses++;
+            m_pipelines.emplace(_key, _create(_key));
+        }
+    }
+
+    VkPipeline pipeline = m_pipelines[_key];
+    if (pipeline == VK_NULL_HANDLE) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
+
+
+VkPipeline PipelineCache::findCompatible(PipelineKey const& _key) const
+{
+    for (const auto& entry : m_pipelines)
+    {
+        if (entry.second != VK_NULL_HANDLE && entry.first.hasSameStates(_key)) {
+            return entry.second;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+
+bool PipelineCache::collectBuilt()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_built.empty()) {
+        return false;
+    }
+
+    for (const auto& [key, pipeline] : m_built)
+    {
+        m_pending.erase(key);
+        m_pipelines.emplace(key, pipeline);
+    }
+    m_built.clear();
+    return true;
+}
+
+
+void PipelineCache::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_builtCondition.wait(lock, [this]() { return m_queue.empty() && m_running == 0; });
+}
+
+
+/*
+ * Hands all the variants over to the deletion queue (frames in flight may still use them)
+ */
+void PipelineCache::retire(Context& _context)
+{
+    // the builds not started yet are dropped, the builds in progress use the layout and render pass being retired
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& build : m_queue) {
+            m_pending.erase(build.key);
+        }
+        m_queue.clear();
+    }
+    wait();
+    collectBuilt();
+
+    std::vector<VkPipeline> pipelines;
+    for (auto& entry : m_pipelines) {
+        pipelines.push_back(entry.second);
+    }
+    m_pipelines.clear();
+
+    _context.getDeletionQueue().retire([pipelines](VkDevice _device)
+    {
+        for (auto pipeline : pipelines) {
+            vkDestroyPipeline(_device, pipeline, nullptr);
+        }
+    });
+}
+
+
+/*
+ * Destroys all the cached pipelines
+ */
+void PipelineCache::cleanup(VkDevice _device)
+{
+    stop();
+    collectBuilt();
+
+    infoLog() << "pipeline cache: " + std::to_string(m_pipelines.size()) + " variants, "
+               + std::to_string(m_hits) + " hits, " + std::to_string(m_misses) + " misses";
+
+    for (auto& entry : m_pipelines)
+    {
+        vkDestroyPipeline(_device, entry.second, nullptr);
+    }
+    m_pipelines.clear();
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,154 @@
+/*********************************************************************************************************************
+ *
+ * pipelinecache.h
+ *
+ * Variants of the graphics pipeline of the scene, built once and kept by key:
+ *  - shader features are specialization constants (see shaders/shading.glsl), so the branches of the disabled
+ *    features are compiled out of each variant, instead of being tested per fragment
+ *  - vertex format, sample count and depth test are fixed-function states of the variant
+ * All the variants share a pipeline layout and render pass (or attachment formats): they are retired together
+ * Variants are built by worker threads: until a variant is ready, a ready variant with the same fixed-function
+ * states (only the shading differs) is drawn instead, so that switching variants never stalls a frame
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+
+#include "utils.h"
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+/*
+ * Key of a pipeline variant
+ * (the first members are the specialization constants of the fragment shaders, given as is to the pipeline)
+ */
+struct PipelineKey
+{
+    // lighting models (constant_id 1, values of shaders/shading.glsl)
+    static constexpr uint32_t LIGHTING_UNLIT = 0;
+    static constexpr uint32_t LIGHTING_DIFFUSE = 1;      // headlight and clustered point lights
+    static constexpr uint32_t LIGHTING_NORMALS = 2;      // displays the normals
+    static constexpr uint32_t LIGHTING_MODEL_COUNT = 3;
+
+    enum class VertexFormat : uint32_t
+    {
+        Full,                   // Vertex: position, color, texture coordinates, normal (streams of the geometry pool)
+        PositionOnly            // positions stream of the geometry pool only, no fragment shader (depth pre-pass)
+    };
+
+    // specialization constants
+    VkBool32 textured = VK_TRUE;                        // constant_id 0
+    uint32_t lightingModel = LIGHTING_DIFFUSE;          // constant_id 1
+    float texCoordScale = 1.0f;                         // constant_id 2
+
+    // fixed-function states
+    VertexFormat vertexFormat = VertexFormat::Full;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkBool32 depthEqual = VK_FALSE;                     // after a depth pre-pass: EQUAL test, no depth writes
+
+    static std::array<VkSpecializationMapEntry, 3> getSpecializationMapEntries();
+
+    bool operator==(PipelineKey const& _other) const;
+    // same fixed-function states: one variant can be drawn in place of the other
+    bool hasSameStates(PipelineKey const& _other) const;
+};
+
+
+class PipelineCache
+{
+
+public:
+
+    // builds the pipeline of a variant (called once per key, from a worker thread: it must not read
+    // state that the main thread modifies)
+    using CreateFunction = std::function<VkPipeline(PipelineKey const&)>;
+
+    static constexpr uint32_t WORKER_COUNT = 2;
+
+    PipelineCache() = default;
+
+    // pipelines are owned by the cache and built by its threads, it cannot be duplicated
+    PipelineCache(PipelineCache const& _other) = delete;
+    PipelineCache& operator=(PipelineCache const& _other) = delete;
+
+    virtual ~PipelineCache() { stop(); };
+
+
+    uint32_t getHits() const { return m_hits; }
+    uint32_t getMisses() const { return m_misses; }
+    size_t getSize() const { return m_pipelines.size(); }
+
+    void start();
+
+    // ready variant, or VK_NULL_HANDLE while it is built in the background (queued on first request)
+    VkPipeline requestPipeline(PipelineKey const& _key, CreateFunction const& _create);
+    // ready variant, built on the calling thread (or waited for) if needed: when there is nothing else to draw
+    VkPipeline getPipeline(PipelineKey const& _key, CreateFunction const& _create);
+    // ready variant with the same fixed-function states as the key (VK_NULL_HANDLE if none)
+    VkPipeline findCompatible(PipelineKey const& _key) const;
+
+    // used once per frame: adds the variants built since the last call (returns false if none)
+    bool collectBuilt();
+    // waits for the builds in progress (they use the current layout and render pass)
+    void wait();
+
+    // the layout, render pass or shaders changed: all the variants are handed over to the deletion queue
+    void retire(Context& _context);
+    void cleanup(VkDevice _device);
+
+
+protected:
+
+    struct PipelineKeyHash
+    {
+        size_t operator()(PipelineKey const& _key) const;
+    };
+
+    struct Build
+    {
+        PipelineKey key;
+        CreateFunction create;
+    };
+
+    void stop();
+    void work();
+
+    // used by the main thread only (VK_NULL_HANDLE: the build failed)
+    std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> m_pipelines;
+    uint32_t m_hits = 0;        // nb of requests served by an existing variant
+    uint32_t m_misses = 0;      // nb of requests that built a new variant
+
+    // shared with the worker threads
+    std::vector<std::thread> m_workers;
+    std::deque<Build> m_queue;                                      // builds not started yet
+    std::unordered_set<PipelineKey, PipelineKeyHash> m_pending;     // queued, in progress or not collected yet
+    std::vector<std::pair<PipelineKey, VkPipeline>> m_built;        // built, not collected yet
+    uint32_t m_running = 0;                                         // nb of builds in progress
+    std::mutex m_mutex;
+    std::condition_variable m_workCondition;                        // a build is queued, or the workers stop
+    std::condition_variable m_builtCondition;                       // a build is finished
+    bool m_stopping = false;
+
+}; // class PipelineCache
+
+} // namespace VulkanDemo
+
+#endif // PIPELINECACHE_H
\ No newline at end of file
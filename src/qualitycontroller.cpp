@@ -0,0 +1,159 @@
+/*********************************************************************************************************************
+ *
+ * qualitycontroller.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include <sstream>
+#include <iomanip>
+
+#include "qualitycontroller.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Builds the list of quality levels and starts from the highest one
+ */
+void QualityController::init(VkSampleCountFlagBits _maxSamples, bool _allowRenderScale, double _budgetMs)
+{
+    m_maxSamples = _maxSamples;
+    m_allowRenderScale = _allowRenderScale;
+    buildLevels();
+
+    m_current = 0;
+    m_budgetMs = _budgetMs;
+    m_averageMs = 0.0;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldownFrames = COOLDOWN_FRAMES;
+}
+
+
+/*
+ * Enables/disables the adaptation (the current level is kept)
+ */
+void QualityController::setEnabled(bool _enabled)
+{
+    m_enabled = _enabled;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldownFrames = COOLDOWN_FRAMES;
+
+    infoLog() << std::string("adaptive quality ") + (m_enabled ? "enabled" : "disabled");
+}
+
+
+/*
+ * Adds or removes the lower render scales, the current level is clamped to the remaining ones
+ */
+bool QualityController::setRenderScaleAllowed(bool _allowRenderScale)
+{
+    if (_allowRenderScale == m_allowRenderScale) {
+        return false;
+    }
+
+    m_allowRenderScale = _allowRenderScale;
+    buildLevels();
+
+    // the levels at full scale are unchanged, only a lower render scale has to be dropped
+    if (m_current < m_levels.size()) {
+        return false;
+    }
+    m_current = static_cast<uint32_t>(m_levels.size()) - 1;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldownFrames = COOLDOWN_FRAMES;
+    m_averageMs = 0.0;
+
+    infoLog() << "quality: render scale not supported by the swap chain, back to full scale ";
+    return true;
+}
+
+
+/*
+ * Accumulates the time of a frame, returns true if the quality level changed
+ */
+bool QualityController::update(double _frameTimeMs)
+{
+    m_averageMs = (m_averageMs == 0.0) ? _frameTimeMs 
+                                       : (1.0 - SMOOTHING) * m_averageMs + SMOOTHING * _frameTimeMs;
+
+    if (!m_enabled) {
+        return false;
+    }
+
+    // lets the new level settle (and the average forget the previous one)
+    if (m_cooldownFrames > 0)
+    {
+        m_cooldownFrames--;
+        return false;
+    }
+
+    m_overBudgetFrames = (m_averageMs > m_budgetMs) ? m_overBudgetFrames + 1 : 0;
+    m_underBudgetFrames = (m_averageMs < UPGRADE_RATIO * m_budgetMs) ? m_underBudgetFrames + 1 : 0;
+
+    if (m_overBudgetFrames >= DOWNGRADE_FRAMES && m_current + 1 < m_levels.size())
+    {
+        changeLevel(m_current + 1);
+        return true;
+    }
+    if (m_underBudgetFrames >= UPGRADE_FRAMES && m_current > 0)
+    {
+        changeLevel(m_current - 1);
+        return true;
+    }
+    return false;
+}
+
+
+/*
+ * Every sample count down to 1, then lower render scales (if allowed)
+ */
+void QualityController::buildLevels()
+{
+    m_levels.clear();
+    for (uint32_t samples = m_maxSamples; samples >= 1; samples /= 2) {
+        m_levels.push_back({ static_cast<VkSampleCountFlagBits>(samples), 1.0f });
+    }
+    if (m_allowRenderScale)
+    {
+        m_levels.push_back({ VK_SAMPLE_COUNT_1_BIT, 0.85f });
+        m_levels.push_back({ VK_SAMPLE_COUNT_1_BIT, 0.7f });
+        m_levels.push_back({ VK_SAMPLE_COUNT_1_BIT, 0.5f });
+    }
+}
+
+
+/*
+ * Switches to another level and logs the decision
+ */
+void QualityController::changeLevel(uint32_t _level)
+{
+    auto describe = [](QualityLevel const& _quality) 
+    {
+        std::ostringstream stream;
+        stream << _quality.samples << "x MSAA, scale " << std::fixed << std::setprecision(2) << _quality.renderScale;
+        return stream.str();
+    };
+
+    std::ostringstream log;
+    log << "quality: " << describe(m_levels[m_current]) << " -> " << describe(m_levels[_level])
+        << " (gpu " << std::fixed << std::setprecision(2) << m_averageMs << " ms, budget " << m_budgetMs << " ms)";
+    infoLog() << log.str();
+
+    m_current = _level;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldownFrames = COOLDOWN_FRAMES;
+    m_averageMs = 0.0;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*********************************************************************************************************************
+ *
+ * qualitycontroller.h
+ *
+ * Chooses the MSAA sample count and the render scale from the measured GPU frame time, to hold a frame budget
+ * Quality levels are ordered from the highest to the lowest, the controller steps down quickly when over budget
+ * and steps up slowly when there is enough headroom (hysteresis, plus a cooldown after each change)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef QUALITYCONTROLLER_H
+#define QUALITYCONTROLLER_H
+
+
+#include "utils.h"
+
+namespace VulkanDemo
+{
+
+
+struct QualityLevel
+{
+    VkSampleCountFlagBits samples;  // MSAA sample count of the color and depth targets
+    float renderScale;              // size of the offscreen targets relative to the swap chain
+};
+
+
+class QualityController
+{
+
+public:
+
+    static constexpr double DEFAULT_BUDGET_MS = 1000.0 / 60.0;
+
+    static constexpr double SMOOTHING = 0.1;            // weight of the last frame in the averaged frame time
+    static constexpr double UPGRADE_RATIO = 0.7;        // headroom needed to step up (fraction of the budget)
+    static constexpr uint32_t DOWNGRADE_FRAMES = 20;    // nb of consecutive frames over budget before stepping down
+    static constexpr uint32_t UPGRADE_FRAMES = 120;     // nb of consecutive frames under UPGRADE_RATIO before stepping up
+    static constexpr uint32_t COOLDOWN_FRAMES = 60;     // nb of frames ignored after a change
+
+    QualityController() = default;
+
+    QualityController(QualityController const& _other) = default;
+    QualityController& operator=(QualityController const& _other) = default;
+
+    virtual ~QualityController() {};
+
+
+    QualityLevel const& getLevel() const { return m_levels[m_current]; }
+    double const getAverageFrameTime() const { return m_averageMs; }
+    double const getBudget() const { return m_budgetMs; }
+    bool const isEnabled() const { return m_enabled; }
+
+    void init(VkSampleCountFlagBits _maxSamples, bool _allowRenderScale, double _budgetMs = DEFAULT_BUDGET_MS);
+    void setEnabled(bool _enabled);
+    // when the support of the upscaling blit changes (new swap chain), returns true if the current level changed
+    bool setRenderScaleAllowed(bool _allowRenderScale);
+
+    bool update(double _frameTimeMs);
+
+
+protected:
+
+    std::vector<QualityLevel> m_levels = { { VK_SAMPLE_COUNT_1_BIT, 1.0f } }; // from highest to lowest quality
+    uint32_t m_current = 0;
+
+    double m_budgetMs = DEFAULT_BUDGET_MS;
+    double m_averageMs = 0.0;
+    uint32_t m_overBudgetFrames = 0;
+    uint32_t m_underBudgetFrames = 0;
+    uint32_t m_cooldownFrames = 0;
+    bool m_enabled = true;
+    VkSampleCountFlagBits m_maxSamples = VK_SAMPLE_COUNT_1_BIT;
+    bool m_allowRenderScale = false;
+
+    void buildLevels();
+    void changeLevel(uint32_t _level);
+
+}; // class QualityController
+
+} // namespace VulkanDemo
+
+#endif // QUALITYCONTROLLER_H
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*********************************************************************************************************************
+ *
+ * queuetimeline.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "queuetimeline.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Creates the timeline semaphore (initial value 0), and loads the functions of VK_KHR_timeline_semaphore
+ */
+void QueueTimeline::create(VkDevice _device, VkQueue _queue)
+{
+    m_queue = _queue;
+    m_submittedValue = 0;
+    m_completedValue = 0;
+
+    VkSemaphoreTypeCreateInfoKHR typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+
+    m_vkWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(_device, "vkWaitSemaphoresKHR"));
+    m_vkGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(_device, "vkGetSemaphoreCounterValueKHR"));
+    if (m_vkWaitSemaphores == nullptr || m_vkGetSemaphoreCounterValue == nullptr) {
+        throw std::runtime_error("failed to load timeline semaphore functions!");
+    }
+}
+
+
+void QueueTimeline::cleanup(VkDevice _device)
+{
+    vkDestroySemaphore(_device, m_semaphore, nullptr);
+    m_semaphore = VK_NULL_HANDLE;
+}
+
+
+uint64_t QueueTimeline::getSubmittedValue()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_submittedValue;
+}
+
+
+/*
+ * The timeline semaphore is added to the signaled semaphores, with the next value
+ */
+uint64_t QueueTimeline::submit(VkCommandBuffer const* _commandBuffers, uint32_t _commandBufferCount,
+                               std::vector<Wait> const& _waits, std::vector<VkSemaphore> const& _signals)
+{
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const auto& wait : _waits)
+    {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stageMask);
+    }
+
+    std::vector<VkSemaphore> signalSemaphores = _signals;
+    std::vector<uint64_t> signalValues(_signals.size(), 0);   // ignored for binary semaphores
+    signalSemaphores.push_back(m_semaphore);
+    signalValues.push_back(0);
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = _commandBufferCount;
+    submitInfo.pCommandBuffers = _commandBuffers;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    // the value is only taken if the submission succeeds
+    std::lock_guard<std::mutex> lock(m_mutex);
+    signalValues.back() = m_submittedValue + 1;
+    if (vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit command buffer!");
+    }
+    return ++m_submittedValue;
+}
+
+
+bool QueueTimeline::isComplete(VkDevice _device, uint64_t _value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (_value <= m_completedValue) {
+        return true;
+    }
+
+    uint64_t value = 0;
+    if (m_vkGetSemaphoreCounterValue(_device, m_semaphore, &value) != VK_SUCCESS) {
+        throw std::runtime_error("failed to read timeline semaphore!");
+    }
+    m_completedValue = std::max(m_completedValue, value);
+    return _value <= m_completedValue;
+}
+
+
+void QueueTimeline::wait(VkDevice _device, uint64_t _value)
+{
+    if (isComplete(_device, _value)) {
+        return;
+    }
+
+    VkSemaphoreWaitInfoKHR waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_semaphore;
+    waitInfo.pValues = &_value;
+
+    if (m_vkWaitSemaphores(_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_completedValue = std::max(m_completedValue, _value);
+}
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,122 @@
+/*********************************************************************************************************************
+ *
+ * queuetimeline.h
+ *
+ * Synchronization of a queue with a timeline semaphore (VK_KHR_timeline_semaphore, core in Vulkan 1.2):
+ * each submission signals the next value of a single counter, so the CPU waits for the exact submission it needs
+ * (a frame slot, an upload) instead of one fence per frame or vkQueueWaitIdle
+ * A signal includes all the batches submitted before it on the queue: once a value is reached, the submissions up
+ * to it are complete. Submissions can also wait for values of the timelines of other queues
+ * (swap chain acquire and present still use binary semaphores, the only ones they accept)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef QUEUETIMELINE_H
+#define QUEUETIMELINE_H
+
+
+#include "utils.h"
+
+#include <mutex>
+
+namespace VulkanDemo
+{
+
+
+class QueueTimeline
+{
+
+public:
+
+    /*
+     * Semaphore waited on by a submission (value ignored for binary semaphores)
+     */
+    struct Wait
+    {
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        uint64_t value = 0;
+        VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    };
+
+    QueueTimeline() = default;
+
+    // owns its semaphore, it cannot be duplicated
+    QueueTimeline(QueueTimeline const& _other) = delete;
+    QueueTimeline& operator=(QueueTimeline const& _other) = delete;
+
+    virtual ~QueueTimeline() {};
+
+
+    VkSemaphore const getSemaphore() const { return m_semaphore; }
+    // value signaled by the last submission
+    uint64_t getSubmittedValue();
+
+    void create(VkDevice _device, VkQueue _queue);
+    void cleanup(VkDevice _device);
+
+    // submits command buffers which signal the next value of the timeline (and _signals), returns that value
+    uint64_t submit(VkCommandBuffer const* _commandBuffers, uint32_t _commandBufferCount,
+                    std::vector<Wait> const& _waits = {}, std::vector<VkSemaphore> const& _signals = {});
+
+    // true once the queue has reached _value
+    bool isComplete(VkDevice _device, uint64_t _value);
+    // blocks until the queue reaches _value (returns at once if it already did)
+    void wait(VkDevice _device, uint64_t _value);
+
+
+protected:
+
+    VkQueue m_queue = VK_NULL_HANDLE;
+    VkSemaphore m_semaphore = VK_NULL_HANDLE;
+
+    uint64_t m_submittedValue = 0;
+    uint64_t m_completedValue = 0;      // last value known to be reached (avoids querying the semaphore)
+    std::mutex m_mutex;                 // values are signaled in submission order, whatever the thread submitting
+
+    PFN_vkWaitSemaphoresKHR m_vkWaitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR m_vkGetSemaphoreCounterValue = nullptr;
+
+}; // class QueueTimeline
+
+
+/*
+ * Helper function to submit a command buffer allocated by beginSingleTimeCommands(),
+ * and wait for its completion only (not for the other submissions in flight)
+ */
+inline void endSingleTimeCommands(VkDevice _device, VkCommandBuffer _commandBuffer, VkCommandPool _commandPool, QueueTimeline& _timeline)
+{
+    vkEndCommandBuffer(_commandBuffer);
+
+    _timeline.wait(_device, _timeline.submit(&_commandBuffer, 1));
+
+    vkFreeCommandBuffers(_device, _commandPool, 1, &_commandBuffer);
+}
+
+
+/*
+ * Helper function for buffer copy
+ */
+inline void copyBuffer(VkDevice _device, VkCommandPool _commandPool, QueueTimeline& _timeline, VkBuffer _srcBuffer, VkBuffer _dstBuffer, VkDeviceSize _size)
+{
+    // Memory transfer operations are executed using command buffers
+
+    // First allocate a temporary command buffer
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(_device, _commandPool);
+
+    // Copy operation
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = 0; // Optional
+    copyRegion.dstOffset = 0; // Optional
+    copyRegion.size = _size;
+    vkCmdCopyBuffer(commandBuffer, _srcBuffer, _dstBuffer, 1, &copyRegion);
+
+    // Ends the command buffer
+    endSingleTimeCommands(_device, commandBuffer, _commandPool, _timeline);
+}
+
+} // namespace VulkanDemo
+
+#endif // QUEUETIMELINE_H
\ No newline at end of file
@@ -0,0 +1,840 @@
+/*********************************************************************************************************************
+ *
+ * rendergraph.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+
+#include "rendergraph.h"
+#include "context.h"
+#include "deletionqueue.h"
+#include "gputimer.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Layout, stages and accesses of an image for a given usage
+ */
+RenderGraph::UsageState RenderGraph::getUsageState(Usage _usage, VkImageAspectFlags _aspect)
+{
+    switch (_usage)
+    {
+        case Usage::ColorAttachment:
+            return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true };
+        case Usage::DepthAttachment:
+            return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true };
+        case Usage::ResolveAttachment:
+            return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true };
+        case Usage::TransferSrc:
+            return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, false };
+        case Usage::ComputeRead:
+            return { getReadLayout(_aspect), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, false };
+        case Usage::TransferDst:
+        default:
+            return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true };
+    }
+}
+
+
+/*
+ * Layout of an image sampled by a compute pass (to be given in its descriptors)
+ */
+VkImageLayout RenderGraph::getReadLayout(VkImageAspectFlags _aspect)
+{
+    return (_aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+
+/*
+ * Declares an image created (and owned) by the graph
+ */
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& _name, const ImageDesc& _desc)
+{
+    Resource resource;
+    resource.name = _name;
+    resource.desc = _desc;
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+
+/*
+ * Declares images owned by someone else (e.g., the swap chain, one image per index given to execute()),
+ * left in _finalLayout after their last pass
+ */
+RenderGraph::ResourceHandle RenderGraph::importImages(const std::string& _name, const ImageDesc& _desc,
+                                                      const std::vector<VkImage>& _images, const std::vector<VkImageView>& _imageViews, VkImageLayout _finalLayout)
+{
+    Resource resource;
+    resource.name = _name;
+    resource.desc = _desc;
+    resource.imported = true;
+    resource.finalLayout = _finalLayout;
+    resource.images = _images;
+    resource.imageViews = _imageViews;
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+
+/*
+ * Declares a pass with a single subpass, writing color attachments (resolved if _resolves is not empty) and an optional depth attachment
+ */
+RenderGraph::PassHandle RenderGraph::addGraphicsPass(const std::string& _name,
+                                                     const std::vector<ResourceHandle>& _colors, ResourceHandle _depth, const std::vector<ResourceHandle>& _resolves,
+                                                     RecordFunction _record)
+{
+    if (!_resolves.empty() && _resolves.size() != _colors.size()) {
+        throw std::runtime_error("render graph: one resolve attachment per color attachment is required!");
+    }
+
+    // attachments are numbered in this order: colors, resolves, depth
+    Pass pass;
+    pass.name = _name;
+    pass.graphics = true;
+    pass.record = _record;
+    for (ResourceHandle color : _colors) {
+        pass.uses.push_back({ color, Usage::ColorAttachment });
+    }
+    for (ResourceHandle resolve : _resolves) {
+        pass.uses.push_back({ resolve, Usage::ResolveAttachment });
+    }
+    if (_depth != NO_RESOURCE) {
+        pass.uses.push_back({ _depth, Usage::DepthAttachment });
+    }
+
+    for (const auto& use : pass.uses)
+    {
+        if (use.resource >= m_resources.size()) {
+            throw std::runtime_error("render graph: invalid resource in pass " + _name + "!");
+        }
+        if (use.usage == Usage::ColorAttachment) {
+            pass.colorFormats.push_back(m_resources[use.resource].desc.format);
+        }
+        else if (use.usage == Usage::DepthAttachment) {
+            pass.depthFormat = m_resources[use.resource].desc.format;
+        }
+    }
+    m_passes.push_back(pass);
+    return static_cast<PassHandle>(m_passes.size() - 1);
+}
+
+
+/*
+ * Declares a pass recording transfer commands (copies, blits)
+ */
+RenderGraph::PassHandle RenderGraph::addTransferPass(const std::string& _name,
+                                                     const std::vector<ResourceHandle>& _reads, const std::vector<ResourceHandle>& _writes,
+                                                     RecordFunction _record)
+{
+    Pass pass;
+    pass.name = _name;
+    pass.graphics = false;
+    pass.record = _record;
+    for (ResourceHandle read : _reads) {
+        pass.uses.push_back({ read, Usage::TransferSrc });
+    }
+    for (ResourceHandle write : _writes) {
+        pass.uses.push_back({ write, Usage::TransferDst });
+    }
+    m_passes.push_back(pass);
+    return static_cast<PassHandle>(m_passes.size() - 1);
+}
+
+
+/*
+ * Declares a pass recording compute dispatches, sampling images written by previous passes
+ * (the images and buffers written by the dispatches are not tracked by the graph)
+ */
+RenderGraph::PassHandle RenderGraph::addComputePass(const std::string& _name, const std::vector<ResourceHandle>& _reads, RecordFunction _record)
+{
+    Pass pass;
+    pass.name = _name;
+    pass.graphics = false;
+    pass.record = _record;
+    for (ResourceHandle read : _reads) {
+        pass.uses.push_back({ read, Usage::ComputeRead });
+    }
+    m_passes.push_back(pass);
+    return static_cast<PassHandle>(m_passes.size() - 1);
+}
+
+
+/*
+ * Derives lifetimes and usages of the images, creates them, then the render passes, framebuffers and barriers
+ */
+void RenderGraph::compile(Context& _context)
+{
+    if (m_dynamicRendering && m_vkCmdBeginRendering == nullptr)
+    {
+        m_vkCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(_context.getDevice(), "vkCmdBeginRenderingKHR"));
+        m_vkCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(_context.getDevice(), "vkCmdEndRenderingKHR"));
+        if (m_vkCmdBeginRendering == nullptr || m_vkCmdEndRendering == nullptr) {
+            throw std::runtime_error("failed to load dynamic rendering functions!");
+        }
+    }
+
+    // 1. -----------------------------------------------------------------------------------------
+    // lifetimes and usage flags
+    for (uint32_t p = 0; p < m_passes.size(); p++)
+    {
+        for (const auto& use : m_passes[p].uses)
+        {
+            if (use.resource >= m_resources.size()) {
+                throw std::runtime_error("render graph: invalid resource in pass " + m_passes[p].name + "!");
+            }
+            Resource& resource = m_resources[use.resource];
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+
+            switch (use.usage)
+            {
+                case Usage::ColorAttachment:
+                case Usage::ResolveAttachment:  resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+                case Usage::DepthAttachment:    resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+                case Usage::TransferSrc:        resource.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; break;
+                case Usage::TransferDst:        resource.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; break;
+                case Usage::ComputeRead:        resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+            }
+        }
+    }
+
+    // an attachment only used inside one pass never needs to reach memory
+    for (auto& resource : m_resources)
+    {
+        const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        resource.transient = !resource.imported
+                          && resource.firstPass == resource.lastPass
+                          && (resource.usage & ~attachmentUsage) == 0;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // images owned by the graph
+    createImages(_context);
+
+    // 3. -----------------------------------------------------------------------------------------
+    // render passes and barriers
+    compilePasses(_context);
+
+    size_t transientCount = std::count_if(m_resources.begin(), m_resources.end(), [](const Resource& _resource) { return _resource.transient; });
+    size_t lazyCount = std::count_if(m_memoryBlocks.begin(), m_memoryBlocks.end(), [](const MemoryBlock& _block) { return _block.lazy; });
+    infoLog() << "RenderGraph::compile(): " + std::to_string(m_passes.size()) + " passes, " + std::to_string(m_resources.size()) + " images ("
+               + std::to_string(transientCount) + " transient), " + std::to_string(m_memoryBlocks.size()) + " memory blocks ("
+               + std::to_string(lazyCount) + " lazily allocated), " + (m_dynamicRendering ? "dynamic rendering" : "render passes");
+}
+
+
+/*
+ * Creates the images owned by the graph, and binds them to memory blocks:
+ * transient attachments get lazily allocated memory if available,
+ * other images share a block with images whose lifetimes do not overlap
+ */
+void RenderGraph::createImages(Context& _context)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(_context.getPhysicalDevice(), &memProperties);
+
+    auto hasLazyMemory = [&memProperties](uint32_t _memoryTypeBits)
+    {
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        {
+            if ((_memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // 1. -----------------------------------------------------------------------------------------
+    // create images and query their requirements
+    std::vector<VkMemoryRequirements> requirements(m_resources.size());
+    std::vector<ResourceHandle> aliasable;
+
+    for (ResourceHandle r = 0; r < m_resources.size(); r++)
+    {
+        Resource& resource = m_resources[r];
+        if (resource.imported || resource.usage == 0) {
+            continue;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = resource.desc.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = resource.usage | (resource.transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+        imageInfo.samples = resource.desc.samples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkImage image;
+        if (vkCreateImage(_context.getDevice(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image " + resource.name + "!");
+        }
+        resource.images = { image };
+        vkGetImageMemoryRequirements(_context.getDevice(), image, &requirements[r]);
+
+        if (resource.transient && hasLazyMemory(requirements[r].memoryTypeBits))
+        {
+            MemoryBlock block;
+            block.size = requirements[r].size;
+            block.memoryTypeBits = requirements[r].memoryTypeBits;
+            block.lazy = true;
+            block.resources = { r };
+            resource.memoryBlock = static_cast<uint32_t>(m_memoryBlocks.size());
+            m_memoryBlocks.push_back(block);
+        }
+        else
+        {
+            aliasable.push_back(r);
+        }
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // aliasing: largest images first, each one joins the first block it does not overlap in time
+    std::sort(aliasable.begin(), aliasable.end(), [&requirements](ResourceHandle _a, ResourceHandle _b) { return requirements[_a].size > requirements[_b].size; });
+
+    for (ResourceHandle r : aliasable)
+    {
+        Resource& resource = m_resources[r];
+        bool assigned = false;
+
+        for (uint32_t b = 0; b < m_memoryBlocks.size() && !assigned; b++)
+        {
+            MemoryBlock& block = m_memoryBlocks[b];
+            if (block.lazy || (block.memoryTypeBits & requirements[r].memoryTypeBits) == 0) {
+                continue;
+            }
+
+            bool overlaps = std::any_of(block.resources.begin(), block.resources.end(), [this, &resource](ResourceHandle _other)
+            {
+                const Resource& other = m_resources[_other];
+                return !(other.lastPass < resource.firstPass || resource.lastPass < other.firstPass);
+            });
+            if (overlaps) {
+                continue;
+            }
+
+            block.size = std::max(block.size, requirements[r].size);
+            block.memoryTypeBits &= requirements[r].memoryTypeBits;
+            block.resources.push_back(r);
+            resource.memoryBlock = b;
+            assigned = true;
+        }
+
+        if (!assigned)
+        {
+            MemoryBlock block;
+            block.size = requirements[r].size;
+            block.memoryTypeBits = requirements[r].memoryTypeBits;
+            block.resources = { r };
+            resource.memoryBlock = static_cast<uint32_t>(m_memoryBlocks.size());
+            m_memoryBlocks.push_back(block);
+        }
+    }
+
+    // 3. -----------------------------------------------------------------------------------------
+    // allocate blocks, bind images (all at offset 0) and create views
+    for (auto& block : m_memoryBlocks)
+    {
+        VkMemoryRequirements blockRequirements{};
+        blockRequirements.size = block.size;
+        blockRequirements.memoryTypeBits = block.memoryTypeBits;
+        block.memory = _context.getMemoryBudget().allocate(_context.getDevice(), blockRequirements,
+                                                           block.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                           MemoryCategory::Attachment);
+
+        std::sort(block.resources.begin(), block.resources.end(), [this](ResourceHandle _a, ResourceHandle _b) { return m_resources[_a].firstPass < m_resources[_b].firstPass; });
+
+        for (ResourceHandle r : block.resources)
+        {
+            Resource& resource = m_resources[r];
+            vkBindImageMemory(_context.getDevice(), resource.images[0], block.memory, 0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = resource.images[0];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.desc.format;
+            viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            VkImageView imageView;
+            if (vkCreateImageView(_context.getDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image view " + resource.name + "!");
+            }
+            resource.imageViews = { imageView };
+        }
+    }
+}
+
+
+/*
+ * Walks the passes in order, tracking the state of each image, to build render passes and barriers
+ */
+void RenderGraph::compilePasses(Context& _context)
+{
+    // last use of a resource in the frame
+    auto lastUsage = [this](ResourceHandle _resource)
+    {
+        const Resource& resource = m_resources[_resource];
+        for (const auto& use : m_passes[resource.lastPass].uses)
+        {
+            if (use.resource == _resource) {
+                return getUsageState(use.usage, resource.desc.aspect);
+            }
+        }
+        return UsageState{};
+    };
+
+    // 1. -----------------------------------------------------------------------------------------
+    // state before the first use: the content is discarded (undefined layout), but the memory may still be
+    // accessed by the previous image of the same block, or by the last pass of the previous frame
+    std::vector<UsageState> states(m_resources.size());
+    for (ResourceHandle r = 0; r < m_resources.size(); r++)
+    {
+        const Resource& resource = m_resources[r];
+        if (resource.imported)
+        {
+            // swap chain images: color attachment output stage chains with the wait on the image available semaphore
+            states[r].stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        else if (resource.memoryBlock != UINT32_MAX)
+        {
+            const auto& blockResources = m_memoryBlocks[resource.memoryBlock].resources;
+            auto it = std::find(blockResources.begin(), blockResources.end(), r);
+            ResourceHandle previous = (it == blockResources.begin()) ? blockResources.back() : *(it - 1);
+            states[r] = lastUsage(previous);
+        }
+        states[r].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    for (uint32_t p = 0; p < m_passes.size(); p++)
+    {
+        Pass& pass = m_passes[p];
+
+        if (pass.graphics && !m_dynamicRendering)
+        {
+            createRenderPass(_context, p, states);
+            continue;
+        }
+
+        // transfer or compute pass, or dynamic rendering: explicit barriers before, and after for images handed back to their owner
+        for (const auto& use : pass.uses)
+        {
+            Resource& resource = m_resources[use.resource];
+            UsageState previous = states[use.resource];
+            UsageState current = getUsageState(use.usage, resource.desc.aspect);
+
+            pass.barriers.push_back({ use.resource, previous.layout, current.layout, previous.write ? previous.access : 0, current.access });
+            pass.srcStages |= previous.stages;
+            pass.dstStages |= current.stages;
+
+            if (resource.imported && resource.lastPass == p && resource.finalLayout != current.layout)
+            {
+                pass.finalBarriers.push_back({ use.resource, current.layout, resource.finalLayout, current.access, 0 });
+                pass.finalStages |= current.stages;
+                current.layout = resource.finalLayout;
+            }
+            states[use.resource] = current;
+        }
+
+        if (pass.graphics) {
+            prepareRendering(p);
+        }
+    }
+}
+
+
+/*
+ * Attachments of a graphics pass recorded with dynamic rendering:
+ * same load/store ops as a render pass, layouts are already set by the barriers
+ */
+void RenderGraph::prepareRendering(uint32_t _passIndex)
+{
+    Pass& pass = m_passes[_passIndex];
+
+    for (const auto& use : pass.uses)
+    {
+        const Resource& resource = m_resources[use.resource];
+        bool first = (resource.firstPass == _passIndex);
+        bool last = (resource.lastPass == _passIndex);
+
+        VkRenderingAttachmentInfoKHR attachment{};
+        attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        attachment.imageLayout = getUsageState(use.usage, resource.desc.aspect).layout;
+        attachment.loadOp = first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachment.storeOp = (!last || resource.imported) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.clearValue = resource.desc.clearValue;
+
+        switch (use.usage)
+        {
+            case Usage::ColorAttachment:
+                pass.colorAttachments.push_back(attachment);
+                pass.colorResources.push_back(use.resource);
+                break;
+            case Usage::ResolveAttachment:
+                // resolve images are not attachments, but targets of the color attachment with the same index
+                pass.resolveResources.push_back(use.resource);
+                break;
+            case Usage::DepthAttachment:
+                pass.depthAttachment = attachment;
+                pass.depthResource = use.resource;
+                break;
+            default: break;
+        }
+        pass.extent = resource.desc.extent;
+    }
+
+    for (size_t i = 0; i < pass.resolveResources.size(); i++)
+    {
+        pass.colorAttachments[i].resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+        pass.colorAttachments[i].resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+}
+
+
+/*
+ * Creation of the render pass and framebuffers of a graphics pass:
+ * load/store ops and layouts follow the previous and next uses of each attachment
+ */
+void RenderGraph::createRenderPass(Context& _context, uint32_t _passIndex, std::vector<UsageState>& _states)
+{
+    Pass& pass = m_passes[_passIndex];
+
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> colorRefs;
+    std::vector<VkAttachmentReference> resolveRefs;
+    VkAttachmentReference depthRef{};
+    bool hasDepth = false;
+
+    // external dependency: previous accesses to the attachments (earlier pass, or previous frame)
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+
+    uint32_t framebufferCount = 1;
+
+    for (const auto& use : pass.uses)
+    {
+        const Resource& resource = m_resources[use.resource];
+        UsageState previous = _states[use.resource];
+        UsageState current = getUsageState(use.usage, resource.desc.aspect);
+        bool first = (resource.firstPass == _passIndex);
+        bool last = (resource.lastPass == _passIndex);
+
+        VkAttachmentDescription attachment{};
+        attachment.format = resource.desc.format;
+        attachment.samples = resource.desc.samples;
+        if (first) {
+            // resolve attachments are entirely overwritten
+            attachment.loadOp = (use.usage == Usage::ResolveAttachment) ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        }
+        else {
+            attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+        attachment.storeOp = (!last || resource.imported) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = previous.layout;
+        attachment.finalLayout = (last && resource.imported) ? resource.finalLayout : current.layout;
+
+        VkAttachmentReference reference{};
+        reference.attachment = static_cast<uint32_t>(attachments.size());
+        reference.layout = current.layout;
+
+        switch (use.usage)
+        {
+            case Usage::ColorAttachment:    colorRefs.push_back(reference); break;
+            case Usage::ResolveAttachment:  resolveRefs.push_back(reference); break;
+            case Usage::DepthAttachment:    depthRef = reference; hasDepth = true; break;
+            default: break;
+        }
+
+        attachments.push_back(attachment);
+        pass.clearValues.push_back(resource.desc.clearValue);
+        pass.extent = resource.desc.extent;
+        framebufferCount = std::max(framebufferCount, static_cast<uint32_t>(resource.imageViews.size()));
+
+        dependency.srcStageMask |= previous.stages;
+        dependency.srcAccessMask |= previous.write ? previous.access : 0;
+        dependency.dstStageMask |= current.stages;
+        dependency.dstAccessMask |= current.access;
+
+        _states[use.resource] = { attachment.finalLayout, current.stages, current.access, current.write };
+    }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+    subpass.pColorAttachments = colorRefs.data();
+    subpass.pResolveAttachments = resolveRefs.empty() ? nullptr : resolveRefs.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    if (vkCreateRenderPass(_context.getDevice(), &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass " + pass.name + "!");
+    }
+
+    // one framebuffer per swap chain image if one is attached
+    pass.framebuffers.resize(framebufferCount);
+    for (uint32_t f = 0; f < framebufferCount; f++)
+    {
+        std::vector<VkImageView> views;
+        for (const auto& use : pass.uses) {
+            views.push_back(getImageView(use.resource, f));
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = pass.renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        framebufferInfo.pAttachments = views.data();
+        framebufferInfo.width = pass.extent.width;
+        framebufferInfo.height = pass.extent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(_context.getDevice(), &framebufferInfo, nullptr, &pass.framebuffers[f]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create framebuffer!");
+        }
+    }
+}
+
+
+/*
+ * Records all the passes, with their barriers (and timestamps if a timer is set)
+ */
+void RenderGraph::execute(VkCommandBuffer _commandBuffer, uint32_t _imageIndex)
+{
+    for (uint32_t p = 0; p < m_passes.size(); p++)
+    {
+        Pass& pass = m_passes[p];
+
+        if (m_timer != nullptr) {
+            m_timer->recordPassBegin(_commandBuffer, p);
+        }
+
+        if (pass.graphics && m_dynamicRendering)
+        {
+            recordBarriers(_commandBuffer, _imageIndex, pass.barriers, pass.srcStages, pass.dstStages);
+
+            for (size_t i = 0; i < pass.colorAttachments.size(); i++)
+            {
+                pass.colorAttachments[i].imageView = getImageView(pass.colorResources[i], _imageIndex);
+                if (i < pass.resolveResources.size()) {
+                    pass.colorAttachments[i].resolveImageView = getImageView(pass.resolveResources[i], _imageIndex);
+                }
+            }
+            if (pass.depthResource != NO_RESOURCE) {
+                pass.depthAttachment.imageView = getImageView(pass.depthResource, _imageIndex);
+            }
+
+            VkRenderingInfoKHR renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+            renderingInfo.renderArea.offset = { 0, 0 };
+            renderingInfo.renderArea.extent = pass.extent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = static_cast<uint32_t>(pass.colorAttachments.size());
+            renderingInfo.pColorAttachments = pass.colorAttachments.data();
+            renderingInfo.pDepthAttachment = (pass.depthResource != NO_RESOURCE) ? &pass.depthAttachment : nullptr;
+
+            m_vkCmdBeginRendering(_commandBuffer, &renderingInfo);
+            pass.record(_commandBuffer, _imageIndex);
+            m_vkCmdEndRendering(_commandBuffer);
+
+            recordBarriers(_commandBuffer, _imageIndex, pass.finalBarriers, pass.finalStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        }
+        else if (pass.graphics)
+        {
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = pass.renderPass;
+            renderPassInfo.framebuffer = pass.framebuffers[(pass.framebuffers.size() == 1) ? 0 : _imageIndex];
+            renderPassInfo.renderArea.offset = { 0, 0 };
+            renderPassInfo.renderArea.extent = pass.extent;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+            renderPassInfo.pClearValues = pass.clearValues.data();
+
+            vkCmdBeginRenderPass(_commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            pass.record(_commandBuffer, _imageIndex);
+            vkCmdEndRenderPass(_commandBuffer);
+        }
+        else
+        {
+            recordBarriers(_commandBuffer, _imageIndex, pass.barriers, pass.srcStages, pass.dstStages);
+            pass.record(_commandBuffer, _imageIndex);
+            recordBarriers(_commandBuffer, _imageIndex, pass.finalBarriers, pass.finalStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        }
+
+        if (m_timer != nullptr) {
+            m_timer->recordPassEnd(_commandBuffer, p);
+        }
+    }
+}
+
+
+/*
+ * Records one pipeline barrier for a list of image transitions
+ */
+void RenderGraph::recordBarriers(VkCommandBuffer _commandBuffer, uint32_t _imageIndex,
+                                 const std::vector<Barrier>& _barriers, VkPipelineStageFlags _srcStages, VkPipelineStageFlags _dstStages)
+{
+    if (_barriers.empty()) {
+        return;
+    }
+
+    m_barrierScratch.clear();
+    for (const auto& barrier : _barriers)
+    {
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.oldLayout = barrier.oldLayout;
+        imageBarrier.newLayout = barrier.newLayout;
+        imageBarrier.srcAccessMask = barrier.srcAccess;
+        imageBarrier.dstAccessMask = barrier.dstAccess;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = getImage(barrier.resource, _imageIndex);
+        imageBarrier.subresourceRange.aspectMask = m_resources[barrier.resource].desc.aspect;
+        imageBarrier.subresourceRange.baseMipLevel = 0;
+        imageBarrier.subresourceRange.levelCount = 1;
+        imageBarrier.subresourceRange.baseArrayLayer = 0;
+        imageBarrier.subresourceRange.layerCount = 1;
+        m_barrierScratch.push_back(imageBarrier);
+    }
+
+    vkCmdPipelineBarrier(_commandBuffer, _srcStages, _dstStages, 0, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(m_barrierScratch.size()), m_barrierScratch.data());
+}
+
+
+VkImage RenderGraph::getImage(ResourceHandle _resource, uint32_t _imageIndex) const
+{
+    const auto& images = m_resources[_resource].images;
+    return images[(images.size() == 1) ? 0 : _imageIndex];
+}
+
+
+VkImageView RenderGraph::getImageView(ResourceHandle _resource, uint32_t _imageIndex) const
+{
+    const auto& imageViews = m_resources[_resource].imageViews;
+    return imageViews[(imageViews.size() == 1) ? 0 : _imageIndex];
+}
+
+
+/*
+ * Destroys render passes, framebuffers, and the images owned by the graph
+ */
+void RenderGraph::cleanup(Context& _context)
+{
+    for (auto& pass : m_passes)
+    {
+        for (auto framebuffer : pass.framebuffers) {
+            vkDestroyFramebuffer(_context.getDevice(), framebuffer, nullptr);
+        }
+        vkDestroyRenderPass(_context.getDevice(), pass.renderPass, nullptr);
+    }
+    for (auto& resource : m_resources)
+    {
+        if (resource.imported) {
+            continue;
+        }
+        for (auto imageView : resource.imageViews) {
+            vkDestroyImageView(_context.getDevice(), imageView, nullptr);
+        }
+        for (auto image : resource.images) {
+            vkDestroyImage(_context.getDevice(), image, nullptr);
+        }
+    }
+    for (auto& block : m_memoryBlocks) {
+        _context.getMemoryBudget().free(_context.getDevice(), block.memory);
+    }
+
+    m_passes.clear();
+    m_resources.clear();
+    m_memoryBlocks.clear();
+}
+
+
+/*
+ * Hands all the objects of the graph over to the deletion queue (frames in flight may still use them)
+ */
+void RenderGraph::retire(Context& _context)
+{
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkRenderPass> renderPasses;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkImage> images;
+    std::vector<VkDeviceMemory> memories;
+
+    for (auto& pass : m_passes)
+    {
+        framebuffers.insert(framebuffers.end(), pass.framebuffers.begin(), pass.framebuffers.end());
+        renderPasses.push_back(pass.renderPass);
+    }
+    for (auto& resource : m_resources)
+    {
+        if (!resource.imported)
+        {
+            imageViews.insert(imageViews.end(), resource.imageViews.begin(), resource.imageViews.end());
+            images.insert(images.end(), resource.images.begin(), resource.images.end());
+        }
+    }
+    for (auto& block : m_memoryBlocks) {
+        memories.push_back(block.memory);
+    }
+
+    MemoryBudget* memoryBudget = &_context.getMemoryBudget();
+    _context.getDeletionQueue().retire([framebuffers, renderPasses, imageViews, images, memories, memoryBudget](VkDevice _device)
+    {
+        for (auto framebuffer : framebuffers) {
+            vkDestroyFramebuffer(_device, framebuffer, nullptr);
+        }
+        for (auto renderPass : renderPasses) {
+            vkDestroyRenderPass(_device, renderPass, nullptr);
+        }
+        for (auto imageView : imageViews) {
+            vkDestroyImageView(_device, imageView, nullptr);
+        }
+        for (auto image : images) {
+            vkDestroyImage(_device, image, nullptr);
+        }
+        for (auto memory : memories) {
+            memoryBudget->free(_device, memory);
+        }
+    });
+
+    m_passes.clear();
+    m_resources.clear();
+    m_memoryBlocks.clear();
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,205 @@
+/*********************************************************************************************************************
+ *
+ * rendergraph.h
+ *
+ * Frame described as a list of passes declaring which images they read and write
+ * compile() derives from these declarations the render passes (load/store ops, initial/final layouts,
+ * subpass dependencies), the barriers between passes, and the images owned by the graph:
+ * attachments used by a single pass are transient (lazily allocated memory where supported),
+ * and images whose lifetimes do not overlap share the same memory
+ * With dynamic rendering (VK_KHR_dynamic_rendering), graphics passes use vkCmdBeginRendering() and explicit
+ * barriers instead: no VkRenderPass nor VkFramebuffer is created
+ * Compute passes read images through samplers, and only get barriers
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+
+#include "utils.h"
+
+#include <string>
+
+namespace VulkanDemo
+{
+
+class Context;
+class GpuTimer;
+
+
+class RenderGraph
+{
+
+public:
+
+    using ResourceHandle = uint32_t;
+    using PassHandle = uint32_t;
+    using RecordFunction = std::function<void(VkCommandBuffer _commandBuffer, uint32_t _imageIndex)>;
+
+    static constexpr ResourceHandle NO_RESOURCE = UINT32_MAX;
+
+    struct ImageDesc
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = { 0, 0 };
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        VkClearValue clearValue{};      // used when the first pass of the frame writes it as an attachment
+    };
+
+    RenderGraph() = default;
+
+    RenderGraph(RenderGraph const& _other) = default;
+    RenderGraph& operator=(RenderGraph const& _other) = default;
+
+    virtual ~RenderGraph() {};
+
+
+    // declaration (in execution order), then compile()
+    ResourceHandle createImage(const std::string& _name, const ImageDesc& _desc);
+    ResourceHandle importImages(const std::string& _name, const ImageDesc& _desc,
+                                const std::vector<VkImage>& _images, const std::vector<VkImageView>& _imageViews, VkImageLayout _finalLayout);
+
+    PassHandle addGraphicsPass(const std::string& _name,
+                               const std::vector<ResourceHandle>& _colors, ResourceHandle _depth, const std::vector<ResourceHandle>& _resolves,
+                               RecordFunction _record);
+    PassHandle addTransferPass(const std::string& _name,
+                               const std::vector<ResourceHandle>& _reads, const std::vector<ResourceHandle>& _writes,
+                               RecordFunction _record);
+    PassHandle addComputePass(const std::string& _name, const std::vector<ResourceHandle>& _reads, RecordFunction _record);
+
+    // must be set before compile(), requires DeviceCapabilities::dynamicRendering
+    void setDynamicRendering(bool _enabled) { m_dynamicRendering = _enabled; }
+    bool isDynamicRendering() const { return m_dynamicRendering; }
+
+    // timestamps around each pass in execute() (nullptr: no measure)
+    void setTimer(GpuTimer* _timer) { m_timer = _timer; }
+
+    void compile(Context& _context);
+    void execute(VkCommandBuffer _commandBuffer, uint32_t _imageIndex);
+
+    // graph is empty afterwards, and can be declared again
+    void cleanup(Context& _context);
+    void retire(Context& _context);
+
+    VkRenderPass getRenderPass(PassHandle _pass) const { return m_passes[_pass].renderPass; }  // VK_NULL_HANDLE with dynamic rendering
+    const std::vector<VkFormat>& getColorFormats(PassHandle _pass) const { return m_passes[_pass].colorFormats; }
+    VkFormat getDepthFormat(PassHandle _pass) const { return m_passes[_pass].depthFormat; }
+    VkExtent2D getExtent(PassHandle _pass) const { return m_passes[_pass].extent; }
+    const std::string& getPassName(PassHandle _pass) const { return m_passes[_pass].name; }
+    uint32_t getPassCount() const { return static_cast<uint32_t>(m_passes.size()); }
+    VkImage getImage(ResourceHandle _resource, uint32_t _imageIndex) const;
+    VkImageView getImageView(ResourceHandle _resource, uint32_t _imageIndex) const;
+    static VkImageLayout getReadLayout(VkImageAspectFlags _aspect);     // layout of the images read by compute passes
+
+
+protected:
+
+    enum class Usage { ColorAttachment, DepthAttachment, ResolveAttachment, TransferSrc, TransferDst, ComputeRead };
+
+    struct UsageState
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        bool write = false;
+    };
+
+    struct ResourceUse
+    {
+        ResourceHandle resource;
+        Usage usage;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        ImageDesc desc;
+        bool imported = false;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;  // imported: layout expected after the last pass
+        std::vector<VkImage> images;                            // one per swap chain image if imported, one otherwise
+        std::vector<VkImageView> imageViews;
+
+        // filled by compile()
+        VkImageUsageFlags usage = 0;
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        bool transient = false;
+        uint32_t memoryBlock = UINT32_MAX;
+    };
+
+    struct Barrier
+    {
+        ResourceHandle resource;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        bool graphics = false;
+        std::vector<ResourceUse> uses;
+        RecordFunction record;
+        std::vector<VkFormat> colorFormats;         // graphics passes: needed to create compatible pipelines
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+        // filled by compile()
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer> framebuffers;    // one per swap chain image if an imported image is attached
+        VkExtent2D extent = { 0, 0 };
+        std::vector<VkClearValue> clearValues;
+        std::vector<Barrier> barriers;              // transfer passes and dynamic rendering: before recording
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<Barrier> finalBarriers;         // imported images to their final layout
+        VkPipelineStageFlags finalStages = 0;
+
+        // dynamic rendering: attachments, completed with the image views in execute()
+        std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+        VkRenderingAttachmentInfoKHR depthAttachment{};
+        std::vector<ResourceHandle> colorResources;
+        std::vector<ResourceHandle> resolveResources;
+        ResourceHandle depthResource = NO_RESOURCE;
+    };
+
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeBits = 0;
+        bool lazy = false;
+        std::vector<ResourceHandle> resources;      // sorted by first pass
+    };
+
+    static UsageState getUsageState(Usage _usage, VkImageAspectFlags _aspect);
+
+    void createImages(Context& _context);
+    void compilePasses(Context& _context);
+    void createRenderPass(Context& _context, uint32_t _passIndex, std::vector<UsageState>& _states);
+    void prepareRendering(uint32_t _passIndex);
+    void recordBarriers(VkCommandBuffer _commandBuffer, uint32_t _imageIndex,
+                        const std::vector<Barrier>& _barriers, VkPipelineStageFlags _srcStages, VkPipelineStageFlags _dstStages);
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<MemoryBlock> m_memoryBlocks;
+    std::vector<VkImageMemoryBarrier> m_barrierScratch;     // avoids an allocation per pass in execute()
+
+    bool m_dynamicRendering = false;
+    PFN_vkCmdBeginRenderingKHR m_vkCmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR m_vkCmdEndRendering = nullptr;
+
+    GpuTimer* m_timer = nullptr;
+
+}; // class RenderGraph
+
+} // namespace VulkanDemo
+
+#endif // RENDERGRAPH_H
\ No newline at end of file
@@ -0,0 +1,123 @@
+/*********************************************************************************************************************
+ *
+ * samplercache.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "samplercache.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Compares all the parameters of two sampler create infos
+ */
+bool SamplerCache::SamplerKey::operator==(SamplerKey const& _other) const
+{
+    VkSamplerCreateInfo const& a = createInfo;
+    VkSamplerCreateInfo const& b = _other.createInfo;
+
+    return a.flags == b.flags &&
+           a.magFilter == b.magFilter &&
+           a.minFilter == b.minFilter &&
+           a.mipmapMode == b.mipmapMode &&
+           a.addressModeU == b.addressModeU &&
+           a.addressModeV == b.addressModeV &&
+           a.addressModeW == b.addressModeW &&
+           a.mipLodBias == b.mipLodBias &&
+           a.anisotropyEnable == b.anisotropyEnable &&
+           a.maxAnisotropy == b.maxAnisotropy &&
+           a.compareEnable == b.compareEnable &&
+           a.compareOp == b.compareOp &&
+           a.minLod == b.minLod &&
+           a.maxLod == b.maxLod &&
+           a.borderColor == b.borderColor &&
+           a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+
+/*
+ * Hashes all the parameters of a sampler create info
+ */
+size_t SamplerCache::SamplerKeyHash::operator()(SamplerKey const& _key) const
+{
+    VkSamplerCreateInfo const& info = _key.createInfo;
+
+    size_t seed = 0;
+    hashCombine(seed, info.flags);
+    hashCombine(seed, info.magFilter);
+    hashCombine(seed, info.minFilter);
+    hashCombine(seed, info.mipmapMode);
+    hashCombine(seed, info.addressModeU);
+    hashCombine(seed, info.addressModeV);
+    hashCombine(seed, info.addressModeW);
+    hashCombine(seed, info.mipLodBias);
+    hashCombine(seed, info.anisotropyEnable);
+    hashCombine(seed, info.maxAnisotropy);
+    hashCombine(seed, info.compareEnable);
+    hashCombine(seed, info.compareOp);
+    hashCombine(seed, info.minLod);
+    hashCombine(seed, info.maxLod);
+    hashCombine(seed, info.borderColor);
+    hashCombine(seed, info.unnormalizedCoordinates);
+    return seed;
+}
+
+
+/*
+ * Returns a sampler matching the given parameters, creates it on first request
+ */
+VkSampler SamplerCache::getSampler(VkDevice _device, VkSamplerCreateInfo const& _createInfo)
+{
+    if (_createInfo.pNext != nullptr) {
+        throw std::invalid_argument("sampler cache does not support chained create infos!");
+    }
+
+    SamplerKey key{ _createInfo };
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_samplers.find(key);
+    if (it != m_samplers.end())
+    {
+        m_hits++;
+        return it->second;
+    }
+
+    VkSampler sampler;
+    if (vkCreateSampler(_device, &_createInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    m_misses++;
+    m_samplers.emplace(key, sampler);
+
+    return sampler;
+}
+
+
+/*
+ * Destroys all the cached samplers
+ */
+void SamplerCache::cleanup(VkDevice _device)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    infoLog() << "sampler cache: " + std::to_string(m_samplers.size()) + " samplers, "
+               + std::to_string(m_hits) + " hits, " + std::to_string(m_misses) + " misses";
+
+    for (auto& entry : m_samplers)
+    {
+        vkDestroySampler(_device, entry.second, nullptr);
+    }
+    m_samplers.clear();
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*********************************************************************************************************************
+ *
+ * samplercache.h
+ *
+ * Cache of VkSampler objects, shared between all the images created with the same parameters
+ * Samplers are immutable, so a single VkSampler can be bound to any number of textures
+ * (and the number of sampler objects is capped by maxSamplerAllocationCount)
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef SAMPLERCACHE_H
+#define SAMPLERCACHE_H
+
+
+#include "utils.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace VulkanDemo
+{
+
+
+class SamplerCache
+{
+
+public:
+
+    SamplerCache() = default;
+
+    // samplers are owned by the cache, it cannot be duplicated
+    SamplerCache(SamplerCache const& _other) = delete;
+    SamplerCache& operator=(SamplerCache const& _other) = delete;
+
+    virtual ~SamplerCache() {};
+
+
+    uint32_t getHits() const { return m_hits; }
+    uint32_t getMisses() const { return m_misses; }
+    size_t getSize() const { return m_samplers.size(); }
+
+    VkSampler getSampler(VkDevice _device, VkSamplerCreateInfo const& _createInfo);
+
+    void cleanup(VkDevice _device);
+
+
+protected:
+
+    /*
+     * Key of the cache: the sampler creation parameters (pNext chains are not supported)
+     */
+    struct SamplerKey
+    {
+        VkSamplerCreateInfo createInfo;
+
+        bool operator==(SamplerKey const& _other) const;
+    };
+
+    struct SamplerKeyHash
+    {
+        size_t operator()(SamplerKey const& _key) const;
+    };
+
+    std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> m_samplers;
+    std::mutex m_mutex;         // samplers may be requested by loading threads
+    uint32_t m_hits = 0;        // nb of requests served by an existing sampler
+    uint32_t m_misses = 0;      // nb of requests that created a new sampler
+
+}; // class SamplerCache
+
+} // namespace VulkanDemo
+
+#endif // SAMPLERCACHE_H
\ No newline at end of file
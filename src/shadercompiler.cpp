@@ -0,0 +1,336 @@
+/*********************************************************************************************************************
+ *
+ * shadercompiler.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+
+#ifdef USE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+#include "shadercompiler.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+namespace
+{
+    // bumped when the compilation options change, so that older cached files are not used
+    constexpr const char* CACHE_VERSION = "1";
+}
+
+
+/*
+ * Sets the folders of the GLSL sources (and precompiled SPIR-V) and of the cache (created if needed)
+ */
+void ShaderCompiler::init(const std::string& _shaderDir, const std::string& _cacheDir)
+{
+    m_shaderDir = _shaderDir;
+    m_cacheDir = _cacheDir;
+
+#ifdef USE_SHADERC
+    std::error_code error;
+    std::filesystem::create_directories(m_cacheDir, error);
+    if (error) {
+        infoLog() << "ShaderCompiler::init(): cannot create " + m_cacheDir + ", shaders are not cached ";
+    }
+#endif
+}
+
+
+std::string ShaderCompiler::readText(const std::string& _path)
+{
+    std::ifstream file(_path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open shader source " + _path + "!");
+    }
+
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+
+/*
+ * Replaces the #include "file" lines by the content of the files (same folder), and lists the files read
+ */
+void ShaderCompiler::expandIncludes(const std::string& _name, std::string& _text, std::vector<std::string>& _files, uint32_t _depth)
+{
+    if (_depth > MAX_INCLUDE_DEPTH) {
+        throw std::runtime_error("too many nested includes in shader " + _name + "!");
+    }
+
+    std::string path = m_shaderDir + _name;
+    _files.push_back(path);
+
+    std::istringstream source(readText(path));
+    std::string line;
+    while (std::getline(source, line))
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+        {
+            size_t first = line.find('"', start);
+            size_t last = line.find('"', first + 1);
+            if (first == std::string::npos || last == std::string::npos) {
+                throw std::runtime_error("invalid include in shader " + _name + "!");
+            }
+            expandIncludes(line.substr(first + 1, last - first - 1), _text, _files, _depth + 1);
+        }
+        else
+        {
+            _text += line;
+            _text += '\n';
+        }
+    }
+}
+
+
+/*
+ * Most recent modification time of a list of files (files being saved are ignored)
+ */
+std::filesystem::file_time_type ShaderCompiler::getLastWrite(const std::vector<std::string>& _files)
+{
+    std::filesystem::file_time_type lastWrite = std::filesystem::file_time_type::min();
+    for (const auto& file : _files)
+    {
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(file, error);
+        if (!error) {
+            lastWrite = std::max(lastWrite, time);
+        }
+    }
+    return lastWrite;
+}
+
+
+/*
+ * SPIR-V of a variant: from the cache if it exists, compiled (and cached) otherwise
+ * (returns false with the compiler messages if the compilation failed)
+ */
+bool ShaderCompiler::compileVariant(Variant& _variant, std::vector<char>& _spirv, std::string& _error)
+{
+    _variant.files.clear();
+
+#ifdef USE_SHADERC
+    // 1. -----------------------------------------------------------------------------------------
+    // key of the cache: expanded source, defines and stage
+    std::string text;
+    expandIncludes(_variant.sourceName, text, _variant.files, 0);
+    _variant.lastWrite = getLastWrite(_variant.files);
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hashBytes(hash, CACHE_VERSION);
+    hashBytes(hash, _variant.sourceName);
+    for (const auto& define : _variant.defines) {
+        hashBytes(hash, define);
+    }
+    hashBytes(hash, text);
+
+    std::ostringstream cacheName;
+    cacheName << m_cacheDir << _variant.sourceName << "." << std::hex << std::setw(16) << std::setfill('0') << hash << ".spv";
+    std::string cachePath = cacheName.str();
+
+    std::ifstream cached(cachePath, std::ios::ate | std::ios::binary);
+    if (cached.is_open())
+    {
+        _spirv.resize(static_cast<size_t>(cached.tellg()));
+        cached.seekg(0);
+        cached.read(_spirv.data(), _spirv.size());
+        m_cacheHits++;
+        return true;
+    }
+
+    // 2. -----------------------------------------------------------------------------------------
+    // compilation
+    std::string extension = std::filesystem::path(_variant.sourceName).extension().string();
+    shaderc_shader_kind kind = (extension == ".vert") ? shaderc_glsl_vertex_shader
+                             : (extension == ".frag") ? shaderc_glsl_fragment_shader
+                             : shaderc_glsl_compute_shader;
+
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);   // instance API version
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    for (const auto& define : _variant.defines)
+    {
+        size_t separator = define.find('=');
+        if (separator == std::string::npos) {
+            options.AddMacroDefinition(define);
+        }
+        else {
+            options.AddMacroDefinition(define.substr(0, separator), define.substr(separator + 1));
+        }
+    }
+
+    shaderc::Compiler compiler;
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(text, kind, _variant.sourceName.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+    {
+        _error = result.GetErrorMessage();
+        return false;
+    }
+
+    const char* code = reinterpret_cast<const char*>(result.cbegin());
+    _spirv.assign(code, code + (result.cend() - result.cbegin()) * sizeof(uint32_t));
+    m_cacheMisses++;
+
+    // 3. -----------------------------------------------------------------------------------------
+    // written next to its final name, then renamed: a cached file is never read partially
+    // (unique temporary name: two threads may compile the same variant at once, both rename the same content)
+    std::string tempPath = cachePath + "." + std::to_string(m_tempFiles++) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(_spirv.data(), _spirv.size());
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error)
+    {
+        std::filesystem::remove(tempPath, error);
+        infoLog() << "ShaderCompiler: cannot write " + cachePath + " ";
+    }
+    return true;
+#else
+    // precompiled file (glslc, see README)
+    _variant.files.push_back(m_shaderDir + _variant.spirvName);
+    _variant.lastWrite = getLastWrite(_variant.files);
+    _spirv = GLtools::readFile(m_shaderDir + _variant.spirvName);
+    return true;
+#endif
+}
+
+
+/*
+ * Returns the SPIR-V of a shader, and watches its files
+ */
+std::vector<char> ShaderCompiler::load(const std::string& _sourceName, const std::vector<std::string>& _defines, const std::string& _spirvName)
+{
+    Variant variant;
+    variant.sourceName = _sourceName;
+    variant.defines = _defines;
+    variant.spirvName = _spirvName;
+
+    std::vector<char> spirv;
+    std::string error;
+    if (!compileVariant(variant, spirv, error)) {
+        throw std::runtime_error("failed to compile shader " + _sourceName + "!\n" + error);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = std::find_if(m_variants.begin(), m_variants.end(), [&variant](const Variant& _other)
+                              { return _other.sourceName == variant.sourceName && _other.defines == variant.defines; });
+    if (found == m_variants.end()) {
+        m_variants.push_back(variant);
+    }
+    else {
+        *found = variant;
+    }
+    return spirv;
+}
+
+
+/*
+ * Starts the thread watching the shader files
+ */
+void ShaderCompiler::startWatching()
+{
+    if (m_watcher.joinable()) {
+        return;
+    }
+
+    m_stopping = false;
+    m_watcher = std::thread(&ShaderCompiler::watch, this);
+    infoLog() << "ShaderCompiler: watching " + m_shaderDir + " ";
+}
+
+
+void ShaderCompiler::stopWatching()
+{
+    if (!m_watcher.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_stopCondition.notify_all();
+    m_watcher.join();
+}
+
+
+/*
+ * Watching thread: compiles the variants whose files changed into the cache
+ * (a variant failing to compile is reported once, and keeps its previous pipelines)
+ */
+void ShaderCompiler::watch()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopCondition.wait_for(lock, std::chrono::milliseconds(WATCH_PERIOD_MS), [this]() { return m_stopping; }))
+    {
+        std::vector<Variant> variants = m_variants;
+        lock.unlock();
+
+        std::vector<std::pair<Variant, bool>> modified;     // variant, compiled
+        for (auto& variant : variants)
+        {
+            if (getLastWrite(variant.files) <= variant.lastWrite) {
+                continue;
+            }
+
+            std::vector<char> spirv;
+            std::string error;
+            bool compiled = false;
+            try {
+                compiled = compileVariant(variant, spirv, error);
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+                variant.lastWrite = getLastWrite(variant.files);
+            }
+
+            if (!compiled) {
+                infoLog() << "ShaderCompiler: " + variant.sourceName + " not reloaded\n" + error;
+            }
+            modified.push_back({ variant, compiled });
+        }
+
+        lock.lock();
+        for (const auto& [variant, compiled] : modified)
+        {
+            for (auto& other : m_variants)
+            {
+                if (other.sourceName == variant.sourceName && other.defines == variant.defines) {
+                    other = variant;
+                }
+            }
+            if (compiled && std::find(m_reloaded.begin(), m_reloaded.end(), variant.sourceName) == m_reloaded.end()) {
+                m_reloaded.push_back(variant.sourceName);
+            }
+        }
+    }
+}
+
+
+std::vector<std::string> ShaderCompiler::takeReloaded()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> reloaded;
+    reloaded.swap(m_reloaded);
+    return reloaded;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,103 @@
+/*********************************************************************************************************************
+ *
+ * shadercompiler.h
+ *
+ * Runtime compilation of the GLSL shaders (shaderc), with a SPIR-V cache on disk:
+ *  - cached files are keyed by a hash of the source (includes expanded), the defines and the stage,
+ *    so a warm start reads SPIR-V only, and an edited source is compiled once
+ *  - a worker thread watches the sources (and their includes) of the loaded shaders, compiles the modified ones
+ *    into the cache, and reports them to the main thread, which creates the pipelines using them again
+ * Without shaderc (USE_SHADERC not defined), the precompiled SPIR-V files are read (see README), and watched
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+
+
+#include "utils.h"
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+
+namespace VulkanDemo
+{
+
+
+class ShaderCompiler
+{
+
+public:
+
+    ShaderCompiler() = default;
+
+    // owns the watching thread, it cannot be duplicated
+    ShaderCompiler(ShaderCompiler const& _other) = delete;
+    ShaderCompiler& operator=(ShaderCompiler const& _other) = delete;
+
+    virtual ~ShaderCompiler() { stopWatching(); };
+
+
+    uint32_t getCacheHits() const { return m_cacheHits; }
+    uint32_t getCacheMisses() const { return m_cacheMisses; }
+
+    void init(const std::string& _shaderDir, const std::string& _cacheDir);
+
+    // SPIR-V of a shader of the shader folder, compiled with the given defines ("NAME" or "NAME=VALUE")
+    // (_spirvName: precompiled file, read without shaderc)
+    std::vector<char> load(const std::string& _sourceName, const std::vector<std::string>& _defines, const std::string& _spirvName);
+
+    // hot reload of the loaded shaders
+    void startWatching();
+    void stopWatching();
+    // used once per frame: sources recompiled since the last call (their pipelines must be created again)
+    std::vector<std::string> takeReloaded();
+
+
+protected:
+
+    static constexpr uint32_t WATCH_PERIOD_MS = 500;
+    static constexpr uint32_t MAX_INCLUDE_DEPTH = 8;
+
+    // a shader loaded with a set of defines
+    struct Variant
+    {
+        std::string sourceName;
+        std::vector<std::string> defines;
+        std::string spirvName;
+        std::vector<std::string> files;                 // source and includes (or precompiled file), watched
+        std::filesystem::file_time_type lastWrite;      // most recent modification of the files, when loaded
+    };
+
+    std::string readText(const std::string& _path);
+    void expandIncludes(const std::string& _name, std::string& _text, std::vector<std::string>& _files, uint32_t _depth);
+    std::filesystem::file_time_type getLastWrite(const std::vector<std::string>& _files);
+    bool compileVariant(Variant& _variant, std::vector<char>& _spirv, std::string& _error);
+    void watch();
+
+    std::string m_shaderDir;
+    std::string m_cacheDir;
+
+    std::vector<Variant> m_variants;
+    std::vector<std::string> m_reloaded;
+    std::mutex m_mutex;                 // variants and reloaded sources, shared with the watching thread
+    std::atomic<uint32_t> m_cacheHits = 0;
+    std::atomic<uint32_t> m_cacheMisses = 0;
+    std::atomic<uint32_t> m_tempFiles = 0;      // suffix of the next temporary file written to the cache
+
+    std::thread m_watcher;
+    std::condition_variable m_stopCondition;
+    bool m_stopping = false;
+
+}; // class ShaderCompiler
+
+} // namespace VulkanDemo
+
+#endif // SHADERCOMPILER_H
\ No newline at end of file
@@ -0,0 +1,61 @@
+// clustered point lights, included by the fragment shaders
+// (lights and light lists of the clusters, written by ClusteredLights)
+
+const uint CLUSTER_COUNT = 16 * 9 * 24;         // ClusteredLights::CLUSTER_COUNT
+const uint MAX_LIGHTS_PER_CLUSTER = 256;        // ClusteredLights::MAX_LIGHTS_PER_CLUSTER
+
+struct PointLight
+{
+    vec4 positionRadius;    // view space position, radius
+    vec4 color;
+};
+
+layout(std430, binding = 6) readonly buffer Lights
+{
+    mat4 invProj;
+    uvec4 grid;             // nb of clusters along x, y and z, nb of lights
+    vec4 params;            // render extent, near and far planes
+    PointLight lights[];
+} lights;
+
+layout(std430, binding = 7) readonly buffer Clusters
+{
+    uint counts[CLUSTER_COUNT];
+    uint indices[];         // MAX_LIGHTS_PER_CLUSTER per cluster
+} clusters;
+
+
+// diffuse lighting of the lights of the cluster containing the fragment
+vec3 computePointLights(vec3 _viewPos, vec3 _viewNormal, vec3 _albedo)
+{
+    if (lights.grid.w == 0u) {
+        return vec3(0.0);
+    }
+
+    // cluster of the fragment: screen tile, and depth slice (same distribution as cluster_lights.comp)
+    uvec3 grid = lights.grid.xyz;
+    float near = lights.params.z;
+    float far = lights.params.w;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / (lights.params.xy / vec2(grid.xy))), grid.xy - 1u);
+    float slice = log(max(-_viewPos.z, near) / near) / log(far / near) * float(grid.z);
+    uint clusterIndex = tile.x + tile.y * grid.x + min(uint(slice), grid.z - 1u) * grid.x * grid.y;
+
+    vec3 normal = normalize(_viewNormal);
+    vec3 result = vec3(0.0);
+
+    uint count = clusters.counts[clusterIndex];
+    for (uint i = 0u; i < count; i++)
+    {
+        PointLight light = lights.lights[clusters.indices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]];
+        vec3 toLight = light.positionRadius.xyz - _viewPos;
+        float distance = length(toLight);
+
+        // smooth falloff, null at the radius of the light
+        float ratio = distance / light.positionRadius.w;
+        float falloff = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+        float attenuation = falloff * falloff / (distance * distance + 1.0);
+
+        result += _albedo * light.color.rgb * max(0.0, dot(normal, toLight / max(distance, 1e-4))) * attenuation;
+    }
+    return result;
+}
\ No newline at end of file
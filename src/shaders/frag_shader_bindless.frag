@@ -0,0 +1,25 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 fragLightDir;
+layout(location = 4) flat in uint fragMaterialIndex;
+layout(location = 5) in vec3 fragViewPos;
+layout(location = 6) in vec3 fragViewNormal;
+
+#include "shading.glsl"
+
+// all the textures of the scene (bindless), indexed by material
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() 
+{
+    vec3 albedo = TEXTURED ? fragColor * texture(textures[nonuniformEXT(fragMaterialIndex)], fragTexCoord * TEXCOORD_SCALE).rgb : fragColor;
+
+    outColor = shade(albedo, fragNormal, fragLightDir, fragViewPos, fragViewNormal);
+}
\ No newline at end of file
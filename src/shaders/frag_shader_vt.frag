@@ -0,0 +1,100 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 fragLightDir;
+layout(location = 5) in vec3 fragViewPos;
+layout(location = 6) in vec3 fragViewNormal;
+
+#include "shading.glsl"
+
+// virtual texture page table: header, then one entry per virtual page (all mips, row by row)
+// entry = atlas x (12 bits) | atlas y (12 bits) | resident mip (7 bits) | valid (1 bit)
+layout(std430, binding = 2) readonly buffer PageTable
+{
+    uint width;
+    uint height;
+    uint tileSize;
+    uint border;
+    uint atlasPages;
+    uint mipCount;
+    uint pad0;
+    uint pad1;
+    uint entries[];
+} pageTable;
+
+// physical atlas containing the resident tiles
+layout(binding = 3) uniform sampler2D atlasSampler;
+
+// feedback: pages requested by this frame
+layout(std430, binding = 4) writeonly buffer Feedback
+{
+    uint requested[];
+} feedback;
+
+layout(location = 0) out vec4 outColor;
+
+
+// nb of pages of a mip level
+uvec2 pageCount(uint _mip)
+{
+    uvec2 mipSize = max(uvec2(1), uvec2(pageTable.width, pageTable.height) >> _mip);
+    return (mipSize + pageTable.tileSize - 1) / pageTable.tileSize;
+}
+
+// coordinates of the page containing _uv in a mip level
+uvec2 pageCoords(vec2 _uv, uint _mip)
+{
+    vec2 mipSize = vec2(max(uvec2(1), uvec2(pageTable.width, pageTable.height) >> _mip));
+    return min(uvec2(_uv * mipSize) / pageTable.tileSize, pageCount(_mip) - 1);
+}
+
+// index of a page in the page table (and feedback buffer)
+uint pageIndex(uint _mip, uvec2 _page)
+{
+    uint offset = 0;
+    for (uint m = 0; m < _mip; m++)
+    {
+        uvec2 count = pageCount(m);
+        offset += count.x * count.y;
+    }
+    return offset + _page.y * pageCount(_mip).x + _page.x;
+}
+
+vec4 sampleVirtualTexture(vec2 _uv)
+{
+    // requested mip, from screen-space derivatives of the virtual texel coordinates
+    vec2 texel = _uv * vec2(pageTable.width, pageTable.height);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    uint mip = uint(clamp(floor(lod), 0.0, float(pageTable.mipCount - 1)));
+
+    vec2 uv = fract(_uv); // repeat addressing
+    uint index = pageIndex(mip, pageCoords(uv, mip));
+    feedback.requested[index] = 1;
+
+    // the entry points to the requested page, or to its closest resident ancestor
+    uint entry = pageTable.entries[index];
+    uvec2 slot = uvec2(entry & 0xFFF, (entry >> 12) & 0xFFF);
+    uint residentMip = (entry >> 24) & 0x7F;
+
+    vec2 mipSize = vec2(max(uvec2(1), uvec2(pageTable.width, pageTable.height) >> residentMip));
+    vec2 page = vec2(pageCoords(uv, residentMip));
+    vec2 inPage = clamp(uv * mipSize - page * float(pageTable.tileSize), 0.0, float(pageTable.tileSize));
+
+    float paddedTileSize = float(pageTable.tileSize + 2 * pageTable.border);
+    vec2 atlasTexel = vec2(slot) * paddedTileSize + float(pageTable.border) + inPage;
+
+    return textureLod(atlasSampler, atlasTexel / (paddedTileSize * float(pageTable.atlasPages)), 0.0);
+}
+
+void main()
+{
+    // untextured: no page is requested
+    vec3 albedo = TEXTURED ? fragColor * sampleVirtualTexture(fragTexCoord * TEXCOORD_SCALE).rgb : fragColor;
+
+    outColor = shade(albedo, fragNormal, fragLightDir, fragViewPos, fragViewNormal);
+}
\ No newline at end of file
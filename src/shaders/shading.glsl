@@ -0,0 +1,28 @@
+// shading of the scene, included by the fragment shaders
+// (variant of the pipeline: specialization constants set by PipelineKey, the disabled branches are compiled out)
+
+#include "clustered_lights.glsl"
+
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const uint LIGHTING_MODEL = 1;
+layout(constant_id = 2) const float TEXCOORD_SCALE = 1.0;
+
+const uint LIGHTING_UNLIT = 0;          // PipelineKey::LIGHTING_UNLIT
+const uint LIGHTING_DIFFUSE = 1;        // PipelineKey::LIGHTING_DIFFUSE
+const uint LIGHTING_NORMALS = 2;        // PipelineKey::LIGHTING_NORMALS
+
+
+// final color of a fragment
+vec4 shade(vec3 _albedo, vec3 _normal, vec3 _lightDir, vec3 _viewPos, vec3 _viewNormal)
+{
+    if (LIGHTING_MODEL == LIGHTING_NORMALS) {
+        return vec4(0.5 * _normal + 0.5, 1.0); // display normals
+    }
+    if (LIGHTING_MODEL == LIGHTING_UNLIT) {
+        return vec4(_albedo, 1.0);
+    }
+
+    vec3 amb = _albedo * 0.05; // ambient color
+    vec3 diff = _albedo * max(0.0, dot(_normal, _lightDir)); // diffuse color
+    return vec4(amb + diff + computePointLights(_viewPos, _viewNormal, _albedo), 1.0);
+}
\ No newline at end of file
@@ -2,36 +2,83 @@
 
 
 // UNIFORMS INPUT  (set = 0 is optionnal, only used in case of multiple descriptor sets)
-layout(set = 0, binding = 0) uniform UniformBufferObject
+// (both are dynamic uniform buffers, sub-allocated in the same ring buffer)
+layout(set = 0, binding = 0) uniform FrameUniforms
 {
-    mat4 model;
     mat4 view;
     mat4 proj;
     vec3 lightPos;
-} ubo;
+} frame;
+
+#ifdef USE_PUSH_CONSTANTS
+// per-draw data, recorded in the command buffer (fast path)
+layout(push_constant) uniform ObjectPushConstants
+{
+    mat4 model;
+    uint objectId;
+    uint materialIndex;
+} object;
+#else
+layout(set = 0, binding = 5) uniform ObjectUniforms
+{
+    mat4 model;
+    uint materialIndex;
+} object;
+#endif
 
 
-// ATTRIBUTE INPUT (i.e., vertex buffer data)
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNormal;
+// VERTEX INPUT: attributes of all the meshes, one stream each in the geometry pool
+// (fetched with gl_VertexIndex, which includes the vertex offset of the draw)
+layout(std430, set = 0, binding = 8) readonly buffer Positions { float positions[]; };
+layout(std430, set = 0, binding = 9) readonly buffer Colors { float colors[]; };
+layout(std430, set = 0, binding = 10) readonly buffer TexCoords { float texCoords[]; };
+layout(std430, set = 0, binding = 11) readonly buffer Normals { float normals[]; };
+
+// parts of the model (selected by the first instance of the draw): transformation relative to the object,
+// and material (NO_MATERIAL: the one of the object)
+const uint NO_MATERIAL = 0xFFFFFFFFu;
+struct Part
+{
+    mat4 transform;
+    uint materialIndex;
+};
+layout(std430, set = 0, binding = 12) readonly buffer Parts { Part parts[]; };
 
 // OUTPUT 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragNormal;
 layout(location = 3) out vec3 fragLightDir;
+layout(location = 4) flat out uint fragMaterialIndex; // index in the bindless textures array
+layout(location = 5) out vec3 fragViewPos;      // view space position and normal (clustered point lights)
+layout(location = 6) out vec3 fragViewNormal;
+
+// same depth as in the depth pre-pass (vert_shader_depth.vert)
+invariant gl_Position;
 
 void main() 
 {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    uint v = uint(gl_VertexIndex);
+    vec3 inPosition = vec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+    vec3 inColor = vec3(colors[3 * v], colors[3 * v + 1], colors[3 * v + 2]);
+    vec2 inTexCoord = vec2(texCoords[2 * v], texCoords[2 * v + 1]);
+    vec3 inNormal = vec3(normals[3 * v], normals[3 * v + 1], normals[3 * v + 2]);
+
+    Part part = parts[gl_InstanceIndex];
+    mat4 model = object.model * part.transform;
+
+    gl_Position = frame.proj * frame.view * model * vec4(inPosition, 1.0);
     //gl_Position = vec4(inPosition, 0.0, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 
     fragNormal = inNormal; // normal in model space
-    vec4 lightPos = inverse(ubo.view * ubo.model) * vec4(ubo.lightPos.rgb, 1.0); // light position (next to the camera) in model space
+    vec4 lightPos = inverse(frame.view * model) * vec4(frame.lightPos.rgb, 1.0); // light position (next to the camera) in model space
     fragLightDir = normalize(lightPos.rgb - inPosition); // light direction vector
+    fragMaterialIndex = (part.materialIndex != NO_MATERIAL) ? part.materialIndex : object.materialIndex;
+
+    mat4 modelView = frame.view * model;
+    fragViewPos = (modelView * vec4(inPosition, 1.0)).xyz;
+    fragViewNormal = mat3(modelView) * inNormal;
     
 }
@@ -0,0 +1,51 @@
+#version 450
+
+
+// depth pre-pass: positions only, no fragment shader
+// (same uniforms and transformation as vert_shader.vert, gl_Position is invariant in both
+// so that the shading pass can use an EQUAL depth test)
+layout(set = 0, binding = 0) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 proj;
+    vec3 lightPos;
+} frame;
+
+#ifdef USE_PUSH_CONSTANTS
+layout(push_constant) uniform ObjectPushConstants
+{
+    mat4 model;
+    uint objectId;
+    uint materialIndex;
+} object;
+#else
+layout(set = 0, binding = 5) uniform ObjectUniforms
+{
+    mat4 model;
+    uint materialIndex;
+} object;
+#endif
+
+
+// positions stream of the geometry pool only (fetched with gl_VertexIndex)
+layout(std430, set = 0, binding = 8) readonly buffer Positions { float positions[]; };
+
+// transformations of the parts of the model (selected by the first instance of the draw)
+struct Part
+{
+    mat4 transform;
+    uint materialIndex;
+};
+layout(std430, set = 0, binding = 12) readonly buffer Parts { Part parts[]; };
+
+invariant gl_Position;
+
+void main() 
+{
+    uint v = uint(gl_VertexIndex);
+    vec3 inPosition = vec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+
+    mat4 model = object.model * parts[gl_InstanceIndex].transform;
+
+    gl_Position = frame.proj * frame.view * model * vec4(inPosition, 1.0);
+}
\ No newline at end of file
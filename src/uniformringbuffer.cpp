@@ -0,0 +1,97 @@
+/*********************************************************************************************************************
+ *
+ * uniformringbuffer.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX 
+#include <algorithm>
+#include <cstring>
+
+#include "uniformringbuffer.h"
+#include "context.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Alignment required for dynamic uniform buffer offsets
+ */
+VkDeviceSize UniformRingBuffer::queryAlignment(Context& _context)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_context.getPhysicalDevice(), &properties);
+    return std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+}
+
+
+/*
+ * Allocates one host visible buffer for all the frames in flight, and keeps it mapped
+ */
+void UniformRingBuffer::create(Context& _context, VkDeviceSize _frameCapacity, uint32_t _framesInFlight)
+{
+    m_alignment = queryAlignment(_context);
+    m_frameCapacity = alignSize(_frameCapacity, m_alignment);
+    VkDeviceSize bufferSize = m_frameCapacity * _framesInFlight;
+
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), bufferSize,
+                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniform,
+                                            m_buffer, m_bufferMemory);
+
+    vkMapMemory(_context.getDevice(), m_bufferMemory, 0, bufferSize, 0, reinterpret_cast<void**>(&m_bufferMapped));
+
+    m_frameStart = 0;
+    m_head = 0;
+
+    infoLog() << "UniformRingBuffer::create(): " + std::to_string(bufferSize) + " bytes, alignment " + std::to_string(m_alignment);
+}
+
+
+/*
+ * Unmaps and destroys the buffer
+ */
+void UniformRingBuffer::cleanup(Context& _context)
+{
+    vkUnmapMemory(_context.getDevice(), m_bufferMemory);
+    vkDestroyBuffer(_context.getDevice(), m_buffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_bufferMemory);
+    m_bufferMapped = nullptr;
+}
+
+
+/*
+ * Rewinds the region of a frame in flight (its timeline value must be reached)
+ */
+void UniformRingBuffer::beginFrame(uint32_t _frameIndex)
+{
+    m_frameStart = m_frameCapacity * _frameIndex;
+    m_head = m_frameStart;
+}
+
+
+/*
+ * Copies data into the region of the current frame, returns its dynamic offset
+ */
+uint32_t UniformRingBuffer::push(void const* _data, VkDeviceSize _size)
+{
+    VkDeviceSize alignedSize = alignSize(_size, m_alignment);
+
+    if (m_head + alignedSize > m_frameStart + m_frameCapacity) {
+        throw std::runtime_error("uniform ring buffer overflow!");
+    }
+
+    std::memcpy(m_bufferMapped + m_head, _data, static_cast<size_t>(_size));
+
+    uint32_t offset = static_cast<uint32_t>(m_head);
+    m_head += alignedSize;
+    return offset;
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
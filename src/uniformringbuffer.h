@@ -0,0 +1,73 @@
+/*********************************************************************************************************************
+ *
+ * uniformringbuffer.h
+ *
+ * Single persistently mapped uniform buffer, split into one region per frame in flight
+ * Per-frame and per-object uniforms are sub-allocated in the region of the current frame
+ * (aligned on minUniformBufferOffsetAlignment), and bound through UNIFORM_BUFFER_DYNAMIC descriptors
+ * with the returned offsets, so any number of objects share the same buffer and descriptor set
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef UNIFORMRINGBUFFER_H
+#define UNIFORMRINGBUFFER_H
+
+
+#include "utils.h"
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+class UniformRingBuffer
+{
+
+public:
+
+    UniformRingBuffer() = default;
+
+    UniformRingBuffer(UniformRingBuffer const& _other) = default;
+    UniformRingBuffer& operator=(UniformRingBuffer const& _other) = default;
+
+    virtual ~UniformRingBuffer() {};
+
+
+    VkBuffer const getBuffer() const { return m_buffer; }
+    VkDeviceSize const getAlignment() const { return m_alignment; }
+    VkDeviceSize const getFrameCapacity() const { return m_frameCapacity; }
+    VkDeviceSize const getUsedSize() const { return m_head - m_frameStart; }
+
+    void create(Context& _context, VkDeviceSize _frameCapacity, uint32_t _framesInFlight);
+    void cleanup(Context& _context);
+
+    static VkDeviceSize queryAlignment(Context& _context);
+    static VkDeviceSize alignSize(VkDeviceSize _size, VkDeviceSize _alignment) { return (_size + _alignment - 1) & ~(_alignment - 1); }
+
+    void beginFrame(uint32_t _frameIndex);
+    uint32_t push(void const* _data, VkDeviceSize _size);
+
+    template <typename T>
+    uint32_t push(T const& _data) { return push(&_data, sizeof(T)); }
+
+
+protected:
+
+    VkBuffer m_buffer;
+    VkDeviceMemory m_bufferMemory;
+    uint8_t* m_bufferMapped = nullptr;
+
+    VkDeviceSize m_alignment = 256;     // minUniformBufferOffsetAlignment (power of two)
+    VkDeviceSize m_frameCapacity = 0;   // size of the region of each frame in flight
+    VkDeviceSize m_frameStart = 0;      // start of the region of the current frame
+    VkDeviceSize m_head = 0;            // next free byte in the region of the current frame
+
+}; // class UniformRingBuffer
+
+} // namespace VulkanDemo
+
+#endif // UNIFORMRINGBUFFER_H
\ No newline at end of file
@@ -20,13 +20,10 @@
 #include <set>
 #include <optional>
 #include <array>
+#include <functional>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES // handles data alignment automatically
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE // define a depth range of [0;1] instead of [-1;1] for the perspective projection matrix
-#include <glm/glm.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+// GLM configuration and hashing helpers, shared with the core library
+#include "core/coreutils.h"
 
 //#include <vulkan/vulkan.h>  // included by GLFW/glfw3.h below
 
@@ -45,21 +42,49 @@ namespace VulkanDemo
     const uint32_t WIDTH = 800;
     const uint32_t HEIGHT = 600;
 
-    const std::string MODEL_PATH = "../models/viking_room/viking_room.obj";
+    const std::string MODEL_PATH = "../models/viking_room/viking_room.obj";      // or a glTF 2.0 model (.glb, .gltf)
     const std::string TEXTURE_PATH = "../models/viking_room/viking_room.png";
+    const std::string VIRTUAL_TEXTURE_PATH = "../models/viking_room/viking_room.vtex"; // tiled copy of TEXTURE_PATH, generated if missing
+    const std::string SHADER_DIR = "../src/shaders/";              // GLSL sources and precompiled SPIR-V
+    const std::string SHADER_CACHE_DIR = "../src/shaders/cache/";  // SPIR-V compiled at runtime
+    const std::string MESH_CACHE_DIR = "cache/meshes/";             // compressed meshes of the Wavefront models (working directory)
 
 
     /*
-     * Structure to store data associated with vertex processing (i.e., MVP matrices and other uniforms)
+     * Structure to store uniforms shared by all objects of a frame (i.e., camera matrices and light)
      */
-    struct UniformBufferObject 
+    struct FrameUniforms 
     {
-        alignas(16) glm::mat4 model;
         alignas(16) glm::mat4 view;
         alignas(16) glm::mat4 proj;
         alignas(16) glm::vec3 lightPos;
     };
 
+    /*
+     * Structure to store uniforms specific to each drawn object (i.e., model matrix)
+     */
+    struct ObjectUniforms 
+    {
+        alignas(16) glm::mat4 model;
+        uint32_t materialIndex;
+    };
+
+    /*
+     * Per-draw data sent as push constants (fast path, replaces ObjectUniforms when supported)
+     */
+    struct ObjectPushConstants 
+    {
+        glm::mat4 model;
+        uint32_t objectId;
+        uint32_t materialIndex;
+    };
+
+    // binding of the per-object uniforms (bindings 1 to 4 are used by textures)
+    const uint32_t OBJECT_UBO_BINDING = 5;
+
+    // max nb of objects drawn per frame (i.e., per-object uniforms in the ring buffer)
+    const uint32_t MAX_OBJECTS = 4096;
+
 
 
     // List of validation layers to enable
@@ -69,7 +94,8 @@ namespace VulkanDemo
 
     // List of required device extensions
     const std::vector<const char*> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME // swap chain is the equivalent of default framebuffer
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME, // swap chain is the equivalent of default framebuffer
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME // synchronization of the frames and uploads (core in 1.2)
     };
 
 
@@ -116,6 +142,43 @@ namespace VulkanDemo
     }
 
 
+    /*
+     * Readable name of a present mode, for logs
+     */
+    inline std::string getPresentModeName(VkPresentModeKHR _presentMode)
+    {
+        switch (_presentMode)
+        {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR:     return "IMMEDIATE";
+            case VK_PRESENT_MODE_MAILBOX_KHR:       return "MAILBOX";
+            case VK_PRESENT_MODE_FIFO_KHR:          return "FIFO";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR:  return "FIFO_RELAXED";
+            default:                                return "UNKNOWN";
+        }
+    }
+
+
+    /*
+     * Checks if a single (optional) extension is available
+     */
+    inline bool checkDeviceExtensionSupport(VkPhysicalDevice _device, const char* _extensionName) 
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(_device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(_device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions) 
+        {
+            if (strcmp(extension.extensionName, _extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+
     /*
      * Checks if all of the requested extensions are available
      */
@@ -262,26 +325,6 @@ namespace VulkanDemo
     }
 
 
-    /*
-    * Helper function for command buffer allocation
-    */
-    inline void endSingleTimeCommands(VkDevice _device, VkCommandBuffer _commandBuffer, VkCommandPool _commandPool, VkQueue _graphicsQueue)
-    {
-        vkEndCommandBuffer(_commandBuffer);
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &_commandBuffer;
-
-        vkQueueSubmit(_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(_graphicsQueue);
-
-        vkFreeCommandBuffers(_device, _commandPool, 1, &_commandBuffer);
-    }
-
-
-
     /*
     * Helper function for buffer creation
     */
@@ -313,28 +356,6 @@ namespace VulkanDemo
         vkBindBufferMemory(_device, _buffer, _bufferMemory, 0);
     }
 
-    /*
-     * Helper function for buffer copy
-     */
-    inline void copyBuffer(VkDevice _device, VkCommandPool _commandPool, VkQueue _graphicsQueue, VkBuffer _srcBuffer, VkBuffer _dstBuffer, VkDeviceSize _size)
-    {
-        // Memory transfer operations are executed using command buffers
-
-        // First allocate a temporary command buffer
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(_device, _commandPool);
-
-        // Copy operation
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0; // Optional
-        copyRegion.dstOffset = 0; // Optional
-        copyRegion.size = _size;
-        vkCmdCopyBuffer(commandBuffer, _srcBuffer, _dstBuffer, 1, &copyRegion);
-
-        // Ends the command buffer
-        endSingleTimeCommands(_device, commandBuffer, _commandPool, _graphicsQueue);
-    }
-
-
     /*
      * Helper function to know if chosen depth format contains a stencil component
      */
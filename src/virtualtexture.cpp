@@ -0,0 +1,789 @@
+/*********************************************************************************************************************
+ *
+ * virtualtexture.cpp
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#define NOMINMAX
+#include <cstdint> // Necessary for uint32_t
+#include <algorithm> // Necessary for std::clamp
+#include <cstring>
+
+#include <stb_image.h>
+
+#include "virtualtexture.h"
+#include "context.h"
+#include "core/imageprocessing.h"
+
+
+
+namespace VulkanDemo
+{
+
+
+/*
+ * Nb of pages of a mip level, horizontally
+ */
+uint32_t TiledTextureFile::getPagesX(uint32_t _mip) const
+{
+    uint32_t mipWidth = std::max(1u, m_header.width >> _mip);
+    return (mipWidth + m_header.tileSize - 1) / m_header.tileSize;
+}
+
+
+/*
+ * Nb of pages of a mip level, vertically
+ */
+uint32_t TiledTextureFile::getPagesY(uint32_t _mip) const
+{
+    uint32_t mipHeight = std::max(1u, m_header.height >> _mip);
+    return (mipHeight + m_header.tileSize - 1) / m_header.tileSize;
+}
+
+
+/*
+ * Index of the first page of each mip level (pages are stored mip by mip, row by row)
+ */
+void TiledTextureFile::computeMipOffsets()
+{
+    m_mipOffsets.resize(m_header.mipCount + 1);
+    m_mipOffsets[0] = 0;
+    for (uint32_t mip = 0; mip < m_header.mipCount; mip++)
+    {
+        m_mipOffsets[mip + 1] = m_mipOffsets[mip] + getPagesX(mip) * getPagesY(mip);
+    }
+}
+
+
+/*
+ * Retrieves mip level and page coordinates from a page index
+ */
+void TiledTextureFile::getPageCoords(uint32_t _pageIndex, uint32_t& _mip, uint32_t& _x, uint32_t& _y) const
+{
+    _mip = 0;
+    while (_pageIndex >= m_mipOffsets[_mip + 1]) {
+        _mip++;
+    }
+
+    uint32_t localIndex = _pageIndex - m_mipOffsets[_mip];
+    _x = localIndex % getPagesX(_mip);
+    _y = localIndex / getPagesX(_mip);
+}
+
+
+/*
+ * Opens a tiled texture file and reads its header
+ */
+void TiledTextureFile::open(std::string const& _path)
+{
+    m_file.open(_path, std::ios::binary);
+    if (!m_file.is_open()) {
+        throw std::runtime_error("failed to open virtual texture file!");
+    }
+
+    m_file.read(reinterpret_cast<char*>(&m_header), sizeof(TiledTextureHeader));
+
+    TiledTextureHeader reference;
+    if (!m_file || std::memcmp(m_header.magic, reference.magic, sizeof(reference.magic)) != 0 || m_header.version != reference.version) {
+        throw std::runtime_error("invalid virtual texture file!");
+    }
+
+    computeMipOffsets();
+
+    infoLog() << "virtual texture: " + std::to_string(m_header.width) + "x" + std::to_string(m_header.height)
+               + ", " + std::to_string(m_header.mipCount) + " mips, " + std::to_string(getPageCount()) + " pages";
+}
+
+
+/*
+ * Reads the pixels of one tile (padded with its border)
+ */
+void TiledTextureFile::readTile(uint32_t _pageIndex, uint8_t* _dst)
+{
+    std::streamoff offset = sizeof(TiledTextureHeader) + static_cast<std::streamoff>(_pageIndex) * getTileBytes();
+
+    m_file.seekg(offset);
+    m_file.read(reinterpret_cast<char*>(_dst), getTileBytes());
+
+    if (!m_file) {
+        throw std::runtime_error("failed to read virtual texture tile!");
+    }
+}
+
+
+/*
+ * Converts an image into a tiled texture file (offline step)
+ * The mip chain is generated with a box filter, and each tile is padded with a border of pixels
+ * duplicated from its neighbours (clamped to the edge of the image)
+ * Mips are written one at a time: only a level and the next one are in memory (1.25x the source at most)
+ */
+void TiledTextureFile::convert(std::string const& _srcPath, std::string const& _dstPath, uint32_t _tileSize, uint32_t _border)
+{
+    int texWidth, texHeight, texChannels;
+    if (!stbi_info(_srcPath.c_str(), &texWidth, &texHeight, &texChannels)) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+    if (static_cast<uint64_t>(texWidth) * static_cast<uint64_t>(texHeight) > MAX_CONVERT_PIXELS)
+    {
+        throw std::runtime_error("failed to convert " + _srcPath + " into a virtual texture: " + std::to_string(texWidth) + "x"
+                                 + std::to_string(texHeight) + " pixels, the converter is limited to " + std::to_string(MAX_CONVERT_PIXELS) + " pixels!");
+    }
+
+    stbi_uc* pixels = stbi_load(_srcPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+
+    TiledTextureFile tiled;
+    tiled.m_header.width = static_cast<uint32_t>(texWidth);
+    tiled.m_header.height = static_cast<uint32_t>(texHeight);
+    tiled.m_header.tileSize = _tileSize;
+    tiled.m_header.border = _border;
+    tiled.m_header.mipCount = 1;
+    while (std::max(tiled.m_header.width >> (tiled.m_header.mipCount - 1), tiled.m_header.height >> (tiled.m_header.mipCount - 1)) > _tileSize) {
+        tiled.m_header.mipCount++;
+    }
+    tiled.computeMipOffsets();
+
+    std::ofstream file(_dstPath, std::ios::binary);
+    if (!file.is_open())
+    {
+        stbi_image_free(pixels);
+        throw std::runtime_error("failed to create virtual texture file!");
+    }
+
+    file.write(reinterpret_cast<char const*>(&tiled.m_header), sizeof(TiledTextureHeader));
+
+    uint32_t padded = tiled.getPaddedTileSize();
+    std::vector<uint8_t> tile(tiled.getTileBytes());
+
+    // level being written (the decoded image for mip 0), and the next one
+    std::vector<uint8_t> level;
+    std::vector<uint8_t> nextLevel;
+    for (uint32_t mip = 0; mip < tiled.m_header.mipCount; mip++)
+    {
+        int32_t mipWidth = static_cast<int32_t>(std::max(1u, tiled.m_header.width >> mip));
+        int32_t mipHeight = static_cast<int32_t>(std::max(1u, tiled.m_header.height >> mip));
+        const uint8_t* src = (mip == 0) ? pixels : level.data();
+
+        for (uint32_t pageY = 0; pageY < tiled.getPagesY(mip); pageY++)
+        {
+            for (uint32_t pageX = 0; pageX < tiled.getPagesX(mip); pageX++)
+            {
+                for (uint32_t y = 0; y < padded; y++)
+                {
+                    int32_t srcY = std::clamp(static_cast<int32_t>(pageY * _tileSize + y) - static_cast<int32_t>(_border), 0, mipHeight - 1);
+                    for (uint32_t x = 0; x < padded; x++)
+                    {
+                        int32_t srcX = std::clamp(static_cast<int32_t>(pageX * _tileSize + x) - static_cast<int32_t>(_border), 0, mipWidth - 1);
+                        std::memcpy(&tile[(y * padded + x) * 4], &src[(static_cast<size_t>(srcY) * mipWidth + srcX) * 4], 4);
+                    }
+                }
+                file.write(reinterpret_cast<char const*>(tile.data()), tile.size());
+            }
+        }
+
+        // next level, then the current one is released
+        if (mip + 1 < tiled.m_header.mipCount)
+        {
+            downsampleBox(src, static_cast<uint32_t>(mipWidth), static_cast<uint32_t>(mipHeight), nextLevel);
+            level.swap(nextLevel);
+            nextLevel = std::vector<uint8_t>();
+        }
+        if (mip == 0) {
+            stbi_image_free(pixels);
+        }
+    }
+
+    if (!file) {
+        throw std::runtime_error("failed to write virtual texture file!");
+    }
+
+    infoLog() << "convert(): " + _dstPath + " OK ";
+}
+
+
+
+/*
+ * Creates the atlas, page table and feedback buffers, makes the coarsest mip resident,
+ * and starts the streaming thread
+ */
+void VirtualTexture::create(Context& _context, std::string const& _path, uint32_t _framesInFlight)
+{
+    m_file.open(_path);
+
+    TiledTextureHeader const& header = m_file.getHeader();
+    uint32_t pageCount = m_file.getPageCount();
+    uint32_t slotCount = ATLAS_PAGES * ATLAS_PAGES;
+    VkDeviceSize tileBytes = m_file.getTileBytes();
+
+    m_pageToSlot.assign(pageCount, INVALID_SLOT);
+    m_slotToPage.assign(slotCount, INVALID_SLOT);
+    m_slotLastUsed.assign(slotCount, 0);
+
+    m_pageTable.assign(PAGE_TABLE_HEADER_SIZE + pageCount, 0);
+    m_pageTable[0] = header.width;
+    m_pageTable[1] = header.height;
+    m_pageTable[2] = header.tileSize;
+    m_pageTable[3] = header.border;
+    m_pageTable[4] = ATLAS_PAGES;
+    m_pageTable[5] = header.mipCount;
+    m_pageTableSize = sizeof(uint32_t) * m_pageTable.size();
+
+
+    // 1. -----------------------------------------------------------------------------------------
+    // Physical atlas, bounded size
+    uint32_t atlasSize = ATLAS_PAGES * m_file.getPaddedTileSize();
+    m_atlas.createImage(_context,
+                        atlasSize, atlasSize, VK_SAMPLE_COUNT_1_BIT,
+                        VK_FORMAT_R8G8B8A8_SRGB,
+                        VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_atlas.createImageView(_context, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // no mipmaps nor anisotropy in the atlas: the mip is selected through the page table
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.mipLodBias = 0.0f;
+    m_atlasSampler = _context.getSamplerCache().getSampler(_context.getDevice(), samplerInfo);
+
+
+    // 2. -----------------------------------------------------------------------------------------
+    // Page table (device local, updated by transfers) and feedback buffers (read back by the host)
+    _context.getMemoryBudget().createBuffer(_context.getDevice(), m_pageTableSize,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Texture,
+                                            m_pageTableBuffer, m_pageTableBufferMemory);
+
+    VkDeviceSize feedbackSize = sizeof(uint32_t) * pageCount;
+    VkDeviceSize stagingSize = MAX_UPLOADS_PER_FRAME * tileBytes + m_pageTableSize;
+
+    m_feedbackBuffers.resize(_framesInFlight);
+    m_feedbackBuffersMemory.resize(_framesInFlight);
+    m_feedbackBuffersMapped.resize(_framesInFlight);
+    m_feedbackInfos.resize(_framesInFlight);
+    m_stagingBuffers.resize(_framesInFlight);
+    m_stagingBuffersMemory.resize(_framesInFlight);
+    m_stagingBuffersMapped.resize(_framesInFlight);
+    m_pendingCopies.resize(_framesInFlight);
+    m_pendingPageTableCopy.assign(_framesInFlight, false);
+
+    for (uint32_t i = 0; i < _framesInFlight; i++)
+    {
+        _context.getMemoryBudget().createBuffer(_context.getDevice(), feedbackSize,
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging,
+                                                m_feedbackBuffers[i], m_feedbackBuffersMemory[i]);
+        vkMapMemory(_context.getDevice(), m_feedbackBuffersMemory[i], 0, feedbackSize, 0, reinterpret_cast<void**>(&m_feedbackBuffersMapped[i]));
+        std::memset(m_feedbackBuffersMapped[i], 0, feedbackSize);
+
+        _context.getMemoryBudget().createBuffer(_context.getDevice(), stagingSize,
+                                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging,
+                                                m_stagingBuffers[i], m_stagingBuffersMemory[i]);
+        vkMapMemory(_context.getDevice(), m_stagingBuffersMemory[i], 0, stagingSize, 0, reinterpret_cast<void**>(&m_stagingBuffersMapped[i]));
+    }
+
+
+    // 3. -----------------------------------------------------------------------------------------
+    // The coarsest mip (a single tile) is loaded synchronously and pinned,
+    // so every virtual page always has a resident ancestor
+    uint32_t coarsestPage = pageCount - 1;
+    uint32_t slot = allocateSlot(coarsestPage);
+    m_slotLastUsed[slot] = UINT64_MAX;
+
+    std::vector<uint8_t> pixels(tileBytes);
+    m_file.readTile(coarsestPage, pixels.data());
+    storeTile(0, slot, pixels.data(), 0);
+    rebuildPageTable();
+    std::memcpy(m_stagingBuffersMapped[0] + MAX_UPLOADS_PER_FRAME * tileBytes, m_pageTable.data(), m_pageTableSize);
+
+    m_atlas.transitionImageLayout(_context, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(_context.getDevice(), _context.getCommandPool());
+
+    vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffers[0], m_atlas.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(m_pendingCopies[0].size()), m_pendingCopies[0].data());
+
+    VkBufferCopy pageTableRegion{};
+    pageTableRegion.srcOffset = MAX_UPLOADS_PER_FRAME * tileBytes;
+    pageTableRegion.dstOffset = 0;
+    pageTableRegion.size = m_pageTableSize;
+    vkCmdCopyBuffer(commandBuffer, m_stagingBuffers[0], m_pageTableBuffer, 1, &pageTableRegion);
+
+    endSingleTimeCommands(_context.getDevice(), commandBuffer, _context.getCommandPool(), _context.getGraphicsTimeline());
+
+    m_atlas.transitionImageLayout(_context, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    m_pendingCopies[0].clear();
+    m_pageTableDirty = false;
+
+
+    // 4. -----------------------------------------------------------------------------------------
+    // Starts the streaming thread (owns m_file from now on)
+    m_stopStreaming = false;
+    m_streamer = std::thread(&VirtualTexture::streamingLoop, this);
+
+    infoLog() << "VirtualTexture::create(): OK ";
+}
+
+
+/*
+ * Stops the streaming thread, destroys buffers and frees memory
+ */
+void VirtualTexture::cleanup(Context& _context)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_stopStreaming = true;
+    }
+    m_streamCondition.notify_all();
+    if (m_streamer.joinable()) {
+        m_streamer.join();
+    }
+
+    for (size_t i = 0; i < m_feedbackBuffers.size(); i++)
+    {
+        vkDestroyBuffer(_context.getDevice(), m_feedbackBuffers[i], nullptr);
+        _context.getMemoryBudget().free(_context.getDevice(), m_feedbackBuffersMemory[i]);
+        vkDestroyBuffer(_context.getDevice(), m_stagingBuffers[i], nullptr);
+        _context.getMemoryBudget().free(_context.getDevice(), m_stagingBuffersMemory[i]);
+    }
+
+    vkDestroyBuffer(_context.getDevice(), m_pageTableBuffer, nullptr);
+    _context.getMemoryBudget().free(_context.getDevice(), m_pageTableBufferMemory);
+
+    // m_atlasSampler is owned by the context's sampler cache
+    m_atlas.cleanup(_context);
+}
+
+
+/*
+ * Bindings of the page table, atlas and feedback buffer (fragment shader)
+ */
+void VirtualTexture::addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings)
+{
+    VkDescriptorSetLayoutBinding pageTableBinding{};
+    pageTableBinding.binding = PAGE_TABLE_BINDING;
+    pageTableBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pageTableBinding.descriptorCount = 1;
+    pageTableBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pageTableBinding.pImmutableSamplers = nullptr;
+    _bindings.push_back(pageTableBinding);
+
+    VkDescriptorSetLayoutBinding atlasBinding{};
+    atlasBinding.binding = ATLAS_BINDING;
+    atlasBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    atlasBinding.descriptorCount = 1;
+    atlasBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    atlasBinding.pImmutableSamplers = nullptr;
+    _bindings.push_back(atlasBinding);
+
+    VkDescriptorSetLayoutBinding feedbackBinding{};
+    feedbackBinding.binding = FEEDBACK_BINDING;
+    feedbackBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    feedbackBinding.descriptorCount = 1;
+    feedbackBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    feedbackBinding.pImmutableSamplers = nullptr;
+    _bindings.push_back(feedbackBinding);
+}
+
+
+/*
+ * Descriptors required by the virtual texture (one descriptor set per frame in flight)
+ */
+void VirtualTexture::addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight)
+{
+    VkDescriptorPoolSize storageSize{};
+    storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageSize.descriptorCount = 2 * _framesInFlight;
+    _poolSizes.push_back(storageSize);
+
+    VkDescriptorPoolSize samplerSize{};
+    samplerSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerSize.descriptorCount = _framesInFlight;
+    _poolSizes.push_back(samplerSize);
+}
+
+
+/*
+ * Descriptor writes for the descriptor set of a given frame in flight
+ */
+void VirtualTexture::addDescriptorWrites(VkDescriptorSet _descriptorSet, uint32_t _frameIndex, std::vector<VkWriteDescriptorSet>& _writes)
+{
+    m_pageTableInfo.buffer = m_pageTableBuffer;
+    m_pageTableInfo.offset = 0;
+    m_pageTableInfo.range = m_pageTableSize;
+
+    m_atlasInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    m_atlasInfo.imageView = m_atlas.getImageView();
+    m_atlasInfo.sampler = m_atlasSampler;
+
+    m_feedbackInfos[_frameIndex].buffer = m_feedbackBuffers[_frameIndex];
+    m_feedbackInfos[_frameIndex].offset = 0;
+    m_feedbackInfos[_frameIndex].range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _descriptorSet;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+
+    write.dstBinding = PAGE_TABLE_BINDING;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &m_pageTableInfo;
+    _writes.push_back(write);
+
+    write.dstBinding = FEEDBACK_BINDING;
+    write.pBufferInfo = &m_feedbackInfos[_frameIndex];
+    _writes.push_back(write);
+
+    write.dstBinding = ATLAS_BINDING;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pBufferInfo = nullptr;
+    write.pImageInfo = &m_atlasInfo;
+    _writes.push_back(write);
+}
+
+
+/*
+ * Reads the feedback of a frame (its timeline value is reached), forwards missing pages to the streaming thread,
+ * and stages the tiles loaded since last frame
+ */
+void VirtualTexture::update(uint32_t _frameIndex)
+{
+    m_frameCounter++;
+    m_pendingCopies[_frameIndex].clear();
+    m_pendingPageTableCopy[_frameIndex] = false;
+
+    // 1. -----------------------------------------------------------------------------------------
+    // Collect requested pages, refresh LRU timestamps of resident ones
+    uint32_t* feedback = m_feedbackBuffersMapped[_frameIndex];
+    std::vector<uint32_t> requests;
+
+    for (uint32_t page = 0; page < m_file.getPageCount(); page++)
+    {
+        if (feedback[page] == 0)
+            continue;
+
+        feedback[page] = 0;
+
+        uint32_t slot = m_pageToSlot[page];
+        if (slot == INVALID_SLOT) {
+            requests.push_back(page);
+        }
+        else if (m_slotLastUsed[slot] != UINT64_MAX) {
+            m_slotLastUsed[slot] = m_frameCounter;
+        }
+    }
+
+    // coarse mips first (stored after the fine ones), so that refinement is progressive
+    std::reverse(requests.begin(), requests.end());
+
+
+    // 2. -----------------------------------------------------------------------------------------
+    // Replace the request queue (outdated requests are dropped) and fetch loaded tiles
+    std::vector<LoadedTile> loadedTiles;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_requestQueue.assign(requests.begin(), requests.end());
+
+        size_t count = std::min<size_t>(m_loadedTiles.size(), MAX_UPLOADS_PER_FRAME);
+        loadedTiles.assign(std::make_move_iterator(m_loadedTiles.begin()), std::make_move_iterator(m_loadedTiles.begin() + count));
+        m_loadedTiles.erase(m_loadedTiles.begin(), m_loadedTiles.begin() + count);
+    }
+    m_streamCondition.notify_one();
+
+
+    // 3. -----------------------------------------------------------------------------------------
+    // Stage loaded tiles, evicting least recently used slots
+    VkDeviceSize stagingOffset = 0;
+    for (LoadedTile const& tile : loadedTiles)
+    {
+        if (m_pageToSlot[tile.pageIndex] != INVALID_SLOT)
+            continue; // already resident (requested twice)
+
+        uint32_t slot = allocateSlot(tile.pageIndex);
+        if (slot == INVALID_SLOT)
+            break; // every slot is in use by the current frame
+
+        storeTile(_frameIndex, slot, tile.pixels.data(), stagingOffset);
+        stagingOffset += m_file.getTileBytes();
+        m_pageTableDirty = true;
+    }
+
+    if (m_pageTableDirty)
+    {
+        rebuildPageTable();
+        std::memcpy(m_stagingBuffersMapped[_frameIndex] + MAX_UPLOADS_PER_FRAME * m_file.getTileBytes(), m_pageTable.data(), m_pageTableSize);
+        m_pendingPageTableCopy[_frameIndex] = true;
+        m_pageTableDirty = false;
+    }
+}
+
+
+/*
+ * Records the copies of the staged tiles and page table
+ * (barriers wait for the shader reads of previous frames)
+ */
+void VirtualTexture::recordUploads(VkCommandBuffer _commandBuffer, uint32_t _frameIndex)
+{
+    std::vector<VkBufferImageCopy> const& copies = m_pendingCopies[_frameIndex];
+
+    if (!copies.empty())
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_atlas.getImage();
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(_commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        vkCmdCopyBufferToImage(_commandBuffer, m_stagingBuffers[_frameIndex], m_atlas.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(copies.size()), copies.data());
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(_commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+    }
+
+    if (m_pendingPageTableCopy[_frameIndex])
+    {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_pageTableBuffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(_commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+
+        VkBufferCopy region{};
+        region.srcOffset = MAX_UPLOADS_PER_FRAME * m_file.getTileBytes();
+        region.dstOffset = 0;
+        region.size = m_pageTableSize;
+        vkCmdCopyBuffer(_commandBuffer, m_stagingBuffers[_frameIndex], m_pageTableBuffer, 1, &region);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(_commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+    }
+}
+
+
+/*
+ * Makes the feedback written by the fragment shader visible to the host
+ */
+void VirtualTexture::recordFeedbackBarrier(VkCommandBuffer _commandBuffer, uint32_t _frameIndex)
+{
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_feedbackBuffers[_frameIndex];
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(_commandBuffer,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr,
+        1, &barrier,
+        0, nullptr);
+}
+
+
+/*
+ * Loads requested tiles from disk, in the background
+ */
+void VirtualTexture::streamingLoop()
+{
+    const size_t maxLoadedTiles = 4 * MAX_UPLOADS_PER_FRAME;
+
+    while (true)
+    {
+        uint32_t pageIndex;
+        {
+            std::unique_lock<std::mutex> lock(m_streamMutex);
+            m_streamCondition.wait(lock, [&]() {
+                return m_stopStreaming || (!m_requestQueue.empty() && m_loadedTiles.size() < maxLoadedTiles);
+            });
+
+            if (m_stopStreaming)
+                return;
+
+            pageIndex = m_requestQueue.front();
+            m_requestQueue.pop_front();
+        }
+
+        LoadedTile tile;
+        tile.pageIndex = pageIndex;
+        tile.pixels.resize(m_file.getTileBytes());
+        try
+        {
+            m_file.readTile(pageIndex, tile.pixels.data());
+        }
+        catch (const std::exception& e)
+        {
+            errorLog() << e.what();
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_loadedTiles.push_back(std::move(tile));
+    }
+}
+
+
+/*
+ * Finds an atlas slot for a page: a free one, or the least recently used one
+ * (slots requested by the current frame and pinned slots are never evicted)
+ */
+uint32_t VirtualTexture::allocateSlot(uint32_t _pageIndex)
+{
+    uint32_t slot = INVALID_SLOT;
+
+    for (uint32_t i = 0; i < m_slotToPage.size(); i++)
+    {
+        if (m_slotToPage[i] == INVALID_SLOT)
+        {
+            slot = i;
+            break; // early exit
+        }
+        if (m_slotLastUsed[i] < m_frameCounter && (slot == INVALID_SLOT || m_slotLastUsed[i] < m_slotLastUsed[slot]))
+        {
+            slot = i;
+        }
+    }
+
+    if (slot == INVALID_SLOT)
+        return INVALID_SLOT;
+
+    // evict previous page
+    if (m_slotToPage[slot] != INVALID_SLOT)
+    {
+        m_pageToSlot[m_slotToPage[slot]] = INVALID_SLOT;
+        m_residentCount--;
+    }
+
+    m_slotToPage[slot] = _pageIndex;
+    m_pageToSlot[_pageIndex] = slot;
+    m_slotLastUsed[slot] = m_frameCounter;
+    m_residentCount++;
+
+    return slot;
+}
+
+
+/*
+ * Copies a tile into the staging buffer of a frame, and prepares its copy into the atlas
+ */
+void VirtualTexture::storeTile(uint32_t _frameIndex, uint32_t _slot, uint8_t const* _pixels, VkDeviceSize _stagingOffset)
+{
+    std::memcpy(m_stagingBuffersMapped[_frameIndex] + _stagingOffset, _pixels, m_file.getTileBytes());
+
+    uint32_t padded = m_file.getPaddedTileSize();
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = _stagingOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { static_cast<int32_t>((_slot % ATLAS_PAGES) * padded), static_cast<int32_t>((_slot / ATLAS_PAGES) * padded), 0 };
+    region.imageExtent = { padded, padded, 1 };
+
+    m_pendingCopies[_frameIndex].push_back(region);
+}
+
+
+/*
+ * Rebuilds the page table entries from the coarsest to the finest mip:
+ * resident pages point to their own slot, other pages to the entry of their parent page
+ * Entry layout: atlas x (12 bits) | atlas y (12 bits) | resident mip (7 bits) | valid (1 bit)
+ */
+void VirtualTexture::rebuildPageTable()
+{
+    uint32_t mipCount = m_file.getHeader().mipCount;
+
+    for (int32_t mip = static_cast<int32_t>(mipCount) - 1; mip >= 0; mip--)
+    {
+        uint32_t pagesX = m_file.getPagesX(mip);
+        uint32_t pagesY = m_file.getPagesY(mip);
+
+        for (uint32_t y = 0; y < pagesY; y++)
+        {
+            for (uint32_t x = 0; x < pagesX; x++)
+            {
+                uint32_t page = m_file.getPageIndex(mip, x, y);
+                uint32_t slot = m_pageToSlot[page];
+                uint32_t entry = 0;
+
+                if (slot != INVALID_SLOT)
+                {
+                    entry = (slot % ATLAS_PAGES) | ((slot / ATLAS_PAGES) << 12) | (static_cast<uint32_t>(mip) << 24) | (1u << 31);
+                }
+                else if (mip + 1 < static_cast<int32_t>(mipCount))
+                {
+                    uint32_t parentX = std::min(x / 2, m_file.getPagesX(mip + 1) - 1);
+                    uint32_t parentY = std::min(y / 2, m_file.getPagesY(mip + 1) - 1);
+                    entry = m_pageTable[PAGE_TABLE_HEADER_SIZE + m_file.getPageIndex(mip + 1, parentX, parentY)];
+                }
+
+                m_pageTable[PAGE_TABLE_HEADER_SIZE + page] = entry;
+            }
+        }
+    }
+}
+
+
+} // namespace VulkanDemo
\ No newline at end of file
@@ -0,0 +1,193 @@
+/*********************************************************************************************************************
+ *
+ * virtualtexture.h
+ *
+ * Virtual texture streamed by tiles from a tiled on-disk file (.vtex)
+ * Only the tiles requested by the GPU feedback pass are kept in a fixed-size physical atlas,
+ * so VRAM usage is bounded regardless of the size of the source texture:
+ *  - the page table (storage buffer) maps every virtual page of every mip to an atlas slot,
+ *    non-resident pages point to their closest resident ancestor
+ *  - the fragment shader writes the pages it needs in a feedback buffer (one per frame in flight)
+ *  - a background thread reads the requested tiles from disk, the main thread uploads them
+ *    into the atlas and evicts the least recently used ones
+ *
+ * Vulkan_demo
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+
+#include "utils.h"
+#include "image.h"
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace VulkanDemo
+{
+
+class Context;
+
+
+/*
+ * Tiled on-disk texture format:
+ *  - header (TiledTextureHeader)
+ *  - RGBA8 tiles of (tileSize + 2 * border)^2 pixels, stored mip by mip, row by row
+ */
+struct TiledTextureHeader
+{
+    char magic[4] = { 'V', 'T', 'E', 'X' };
+    uint32_t version = 1;
+    uint32_t width = 0;         // virtual texture size (at mip 0)
+    uint32_t height = 0;
+    uint32_t tileSize = 128;    // nb of useful pixels per tile side
+    uint32_t border = 1;        // nb of pixels duplicated from neighbour tiles (for bilinear filtering)
+    uint32_t mipCount = 1;      // the coarsest mip fits into one tile
+    uint32_t pad = 0;
+};
+
+
+class TiledTextureFile
+{
+
+public:
+
+    TiledTextureFile() = default;
+
+    TiledTextureHeader const& getHeader() const { return m_header; }
+    uint32_t getPaddedTileSize() const { return m_header.tileSize + 2 * m_header.border; }
+    size_t getTileBytes() const { return static_cast<size_t>(getPaddedTileSize()) * getPaddedTileSize() * 4; }
+
+    uint32_t getPagesX(uint32_t _mip) const;
+    uint32_t getPagesY(uint32_t _mip) const;
+    uint32_t getPageCount() const { return m_mipOffsets.back(); }
+    uint32_t getPageIndex(uint32_t _mip, uint32_t _x, uint32_t _y) const { return m_mipOffsets[_mip] + _y * getPagesX(_mip) + _x; }
+    void getPageCoords(uint32_t _pageIndex, uint32_t& _mip, uint32_t& _x, uint32_t& _y) const;
+
+    void open(std::string const& _path);
+    void readTile(uint32_t _pageIndex, uint8_t* _dst);
+
+    // source images are decoded at once by stb_image, which decodes at most 2^31 bytes (RGBA8)
+    static constexpr uint64_t MAX_CONVERT_PIXELS = (1ull << 31) / 4;
+
+    static void convert(std::string const& _srcPath, std::string const& _dstPath, uint32_t _tileSize, uint32_t _border);
+
+
+protected:
+
+    TiledTextureHeader m_header;
+    std::vector<uint32_t> m_mipOffsets;     // index of the first page of each mip (+ total nb of pages)
+    std::ifstream m_file;
+
+    void computeMipOffsets();
+
+}; // class TiledTextureFile
+
+
+
+class VirtualTexture
+{
+
+public:
+
+    // bindings used by the virtual texture in the descriptor set of the app
+    static constexpr uint32_t PAGE_TABLE_BINDING = 2;
+    static constexpr uint32_t ATLAS_BINDING = 3;
+    static constexpr uint32_t FEEDBACK_BINDING = 4;
+
+    static constexpr uint32_t ATLAS_PAGES = 32;             // the atlas stores ATLAS_PAGES^2 tiles
+    static constexpr uint32_t MAX_UPLOADS_PER_FRAME = 16;   // nb of tiles uploaded per frame, at most
+
+    VirtualTexture() = default;
+
+    // owns a streaming thread, cannot be duplicated
+    VirtualTexture(VirtualTexture const& _other) = delete;
+    VirtualTexture& operator=(VirtualTexture const& _other) = delete;
+
+    virtual ~VirtualTexture() {};
+
+
+    uint32_t getResidentPageCount() const { return m_residentCount; }
+
+    void create(Context& _context, std::string const& _path, uint32_t _framesInFlight);
+    void cleanup(Context& _context);
+
+    static void addDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& _bindings);
+    static void addDescriptorPoolSizes(std::vector<VkDescriptorPoolSize>& _poolSizes, uint32_t _framesInFlight);
+    void addDescriptorWrites(VkDescriptorSet _descriptorSet, uint32_t _frameIndex, std::vector<VkWriteDescriptorSet>& _writes);
+
+    // used in drawFrame(), once the timeline value of the frame is reached
+    void update(uint32_t _frameIndex);
+    // used in recordCommandBuffer(), before and after the render pass
+    void recordUploads(VkCommandBuffer _commandBuffer, uint32_t _frameIndex);
+    void recordFeedbackBarrier(VkCommandBuffer _commandBuffer, uint32_t _frameIndex);
+
+
+protected:
+
+    static constexpr uint32_t INVALID_SLOT = 0xFFFFFFFF;
+    static constexpr uint32_t PAGE_TABLE_HEADER_SIZE = 8; // nb of uints in front of the page table entries
+
+    struct LoadedTile
+    {
+        uint32_t pageIndex;
+        std::vector<uint8_t> pixels;
+    };
+
+    TiledTextureFile m_file;
+
+    // physical storage
+    Image m_atlas;
+    VkSampler m_atlasSampler = nullptr;
+    VkBuffer m_pageTableBuffer;
+    VkDeviceMemory m_pageTableBufferMemory;
+    std::vector<VkBuffer> m_feedbackBuffers;            // one per frame in flight
+    std::vector<VkDeviceMemory> m_feedbackBuffersMemory;
+    std::vector<uint32_t*> m_feedbackBuffersMapped;
+    std::vector<VkBuffer> m_stagingBuffers;             // one per frame in flight
+    std::vector<VkDeviceMemory> m_stagingBuffersMemory;
+    std::vector<uint8_t*> m_stagingBuffersMapped;
+    VkDeviceSize m_pageTableSize = 0;
+
+    // descriptor infos, must live until vkUpdateDescriptorSets()
+    VkDescriptorBufferInfo m_pageTableInfo{};
+    VkDescriptorImageInfo m_atlasInfo{};
+    std::vector<VkDescriptorBufferInfo> m_feedbackInfos;
+
+    // residency (main thread only)
+    std::vector<uint32_t> m_pageToSlot;         // atlas slot of each virtual page
+    std::vector<uint32_t> m_slotToPage;         // virtual page stored in each atlas slot
+    std::vector<uint64_t> m_slotLastUsed;       // frame at which each slot was last requested (LRU)
+    std::vector<uint32_t> m_pageTable;          // CPU copy of the page table (header + entries)
+    uint32_t m_residentCount = 0;
+    uint64_t m_frameCounter = 0;
+    bool m_pageTableDirty = false;
+
+    // uploads prepared by update(), recorded by recordUploads()
+    std::vector<std::vector<VkBufferImageCopy> > m_pendingCopies;
+    std::vector<bool> m_pendingPageTableCopy;
+
+    // streaming (shared with the loading thread)
+    std::thread m_streamer;
+    std::mutex m_streamMutex;
+    std::condition_variable m_streamCondition;
+    std::deque<uint32_t> m_requestQueue;
+    std::vector<LoadedTile> m_loadedTiles;
+    bool m_stopStreaming = false;
+
+    void streamingLoop();
+    uint32_t allocateSlot(uint32_t _pageIndex);
+    void storeTile(uint32_t _frameIndex, uint32_t _slot, uint8_t const* _pixels, VkDeviceSize _stagingOffset);
+    void rebuildPageTable();
+
+}; // class VirtualTexture
+
+} // namespace VulkanDemo
+
+#endif // VIRTUALTEXTURE_H
\ No newline at end of file